@@ -0,0 +1,68 @@
+// Counter::Inc from 1 to 64 threads: the single-atomic layout every counter used before versus the
+// striped layout of per-request counters such as http_server_requests_total.
+//
+//   chmicro_bench_counter [increments per thread]
+
+#include <chmicro/core/metrics.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Wall time for `threads` threads to each add `increments` to one counter, in ns per increment
+// summed over all threads.
+double NsPerInc(chmicro::CounterLayout layout, std::size_t threads, std::size_t increments) {
+    chmicro::Counter counter(layout);
+    std::atomic<std::size_t> ready{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> pool;
+    for (std::size_t t = 0; t < threads; ++t) {
+        pool.emplace_back([&] {
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            for (std::size_t i = 0; i < increments; ++i) {
+                counter.Inc();
+            }
+        });
+    }
+    while (ready.load() != threads) {
+        std::this_thread::yield();
+    }
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& t : pool) {
+        t.join();
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    auto total = static_cast<std::int64_t>(threads * increments);
+    if (counter.Value() != total) {
+        std::printf("lost increments: %lld of %lld\n", static_cast<long long>(total - counter.Value()),
+            static_cast<long long>(total));
+    }
+    return elapsed / static_cast<double>(total);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::size_t increments = argc > 1 ? static_cast<std::size_t>(std::strtoull(argv[1], nullptr, 10)) : 5000000;
+
+    std::printf("counter increments (%zu per thread, %u hardware threads, %zu stripes)\n", increments,
+        std::thread::hardware_concurrency(), chmicro::MetricStripeCount());
+    std::printf("  threads   single ns/inc   striped ns/inc   speedup\n");
+    for (std::size_t threads : {1, 2, 4, 8, 16, 32, 64}) {
+        auto single = NsPerInc(chmicro::CounterLayout::single, threads, increments);
+        auto striped = NsPerInc(chmicro::CounterLayout::striped, threads, increments);
+        std::printf("  %7zu   %13.2f   %14.2f   %6.2fx\n", threads, single, striped, single / striped);
+    }
+    return 0;
+}
@@ -0,0 +1,121 @@
+// Scraping a registry with 50k series: render time, and how long a registry lookup on the request
+// path (CounterMetric for a new or existing series) waits while scrapes run back to back.
+//
+//   chmicro_bench_exposition [scrapes]
+
+#include <chmicro/core/metrics.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// 30k counters, 10k gauges, 9k histograms and 1k log-linear histograms.
+void Populate(chmicro::MetricsRegistry& registry) {
+    for (int route = 0; route < 1000; ++route) {
+        auto path = "/api/v1/resource" + std::to_string(route);
+        for (int status : {200, 201, 204, 301, 304, 400, 401, 403, 404, 409, 412, 429, 500, 502, 503,
+                 504, 202, 206, 302, 307, 405, 406, 408, 410, 411, 413, 414, 415, 416, 501}) {
+            registry.CounterMetric("bench_requests_total", "Requests", {{{"path", path}, {"status", std::to_string(status)}}})
+                .Inc(route + status);
+        }
+        for (int i = 0; i < 10; ++i) {
+            registry.GaugeMetric("bench_inflight", "In flight", {{{"path", path}, {"slot", std::to_string(i)}}}).Set(i);
+        }
+        for (int i = 0; i < 9; ++i) {
+            registry.HistogramMetric("bench_request_ms", "Latency", {0.25, 0.5, 1, 2, 5, 10, 25, 50, 100},
+                {{{"path", path}, {"shard", std::to_string(i)}}})
+                .Observe(route % 100);
+        }
+        registry.LogLinearMetric("bench_request_loglinear_ms", "Latency", {{{"path", path}}}).Observe(route);
+    }
+}
+
+// Per-lookup wait, in microseconds, of a thread resolving series while `scraping` is set.
+chmicro::LogLinearSnapshot LookupWaits(chmicro::MetricsRegistry& registry, const std::atomic<bool>& scraping,
+    std::atomic<bool>& started) {
+    chmicro::LogLinearOptions opt;
+    opt.resolution = 1;
+    chmicro::LogLinearHistogram waits(opt);
+    std::size_t i = 0;
+    while (!started.load() || scraping.load()) {
+        auto path = "/lookup" + std::to_string(i++ % 100);
+        auto start = Clock::now();
+        registry.CounterMetric("bench_lookup_total", "Lookups", {{{"path", std::move(path)}}}).Inc();
+        waits.Observe(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    return waits.Snapshot();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::size_t scrapes = argc > 1 ? static_cast<std::size_t>(std::strtoull(argv[1], nullptr, 10)) : 20;
+
+    chmicro::MetricsRegistry registry;
+    // bench_requests_total alone has 30k series, over the default limit.
+    registry.SetDefaultSeriesLimit(0);
+    Populate(registry);
+
+    std::string text;
+    auto start = Clock::now();
+    for (std::size_t i = 0; i < scrapes; ++i) {
+        text = registry.ToPrometheusText();
+    }
+    auto to_text_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / static_cast<double>(scrapes);
+
+    std::string buffer;
+    double write_ms[2] = {};
+    for (auto format : {chmicro::ExpositionFormat::prometheus, chmicro::ExpositionFormat::openmetrics}) {
+        start = Clock::now();
+        for (std::size_t i = 0; i < scrapes; ++i) {
+            buffer.clear();
+            registry.WriteText(buffer, format);
+        }
+        write_ms[static_cast<int>(format)] =
+            std::chrono::duration<double, std::milli>(Clock::now() - start).count() / static_cast<double>(scrapes);
+    }
+
+    std::printf("exposition of 50000 series (%zu scrapes, %zu bytes)\n", scrapes, text.size());
+    std::printf("  ToPrometheusText          %8.2f ms/scrape\n", to_text_ms);
+    std::printf("  WriteText, reused buffer  %8.2f ms/scrape\n", write_ms[0]);
+    std::printf("  WriteText, OpenMetrics    %8.2f ms/scrape\n", write_ms[1]);
+
+    // Lookups alone, then with a scraper thread rendering back to back.
+    std::atomic<bool> scraping{true};
+    std::atomic<bool> started{true};
+    std::thread idle_timer([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        scraping = false;
+    });
+    auto idle = LookupWaits(registry, scraping, started);
+    idle_timer.join();
+
+    started = false;
+    scraping = true;
+    std::thread scraper([&] {
+        started = true;
+        for (std::size_t i = 0; i < scrapes; ++i) {
+            buffer.clear();
+            registry.WriteText(buffer, chmicro::ExpositionFormat::prometheus);
+        }
+        scraping = false;
+    });
+    auto busy = LookupWaits(registry, scraping, started);
+    scraper.join();
+
+    std::printf("registry lookup wait (us)    p50      p99    p99.9      max\n");
+    std::printf("  idle                  %8.1f %8.1f %8.1f %8.1f\n", idle.Quantile(0.5), idle.Quantile(0.99),
+        idle.Quantile(0.999), idle.Quantile(1.0));
+    std::printf("  while scraping        %8.1f %8.1f %8.1f %8.1f\n", busy.Quantile(0.5), busy.Quantile(0.99),
+        busy.Quantile(0.999), busy.Quantile(1.0));
+    return 0;
+}
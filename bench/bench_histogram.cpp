@@ -0,0 +1,108 @@
+// Histogram::Observe from 1 to 64 threads: the mutex-guarded histogram used before versus the
+// sharded lock-free one, with the buckets of http_server_request_ms.
+//
+//   chmicro_bench_histogram [observations per thread]
+
+#include <chmicro/core/metrics.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// The previous Histogram: one mutex around the counts and the sum.
+class MutexHistogram {
+public:
+    explicit MutexHistogram(std::vector<double> buckets) : buckets_(std::move(buckets)), counts_(buckets_.size(), 0) {}
+
+    void Observe(double v) {
+        std::lock_guard<std::mutex> lk(mu_);
+        sum_ += v;
+        ++count_;
+        auto it = std::lower_bound(buckets_.begin(), buckets_.end(), v);
+        if (it != buckets_.end()) {
+            ++counts_[static_cast<std::size_t>(it - buckets_.begin())];
+        }
+    }
+
+    std::uint64_t Count() {
+        std::lock_guard<std::mutex> lk(mu_);
+        return count_;
+    }
+
+private:
+    std::vector<double> buckets_;
+    std::mutex mu_;
+    std::vector<std::uint64_t> counts_;
+    double sum_ = 0.0;
+    std::uint64_t count_ = 0;
+};
+
+const std::vector<double> kBuckets{0.25, 0.5, 1, 2, 5, 10, 25, 50, 100};
+
+// Wall time for `threads` threads to each make `observations` observations, in ns per observation
+// summed over all threads.
+template <class Hist>
+double NsPerObserve(Hist& hist, std::size_t threads, std::size_t observations) {
+    std::atomic<std::size_t> ready{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> pool;
+    for (std::size_t t = 0; t < threads; ++t) {
+        pool.emplace_back([&, t] {
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            // Latencies spread over the buckets.
+            double v = 0.1 * static_cast<double>(t + 1);
+            for (std::size_t i = 0; i < observations; ++i) {
+                hist.Observe(v);
+                v = v > 150 ? 0.1 : v * 1.3;
+            }
+        });
+    }
+    while (ready.load() != threads) {
+        std::this_thread::yield();
+    }
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& t : pool) {
+        t.join();
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return elapsed / static_cast<double>(threads * observations);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::size_t observations = argc > 1 ? static_cast<std::size_t>(std::strtoull(argv[1], nullptr, 10)) : 2000000;
+
+    std::printf("histogram observations (%zu per thread, %u hardware threads, %zu shards)\n", observations,
+        std::thread::hardware_concurrency(), chmicro::MetricStripeCount());
+    std::printf("  threads   mutex ns/obs   sharded ns/obs   speedup\n");
+    for (std::size_t threads : {1, 2, 4, 8, 16, 32, 64}) {
+        MutexHistogram locked(kBuckets);
+        chmicro::Histogram sharded(kBuckets);
+        auto mutex_ns = NsPerObserve(locked, threads, observations);
+        auto sharded_ns = NsPerObserve(sharded, threads, observations);
+
+        std::vector<std::uint64_t> counts;
+        double sum = 0.0;
+        std::uint64_t count = 0;
+        sharded.Snapshot(counts, sum, count);
+        if (count != locked.Count() || count != threads * observations) {
+            std::printf("lost observations: %llu\n", static_cast<unsigned long long>(threads * observations - count));
+        }
+        std::printf("  %7zu   %12.2f   %14.2f   %6.2fx\n", threads, mutex_ns, sharded_ns, mutex_ns / sharded_ns);
+    }
+    return 0;
+}
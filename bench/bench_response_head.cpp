@@ -0,0 +1,106 @@
+// Per-request cost of serializing the response header block: the previous beast::http::fields
+// path versus the pre-encoded AppendResponseHead path used by HttpServer.
+//
+//   chmicro_bench_response_head [iterations]
+
+#include <chmicro/http/response_writer.h>
+#include <chmicro/http/types.h>
+
+#include <boost/beast/http.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <memory_resource>
+#include <string>
+
+namespace {
+
+namespace beast_http = boost::beast::http;
+using chmicro::http::Allocator;
+using chmicro::http::Fields;
+
+// What HttpSession::Respond did before: fill beast fields, then walk them into the output.
+void FieldsHead(std::pmr::string& out, unsigned version, const chmicro::http::Response& resp,
+    const chmicro::TraceContext& trace, bool keep_alive, std::pmr::memory_resource* mr) {
+    beast_http::response_header<Fields> h{Allocator(mr)};
+    h.result(resp.status);
+    h.version(version);
+    h.set(beast_http::field::server, "chmicro/0.1");
+    h.set(beast_http::field::content_type, resp.content_type);
+    h.set("traceparent", trace.ToTraceParent());
+    for (const auto& f : resp.headers) {
+        h.set(f.first, f.second);
+    }
+    h.set(beast_http::field::content_length, std::to_string(resp.body.size()));
+    if (version == 10 && keep_alive) {
+        h.set(beast_http::field::connection, "keep-alive");
+    } else if (version == 11 && !keep_alive) {
+        h.set(beast_http::field::connection, "close");
+    }
+
+    out.append(version == 10 ? "HTTP/1.0 " : "HTTP/1.1 ");
+    out.append(std::to_string(h.result_int()));
+    out.push_back(' ');
+    auto reason = h.reason();
+    out.append(reason.data(), reason.size());
+    out.append("\r\n");
+    for (const auto& f : h) {
+        auto name = f.name_string();
+        auto value = f.value();
+        out.append(name.data(), name.size());
+        out.append(": ");
+        out.append(value.data(), value.size());
+        out.append("\r\n");
+    }
+    out.append("\r\n");
+}
+
+template <class Fn>
+double NsPerOp(std::size_t iterations, Fn&& fn) {
+    // Same shape as the server: a small arena rewound after every response.
+    std::array<std::byte, 8 * 1024> buffer;
+    std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size());
+    std::size_t sink = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < iterations; ++i) {
+        std::pmr::string out(&arena);
+        out.reserve(256);
+        fn(out, &arena);
+        sink += out.size();
+        out = std::pmr::string(&arena);
+        arena.release();
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    if (sink == 0) {
+        std::puts("unexpected empty output");
+    }
+    return elapsed / static_cast<double>(iterations);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::size_t iterations = argc > 1 ? static_cast<std::size_t>(std::strtoull(argv[1], nullptr, 10)) : 1000000;
+
+    chmicro::http::Response resp;
+    resp.SetJson("{\"key\":\"hot\",\"value\":\"v\"}");
+    resp.headers["x-request-id"] = "0123456789abcdef";
+    auto trace = chmicro::TraceContext::NewRoot();
+
+    auto fields = NsPerOp(iterations, [&](std::pmr::string& out, std::pmr::memory_resource* mr) {
+        FieldsHead(out, 11, resp, trace, true, mr);
+    });
+    auto precomputed = NsPerOp(iterations, [&](std::pmr::string& out, std::pmr::memory_resource*) {
+        chmicro::http::AppendResponseHead(out, 11, resp, trace, true);
+    });
+
+    std::printf("header serialization (%zu iterations)\n", iterations);
+    std::printf("  beast fields:  %8.1f ns/response\n", fields);
+    std::printf("  precomputed:   %8.1f ns/response\n", precomputed);
+    std::printf("  speedup:       %8.2fx\n", precomputed > 0 ? fields / precomputed : 0.0);
+    return 0;
+}
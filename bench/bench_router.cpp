@@ -0,0 +1,119 @@
+// Route lookup cost: the exact-path hash map Router used before the radix tree versus
+// Router::Match, for 10, 100 and 1000 routes. The tree is also timed on "{id}" routes, which the
+// hash map cannot express.
+//
+//   chmicro_bench_router [iterations]
+
+#include <chmicro/http/router.h>
+
+#include <boost/functional/hash.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+namespace beast_http = boost::beast::http;
+
+// The previous lookup: (method, path) hash map probed with a borrowed key.
+class HashRouter {
+public:
+    void Add(beast_http::verb method, std::string path) { routes_.emplace(Key{method, std::move(path)}, routes_.size()); }
+
+    const std::size_t* Match(beast_http::verb method, std::string_view path) const {
+        auto it = routes_.find(KeyView{method, path});
+        return it == routes_.end() ? nullptr : &it->second;
+    }
+
+private:
+    struct Key {
+        beast_http::verb method;
+        std::string path;
+    };
+    struct KeyView {
+        beast_http::verb method;
+        std::string_view path;
+    };
+    struct Hash {
+        using is_transparent = void;
+        std::size_t operator()(const Key& k) const { return (*this)(KeyView{k.method, k.path}); }
+        std::size_t operator()(const KeyView& k) const {
+            std::size_t seed = 0;
+            boost::hash_combine(seed, static_cast<unsigned>(k.method));
+            boost::hash_combine(seed, std::hash<std::string_view>{}(k.path));
+            return seed;
+        }
+    };
+    struct Eq {
+        using is_transparent = void;
+        template <class A, class B>
+        bool operator()(const A& a, const B& b) const {
+            return a.method == b.method && std::string_view(a.path) == std::string_view(b.path);
+        }
+    };
+
+    std::unordered_map<Key, std::size_t, Hash, Eq> routes_;
+};
+
+// Route i of a service with `n` routes: a handful of API versions, many resources sharing prefixes.
+std::string Resource(std::size_t i) {
+    return "/api/v" + std::to_string(i % 3 + 1) + "/resource" + std::to_string(i) + "/items";
+}
+
+template <class Fn>
+double NsPerOp(std::size_t iterations, const std::vector<std::string>& paths, Fn&& fn) {
+    std::size_t hits = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < iterations; ++i) {
+        hits += fn(paths[i % paths.size()]) ? 1 : 0;
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    if (hits != iterations) {
+        std::printf("unexpected misses: %zu\n", iterations - hits);
+    }
+    return elapsed / static_cast<double>(iterations);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::size_t iterations = argc > 1 ? static_cast<std::size_t>(std::strtoull(argv[1], nullptr, 10)) : 2000000;
+    const auto get = beast_http::verb::get;
+    auto noop = [](const chmicro::http::Request&, chmicro::http::Response&) {};
+
+    std::printf("route lookup (%zu iterations, ns/lookup)\n", iterations);
+    std::printf("  routes   hash map   radix   radix {id}\n");
+    for (std::size_t n : {10, 100, 1000}) {
+        HashRouter hash;
+        chmicro::http::Router radix;
+        chmicro::http::Router params;
+        std::vector<std::string> paths;
+        std::vector<std::string> param_paths;
+        for (std::size_t i = 0; i < n; ++i) {
+            auto path = Resource(i);
+            hash.Add(get, path);
+            radix.Get(path, noop);
+            paths.push_back(path);
+
+            // "/api/v1/resource7/items" -> "/api/v1/resource7/{id}", looked up as ".../4711".
+            auto base = path.substr(0, path.size() - 5);
+            params.Get(base + "{id}", noop);
+            param_paths.push_back(base + std::to_string(4711 + i));
+        }
+
+        auto hashed = NsPerOp(iterations, paths, [&](const std::string& p) { return hash.Match(get, p) != nullptr; });
+        auto tree = NsPerOp(iterations, paths, [&](const std::string& p) { return radix.Match(get, p) != nullptr; });
+        chmicro::http::PathParams captured;
+        auto tree_params = NsPerOp(iterations, param_paths, [&](const std::string& p) {
+            return params.Match(get, p, &captured) != nullptr;
+        });
+        std::printf("  %6zu   %8.1f   %5.1f   %10.1f\n", n, hashed, tree, tree_params);
+    }
+    return 0;
+}
@@ -0,0 +1,87 @@
+#!/bin/sh
+# Throughput and syscalls per request of the hello and KV examples, epoll build vs io_uring build.
+#
+#   bench/io_backend.sh <epoll-build-dir> <io_uring-build-dir> [seconds]
+#
+# Configure the second build with -DCHMICRO_ENABLE_IO_URING=ON. Both servers are driven by the
+# loadgen of the first build, so only the server's backend differs. Syscalls are counted with
+# `perf stat -e raw_syscalls:sys_enter` (falls back to `strace -c -f`, which slows the server down;
+# its count is still valid, its throughput is not) in a second run after the throughput run; with
+# neither installed the column reads n/a.
+set -eu
+
+EPOLL=$1
+URING=$2
+SECONDS_PER_RUN=${3:-10}
+PORT=${CHMICRO_BENCH_PORT:-18200}
+LOADGEN="$EPOLL/chmicro_loadgen"
+LOAD_ARGS="--threads 2 --concurrency 64 --warmup 1"
+DIR=$(mktemp -d)
+SERVER=""
+trap '[ -n "$SERVER" ] && kill -9 $SERVER 2>/dev/null; rm -rf "$DIR"' EXIT
+
+start_server() { # <binary> <log>
+    "$1" --listen "127.0.0.1:$PORT" --threads 2 >"$2" 2>&1 &
+    SERVER=$!
+    i=0
+    until grep -q "listening" "$2"; do
+        i=$((i + 1))
+        [ $i -le 100 ] || { echo "server did not start: $1" >&2; cat "$2" >&2; exit 1; }
+        sleep 0.1
+    done
+}
+
+stop_server() {
+    kill $SERVER
+    wait $SERVER 2>/dev/null || true
+    SERVER=""
+}
+
+ok_count() { sed -n 's/^ok=\([0-9]*\) .*/\1/p' "$1"; }
+qps() { sed -n 's/^qps=\([0-9.]*\) .*/\1/p' "$1"; }
+
+# Counts the server's syscalls while `loadgen` runs against it; prints the total.
+count_syscalls() { # <target> <out>
+    if command -v perf >/dev/null 2>&1; then
+        perf stat -x, -e raw_syscalls:sys_enter -p $SERVER -o "$DIR/perf.txt" &
+        COUNTER=$!
+        sleep 0.2
+        $LOADGEN --port "$PORT" --target "$1" $LOAD_ARGS --warmup 0 --duration "$SECONDS_PER_RUN" >"$2"
+        kill -INT $COUNTER
+        wait $COUNTER 2>/dev/null || true
+        awk -F, '/raw_syscalls/ { print $1 }' "$DIR/perf.txt"
+    elif command -v strace >/dev/null 2>&1; then
+        strace -c -f -p $SERVER -o "$DIR/strace.txt" &
+        COUNTER=$!
+        sleep 0.5
+        $LOADGEN --port "$PORT" --target "$1" $LOAD_ARGS --warmup 0 --duration "$SECONDS_PER_RUN" >"$2"
+        kill -INT $COUNTER
+        wait $COUNTER 2>/dev/null || true
+        awk '/^100.00/ { print $4 }' "$DIR/strace.txt"
+    else
+        $LOADGEN --port "$PORT" --target "$1" $LOAD_ARGS --warmup 0 --duration 1 >"$2"
+    fi
+}
+
+printf "%-8s %-9s %-16s %12s %14s\n" backend example target qps syscalls/req
+for build in "$EPOLL" "$URING"; do
+    for case in "chmicro_hello /health" "chmicro_kv /get?key=hot"; do
+        set -- $case
+        start_server "$build/$1" "$DIR/server.log"
+        if [ "$1" = chmicro_kv ]; then
+            curl -fsS -X POST "http://127.0.0.1:$PORT/put" -H "Content-Type: application/json" \
+                -d '{"key":"hot","value":"v"}' >/dev/null
+        fi
+        backend=$(sed -n 's/.* reactor threads on \([a-z_]*\).*/\1/p' "$DIR/server.log" | head -n 1)
+
+        $LOADGEN --port "$PORT" --target "$2" $LOAD_ARGS --duration "$SECONDS_PER_RUN" >"$DIR/load.txt"
+        rate=$(qps "$DIR/load.txt")
+
+        calls=$(count_syscalls "$2" "$DIR/counted.txt")
+        requests=$(ok_count "$DIR/counted.txt")
+        per_req=$(awk -v c="${calls:-0}" -v r="${requests:-0}" 'BEGIN { if (r > 0 && c > 0) printf "%.2f", c / r; else print "n/a" }')
+
+        printf "%-8s %-9s %-16s %12s %14s\n" "${backend:-?}" "${1#chmicro_}" "$2" "$rate" "$per_req"
+        stop_server
+    done
+done
@@ -37,6 +37,8 @@ int main(int argc, char** argv) {
     chmicro::AppOptions opt;
     opt.io_threads = 0;
     opt.log_level = "info";
+    // Re-executed as-is by a SIGUSR2 handover.
+    opt.argv.assign(argv, argv + argc);
 
     chmicro::http::ListenAddress listen{"0.0.0.0", 8086};
 
@@ -83,8 +85,7 @@ int main(int argc, char** argv) {
         resp.body = chmicro::DefaultMetrics().ToPrometheusText();
     });
 
-    auto& ioc = app.Io().Next();
-    auto server = std::make_shared<chmicro::http::HttpServer>(ioc, listen, std::move(r));
+    auto server = std::make_shared<chmicro::http::HttpServer>(app.Io(), listen, std::move(r));
     app.AddServer(server);
 
     chmicro::log::info("Press Ctrl+C to stop.");
@@ -1,18 +1,25 @@
 #include <chmicro/core/metrics.h>
+#include <chmicro/http/http_client.h>
 #include <chmicro/http/http_server.h>
+#include <chmicro/http/response_cache.h>
 #include <chmicro/http/router.h>
 #include <chmicro/core/log.h>
+#include <chmicro/resilience/admission_controller.h>
+#include <chmicro/resilience/bulkhead.h>
 #include <chmicro/runtime/app.h>
 
 #include <chjson/chjson.hpp>
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
 #include <memory>
 #include <shared_mutex>
+#include <sstream>
 #include <string>
 #include <string_view>
 #include <unordered_map>
@@ -74,6 +81,17 @@ public:
         return true;
     }
 
+    std::size_t ShardCount() const {
+        return shards_;
+    }
+
+    // Copy of one shard, so callers can stream it without holding the lock across I/O.
+    std::vector<std::pair<std::string, std::string>> SnapshotShard(std::size_t i) const {
+        auto& shard = *table_[i];
+        std::shared_lock<std::shared_mutex> lk(shard.mu);
+        return {shard.kv.begin(), shard.kv.end()};
+    }
+
     std::size_t Size() const {
         std::size_t total = 0;
         for (const auto& shardp : table_) {
@@ -128,10 +146,17 @@ int main(int argc, char** argv) {
     chmicro::AppOptions opt;
     opt.io_threads = 0;
     opt.log_level = "info";
+    // Re-executed as-is by a SIGUSR2 handover.
+    opt.argv.assign(argv, argv + argc);
 
     chmicro::http::ListenAddress listen{"0.0.0.0", 8087};
     std::size_t shards = 64;
     std::size_t max_value_bytes = 4096;
+    chmicro::http::ListenAddress upstream;
+    std::string blob_dir;
+    long cache_ttl_ms = 0;
+    std::uint32_t compute_limit = 0;
+    chmicro::http::HttpServerOptions server_opt;
 
     for (int i = 1; i < argc; ++i) {
         std::string_view a(argv[i]);
@@ -148,6 +173,28 @@ int main(int argc, char** argv) {
             shards = static_cast<std::size_t>(std::atoi(argv[++i]));
         } else if (a == "--max-value" && i + 1 < argc) {
             max_value_bytes = static_cast<std::size_t>(std::atoi(argv[++i]));
+        } else if (a == "--workers" && i + 1 < argc) {
+            opt.worker_threads = static_cast<std::size_t>(std::atoi(argv[++i]));
+        } else if (a == "--upstream" && i + 1 < argc) {
+            if (!ParseListen(argv[++i], upstream)) {
+                std::cerr << "Invalid --upstream, expected host:port\n";
+                return 2;
+            }
+        } else if (a == "--stream-chunk" && i + 1 < argc) {
+            server_opt.stream_chunk_bytes = static_cast<std::size_t>(std::atoi(argv[++i]));
+        } else if (a == "--blob-dir" && i + 1 < argc) {
+            blob_dir = argv[++i];
+        } else if (a == "--no-sendfile") {
+            server_opt.use_sendfile = false;
+        } else if (a == "--admission") {
+            server_opt.admission_controller = std::make_shared<chmicro::resilience::AdmissionController>(
+                chmicro::resilience::AdmissionControllerOptions{});
+        } else if (a == "--reuse-port") {
+            server_opt.reuse_port = true;
+        } else if (a == "--cache-ttl-ms" && i + 1 < argc) {
+            cache_ttl_ms = std::atol(argv[++i]);
+        } else if (a == "--compute-limit" && i + 1 < argc) {
+            compute_limit = static_cast<std::uint32_t>(std::atoi(argv[++i]));
         }
     }
 
@@ -157,7 +204,7 @@ int main(int argc, char** argv) {
     chmicro::http::Router r;
 
     // Middleware: propagate / generate request-id; add a few diagnostic headers.
-    r.Use([&](const chmicro::http::Request& req, chmicro::http::Response& resp, chmicro::http::Next next) {
+    r.Use("request-id", [&](const chmicro::http::Request& req, chmicro::http::Response& resp, chmicro::http::Next next) {
         std::string req_id;
         if (auto it = req.raw.find("x-request-id"); it != req.raw.end()) {
             req_id.assign(it->value().data(), it->value().size());
@@ -170,20 +217,37 @@ int main(int argc, char** argv) {
         next();
     });
 
+    // --cache-ttl-ms: serve repeated /get?key=... from cached responses. Entries are keyed by the
+    // store key, so the write paths below can invalidate exactly what they change. A cached body
+    // carries the traceparent of the request that filled it.
+    std::unique_ptr<chmicro::http::ResponseCache> cache;
+    chmicro::http::RouteOptions get_opt;
+    if (cache_ttl_ms > 0) {
+        chmicro::http::ResponseCacheOptions cache_opt;
+        cache_opt.ttl = std::chrono::milliseconds(cache_ttl_ms);
+        cache_opt.key = [](const chmicro::http::Request& req) { return std::string(req.Query("key")); };
+        cache_opt.name = "kv";
+        cache = std::make_unique<chmicro::http::ResponseCache>(std::move(cache_opt));
+        get_opt.middleware.push_back(cache->AsMiddleware());
+    }
+
+    // Probes and scrapes keep working while --admission sheds load, and skip the request-id headers.
+    chmicro::http::RouteOptions always;
+    always.bypass_admission = true;
+    always.skip_middleware = {"request-id"};
+
     r.Get("/health", [](const chmicro::http::Request&, chmicro::http::Response& resp) {
         resp.status = 200;
         resp.content_type = "text/plain; charset=utf-8";
         resp.body = "ok";
-    });
+    }, always);
 
     r.Get("/stats", [&](const chmicro::http::Request&, chmicro::http::Response& resp) {
         chjson::value j(chjson::value::object{{"keys", chjson::value::integer(static_cast<std::int64_t>(store.Size()))}});
         SetJson(resp, std::move(j));
     });
 
-    // GET /get?key=foo
-    r.Get("/get", [&](const chmicro::http::Request& req, chmicro::http::Response& resp) {
-        std::string key(req.Query("key"));
+    auto get_value = [&](std::string key, const chmicro::http::Request& req, chmicro::http::Response& resp) {
         if (key.empty()) {
             SetJson(resp, chjson::value(chjson::value::object{{"error", chjson::value("missing query param: key")}}), 400);
             return;
@@ -202,8 +266,25 @@ int main(int argc, char** argv) {
             {"traceparent", chjson::value(req.trace.ToTraceParent())},
         });
         SetJson(resp, std::move(j));
+    };
+
+    // GET /get?key=foo
+    r.Get("/get", [&](const chmicro::http::Request& req, chmicro::http::Response& resp) {
+        get_value(std::string(req.Query("key")), req, resp);
+    }, get_opt);
+
+    // GET /kv/foo  (same lookup, key taken from the path)
+    r.Get("/kv/{key}", [&](const chmicro::http::Request& req, chmicro::http::Response& resp) {
+        get_value(std::string(req.Param("key")), req, resp);
     });
 
+    // Body caps are enforced from the request head, so an oversized upload is refused with 413
+    // before it is transferred. /put allows for the JSON envelope and worst-case \\uXXXX escaping.
+    chmicro::http::RouteOptions put_opt;
+    put_opt.max_body_bytes = 6 * max_value_bytes + 1024;
+    chmicro::http::RouteOptions put_stream_opt;
+    put_stream_opt.max_body_bytes = max_value_bytes;
+
     // POST /put  {"key":"k","value":"v"}
     r.Post("/put", [&](const chmicro::http::Request& req, chmicro::http::Response& resp) {
         auto r = chjson::parse(req.raw.body());
@@ -225,11 +306,109 @@ int main(int argc, char** argv) {
             }), 413);
             return;
         }
-        store.Put(std::move(key), std::move(value));
+        // After the write, so a /get that read the old value while it ran is not cached either.
+        store.Put(key, std::move(value));
+        if (cache) {
+            cache->Invalidate(key);
+        }
+        SetJson(resp, chjson::value(chjson::value::object{{"ok", chjson::value(true)}}));
+    }, put_opt);
+
+    // POST /put_stream?key=foo  (raw value as the body)
+    // The body is read chunk by chunk; a chunked upload without Content-Length is rejected as soon
+    // as it crosses --max-value instead of after the whole payload has been buffered.
+    r.PostStream("/put_stream", [&](const chmicro::http::Request& req, chmicro::http::BodyReader& body,
+                                    chmicro::http::Response& resp, chmicro::http::ResponseStream&) -> boost::asio::awaitable<void> {
+        std::string key(req.Query("key"));
+        if (key.empty()) {
+            SetJson(resp, chjson::value(chjson::value::object{{"error", chjson::value("missing query param: key")}}), 400);
+            co_return;
+        }
+
+        std::string value;
+        while (true) {
+            auto chunk = co_await body.Read();
+            if (!chunk.ok()) {
+                // invalid_argument: the body crossed put_stream_opt.max_body_bytes.
+                bool too_large = chunk.status().code() == chmicro::StatusCode::invalid_argument;
+                SetJson(resp, chjson::value(chjson::value::object{{"error", chjson::value(chunk.status().message())}}), too_large ? 413 : 400);
+                co_return;
+            }
+            if (chunk.value().empty()) {
+                break;
+            }
+            if (value.size() + chunk.value().size() > max_value_bytes) {
+                SetJson(resp, chjson::value(chjson::value::object{
+                    {"error", chjson::value("value too large")},
+                    {"max", chjson::value::integer(static_cast<std::int64_t>(max_value_bytes))},
+                }), 413);
+                co_return;
+            }
+            value.append(chunk.value());
+        }
+        store.Put(key, std::move(value));
+        if (cache) {
+            cache->Invalidate(key);
+        }
         SetJson(resp, chjson::value(chjson::value::object{{"ok", chjson::value(true)}}));
+    }, put_stream_opt);
+
+    // GET /export[?synthetic_mb=N]  -> every key/value as NDJSON, streamed with chunked encoding.
+    // synthetic_mb appends N MiB of filler lines to exercise large payloads; memory stays bounded
+    // by one chunk either way.
+    r.GetStream("/export", [&](const chmicro::http::Request& req, chmicro::http::BodyReader&,
+                               chmicro::http::Response& resp, chmicro::http::ResponseStream& out) -> boost::asio::awaitable<void> {
+        std::uint64_t synthetic_bytes = 0;
+        if (auto s = req.Query("synthetic_mb"); !s.empty()) {
+            synthetic_bytes = std::strtoull(std::string(s).c_str(), nullptr, 10) << 20;
+        }
+        resp.content_type = "application/x-ndjson";
+
+        const std::size_t chunk_bytes = std::max<std::size_t>(server_opt.stream_chunk_bytes, 1);
+        std::string pending;
+        pending.reserve(chunk_bytes);
+        auto flush = [&]() -> boost::asio::awaitable<bool> {
+            auto st = co_await out.Write(pending);
+            pending.clear();
+            co_return st.ok();
+        };
+
+        for (std::size_t i = 0; i < store.ShardCount(); ++i) {
+            for (auto& kv : store.SnapshotShard(i)) {
+                pending += chjson::dump(chjson::value(chjson::value::object{
+                    {"key", chjson::value(std::move(kv.first))},
+                    {"value", chjson::value(std::move(kv.second))},
+                }));
+                pending.push_back('\n');
+                if (pending.size() >= chunk_bytes && !co_await flush()) {
+                    co_return;
+                }
+            }
+        }
+
+        static constexpr std::string_view kFiller =
+            "{\"key\":\"synthetic\",\"value\":\"0123456789abcdef0123456789abcdef0123456789abcdef0123456789a\"}\n";
+        for (std::uint64_t sent = 0; sent < synthetic_bytes; sent += kFiller.size()) {
+            pending.append(kFiller);
+            if (pending.size() >= chunk_bytes && !co_await flush()) {
+                co_return;
+            }
+        }
+        co_await flush();
     });
 
     // CPU workload endpoint: GET /compute?iters=100000
+    // Offloaded to the worker pool so a slow call does not stall the other connections on its reactor.
+    // --compute-limit N also caps it at N running calls plus N queued for up to 100 ms; the rest get 503.
+    chmicro::http::RouteOptions offload;
+    offload.execution = chmicro::http::ExecutionPolicy::offload;
+    if (compute_limit > 0) {
+        chmicro::resilience::BulkheadOptions bulkhead_opt;
+        bulkhead_opt.max_concurrent = compute_limit;
+        bulkhead_opt.max_queue = compute_limit;
+        bulkhead_opt.name = "compute";
+        offload.bulkhead = std::make_shared<chmicro::resilience::Bulkhead>(std::move(bulkhead_opt));
+    }
     r.Get("/compute", [&](const chmicro::http::Request& req, chmicro::http::Response& resp) {
         std::uint64_t iters = 10000;
         if (auto s = req.Query("iters"); !s.empty()) {
@@ -240,16 +419,79 @@ int main(int argc, char** argv) {
             {"ok", chjson::value(true)},
             {"iters", chjson::value::integer(static_cast<std::int64_t>(iters))},
         }));
-    });
+    }, offload);
+
+    // GET /proxy?key=foo -> upstream /get?key=foo. A coroutine handler: the downstream round trip
+    // is awaited, so the IO thread keeps serving other connections meanwhile.
+    if (upstream.port != 0) {
+        r.GetAsync("/proxy", [&](const chmicro::http::Request& req, chmicro::http::Response& resp) -> boost::asio::awaitable<void> {
+            std::string target = "/get?key=" + std::string(req.Query("key"));
+            auto res = co_await chmicro::http::HttpClient::AsyncGet(
+                upstream.host, std::to_string(upstream.port), std::move(target), std::chrono::milliseconds(1000));
+            if (!res.ok()) {
+                SetJson(resp, chjson::value(chjson::value::object{{"error", chjson::value(res.status().message())}}), 502);
+                co_return;
+            }
+            resp.status = static_cast<unsigned>(res.value().status);
+            resp.content_type = res.value().content_type;
+            resp.body = std::move(res.value().body);
+        });
+    }
 
-    r.Get("/metrics", [](const chmicro::http::Request&, chmicro::http::Response& resp) {
+    // GET /blobs/<name>       -> file under --blob-dir, zero-copy (sendfile/mmap), Range supported
+    // GET /blob_copy/<name>   -> same file read into Response::body, for comparison
+    if (!blob_dir.empty()) {
+        r.Static("/blobs/", blob_dir);
+        r.AddPrefixRoute(boost::beast::http::verb::get, "/blob_copy/", [&](const chmicro::http::Request& req, chmicro::http::Response& resp) {
+            auto name = req.path.substr(std::string_view("/blob_copy/").size());
+            if (name.empty() || name.find("..") != std::string_view::npos) {
+                SetJson(resp, chjson::value(chjson::value::object{{"error", chjson::value("bad name")}}), 404);
+                return;
+            }
+            std::ifstream in(blob_dir + "/" + std::string(name), std::ios::binary | std::ios::ate);
+            if (!in) {
+                SetJson(resp, chjson::value(chjson::value::object{{"error", chjson::value("not found")}}), 404);
+                return;
+            }
+            std::string data(static_cast<std::size_t>(in.tellg()), '\0');
+            in.seekg(0);
+            in.read(data.data(), static_cast<std::streamsize>(data.size()));
+            resp.status = 200;
+            resp.content_type = "application/octet-stream";
+            resp.body = data;
+        });
+    }
+
+    // OpenMetrics when the scraper asks for it. Each IO thread renders into its own reused buffer.
+    r.Get("/metrics", [](const chmicro::http::Request& req, chmicro::http::Response& resp) {
+        auto format = req.Header("accept").find("application/openmetrics-text") != std::string_view::npos
+            ? chmicro::ExpositionFormat::openmetrics
+            : chmicro::ExpositionFormat::prometheus;
+        thread_local std::string text;
+        text.clear();
+        chmicro::DefaultMetrics().WriteText(text, format);
         resp.status = 200;
-        resp.content_type = "text/plain; version=0.0.4; charset=utf-8";
-        resp.body = chmicro::DefaultMetrics().ToPrometheusText();
-    });
+        resp.content_type = chmicro::ExpositionContentType(format);
+        resp.body = text;
+    }, always);
+
+    // Raw percentiles of every log-linear series, one line each, e.g.
+    //   http_server_request_ms{path="/get"} count=120 p50=0.21 p90=0.33 p99=0.9 p999=2.1 max=3.4
+    r.Get("/debug/latency", [](const chmicro::http::Request&, chmicro::http::Response& resp) {
+        std::ostringstream out;
+        for (const auto& series : chmicro::DefaultMetrics().LogLinearSnapshots()) {
+            const auto& snap = series.snapshot;
+            out << series.name << series.labels.ToPrometheusLabelText() << " count=" << snap.count
+                << " p50=" << snap.Quantile(0.5) << " p90=" << snap.Quantile(0.9) << " p99=" << snap.Quantile(0.99)
+                << " p999=" << snap.Quantile(0.999) << " max=" << snap.Quantile(1.0) << "\n";
+        }
+        resp.status = 200;
+        resp.content_type = "text/plain; charset=utf-8";
+        resp.body = out.str();
+    }, always);
 
-    auto& ioc = app.Io().Next();
-    auto server = std::make_shared<chmicro::http::HttpServer>(ioc, listen, std::move(r));
+    server_opt.workers = &app.Workers();
+    auto server = std::make_shared<chmicro::http::HttpServer>(app.Io(), listen, std::move(r), server_opt);
     app.AddServer(server);
 
     chmicro::log::info("KV service: http://{}:{} (shards={}, max_value={})", listen.host, listen.port, shards, max_value_bytes);
@@ -1,20 +1,28 @@
-#include <boost/asio.hpp>
-#include <boost/beast.hpp>
-
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <optional>
+#include <random>
+#include <sstream>
 #include <string>
 #include <string_view>
 #include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
-#ifdef _MSC_VER
-#include <intrin.h>
-#endif
+#include <boost/asio.hpp>
+#include <boost/beast.hpp>
+
+#include <chmicro/core/metrics.h>
+#include <chmicro/http/hpack.h>
+#include <chmicro/http/http2.h>
 
 namespace asio = boost::asio;
 namespace beast = boost::beast;
@@ -36,94 +44,85 @@ struct Options {
 
     int timeout_ms = 1000;
     bool keepalive = true;
-};
 
-int Log2FloorU64(std::uint64_t x) {
-    if (x == 0) {
-        return -1;
-    }
-#ifdef _MSC_VER
-    unsigned long idx = 0;
-    _BitScanReverse64(&idx, x);
-    return static_cast<int>(idx);
-#else
-    return 63 - __builtin_clzll(x);
-#endif
-}
+    // Requests written back-to-back per connection before reading the responses (HTTP/1.1 pipelining).
+    std::size_t pipeline = 1;
 
-class LatencyHistogram {
-public:
-    static constexpr std::size_t kBuckets = 64; // log2(us)
+    // When set, a second pass runs against this target and both are compared, e.g. the same blob
+    // served zero-copy and through a std::string body.
+    std::string compare_target;
 
-    void Reset() {
-        for (auto& b : buckets_) {
-            b.store(0, std::memory_order_relaxed);
-        }
-        ok_.store(0, std::memory_order_relaxed);
-        err_.store(0, std::memory_order_relaxed);
-        bytes_.store(0, std::memory_order_relaxed);
-    }
+    // Open-loop mode: total requests per second, spread evenly over the connections. Latency is
+    // measured from each request's scheduled send time, so time spent queued behind a slow
+    // response counts. 0 = closed loop (send as soon as the previous response arrived).
+    double rate = 0.0;
+
+    // HTTP/2 mode (prior-knowledge h2c): the same `concurrency` requests in flight, multiplexed
+    // as streams over this many connections. A plain HTTP/1.1 pass runs first for comparison.
+    std::size_t h2_connections = 0;
 
+    // Appends "/<random hex>" to the target path of every HTTP/1.1 request, the way a scanner walks
+    // URLs that match no route.
+    bool random_paths = false;
+};
+
+// Loadgen-side counters. Latencies go into a log-linear histogram in ms (1 us steps, within 1.6%),
+// so the reported percentiles are not rounded to a power of two.
+class LatencyHistogram {
+public:
     void RecordOk(std::uint64_t latency_us, std::uint64_t bytes_in) {
         ok_.fetch_add(1, std::memory_order_relaxed);
         bytes_.fetch_add(bytes_in, std::memory_order_relaxed);
+        latency_ms_.Observe(static_cast<double>(latency_us) / 1000.0);
+    }
 
-        // Bucket by log2(latency_us + 1)
-        auto v = latency_us + 1;
-        int idx = Log2FloorU64(v);
-        if (idx < 0) {
-            idx = 0;
-        }
-        if (idx >= static_cast<int>(kBuckets)) {
-            idx = static_cast<int>(kBuckets - 1);
+    // Answered, but not with 2xx (e.g. shed with 503); kept out of ok and the latency histogram.
+    void RecordNon2xx(unsigned status) {
+        non2xx_.fetch_add(1, std::memory_order_relaxed);
+        if (status == 503) {
+            unavailable_.fetch_add(1, std::memory_order_relaxed);
         }
-        buckets_[static_cast<std::size_t>(idx)].fetch_add(1, std::memory_order_relaxed);
     }
 
     void RecordErr() {
         err_.fetch_add(1, std::memory_order_relaxed);
     }
 
+    // A reused connection closed before answering, and the request was resent on a new one.
+    void RecordRetry() {
+        retries_.fetch_add(1, std::memory_order_relaxed);
+    }
+
     struct Snapshot {
         std::uint64_t ok = 0;
+        std::uint64_t non2xx = 0;
+        std::uint64_t unavailable = 0;
         std::uint64_t err = 0;
+        std::uint64_t retries = 0;
         std::uint64_t bytes = 0;
-        std::vector<std::uint64_t> buckets;
+        chmicro::LogLinearSnapshot latency_ms;
     };
 
     Snapshot Get() const {
         Snapshot s;
         s.ok = ok_.load(std::memory_order_relaxed);
+        s.non2xx = non2xx_.load(std::memory_order_relaxed);
+        s.unavailable = unavailable_.load(std::memory_order_relaxed);
         s.err = err_.load(std::memory_order_relaxed);
+        s.retries = retries_.load(std::memory_order_relaxed);
         s.bytes = bytes_.load(std::memory_order_relaxed);
-        s.buckets.resize(kBuckets);
-        for (std::size_t i = 0; i < kBuckets; ++i) {
-            s.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
-        }
+        s.latency_ms = latency_ms_.Snapshot();
         return s;
     }
 
-    static std::uint64_t ApproxPercentileUs(const Snapshot& s, double p) {
-        if (s.ok == 0) {
-            return 0;
-        }
-        std::uint64_t rank = static_cast<std::uint64_t>(static_cast<long double>(s.ok - 1) * p);
-        std::uint64_t cum = 0;
-        for (std::size_t i = 0; i < s.buckets.size(); ++i) {
-            cum += s.buckets[i];
-            if (cum > rank) {
-                // Approx upper bound of this bucket: 2^i us
-                return (i >= 63) ? (1ULL << 63) : (1ULL << i);
-            }
-        }
-        return (1ULL << (kBuckets - 1));
-    }
-
 private:
     std::atomic<std::uint64_t> ok_{0};
+    std::atomic<std::uint64_t> non2xx_{0};
+    std::atomic<std::uint64_t> unavailable_{0};
     std::atomic<std::uint64_t> err_{0};
+    std::atomic<std::uint64_t> retries_{0};
     std::atomic<std::uint64_t> bytes_{0};
-    std::array<std::atomic<std::uint64_t>, kBuckets> buckets_{};
+    chmicro::LogLinearHistogram latency_ms_;
 };
 
 class LoadSession : public std::enable_shared_from_this<LoadSession> {
@@ -132,14 +131,23 @@ public:
         Options opt,
         std::shared_ptr<std::atomic<bool>> stop,
         std::shared_ptr<std::atomic<std::uint64_t>> stop_at_ns,
-        std::shared_ptr<LatencyHistogram> hist)
+        std::shared_ptr<LatencyHistogram> hist,
+        std::size_t index = 0)
                 : opt_(std::move(opt)),
           stop_(std::move(stop)),
           stop_at_ns_(std::move(stop_at_ns)),
           hist_(std::move(hist)),
           resolver_(ioc),
           stream_(ioc),
-          timer_(ioc) {}
+          timer_(ioc),
+          pace_timer_(ioc),
+          rng_(std::random_device{}() ^ index) {
+        if (opt_.rate > 0) {
+            // Each connection sends every `concurrency / rate` seconds, staggered by its index.
+            interval_ns_ = static_cast<std::uint64_t>(static_cast<double>(opt_.concurrency) * 1e9 / opt_.rate);
+            next_send_ns_ = NowNs() + interval_ns_ * index / std::max<std::size_t>(opt_.concurrency, 1);
+        }
+    }
 
     void Start() {
         Resolve();
@@ -171,6 +179,8 @@ private:
 
     void OnResolve(beast::error_code ec, tcp::resolver::results_type results) {
         if (ec) {
+            // A failed retry counts as the request's error.
+            retrying_ = false;
             hist_->RecordErr();
             return ReconnectSoon();
         }
@@ -181,9 +191,13 @@ private:
 
     void OnConnect(beast::error_code ec, tcp::resolver::results_type::endpoint_type) {
         if (ec) {
+            retrying_ = false;
             hist_->RecordErr();
             return ReconnectSoon();
         }
+        // The connect deadline must not carry over to reads; per-request timeouts use timer_.
+        stream_.expires_never();
+        answered_ = 0;
 
         // Build request template.
         req_.version(11);
@@ -193,6 +207,17 @@ private:
         req_.set(http::field::user_agent, "chmicro_loadgen/0.1");
         req_.keep_alive(opt_.keepalive);
 
+        if (opt_.pipeline > 1) {
+            std::ostringstream oss;
+            oss << req_;
+            auto one = oss.str();
+            pipelined_.clear();
+            pipelined_.reserve(one.size() * opt_.pipeline);
+            for (std::size_t i = 0; i < opt_.pipeline; ++i) {
+                pipelined_.append(one);
+            }
+        }
+
         DoRequest();
     }
 
@@ -201,16 +226,63 @@ private:
             Close();
             return;
         }
+        if (interval_ns_ > 0) {
+            auto now = NowNs();
+            if (now < next_send_ns_) {
+                pace_timer_.expires_after(std::chrono::nanoseconds(next_send_ns_ - now));
+                pace_timer_.async_wait([self = shared_from_this()](beast::error_code ec) {
+                    if (!ec) {
+                        self->SendRequest();
+                    }
+                });
+                return;
+            }
+        }
+        SendRequest();
+    }
+
+    void SendRequest() {
+        if (ShouldStop()) {
+            Close();
+            return;
+        }
 
         // Reset response state.
-        res_ = {};
         buffer_.consume(buffer_.size());
 
-        start_ns_ = NowNs();
+        if (opt_.random_paths && !retrying_) {
+            auto target = std::string_view(opt_.target);
+            auto query = target.find('?');
+            char hex[17];
+            std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(rng_()));
+            random_target_.assign(target.substr(0, query)).append("/").append(hex);
+            if (query != std::string_view::npos) {
+                random_target_.append(target.substr(query));
+            }
+            req_.target(random_target_);
+        }
+
+        if (retrying_) {
+            // Same request again: keep its start time, so the reconnect counts as latency.
+            retrying_ = false;
+        } else if (interval_ns_ > 0) {
+            // Latency counts from the scheduled time, including any backlog on this connection.
+            start_ns_ = next_send_ns_;
+            next_send_ns_ += interval_ns_;
+        } else {
+            start_ns_ = NowNs();
+        }
+        outstanding_ = opt_.pipeline > 1 ? opt_.pipeline : 1;
+        timed_out_ = false;
 
         timer_.expires_after(std::chrono::milliseconds(opt_.timeout_ms));
         timer_.async_wait(beast::bind_front_handler(&LoadSession::OnTimeout, shared_from_this()));
 
+        if (opt_.pipeline > 1) {
+            // The whole batch goes out in one write; responses are read back in order.
+            asio::async_write(stream_, asio::buffer(pipelined_), beast::bind_front_handler(&LoadSession::OnWrite, shared_from_this()));
+            return;
+        }
         http::async_write(stream_, req_, beast::bind_front_handler(&LoadSession::OnWrite, shared_from_this()));
     }
 
@@ -219,6 +291,7 @@ private:
             return;
         }
         // Request timed out.
+        timed_out_ = true;
         hist_->RecordErr();
         beast::error_code ignored;
         stream_.socket().close(ignored);
@@ -227,33 +300,70 @@ private:
     void OnWrite(beast::error_code ec, std::size_t) {
         if (ec) {
             timer_.cancel();
+            if (CanRetry()) {
+                return Retry();
+            }
             hist_->RecordErr();
             return ReconnectSoon();
         }
 
-        http::async_read(stream_, buffer_, res_, beast::bind_front_handler(&LoadSession::OnRead, shared_from_this()));
+        ReadResponse();
     }
 
-    void OnRead(beast::error_code ec, std::size_t bytes_transferred) {
-        timer_.cancel();
+    void ReadResponse() {
+        // Large blobs (--compare-target) exceed beast's 8 MiB default response limit.
+        parser_.emplace();
+        parser_->body_limit(std::numeric_limits<std::uint64_t>::max());
+        http::async_read(stream_, buffer_, *parser_, beast::bind_front_handler(&LoadSession::OnRead, shared_from_this()));
+    }
 
+    void OnRead(beast::error_code ec, std::size_t bytes_transferred) {
         if (ec) {
+            timer_.cancel();
+            if (CanRetry() && !parser_->got_some()) {
+                return Retry();
+            }
             hist_->RecordErr();
             return ReconnectSoon();
         }
+        ++answered_;
 
         auto end_ns = NowNs();
         auto latency_us = (end_ns - start_ns_) / 1000;
-        hist_->RecordOk(latency_us, static_cast<std::uint64_t>(bytes_transferred));
+        auto status = parser_->get().result_int();
+        if (status >= 200 && status < 300) {
+            hist_->RecordOk(latency_us, static_cast<std::uint64_t>(bytes_transferred));
+        } else {
+            hist_->RecordNon2xx(status);
+        }
+
+        if (--outstanding_ > 0 && !parser_->get().need_eof()) {
+            return ReadResponse();
+        }
+        timer_.cancel();
 
         // Continue on the same connection (keep-alive). If server closed, reconnect.
-        if (!opt_.keepalive || res_.need_eof()) {
+        if (!opt_.keepalive || parser_->get().need_eof()) {
             return ReconnectSoon();
         }
 
         DoRequest();
     }
 
+    // Like browsers and most HTTP clients: a keep-alive connection the server closed while the
+    // request was on its way (e.g. a draining server) fails before any response byte arrives, and
+    // the request is safe to resend once on a fresh connection. A timeout is not retried.
+    bool CanRetry() const {
+        return answered_ > 0 && outstanding_ == std::max<std::size_t>(opt_.pipeline, 1) && !timed_out_ && !ShouldStop();
+    }
+
+    void Retry() {
+        hist_->RecordRetry();
+        Close();
+        retrying_ = true;
+        Resolve();
+    }
+
     void ReconnectSoon() {
         Close();
         if (ShouldStop()) {
@@ -285,12 +395,326 @@ private:
     tcp::resolver resolver_;
     beast::tcp_stream stream_;
     asio::steady_timer timer_;
+    asio::steady_timer pace_timer_;
 
     beast::flat_buffer buffer_;
     http::request<http::empty_body> req_;
-    http::response<http::string_body> res_;
+    std::optional<http::response_parser<http::string_body>> parser_;
+    std::string pipelined_;
+    std::size_t outstanding_ = 0;
+    // Responses read on the current connection; a connection is reused once this is non-zero.
+    std::uint64_t answered_ = 0;
+    bool retrying_ = false;
+    bool timed_out_ = false;
 
     std::uint64_t start_ns_ = 0;
+    // Open-loop pacing (--rate).
+    std::uint64_t interval_ns_ = 0;
+    std::uint64_t next_send_ns_ = 0;
+    // --random-paths
+    std::mt19937_64 rng_;
+    std::string random_target_;
+};
+
+// Closed-loop HTTP/2 client: keeps `streams` requests in flight on one connection and starts the
+// next as soon as one completes.
+class H2LoadSession : public std::enable_shared_from_this<H2LoadSession> {
+public:
+    H2LoadSession(asio::io_context& ioc,
+        Options opt,
+        std::size_t streams,
+        std::shared_ptr<std::atomic<bool>> stop,
+        std::shared_ptr<std::atomic<std::uint64_t>> stop_at_ns,
+        std::shared_ptr<LatencyHistogram> hist)
+        : opt_(std::move(opt)),
+          streams_(std::max<std::size_t>(streams, 1)),
+          stop_(std::move(stop)),
+          stop_at_ns_(std::move(stop_at_ns)),
+          hist_(std::move(hist)),
+          strand_(asio::make_strand(ioc)),
+          resolver_(strand_),
+          stream_(strand_),
+          timer_(strand_) {}
+
+    void Start() {
+        Resolve();
+    }
+
+private:
+    enum : std::uint8_t { kData = 0, kHeaders = 1, kRstStream = 3, kSettings = 4, kPing = 6, kGoAway = 7 };
+    static constexpr std::uint8_t kEndStream = 0x1;
+    static constexpr std::uint8_t kEndHeaders = 0x4;
+    // Receive windows opened far enough that flow control never paces the benchmark.
+    static constexpr std::uint32_t kWindow = 1u << 30;
+
+    struct InFlight {
+        std::uint64_t start_ns = 0;
+        unsigned status = 0;
+        std::uint64_t bytes = 0;
+    };
+
+    static std::uint64_t NowNs() {
+        return static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    bool ShouldStop() const {
+        return stop_->load(std::memory_order_relaxed) || NowNs() >= stop_at_ns_->load(std::memory_order_relaxed);
+    }
+
+    static void AppendFrame(std::string& out, std::uint8_t type, std::uint8_t flags, std::uint32_t id, std::string_view payload) {
+        auto n = payload.size();
+        const char head[9] = {static_cast<char>(n >> 16), static_cast<char>(n >> 8), static_cast<char>(n),
+            static_cast<char>(type), static_cast<char>(flags), static_cast<char>(id >> 24), static_cast<char>(id >> 16),
+            static_cast<char>(id >> 8), static_cast<char>(id)};
+        out.append(head, sizeof(head));
+        out.append(payload);
+    }
+
+    static std::string U32(std::uint32_t v) {
+        return {static_cast<char>(v >> 24), static_cast<char>(v >> 16), static_cast<char>(v >> 8), static_cast<char>(v)};
+    }
+
+    void Resolve() {
+        if (ShouldStop()) {
+            return;
+        }
+        resolver_.async_resolve(opt_.host, opt_.port,
+            beast::bind_front_handler(&H2LoadSession::OnResolve, shared_from_this()));
+    }
+
+    void OnResolve(beast::error_code ec, tcp::resolver::results_type results) {
+        if (ec) {
+            hist_->RecordErr();
+            return ReconnectSoon();
+        }
+        stream_.expires_after(std::chrono::milliseconds(opt_.timeout_ms));
+        stream_.async_connect(results, beast::bind_front_handler(&H2LoadSession::OnConnect, shared_from_this()));
+    }
+
+    void OnConnect(beast::error_code ec, tcp::resolver::results_type::endpoint_type) {
+        if (ec) {
+            hist_->RecordErr();
+            return ReconnectSoon();
+        }
+        stream_.expires_never();
+        // New requests are written while earlier streams are still in flight.
+        stream_.socket().set_option(tcp::no_delay(true), ec);
+        encoder_ = chmicro::http::HpackEncoder();
+        decoder_ = chmicro::http::HpackDecoder();
+        in_flight_.clear();
+        in_.consume(in_.size());
+        next_id_ = 1;
+        consumed_ = 0;
+        closed_ = false;
+
+        out_.append(chmicro::http::kHttp2Preface);
+        // SETTINGS_INITIAL_WINDOW_SIZE, then the connection window.
+        AppendFrame(out_, kSettings, 0, 0, std::string("\x00\x04", 2) + U32(kWindow));
+        AppendFrame(out_, 8, 0, 0, U32(kWindow - 65535));
+        Fill();
+        Read();
+    }
+
+    // Opens streams up to the per-connection limit.
+    void Fill() {
+        while (!closed_ && in_flight_.size() < streams_ && !ShouldStop()) {
+            std::string block;
+            encoder_.Begin(block);
+            encoder_.Encode(":method", "GET", block);
+            encoder_.Encode(":scheme", "http", block);
+            encoder_.Encode(":path", opt_.target, block);
+            encoder_.Encode(":authority", opt_.host, block);
+            encoder_.Encode("user-agent", "chmicro_loadgen/0.1", block);
+            AppendFrame(out_, kHeaders, kEndStream | kEndHeaders, next_id_, block);
+            in_flight_[next_id_] = InFlight{NowNs()};
+            next_id_ += 2;
+        }
+        if (!in_flight_.empty()) {
+            timer_.expires_after(std::chrono::milliseconds(opt_.timeout_ms));
+            timer_.async_wait(beast::bind_front_handler(&H2LoadSession::OnTimeout, shared_from_this()));
+        }
+        Flush();
+    }
+
+    void Flush() {
+        if (writing_ || out_.empty() || closed_) {
+            return;
+        }
+        writing_ = true;
+        std::swap(out_, sending_);
+        asio::async_write(stream_, asio::buffer(sending_),
+            [self = shared_from_this()](beast::error_code ec, std::size_t) {
+                self->writing_ = false;
+                self->sending_.clear();
+                if (ec) {
+                    return self->Fail();
+                }
+                self->Flush();
+            });
+    }
+
+    void Read() {
+        stream_.async_read_some(in_.prepare(64 * 1024), beast::bind_front_handler(&H2LoadSession::OnRead, shared_from_this()));
+    }
+
+    void OnRead(beast::error_code ec, std::size_t n) {
+        if (ec) {
+            return Fail();
+        }
+        in_.commit(n);
+        while (!closed_) {
+            auto data = in_.data();
+            std::string_view buf(static_cast<const char*>(data.data()), data.size());
+            if (buf.size() < 9) {
+                break;
+            }
+            auto len = std::size_t{static_cast<unsigned char>(buf[0])} << 16 | std::size_t{static_cast<unsigned char>(buf[1])} << 8 |
+                static_cast<unsigned char>(buf[2]);
+            if (buf.size() < 9 + len) {
+                break;
+            }
+            auto type = static_cast<std::uint8_t>(buf[3]);
+            auto flags = static_cast<std::uint8_t>(buf[4]);
+            auto id = (std::uint32_t{static_cast<unsigned char>(buf[5])} << 24 | std::uint32_t{static_cast<unsigned char>(buf[6])} << 16 |
+                std::uint32_t{static_cast<unsigned char>(buf[7])} << 8 | static_cast<unsigned char>(buf[8])) & 0x7fffffff;
+            OnFrame(type, flags, id, buf.substr(9, len));
+            in_.consume(9 + len);
+        }
+        if (closed_) {
+            return;
+        }
+        if (ShouldStop() && in_flight_.empty()) {
+            return Close();
+        }
+        Fill();
+        Read();
+    }
+
+    void OnFrame(std::uint8_t type, std::uint8_t flags, std::uint32_t id, std::string_view payload) {
+        switch (type) {
+        case kHeaders: {
+            std::vector<chmicro::http::HeaderField> fields;
+            if (!decoder_.Decode(payload, fields).ok()) {
+                return Fail();
+            }
+            if (auto it = in_flight_.find(id); it != in_flight_.end()) {
+                for (const auto& f : fields) {
+                    if (f.name == ":status") {
+                        it->second.status = static_cast<unsigned>(std::atoi(f.value.c_str()));
+                    }
+                }
+            }
+            break;
+        }
+        case kData:
+            if (auto it = in_flight_.find(id); it != in_flight_.end()) {
+                it->second.bytes += payload.size();
+            }
+            consumed_ += payload.size();
+            if (consumed_ >= kWindow / 2) {
+                AppendFrame(out_, 8, 0, 0, U32(static_cast<std::uint32_t>(consumed_)));
+                consumed_ = 0;
+            }
+            break;
+        case kRstStream:
+            if (in_flight_.erase(id) > 0) {
+                hist_->RecordErr();
+            }
+            return;
+        case kSettings:
+            if ((flags & 0x1) == 0) {
+                AppendFrame(out_, kSettings, 0x1, 0, {});
+            }
+            return;
+        case kPing:
+            if ((flags & 0x1) == 0) {
+                AppendFrame(out_, kPing, 0x1, 0, payload);
+            }
+            return;
+        case kGoAway:
+            // Streams above the last one the server took are never answered: fail and reconnect.
+            return Fail();
+        default:
+            return;
+        }
+        if ((flags & kEndStream) != 0) {
+            auto it = in_flight_.find(id);
+            if (it == in_flight_.end()) {
+                return;
+            }
+            auto status = it->second.status;
+            if (status >= 200 && status < 300) {
+                hist_->RecordOk((NowNs() - it->second.start_ns) / 1000, it->second.bytes);
+            } else {
+                hist_->RecordNon2xx(status);
+            }
+            in_flight_.erase(it);
+        }
+    }
+
+    void OnTimeout(beast::error_code ec) {
+        if (ec == asio::error::operation_aborted || closed_) {
+            return;
+        }
+        // Stalled: nothing completed within the timeout.
+        Fail();
+    }
+
+    void Fail() {
+        if (closed_) {
+            return;
+        }
+        for (std::size_t i = 0; i < in_flight_.size(); ++i) {
+            hist_->RecordErr();
+        }
+        in_flight_.clear();
+        ReconnectSoon();
+    }
+
+    void ReconnectSoon() {
+        Close();
+        if (ShouldStop()) {
+            return;
+        }
+        timer_.expires_after(std::chrono::milliseconds(50));
+        timer_.async_wait([self = shared_from_this()](beast::error_code ec) {
+            if (!ec) {
+                self->Resolve();
+            }
+        });
+    }
+
+    void Close() {
+        closed_ = true;
+        timer_.cancel();
+        out_.clear();
+        beast::error_code ec;
+        stream_.socket().shutdown(tcp::socket::shutdown_both, ec);
+        stream_.socket().close(ec);
+    }
+
+    Options opt_;
+    std::size_t streams_;
+    std::shared_ptr<std::atomic<bool>> stop_;
+    std::shared_ptr<std::atomic<std::uint64_t>> stop_at_ns_;
+    std::shared_ptr<LatencyHistogram> hist_;
+
+    asio::strand<asio::io_context::executor_type> strand_;
+    tcp::resolver resolver_;
+    beast::tcp_stream stream_;
+    asio::steady_timer timer_;
+
+    chmicro::http::HpackEncoder encoder_;
+    chmicro::http::HpackDecoder decoder_;
+    std::unordered_map<std::uint32_t, InFlight> in_flight_;
+    std::uint32_t next_id_ = 1;
+    std::uint64_t consumed_ = 0;
+    beast::flat_buffer in_;
+    std::string out_;
+    std::string sending_;
+    bool writing_ = false;
+    bool closed_ = false;
 };
 
 void PrintUsage() {
@@ -302,7 +726,95 @@ void PrintUsage() {
               << "  --concurrency <n>\n"
               << "  --warmup <seconds>\n"
               << "  --duration <seconds>\n"
-              << "  --timeout-ms <ms>\n";
+              << "  --timeout-ms <ms>\n"
+              << "  --pipeline <n>      pipeline n requests per connection; also runs an\n"
+              << "                      unpipelined pass and reports the throughput gain\n"
+              << "  --compare-target <path?query>\n"
+              << "                      run a second pass against this target and compare\n"
+              << "  --rate <rps>        open loop: send at a fixed total rate instead of\n"
+              << "                      back-to-back; latency includes queueing delay\n"
+              << "  --h2 <connections>  multiplex the same concurrency as HTTP/2 streams over\n"
+              << "                      this many h2c connections; also runs an HTTP/1.1 pass\n"
+              << "                      and compares connections and tail latency\n"
+              << "  --random-paths      send every request to <target path>/<random hex>, like a\n"
+              << "                      scanner probing URLs no route matches (HTTP/1.1 only)\n";
+}
+
+struct PhaseResult {
+    double elapsed = 0.0;
+    LatencyHistogram::Snapshot snap;
+};
+
+PhaseResult RunPhase(const Options& opt, int seconds) {
+    asio::io_context ioc;
+
+    auto stop = std::make_shared<std::atomic<bool>>(false);
+    auto stop_at_ns = std::make_shared<std::atomic<std::uint64_t>>(0);
+    auto hist = std::make_shared<LatencyHistogram>();
+
+    auto start = std::chrono::steady_clock::now();
+    stop_at_ns->store(static_cast<std::uint64_t>(
+                         std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count())
+                         + static_cast<std::uint64_t>(seconds) * 1000ULL * 1000ULL * 1000ULL,
+        std::memory_order_relaxed);
+
+    if (opt.h2_connections > 0) {
+        // Streams spread as evenly as possible over the connections.
+        for (std::size_t i = 0; i < opt.h2_connections; ++i) {
+            auto streams = opt.concurrency / opt.h2_connections + (i < opt.concurrency % opt.h2_connections ? 1 : 0);
+            std::make_shared<H2LoadSession>(ioc, opt, streams, stop, stop_at_ns, hist)->Start();
+        }
+    } else {
+        for (std::size_t i = 0; i < opt.concurrency; ++i) {
+            std::make_shared<LoadSession>(ioc, opt, stop, stop_at_ns, hist, i)->Start();
+        }
+    }
+
+    std::vector<std::thread> threads;
+    threads.reserve(opt.threads);
+    for (std::size_t t = 0; t < opt.threads; ++t) {
+        threads.emplace_back([&] { ioc.run(); });
+    }
+
+    // Wait for duration.
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    stop->store(true, std::memory_order_relaxed);
+    ioc.stop();
+
+    for (auto& th : threads) {
+        th.join();
+    }
+
+    PhaseResult r;
+    r.elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    r.snap = hist->Get();
+    return r;
+}
+
+void PrintSummary(const Options& opt, const PhaseResult& r) {
+    const auto& snap = r.snap;
+    double qps = r.elapsed > 0 ? (static_cast<double>(snap.ok) / r.elapsed) : 0.0;
+    double mbps = r.elapsed > 0 ? (static_cast<double>(snap.bytes) / r.elapsed / (1024.0 * 1024.0)) : 0.0;
+
+
+    std::cout << "\n=== chmicro_loadgen summary ===\n";
+    std::cout << "target: http://" << opt.host << ":" << opt.port << opt.target << "\n";
+    std::cout << "threads=" << opt.threads << " concurrency=" << opt.concurrency << " pipeline=" << opt.pipeline
+              << " duration=" << opt.duration_seconds << "s\n";
+    std::cout << "protocol=" << (opt.h2_connections > 0 ? "h2c" : "http/1.1")
+              << " connections=" << (opt.h2_connections > 0 ? opt.h2_connections : opt.concurrency) << "\n";
+    if (opt.rate > 0) {
+        std::cout << "rate=" << opt.rate << " rps (open loop)\n";
+    }
+    std::cout << "ok=" << snap.ok << " non2xx=" << snap.non2xx << " (503=" << snap.unavailable << ")"
+              << " err=" << snap.err << " retried=" << snap.retries << "\n";
+    std::cout << "qps=" << qps << "  recv=" << mbps << " MiB/s\n";
+    std::cout << "latency of 2xx responses (log-linear, within 1.6%):\n";
+    std::cout << "  p50=" << snap.latency_ms.Quantile(0.50) << " ms\n";
+    std::cout << "  p90=" << snap.latency_ms.Quantile(0.90) << " ms\n";
+    std::cout << "  p99=" << snap.latency_ms.Quantile(0.99) << " ms\n";
+    std::cout << "  p999=" << snap.latency_ms.Quantile(0.999) << " ms\n";
+    std::cout << "  max=" << snap.latency_ms.Quantile(1.0) << " ms\n";
 }
 
 } // namespace
@@ -336,6 +848,16 @@ int main(int argc, char** argv) {
             opt.duration_seconds = std::atoi(need("--duration"));
         } else if (a == "--timeout-ms") {
             opt.timeout_ms = std::atoi(need("--timeout-ms"));
+        } else if (a == "--pipeline") {
+            opt.pipeline = static_cast<std::size_t>(std::atoi(need("--pipeline")));
+        } else if (a == "--compare-target") {
+            opt.compare_target = need("--compare-target");
+        } else if (a == "--rate") {
+            opt.rate = std::atof(need("--rate"));
+        } else if (a == "--h2") {
+            opt.h2_connections = static_cast<std::size_t>(std::atoi(need("--h2")));
+        } else if (a == "--random-paths") {
+            opt.random_paths = true;
         } else if (a == "--help" || a == "-h") {
             PrintUsage();
             return 0;
@@ -352,88 +874,86 @@ int main(int argc, char** argv) {
         opt.duration_seconds = 10;
     }
 
-    asio::io_context ioc;
-
-    auto stop = std::make_shared<std::atomic<bool>>(false);
-    auto stop_at_ns = std::make_shared<std::atomic<std::uint64_t>>(0);
-    auto hist = std::make_shared<LatencyHistogram>();
-
-    // Warmup phase.
-    if (opt.warmup_seconds > 0) {
-        hist->Reset();
-        stop_at_ns->store(static_cast<std::uint64_t>(
-                             std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count())
-                             + static_cast<std::uint64_t>(opt.warmup_seconds) * 1000ULL * 1000ULL * 1000ULL,
-            std::memory_order_relaxed);
-
-        for (std::size_t i = 0; i < opt.concurrency; ++i) {
-            std::make_shared<LoadSession>(ioc, opt, stop, stop_at_ns, hist)->Start();
-        }
-
-        std::vector<std::thread> threads;
-        threads.reserve(opt.threads);
-        for (std::size_t t = 0; t < opt.threads; ++t) {
-            threads.emplace_back([&] { ioc.run(); });
-        }
-
-        std::this_thread::sleep_for(std::chrono::seconds(opt.warmup_seconds));
-        // Stop warmup sessions by letting them see stop_at.
-        ioc.stop();
-        for (auto& th : threads) {
-            th.join();
-        }
-
-        // Reset for measured run.
-        ioc.restart();
+    if (opt.pipeline == 0) {
+        opt.pipeline = 1;
     }
-
-    hist->Reset();
-    auto start = std::chrono::steady_clock::now();
-    stop_at_ns->store(static_cast<std::uint64_t>(
-                         std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count())
-                         + static_cast<std::uint64_t>(opt.duration_seconds) * 1000ULL * 1000ULL * 1000ULL,
-        std::memory_order_relaxed);
-
-    for (std::size_t i = 0; i < opt.concurrency; ++i) {
-        std::make_shared<LoadSession>(ioc, opt, stop, stop_at_ns, hist)->Start();
+    if (opt.rate > 0 && opt.pipeline > 1) {
+        std::cerr << "--rate ignores --pipeline\n";
+        opt.pipeline = 1;
     }
 
-    std::vector<std::thread> threads;
-    threads.reserve(opt.threads);
-    for (std::size_t t = 0; t < opt.threads; ++t) {
-        threads.emplace_back([&] { ioc.run(); });
+    if (opt.random_paths && opt.pipeline > 1) {
+        std::cerr << "--random-paths ignores --pipeline\n";
+        opt.pipeline = 1;
     }
 
-    // Wait for duration.
-    std::this_thread::sleep_for(std::chrono::seconds(opt.duration_seconds));
-    stop->store(true, std::memory_order_relaxed);
-    ioc.stop();
-
-    for (auto& th : threads) {
-        th.join();
+    if (opt.h2_connections > 0 && (opt.rate > 0 || opt.pipeline > 1 || !opt.compare_target.empty() || opt.random_paths)) {
+        std::cerr << "--h2 runs closed loop on one target; ignoring --rate, --pipeline, --compare-target and --random-paths\n";
+        opt.rate = 0;
+        opt.pipeline = 1;
+        opt.compare_target.clear();
+        opt.random_paths = false;
     }
+    opt.h2_connections = std::min(opt.h2_connections, opt.concurrency);
 
-    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
-    auto snap = hist->Get();
+    if (opt.warmup_seconds > 0) {
+        (void)RunPhase(opt, opt.warmup_seconds);
+    }
 
-    double qps = elapsed > 0 ? (static_cast<double>(snap.ok) / elapsed) : 0.0;
-    double mbps = elapsed > 0 ? (static_cast<double>(snap.bytes) / elapsed / (1024.0 * 1024.0)) : 0.0;
+    if (opt.h2_connections > 0) {
+        // Baseline: one HTTP/1.1 connection per in-flight request.
+        auto h1_opt = opt;
+        h1_opt.h2_connections = 0;
+        auto h1 = RunPhase(h1_opt, opt.duration_seconds);
+        PrintSummary(h1_opt, h1);
+
+        auto h2 = RunPhase(opt, opt.duration_seconds);
+        PrintSummary(opt, h2);
+
+        auto qps = [](const PhaseResult& r) { return r.elapsed > 0 ? static_cast<double>(r.snap.ok) / r.elapsed : 0.0; };
+        auto p99_ms = [](const PhaseResult& r) { return r.snap.latency_ms.Quantile(0.99); };
+        std::cout << "\nh2c vs http/1.1: " << opt.h2_connections << " vs " << opt.concurrency << " connections, "
+                  << qps(h2) << " vs " << qps(h1) << " qps, p99 " << p99_ms(h2) << " vs " << p99_ms(h1) << " ms\n";
+        return 0;
+    }
 
-    auto p50_us = LatencyHistogram::ApproxPercentileUs(snap, 0.50);
-    auto p90_us = LatencyHistogram::ApproxPercentileUs(snap, 0.90);
-    auto p99_us = LatencyHistogram::ApproxPercentileUs(snap, 0.99);
-    auto p999_us = LatencyHistogram::ApproxPercentileUs(snap, 0.999);
+    if (!opt.compare_target.empty()) {
+        auto first = RunPhase(opt, opt.duration_seconds);
+        PrintSummary(opt, first);
+
+        auto other_opt = opt;
+        other_opt.target = opt.compare_target;
+        auto other = RunPhase(other_opt, opt.duration_seconds);
+        PrintSummary(other_opt, other);
+
+        auto rate = [](const PhaseResult& r, double v) { return r.elapsed > 0 ? v / r.elapsed : 0.0; };
+        auto qps_a = rate(first, static_cast<double>(first.snap.ok));
+        auto qps_b = rate(other, static_cast<double>(other.snap.ok));
+        auto mib_a = rate(first, static_cast<double>(first.snap.bytes) / (1024.0 * 1024.0));
+        auto mib_b = rate(other, static_cast<double>(other.snap.bytes) / (1024.0 * 1024.0));
+        std::cout << "\n" << opt.target << " vs " << opt.compare_target << ": "
+                  << (qps_b > 0 ? qps_a / qps_b : 0.0) << "x qps (" << qps_a << " vs " << qps_b << "), "
+                  << mib_a << " vs " << mib_b << " MiB/s\n";
+        return 0;
+    }
 
-    std::cout << "\n=== chmicro_loadgen summary ===\n";
-    std::cout << "target: http://" << opt.host << ":" << opt.port << opt.target << "\n";
-    std::cout << "threads=" << opt.threads << " concurrency=" << opt.concurrency << " duration=" << opt.duration_seconds << "s\n";
-    std::cout << "ok=" << snap.ok << " err=" << snap.err << "\n";
-    std::cout << "qps=" << qps << "  recv=" << mbps << " MiB/s\n";
-    std::cout << "latency (approx, log2(us) buckets):\n";
-    std::cout << "  p50=" << (p50_us / 1000.0) << " ms\n";
-    std::cout << "  p90=" << (p90_us / 1000.0) << " ms\n";
-    std::cout << "  p99=" << (p99_us / 1000.0) << " ms\n";
-    std::cout << "  p999=" << (p999_us / 1000.0) << " ms\n";
+    if (opt.pipeline > 1) {
+        // Baseline pass without pipelining, same connections and duration.
+        auto base_opt = opt;
+        base_opt.pipeline = 1;
+        auto base = RunPhase(base_opt, opt.duration_seconds);
+        PrintSummary(base_opt, base);
+
+        auto piped = RunPhase(opt, opt.duration_seconds);
+        PrintSummary(opt, piped);
+
+        auto base_qps = base.elapsed > 0 ? static_cast<double>(base.snap.ok) / base.elapsed : 0.0;
+        auto piped_qps = piped.elapsed > 0 ? static_cast<double>(piped.snap.ok) / piped.elapsed : 0.0;
+        std::cout << "\npipelining gain: " << (base_qps > 0 ? piped_qps / base_qps : 0.0)
+                  << "x (" << base_qps << " -> " << piped_qps << " qps)\n";
+        return 0;
+    }
 
+    PrintSummary(opt, RunPhase(opt, opt.duration_seconds));
     return 0;
 }
@@ -1,10 +1,17 @@
 #pragma once
 
+#include <array>
 #include <atomic>
 #include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <initializer_list>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <set>
+#include <stdexcept>
 #include <string>
 #include <string_view>
 #include <unordered_map>
@@ -19,20 +26,63 @@ struct MetricLabels {
     std::string ToPrometheusLabelText() const;
 };
 
+enum class ExpositionFormat {
+    prometheus = 0, // Prometheus text format 0.0.4
+    openmetrics,    // OpenMetrics 1.0 text: counter families without _total, terminated by "# EOF"
+};
+
+// Content-Type of a scrape response in `format`.
+std::string_view ExpositionContentType(ExpositionFormat format);
+
+// Stripes of striped counters and sharded histograms: the hardware thread count rounded up to a
+// power of two, at most 64.
+std::size_t MetricStripeCount();
+
+namespace detail {
+
+// Threads take stripes round-robin on first use and keep them.
+std::size_t NextStripe();
+inline std::size_t ThreadStripe() {
+    thread_local const std::size_t stripe = NextStripe();
+    return stripe;
+}
+
+} // namespace detail
+
+enum class CounterLayout {
+    single = 0, // one atomic; for counters bumped now and then
+    striped,    // one cache line per thread stripe, summed when read; for per-request counters
+};
+
 class Counter {
 public:
+    explicit Counter(CounterLayout layout = CounterLayout::single);
+
     // Thread-safe
-    void Inc(std::int64_t v = 1) { value_.fetch_add(v, std::memory_order_relaxed); }
-    std::int64_t Value() const { return value_.load(std::memory_order_relaxed); }
+    void Inc(std::int64_t v = 1) {
+        if (stripes_ == nullptr) {
+            value_.fetch_add(v, std::memory_order_relaxed);
+        } else {
+            stripes_[detail::ThreadStripe() & stripe_mask_].value.fetch_add(v, std::memory_order_relaxed);
+        }
+    }
+    std::int64_t Value() const;
 
 private:
+    struct alignas(64) Stripe {
+        std::atomic<std::int64_t> value{0};
+    };
+
     std::atomic<std::int64_t> value_{0};
+    std::unique_ptr<Stripe[]> stripes_;
+    std::size_t stripe_mask_ = 0;
 };
 
 class Gauge {
 public:
     // Thread-safe
     void Set(double v);
+    void Add(double delta);
     double Value() const;
 
 private:
@@ -40,6 +90,9 @@ private:
     double value_{0.0};
 };
 
+// Observations go to the calling thread's shard (see MetricStripeCount) with relaxed atomic adds,
+// so concurrent Observe calls neither lock nor share cache lines. Snapshot merges the shards. The
+// sum is kept in fixed point, to 1e-6.
 class Histogram {
 public:
     // Thread-safe
@@ -48,63 +101,301 @@ public:
     void Observe(double v);
     std::vector<double> Buckets() const;
 
-    // Returns counts per bucket (same size as buckets), and sum/total.
+    // Returns counts per bucket (same size as buckets), and sum/total. An observation made meanwhile
+    // may be in the counts but not yet in the sum or the other way round; the total is always the
+    // sum of the counts, so the exposed buckets stay cumulative.
     void Snapshot(std::vector<std::uint64_t>& bucket_counts, double& sum, std::uint64_t& count) const;
 
 private:
+    static constexpr double kSumScale = 1e6;
+    static constexpr std::size_t kCellsPerLine = 8;
+
+    struct alignas(64) Line {
+        std::atomic<std::int64_t> cells[kCellsPerLine] = {};
+    };
+
+    // Cell `i` of shard `shard`: bucket counts, then the count above the last bucket, then the sum.
+    std::atomic<std::int64_t>& Cell(std::size_t shard, std::size_t i) const {
+        return lines_[shard * lines_per_shard_ + i / kCellsPerLine].cells[i % kCellsPerLine];
+    }
+
     std::vector<double> buckets_;
-    mutable std::mutex mu_;
-    std::vector<std::uint64_t> bucket_counts_;
-    double sum_{0.0};
-    std::uint64_t count_{0};
+    std::size_t lines_per_shard_ = 0;
+    std::size_t shard_mask_ = 0;
+    std::unique_ptr<Line[]> lines_;
+};
+
+struct LogLinearOptions {
+    // Values are counted in steps of `resolution`; anything below it lands in the zero bucket.
+    double resolution = 0.001;
+    // 2^precision_bits buckets per power of two: quantiles are within 2^-(precision_bits + 1) of
+    // the true value (1.6% at 5).
+    unsigned precision_bits = 5;
+    // Values up to resolution * 2^range_bits are told apart; larger ones count in the last bucket.
+    unsigned range_bits = 32;
+    // Memory per series: (range_bits - precision_bits + 1) * 2^precision_bits buckets of 8 bytes
+    // (896, about 7 KiB, at the defaults) for each thread shard that has observed a value, so up to
+    // 8x that for a series hit from many threads. Families with many label sets (the registry
+    // allows 10000 per name) add up: prefer fewer precision_bits or range_bits there.
+
+    bool operator==(const LogLinearOptions&) const = default;
+};
+
+// Merged counts of one or more LogLinearHistograms with the same options.
+struct LogLinearSnapshot {
+    LogLinearOptions options;
+    std::vector<std::uint64_t> counts;
+    double sum = 0.0;
+    std::uint64_t count = 0;
+
+    // Throws std::invalid_argument when the options differ. An empty snapshot takes the other's.
+    void Merge(const LogLinearSnapshot& other);
+
+    // Midpoint of the bucket holding the ceil(q * count)-th smallest value; 0 when empty.
+    double Quantile(double q) const;
+};
+
+// HDR-style histogram: exact counts below 2^precision_bits steps, then 2^precision_bits linear
+// buckets per power of two, so relative error stays bounded from microseconds to minutes without
+// hand-picked buckets. Sharded per thread like Histogram, over at most 8 shards, each allocated
+// by the first observation made on it.
+class LogLinearHistogram {
+public:
+    explicit LogLinearHistogram(LogLinearOptions options = {});
+    ~LogLinearHistogram();
+    LogLinearHistogram(const LogLinearHistogram&) = delete;
+    LogLinearHistogram& operator=(const LogLinearHistogram&) = delete;
+
+    // Thread-safe
+    void Observe(double v);
+    LogLinearSnapshot Snapshot() const;
+    // Same, into `out`, reusing its storage.
+    void Snapshot(LogLinearSnapshot& out) const;
+
+    const LogLinearOptions& Options() const { return options_; }
+
+    static std::size_t BucketCount(const LogLinearOptions& options);
+    static std::size_t BucketIndex(const LogLinearOptions& options, double v);
+    // Lower and upper bound of bucket `i`, in the unit of the observed values.
+    static double BucketLower(const LogLinearOptions& options, std::size_t i);
+    static double BucketUpper(const LogLinearOptions& options, std::size_t i);
+
+private:
+    static constexpr double kSumScale = 1e6;
+    static constexpr std::size_t kMaxShards = 8;
+    static constexpr std::size_t kCellsPerLine = 8;
+
+    struct alignas(64) Line {
+        std::atomic<std::int64_t> cells[kCellsPerLine] = {};
+    };
+
+    // Cell `i` of a shard: bucket counts, then the sum.
+    static std::atomic<std::int64_t>& Cell(Line* lines, std::size_t i) {
+        return lines[i / kCellsPerLine].cells[i % kCellsPerLine];
+    }
+    // Lines of `shard`, allocated on first use.
+    Line* Shard(std::size_t shard);
+
+    LogLinearOptions options_;
+    std::size_t buckets_ = 0;
+    std::size_t lines_per_shard_ = 0;
+    std::size_t shard_mask_ = 0;
+    std::array<std::atomic<Line*>, kMaxShards> shards_{};
+};
+
+// Series of one metric told apart by the values of a fixed list of labels. Resolve a child once and
+// keep the reference: children live as long as their registry, so recording through one takes no
+// lock and allocates nothing.
+template <class Metric>
+class Family {
+public:
+    // Sets `overflowed` when the labels were folded into the metric's overflow series, which is then
+    // not cached: the lookup is counted again next time.
+    using Create = std::function<Metric&(MetricLabels, bool& overflowed)>;
+
+    Family(std::vector<std::string> label_names, Create create)
+        : label_names_(std::move(label_names)), create_(std::move(create)) {}
+
+    // Thread-safe. `values` follow the order of LabelNames(); a different count throws
+    // std::invalid_argument.
+    Metric& WithLabelValues(std::initializer_list<std::string_view> values);
+
+    const std::vector<std::string>& LabelNames() const { return label_names_; }
+
+private:
+    std::vector<std::string> label_names_;
+    Create create_;
+    std::mutex mu_;
+    // Values joined with '\n'. Bounded by the registry's series limit.
+    std::unordered_map<std::string, Metric*> children_;
 };
 
 class MetricsRegistry {
 public:
+    static constexpr std::size_t kDefaultSeriesLimit = 10000;
+    static constexpr std::string_view kOverflowLabelValue = "__overflow__";
+    static constexpr std::string_view kOverflowMetric = "metrics_series_overflow_total";
+
+    // Thread-safe. Caps the label sets of one metric name. Past the cap, a new label set resolves
+    // to the name's overflow series, whose label values are all kOverflowLabelValue, and bumps
+    // metrics_series_overflow_total{metric}. Series that already exist are unaffected. 0 means
+    // unlimited; names without a limit of their own get the default.
+    void SetSeriesLimit(std::string name, std::size_t limit);
+    void SetDefaultSeriesLimit(std::size_t limit);
+
     // Thread-safe
-    Counter& CounterMetric(std::string name, std::string help, MetricLabels labels = {});
+    // `layout` applies when the series is first registered.
+    Counter& CounterMetric(std::string name, std::string help, MetricLabels labels = {}, CounterLayout layout = CounterLayout::single);
     Gauge& GaugeMetric(std::string name, std::string help, MetricLabels labels = {});
     Histogram& HistogramMetric(std::string name, std::string help, std::vector<double> buckets, MetricLabels labels = {});
+    // Exposed as a Prometheus summary (quantiles 0.5, 0.9, 0.99, 0.999).
+    LogLinearHistogram& LogLinearMetric(std::string name, std::string help, MetricLabels labels = {},
+        LogLinearOptions options = {});
 
-    // Thread-safe
+    // Thread-safe. Families are keyed by name; the help, label names and buckets of the first call
+    // stay. Their children are the series the *Metric calls above return for the same labels.
+    Family<Counter>& CounterFamily(std::string name, std::string help, std::vector<std::string> label_names,
+        CounterLayout layout = CounterLayout::single);
+    Family<Gauge>& GaugeFamily(std::string name, std::string help, std::vector<std::string> label_names);
+    Family<Histogram>& HistogramFamily(std::string name, std::string help, std::vector<double> buckets,
+        std::vector<std::string> label_names);
+    Family<LogLinearHistogram>& LogLinearFamily(std::string name, std::string help, std::vector<std::string> label_names,
+        LogLinearOptions options = {});
+
+    // Thread-safe. Appends every series to `out`, grouped by metric name. The registry lock is held
+    // only to collect the series; they are read and formatted outside it, so registrations and
+    // lookups never wait for a scrape. Concurrent scrapes take turns. With `out` reused, a scrape
+    // does not allocate once the registry stops growing.
+    void WriteText(std::string& out, ExpositionFormat format = ExpositionFormat::prometheus) const;
     std::string ToPrometheusText() const;
 
+    struct LogLinearSeries {
+        std::string name;
+        MetricLabels labels;
+        LogLinearSnapshot snapshot;
+    };
+    // Thread-safe. Every log-linear series, sorted by name and labels; for debug endpoints that
+    // report raw percentiles.
+    std::vector<LogLinearSeries> LogLinearSnapshots() const;
+
 private:
-    struct CounterEntry {
-        std::string help;
+    enum class SeriesType { counter, gauge, histogram, summary };
+
+    // What a scrape needs of a series besides its value, rendered once when it is registered.
+    struct Series {
+        Series(SeriesType type_, std::string_view name_, std::string_view help_, MetricLabels labels_);
+
+        SeriesType type;
+        std::string name;
+        std::string help; // escaped for a HELP line
         MetricLabels labels;
+        std::string label_text;
+    };
+
+    // By name, then type, then labels: the order series are exposed in.
+    struct SeriesOrder {
+        bool operator()(const Series* a, const Series* b) const;
+    };
+
+    struct CounterEntry : Series {
         Counter counter;
 
-        CounterEntry(std::string help_, MetricLabels labels_)
-            : help(std::move(help_)), labels(std::move(labels_)), counter() {}
+        CounterEntry(std::string_view name_, std::string_view help_, MetricLabels labels_, CounterLayout layout)
+            : Series(SeriesType::counter, name_, help_, std::move(labels_)), counter(layout) {}
     };
 
-    struct GaugeEntry {
-        std::string help;
-        MetricLabels labels;
+    struct GaugeEntry : Series {
         Gauge gauge;
 
-        GaugeEntry(std::string help_, MetricLabels labels_)
-            : help(std::move(help_)), labels(std::move(labels_)), gauge() {}
+        GaugeEntry(std::string_view name_, std::string_view help_, MetricLabels labels_)
+            : Series(SeriesType::gauge, name_, help_, std::move(labels_)) {}
     };
 
-    struct HistogramEntry {
-        std::string help;
-        MetricLabels labels;
+    struct HistogramEntry : Series {
         Histogram histogram;
+        std::vector<std::string> bucket_label_text; // with le, for each bucket and then +Inf
+
+        HistogramEntry(std::string_view name_, std::string_view help_, MetricLabels labels_, std::vector<double> buckets_);
+    };
 
-        HistogramEntry(std::string help_, MetricLabels labels_, std::vector<double> buckets_)
-            : help(std::move(help_)), labels(std::move(labels_)), histogram(std::move(buckets_)) {}
+    struct LogLinearEntry : Series {
+        LogLinearHistogram histogram;
+        std::vector<std::string> quantile_label_text; // with quantile, for each exposed quantile
+
+        LogLinearEntry(std::string_view name_, std::string_view help_, MetricLabels labels_, LogLinearOptions options);
+    };
+
+    // Scrape state, reused across scrapes under scrape_mu_.
+    struct Scratch {
+        std::vector<const Series*> series;
+        std::vector<std::uint64_t> bucket_counts;
+        LogLinearSnapshot log_linear;
     };
 
     static std::string Key(std::string_view name, const MetricLabels& labels);
 
+    template <class Metric>
+    using FamilyMap = std::unordered_map<std::string, std::unique_ptr<Family<Metric>>>;
+
+    // Locked by mu_. Finds or registers a series, folding it into the overflow series (and setting
+    // `*overflowed`, when given) if `name` is at its limit.
+    template <class Entry, class... Args>
+    Entry& FindSeries(std::unordered_map<std::string, Entry>& entries, std::string_view name, std::string& help,
+        MetricLabels& labels, bool* overflowed, Args&&... args);
+    // Locked by mu_. Counts a new series of `name` if it is under its limit.
+    bool AdmitSeries(std::string_view name);
+
+    // Locked by mu_; creates the family with `make()` on first use.
+    template <class Metric, class Make>
+    Family<Metric>& FindFamily(FamilyMap<Metric>& families, std::string name, Make&& make);
+
+    // Taken before mu_ when both are held.
+    mutable std::mutex scrape_mu_;
+    mutable Scratch scratch_;
+
     mutable std::mutex mu_;
+    std::set<const Series*, SeriesOrder> ordered_;
     std::unordered_map<std::string, CounterEntry> counters_;
     std::unordered_map<std::string, GaugeEntry> gauges_;
     std::unordered_map<std::string, HistogramEntry> histograms_;
+    std::unordered_map<std::string, LogLinearEntry> log_linear_;
+    FamilyMap<Counter> counter_families_;
+    FamilyMap<Gauge> gauge_families_;
+    FamilyMap<Histogram> histogram_families_;
+    FamilyMap<LogLinearHistogram> log_linear_families_;
+    std::unordered_map<std::string, std::size_t> series_counts_;
+    std::unordered_map<std::string, std::size_t> series_limits_;
+    std::size_t default_series_limit_ = kDefaultSeriesLimit;
 };
 
+template <class Metric>
+Metric& Family<Metric>::WithLabelValues(std::initializer_list<std::string_view> values) {
+    if (values.size() != label_names_.size()) {
+        throw std::invalid_argument("metric family expects " + std::to_string(label_names_.size()) + " label values");
+    }
+    std::string key;
+    for (auto v : values) {
+        key.append(v);
+        key.push_back('\n');
+    }
+    std::lock_guard<std::mutex> lk(mu_);
+    auto it = children_.find(key);
+    if (it == children_.end()) {
+        MetricLabels labels;
+        auto v = values.begin();
+        for (const auto& name : label_names_) {
+            labels.kv.emplace(name, std::string(*v++));
+        }
+        bool overflowed = false;
+        auto& metric = create_(std::move(labels), overflowed);
+        if (overflowed) {
+            return metric;
+        }
+        it = children_.emplace(std::move(key), &metric).first;
+    }
+    return *it->second;
+}
+
 // Global default registry (Thread-safe)
 MetricsRegistry& DefaultMetrics();
 
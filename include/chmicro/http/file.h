@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <chmicro/core/status.h>
+
+namespace chmicro::http {
+
+// Read-only regular file served as a zero-copy response body. Shared by every response that is
+// sending it; the descriptor is closed with the last reference.
+class File {
+public:
+    static chmicro::Result<std::shared_ptr<const File>> Open(const std::string& path);
+
+    ~File();
+    File(const File&) = delete;
+    File& operator=(const File&) = delete;
+
+    int fd() const { return fd_; }
+    std::uint64_t size() const { return size_; }
+
+    // Copies up to `n` bytes at `offset` into `out`. Returns the byte count, 0 at end of file and
+    // -1 on error. Used where neither sendfile(2) nor mmap is available.
+    std::ptrdiff_t ReadAt(std::uint64_t offset, char* out, std::size_t n) const;
+
+private:
+    File(int fd, std::uint64_t size) : fd_(fd), size_(size) {}
+
+    int fd_ = -1;
+    std::uint64_t size_ = 0;
+};
+
+struct ByteRange {
+    std::uint64_t offset = 0;
+    std::uint64_t length = 0;
+};
+
+enum class RangeStatus {
+    none = 0,      // no usable Range header: serve the whole representation
+    satisfiable,   // serve `out` with 206
+    unsatisfiable, // answer 416
+};
+
+// Parses a single "bytes=first-last", "bytes=first-" or "bytes=-suffix" Range header against a
+// representation of `size` bytes. Multiple ranges and malformed headers yield none, which RFC 7233
+// allows a server to treat as if no Range had been sent.
+RangeStatus ParseRange(std::string_view header, std::uint64_t size, ByteRange& out);
+
+// Media type for a file name, from its extension; application/octet-stream when unknown.
+std::string_view ContentTypeForPath(std::string_view path);
+
+} // namespace chmicro::http
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <chmicro/core/status.h>
+
+namespace chmicro::http {
+
+// HPACK (RFC 7541) header compression for HTTP/2.
+
+struct HeaderField {
+    std::string name;
+    std::string value;
+};
+
+// Recently indexed fields, newest first. Each entry counts its name and value plus 32 bytes.
+class HpackDynamicTable {
+public:
+    explicit HpackDynamicTable(std::size_t capacity = 4096) : capacity_(capacity) {}
+
+    void Add(std::string_view name, std::string_view value);
+    // Evicts oldest entries until the table fits.
+    void SetCapacity(std::size_t capacity);
+
+    std::size_t Capacity() const { return capacity_; }
+    std::size_t Size() const { return size_; }
+    std::size_t Count() const { return entries_.size(); }
+    // 0 is the newest entry.
+    const HeaderField& At(std::size_t i) const { return entries_[i]; }
+
+private:
+    void Evict(std::size_t capacity);
+
+    std::deque<HeaderField> entries_;
+    std::size_t size_ = 0;
+    std::size_t capacity_;
+};
+
+class HpackDecoder {
+public:
+    // `max_table_size` is the SETTINGS_HEADER_TABLE_SIZE this endpoint advertised; the encoder's
+    // table size updates may not exceed it.
+    explicit HpackDecoder(std::size_t max_table_size = 4096);
+
+    // Decodes one complete header block (HEADERS plus CONTINUATION payloads), appending to `out`.
+    // Any failure leaves the shared table unusable and is a connection error (COMPRESSION_ERROR).
+    chmicro::Status Decode(std::string_view block, std::vector<HeaderField>& out);
+
+    // Bounds the decoded fields of one block (names, values and 32 bytes per field).
+    void SetMaxHeaderListSize(std::size_t bytes) { max_list_size_ = bytes; }
+
+    const HpackDynamicTable& Table() const { return table_; }
+
+private:
+    std::size_t max_table_size_;
+    std::size_t max_list_size_ = 64 * 1024;
+    HpackDynamicTable table_;
+};
+
+class HpackEncoder {
+public:
+    HpackEncoder() = default;
+
+    // Peer's SETTINGS_HEADER_TABLE_SIZE. The resize is announced at the start of the next block.
+    void SetMaxTableSize(std::size_t bytes);
+
+    // Starts a header block in `out`.
+    void Begin(std::string& out);
+    // Appends one field. Exact table matches become an index. Other fields are literals, entered
+    // into the dynamic table when `index` is set (for values that repeat across messages).
+    // Strings are Huffman-coded when that is shorter.
+    void Encode(std::string_view name, std::string_view value, std::string& out, bool index = true);
+
+    const HpackDynamicTable& Table() const { return table_; }
+
+private:
+    HpackDynamicTable table_;
+    std::size_t pending_size_update_ = 0;
+    bool size_update_pending_ = false;
+};
+
+// RFC 7541 section 5.2 Huffman code.
+std::size_t HuffmanEncodedLength(std::string_view in);
+void HuffmanEncode(std::string_view in, std::string& out);
+chmicro::Status HuffmanDecode(std::string_view in, std::string& out);
+
+} // namespace chmicro::http
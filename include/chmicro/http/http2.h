@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/core/tcp_stream.hpp>
+
+#include <chmicro/core/metrics.h>
+#include <chmicro/http/hpack.h>
+#include <chmicro/runtime/timer_wheel.h>
+
+namespace chmicro::http {
+
+class Router;
+struct HttpServerOptions;
+
+// What a prior-knowledge h2c client sends first (RFC 9113 section 3.4).
+inline constexpr std::string_view kHttp2Preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+namespace detail {
+
+class RequestMetrics;
+
+// State an HTTP/2 connection shares with the HttpServer that accepted it.
+struct ServerContext {
+    // The server whose router, options and counters the rest refer to; sessions keep it alive.
+    std::shared_ptr<const void> owner;
+    Router& router;
+    const HttpServerOptions& options;
+    chmicro::Gauge& connections;
+    std::shared_ptr<chmicro::TimerWheel> wheel;
+    std::atomic<std::size_t>& open;
+    const std::atomic<bool>& draining;
+    RequestMetrics& metrics;
+};
+
+// Serves an accepted connection as HTTP/2. `buffered` holds bytes already read from it, starting
+// at the client preface. After "Upgrade: h2c", `upgrade` is the upgrading request as HTTP/2 fields
+// (answered on stream 1) and `settings` the decoded HTTP2-Settings payload.
+void ServeHttp2(boost::beast::tcp_stream stream, boost::beast::flat_buffer buffered, const ServerContext& ctx,
+    std::vector<HeaderField> upgrade = {}, std::string settings = {});
+
+} // namespace detail
+} // namespace chmicro::http
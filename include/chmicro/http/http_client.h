@@ -2,6 +2,9 @@
 
 #include <chrono>
 #include <string>
+#include <utility>
+
+#include <boost/asio/awaitable.hpp>
 
 #include <chmicro/core/status.h>
 
@@ -21,6 +24,14 @@ public:
         std::string port,
         std::string target,
         std::chrono::milliseconds timeout);
+
+    // Non-blocking: runs on the calling coroutine's executor, so an AsyncHandler can keep many
+    // downstream calls in flight per IO thread. `timeout` bounds connect + write + read.
+    static boost::asio::awaitable<chmicro::Result<HttpClientResponse>> AsyncGet(
+        std::string host,
+        std::string port,
+        std::string target,
+        std::chrono::milliseconds timeout);
 };
 
 } // namespace chmicro::http
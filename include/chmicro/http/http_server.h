@@ -1,14 +1,24 @@
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 #include <boost/asio/ip/tcp.hpp>
 
+#include <chmicro/core/metrics.h>
 #include <chmicro/runtime/app.h>
+#include <chmicro/runtime/timer_wheel.h>
 #include <chmicro/http/router.h>
+#include <chmicro/resilience/admission_controller.h>
 
 namespace chmicro::http {
 
@@ -17,22 +27,170 @@ struct ListenAddress {
     std::uint16_t port = 0;
 };
 
+// Decides whether a request may proceed, once its head is parsed and its route matched and before
+// any of the body is read. `route` is null for unmatched paths. Return false to answer with `resp`
+// (e.g. 429 with Retry-After); when admitting, `resp` is passed on to the route unchanged.
+using AdmissionHook = std::function<bool(const Request& head, const Route* route, Response& resp)>;
+
+struct HttpServerOptions {
+    // Multi-reactor mode only. When true (and the platform supports SO_REUSEPORT), every pool
+    // context gets its own listening socket and the kernel balances connections between them.
+    // Otherwise a single acceptor hands accepted sockets to the pool contexts round-robin.
+    bool reuse_port = false;
+
+    // Pool running routes registered with ExecutionPolicy::offload (typically &app.Workers()).
+    // When null, offloaded routes run inline on the IO thread.
+    chmicro::WorkerPool* workers = nullptr;
+
+    // HTTP/1.1 pipelining: complete requests already buffered on a connection are run in order and
+    // their responses go out in one gather write. Caps how many responses one write may batch;
+    // 1 disables batching.
+    std::size_t max_pipeline_depth = 16;
+
+    // Stream routes: size of the buffer BodyReader::Read() fills. Bounds per-connection memory for
+    // request bodies of any length.
+    std::size_t stream_chunk_bytes = 64 * 1024;
+
+    // File bodies (Response::SetFile, Router::Static) go out with sendfile(2) on Linux. When false,
+    // or where sendfile is unavailable, they are written from a bounded mmap'd window instead.
+    bool use_sendfile = true;
+
+    // Largest body buffered for regular routes without their own RouteOptions::max_body_bytes.
+    std::uint64_t max_body_bytes = 1024 * 1024;
+
+    // Cleartext HTTP/2 (h2c) on the same listeners, for connections that open with the HTTP/2
+    // preface (prior knowledge) or whose first request is bodyless and asks for "Upgrade: h2c".
+    // Each stream goes through routing, admission and metrics like an HTTP/1.1 request.
+    bool http2 = true;
+    // SETTINGS_MAX_CONCURRENT_STREAMS; streams over it are refused.
+    std::uint32_t http2_max_streams = 128;
+    // Flow-control window per stream: request body a client may send before the handler reads it.
+    std::uint32_t http2_stream_window = 256 * 1024;
+
+    // Optional; see AdmissionHook. Requests sent with "Expect: 100-continue" only get the interim
+    // 100 response once admitted, so rejected clients never transmit the body.
+    AdmissionHook admission;
+
+    // Adaptive in-flight limit checked after `admission`, shared by every reactor. Requests over
+    // the limit get 503 with Retry-After; routes with RouteOptions::bypass_admission are exempt.
+    // Offloaded routes report their worker-pool wait as queue delay.
+    std::shared_ptr<chmicro::resilience::AdmissionController> admission_controller;
+
+    // Connection deadlines; 0 disables one. They are enforced by one coarse TimerWheel per reactor
+    // ticking every `timer_tick`, not a timer per operation. An expired deadline closes the
+    // connection and counts http_server_timeouts_total{reason}.
+    std::chrono::milliseconds idle_timeout{60000};   // keep-alive wait for a request's first byte
+    std::chrono::milliseconds header_timeout{10000}; // first byte to the end of the request head
+    std::chrono::milliseconds body_timeout{30000};   // longest wait for more request body
+    std::chrono::milliseconds write_timeout{30000};  // per response write, plus its size at min_transfer_rate
+    // Bytes/s a request body must average once the server has waited `min_rate_grace` for it; also
+    // the rate write deadlines allow for. 0 disables.
+    std::uint64_t min_transfer_rate = 1024;
+    std::chrono::milliseconds min_rate_grace{5000};
+    std::chrono::milliseconds timer_tick{250};
+};
+
+namespace detail {
+
+// Labels of http_server_rejected_total{reason} and http_server_timeouts_total{reason}.
+enum class RejectReason { body_too_large, admission, overload, bulkhead, streams };
+enum class TimeoutReason { idle, header, body, write, min_rate };
+
+// http_server_request_ms{path} and http_server_requests_total{path,status} of one server. Requests
+// are labeled with their route's path, or "__unmatched__", and statuses outside 100-599 with
+// "other", so the series stay bounded whatever paths clients send. Handles are resolved up front
+// (per status code on first use), so Record() neither takes the registry lock nor allocates.
+class RequestMetrics {
+public:
+    static constexpr std::string_view kUnmatched = "__unmatched__";
+
+    explicit RequestMetrics(const Router& router);
+
+    // Thread-safe. `route` is null for unmatched requests.
+    void Record(const Route* route, unsigned status, double elapsed_ms);
+    // Thread-safe; bound per reason up front like the route series.
+    void Rejected(RejectReason reason) { rejected_[static_cast<std::size_t>(reason)]->Inc(); }
+    void TimedOut(TimeoutReason reason) { timeouts_[static_cast<std::size_t>(reason)]->Inc(); }
+
+private:
+    static constexpr unsigned kMinStatus = 100;
+    static constexpr unsigned kMaxStatus = 599;
+
+    struct RouteSeries {
+        std::string_view label;
+        chmicro::LogLinearHistogram* latency = nullptr;
+        // Indexed by status - kMinStatus; the last slot is "other".
+        std::array<std::atomic<chmicro::Counter*>, kMaxStatus - kMinStatus + 2> requests{};
+    };
+
+    RouteSeries& Series(const Route* route);
+
+    chmicro::Family<chmicro::LogLinearHistogram>& latency_;
+    chmicro::Family<chmicro::Counter>& requests_;
+    std::unordered_map<const Route*, std::unique_ptr<RouteSeries>> routes_;
+    RouteSeries unmatched_;
+    std::array<chmicro::Counter*, 5> rejected_{};
+    std::array<chmicro::Counter*, 5> timeouts_{};
+};
+
+} // namespace detail
+
 class HttpServer final : public chmicro::IHttpServer, public std::enable_shared_from_this<HttpServer> {
 public:
-    HttpServer(boost::asio::io_context& ioc, ListenAddress addr, Router router);
+    // Single-reactor mode: every connection is served on `ioc`.
+    HttpServer(boost::asio::io_context& ioc, ListenAddress addr, Router router, HttpServerOptions options = {});
+
+    // Multi-reactor mode: connections are spread across every context of `pool`.
+    HttpServer(chmicro::IoContextPool& pool, ListenAddress addr, Router router, HttpServerOptions options = {});
 
-    void Start() override;
+    // Binds the listen address, or adopts the listeners passed to InheritListeners(). On failure the
+    // server stays stopped and inherited handles are closed.
+    chmicro::Status Start() override;
     void Stop() override;
 
+    // Closes the listeners. Responses then carry "Connection: close", and keep-alive connections
+    // waiting for another request are closed (those with idle_timeout disabled are left to the
+    // caller's drain deadline). Connections that never sent a request still get to send one.
+    void Drain() override;
+    std::size_t ActiveConnections() const override;
+
+    std::vector<int> ListenerHandles() const override;
+    // Must precede Start(). One handle per former acceptor; as many as there are contexts spread
+    // them like reuse_port, otherwise they hand sessions out round-robin.
+    void InheritListeners(std::vector<int> handles) override;
+
+    // Port of the first listener once started; resolves ListenAddress::port 0.
+    std::uint16_t LocalPort() const;
+
 private:
-    void DoAccept();
+    struct Listener {
+        std::unique_ptr<boost::asio::ip::tcp::acceptor> acceptor;
+        // Index into contexts_ serving sessions accepted here, or kRoundRobin to spread them.
+        std::size_t context = 0;
+    };
+
+    static constexpr std::size_t kRoundRobin = static_cast<std::size_t>(-1);
+
+    chmicro::Status OpenListener(Listener& l, const boost::asio::ip::tcp::endpoint& endpoint, bool reuse_port);
+    void DoAccept(std::size_t listener);
 
-    boost::asio::io_context& ioc_;
+    std::vector<boost::asio::io_context*> contexts_;
     ListenAddress addr_;
     Router router_;
+    HttpServerOptions options_;
+    std::unique_ptr<detail::RequestMetrics> metrics_;
 
-    boost::asio::ip::tcp::acceptor acceptor_;
+    std::vector<Listener> listeners_;
+    std::vector<int> inherited_;
+    // One per context, indexed like contexts_.
+    std::vector<std::shared_ptr<chmicro::TimerWheel>> wheels_;
+    // Per-context connection gauges (http_server_connections{context="i"}).
+    std::vector<chmicro::Gauge*> connections_;
+    std::atomic<std::size_t> rr_{0};
     std::atomic<bool> running_{false};
+    std::atomic<bool> draining_{false};
+    // Sessions of this server, unlike the gauges which every server on a context shares.
+    std::atomic<std::size_t> open_{0};
 };
 
 } // namespace chmicro::http
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <chmicro/core/metrics.h>
+#include <chmicro/http/router.h>
+
+namespace chmicro::http {
+
+struct ResponseCacheOptions {
+    // Entries are spread over independently locked shards by key hash.
+    std::size_t shards = 16;
+    // Budget for keys and cached responses across all shards; each shard evicts its least recently
+    // used entries once it holds more than max_bytes / shards.
+    std::size_t max_bytes = 64 * 1024 * 1024;
+    // Larger responses are passed through without being stored.
+    std::size_t max_entry_bytes = 1024 * 1024;
+    std::chrono::milliseconds ttl{1000};
+
+    // Request paths (exact, without query) whose GET responses are cached; empty caches every GET.
+    // Only synchronous routes qualify: for async and stream routes the handler has not produced the
+    // response yet when next() returns.
+    std::vector<std::string> paths;
+    // Response statuses that are stored.
+    std::vector<unsigned> statuses{200};
+
+    // Cache key for a request; defaults to the request target (path and query).
+    std::function<std::string(const Request&)> key;
+
+    // How long a concurrent miss waits for the request already running the handler for its key
+    // before running the handler itself. Misses handled inline on a reactor (InlineOnReactor())
+    // never wait: they get the expired entry the running request is replacing if there is one, and
+    // run the handler themselves otherwise. Offload routes to coalesce reliably.
+    std::chrono::milliseconds coalesce_wait{1000};
+
+    // Value of the "cache" label on the http_cache_* metrics.
+    std::string name = "http";
+};
+
+// In-process cache of complete responses (status, content type, the headers the handler set and
+// body) for idempotent GETs, installed with Router::Use(cache.AsMiddleware()) or on single routes
+// through RouteOptions::middleware.
+//
+// Concurrent misses for one key are coalesced: the first runs the handler, the others wait for its
+// response instead of running the handler again (except on reactor threads; see coalesce_wait).
+// Writers call Invalidate() with the key they changed; a response still being computed for that key
+// is then handed to its waiters but not stored. Counts
+// http_cache_{hits,misses,coalesced,stale,evictions}_total and http_cache_bytes.
+class ResponseCache {
+public:
+    explicit ResponseCache(ResponseCacheOptions opts = {});
+
+    ResponseCache(const ResponseCache&) = delete;
+    ResponseCache& operator=(const ResponseCache&) = delete;
+
+    // The middleware refers to this cache, which must outlive the router using it. Register it
+    // after middleware that sets per-request headers: those are kept on hits, not cached.
+    Middleware AsMiddleware();
+
+    // Thread-safe. Drop the entry for `key` (as produced by ResponseCacheOptions::key).
+    void Invalidate(std::string_view key);
+    // Thread-safe. Drop every entry.
+    void Clear();
+
+    // Thread-safe.
+    std::size_t Size() const;
+    std::size_t Bytes() const;
+    std::int64_t Hits() const { return hits_.Value(); }
+    std::int64_t Misses() const { return misses_.Value(); }
+    std::int64_t Coalesced() const { return coalesced_.Value(); }
+    std::int64_t Stale() const { return stale_.Value(); }
+
+private:
+    // One cached response, packed into a single allocation.
+    struct Entry {
+        unsigned status = 200;
+        std::size_t content_type_len = 0;
+        // Name and value lengths of the headers stored after the content type; the body follows.
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> headers;
+        std::string data;
+        std::chrono::steady_clock::time_point expires;
+
+        void ApplyTo(Response& resp) const;
+    };
+
+    // A handler run for a key that concurrent misses wait on.
+    struct Flight {
+        std::mutex mu;
+        std::condition_variable cv;
+        bool done = false;
+        std::shared_ptr<const Entry> entry; // null when the response was not cacheable
+        std::shared_ptr<const Entry> stale; // expired entry the run replaces; set before it is shared
+        bool invalidated = false;           // guarded by the shard mutex
+    };
+
+    struct Node {
+        std::string key;
+        std::shared_ptr<const Entry> entry;
+        std::size_t bytes = 0;
+    };
+
+    struct KeyHash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+    };
+    struct KeyEq {
+        using is_transparent = void;
+        bool operator()(std::string_view a, std::string_view b) const { return a == b; }
+    };
+
+    struct Shard {
+        mutable std::mutex mu;
+        std::list<Node> lru; // most recently used first
+        std::unordered_map<std::string, std::list<Node>::iterator, KeyHash, KeyEq> index;
+        std::unordered_map<std::string, std::shared_ptr<Flight>, KeyHash, KeyEq> flights;
+        std::size_t bytes = 0;
+    };
+
+    void Serve(const Request& req, Response& resp, const Next& next);
+    bool Cacheable(const Request& req) const;
+    std::shared_ptr<const Entry> Capture(const Response& resp, const std::vector<std::pair<std::string, std::string>>& before) const;
+    // Ends the handler run `flight` for `key`, storing `entry` unless it was invalidated meanwhile.
+    void Complete(Shard& shard, const std::string& key, const std::shared_ptr<Flight>& flight, std::shared_ptr<const Entry> entry);
+    void EraseLocked(Shard& shard, std::list<Node>::iterator it);
+    Shard& ShardFor(std::string_view key);
+
+    ResponseCacheOptions opts_;
+    std::unordered_set<std::string, KeyHash, KeyEq> paths_;
+    std::size_t shard_budget_ = 0;
+    std::vector<std::unique_ptr<Shard>> shards_;
+
+    chmicro::Counter& hits_;
+    chmicro::Counter& misses_;
+    chmicro::Counter& coalesced_;
+    chmicro::Counter& stale_;
+    chmicro::Counter& evictions_;
+    chmicro::Gauge& bytes_;
+};
+
+} // namespace chmicro::http
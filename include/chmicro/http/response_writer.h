@@ -0,0 +1,52 @@
+#pragma once
+
+#include <ctime>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+
+#include <chmicro/core/trace.h>
+#include <chmicro/http/types.h>
+
+namespace chmicro::http {
+
+// RFC 7231 IMF-fixdate "Date: ...\r\n" line. Each thread (i.e. each reactor) keeps its own copy
+// and reformats it at most once per second, so callers never take a lock.
+class HttpDate {
+public:
+    // "Date: Thu, 16 Oct 2026 12:00:00 GMT\r\n"; valid until the next call on this thread.
+    static std::string_view Line();
+
+    // Same format for an explicit time; used by Line() and tests.
+    static std::string Format(std::time_t t);
+};
+
+// Pre-encoded "HTTP/1.x <code> <reason>\r\nServer: chmicro/0.1\r\n" for codes 100-599;
+// anything else is treated as 500.
+std::string_view StatusPrefix(unsigned version, unsigned status);
+
+// False for 1xx, 204 and 304: those responses end with their header block (RFC 9112 section 6.3),
+// so they carry neither a body nor Content-Length/Transfer-Encoding.
+bool StatusHasBody(unsigned status);
+
+// How the body following the header block is delimited.
+enum class BodyFraming {
+    content_length = 0, // Content-Length: resp.BodySize()
+    chunked,            // Transfer-Encoding: chunked (HTTP/1.1 only)
+    close,              // ends when the connection closes; forces keep_alive off
+};
+
+// Appends the complete header block for `resp` (status line, Server, Date, Content-Type,
+// traceparent, custom headers, body framing, Connection, blank line) to `out`. `framing` is ignored
+// when !StatusHasBody(resp.status). Keep-alive follows the same rules as beast's
+// message::keep_alive()/need_eof(). resp.headers are emitted
+// as-is, so set the content type through resp.content_type. Does not allocate beyond growing `out`.
+void AppendResponseHead(
+    std::pmr::string& out,
+    unsigned version,
+    const Response& resp,
+    const chmicro::TraceContext& trace,
+    bool keep_alive,
+    BodyFraming framing = BodyFraming::content_length);
+
+} // namespace chmicro::http
@@ -1,46 +1,274 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <tuple>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include <boost/asio/awaitable.hpp>
 #include <boost/beast/http.hpp>
 
+#include <chmicro/http/stream.h>
 #include <chmicro/http/types.h>
+#include <chmicro/resilience/bulkhead.h>
 
 namespace chmicro::http {
 
 using Handler = std::function<void(const Request&, Response&)>;
-using Next = std::function<void()>;
+// Coroutine handler: runs on the session strand and may co_await downstream I/O
+// (e.g. HttpClient::AsyncGet) without blocking the IO thread.
+using AsyncHandler = std::function<boost::asio::awaitable<void>(const Request&, Response&)>;
+// Stream handler: reads the request body through `body` and may answer either by filling `resp`
+// (sent as usual) or chunk by chunk through `out`. Runs on the session strand like AsyncHandler.
+using StreamHandler = std::function<boost::asio::awaitable<void>(const Request&, BodyReader& body, Response& resp, ResponseStream& out)>;
+class Next;
 using Middleware = std::function<void(const Request&, Response&, Next)>;
 
+// Continues a route's middleware chain: calls the following middleware, or the handler step after
+// the last one. A few pointers, passed by value; valid only during the call it was passed to.
+class Next {
+public:
+    void operator()() const;
+
+private:
+    friend class Router;
+
+    Next(const std::shared_ptr<const Middleware>* chain, std::size_t remaining, const Request& req, Response& resp,
+        void* terminal, void (*terminal_fn)(void*))
+        : chain_(chain), remaining_(remaining), req_(&req), resp_(&resp), terminal_(terminal), terminal_fn_(terminal_fn) {}
+
+    const std::shared_ptr<const Middleware>* chain_;
+    std::size_t remaining_;
+    const Request* req_;
+    Response* resp_;
+    void* terminal_;
+    void (*terminal_fn_)(void*);
+};
+
+namespace detail {
+
+template <std::size_t I, class Stages, class Continue>
+void RunStages(const Stages& stages, const Request& req, Response& resp, const Continue& next) {
+    if constexpr (I == std::tuple_size_v<Stages>) {
+        next();
+    } else {
+        std::get<I>(stages)(req, resp, [&] { RunStages<I + 1>(stages, req, resp, next); });
+    }
+}
+
+} // namespace detail
+
+// Composes middleware known at compile time into one Middleware. Each stage is called as
+// stage(req, resp, next) with a generic `next` that runs the following stage; the calls between
+// stages are direct and can be inlined, so the chain costs one type-erased call in total.
+template <class... Stages>
+Middleware Compose(Stages... stages) {
+    return [stages = std::make_tuple(std::move(stages)...)](const Request& req, Response& resp, Next next) {
+        detail::RunStages<0>(stages, req, resp, next);
+    };
+}
+
+enum class ExecutionPolicy {
+    inline_io = 0, // run on the IO thread that read the request (default; for cheap handlers)
+    offload,       // run on the App worker pool; the response is written back on the session strand
+};
+
+// Marks the calling thread, for its lifetime, as a reactor running a handler inline. HttpServer
+// sets it around ExecutionPolicy::inline_io routes and HandleAsync/HandleStream around middleware;
+// blocking there stalls every connection of that reactor, so middleware that would wait
+// (ResponseCache) checks InlineOnReactor() first.
+class InlineHandlerScope {
+public:
+    InlineHandlerScope();
+    ~InlineHandlerScope();
+
+    InlineHandlerScope(const InlineHandlerScope&) = delete;
+    InlineHandlerScope& operator=(const InlineHandlerScope&) = delete;
+
+private:
+    bool outer_;
+};
+
+// True inside an InlineHandlerScope on the calling thread.
+bool InlineOnReactor();
+
+struct RouteOptions {
+    // Ignored for async and stream routes, which always run on the session strand.
+    ExecutionPolicy execution = ExecutionPolicy::inline_io;
+
+    // Request body cap in bytes. 0 means HttpServerOptions::max_body_bytes for buffered routes and
+    // no cap for stream routes. A Content-Length above it is answered with 413 before the body is
+    // read; a chunked body fails once it crosses the cap.
+    std::uint64_t max_body_bytes = 0;
+
+    // Skips HttpServerOptions::admission_controller, e.g. for health checks and metrics that must
+    // stay reachable while the server sheds load.
+    bool bypass_admission = false;
+
+    // Caps how many requests of this route run at once (HttpServer enforces it; Router::Handle
+    // does not). Routes may share one. A request it cannot admit is answered with 503.
+    std::shared_ptr<chmicro::resilience::Bulkhead> bulkhead;
+
+    // Names of Router::Use middleware this route skips.
+    std::vector<std::string> skip_middleware;
+    // Runs after the router-wide middleware, for this route only.
+    std::vector<Middleware> middleware;
+};
+
+struct Route {
+    boost::beast::http::verb method;
+    std::string path;
+    Handler handler;             // set for synchronous routes
+    AsyncHandler async_handler;  // set for coroutine routes
+    StreamHandler stream_handler; // set for streaming routes
+    RouteOptions options;
+    // Names of the parameter segments in `path`, in order.
+    std::vector<std::string> params;
+    // Middleware run for this route, flattened by the Router: router-wide ones not skipped, then
+    // options.middleware.
+    std::vector<std::shared_ptr<const Middleware>> chain;
+
+    bool is_async() const { return static_cast<bool>(async_handler); }
+    bool is_stream() const { return static_cast<bool>(stream_handler); }
+};
+
+// Route paths are matched segment by segment against a compressed radix tree per method:
+//   /users/{id}/posts   "{id}" matches one non-empty segment
+//   /files/*path        "*path" matches the rest of the path, slashes included; last segment only
+// Literal segments win over "{param}", which wins over "*wildcard"; matching backtracks when a
+// more specific branch dead-ends. Captured values are read with Request::Param(). Registering a
+// malformed pattern (a parameter sharing its segment with text, a wildcard before the end, more
+// than PathParams::kMax parameters) throws std::invalid_argument.
 class Router {
 public:
+    Router();
+    ~Router();
+    // Copies rebuild the lookup tree for their own routes.
+    Router(const Router& o);
+    Router& operator=(const Router& o);
+    Router(Router&&) noexcept;
+    Router& operator=(Router&&) noexcept;
+
     // Thread-safe for read after construction. Build routes before serving.
+    // Adds middleware for every route, including routes registered earlier. Each route's chain is
+    // flattened here and at registration, so requests do not build one. A named middleware can be
+    // left out per route with RouteOptions::skip_middleware.
     void Use(Middleware mw);
+    void Use(std::string name, Middleware mw);
+
+    void AddRoute(boost::beast::http::verb method, std::string path, Handler handler, RouteOptions options = {});
+
+    void Get(std::string path, Handler handler, RouteOptions options = {}) {
+        AddRoute(boost::beast::http::verb::get, std::move(path), std::move(handler), std::move(options));
+    }
+    void Post(std::string path, Handler handler, RouteOptions options = {}) {
+        AddRoute(boost::beast::http::verb::post, std::move(path), std::move(handler), std::move(options));
+    }
+
+    void AddAsyncRoute(boost::beast::http::verb method, std::string path, AsyncHandler handler, RouteOptions options = {});
+
+    void GetAsync(std::string path, AsyncHandler handler, RouteOptions options = {}) {
+        AddAsyncRoute(boost::beast::http::verb::get, std::move(path), std::move(handler), std::move(options));
+    }
+    void PostAsync(std::string path, AsyncHandler handler, RouteOptions options = {}) {
+        AddAsyncRoute(boost::beast::http::verb::post, std::move(path), std::move(handler), std::move(options));
+    }
+
+    // The request body is not buffered for stream routes: the handler reads it through BodyReader.
+    void AddStreamRoute(boost::beast::http::verb method, std::string path, StreamHandler handler, RouteOptions options = {});
+
+    void GetStream(std::string path, StreamHandler handler, RouteOptions options = {}) {
+        AddStreamRoute(boost::beast::http::verb::get, std::move(path), std::move(handler), std::move(options));
+    }
+    void PostStream(std::string path, StreamHandler handler, RouteOptions options = {}) {
+        AddStreamRoute(boost::beast::http::verb::post, std::move(path), std::move(handler), std::move(options));
+    }
+
+    // Matches every path that starts with `prefix` (after exact routes; the longest prefix wins).
+    void AddPrefixRoute(boost::beast::http::verb method, std::string prefix, Handler handler, RouteOptions options = {});
 
-    void AddRoute(boost::beast::http::verb method, std::string path, Handler handler);
+    // Serves files under `dir` for GET <prefix><relative path> as zero-copy file bodies, with Range
+    // support. Paths are not percent-decoded; "." and ".." segments are refused with 404.
+    void Static(std::string prefix, std::string dir, RouteOptions options = {});
 
-    void Get(std::string path, Handler handler) { AddRoute(boost::beast::http::verb::get, std::move(path), std::move(handler)); }
-    void Post(std::string path, Handler handler) { AddRoute(boost::beast::http::verb::post, std::move(path), std::move(handler)); }
+    // Every registered route, exact and prefix. The pointers stay valid until the router changes.
+    std::vector<const Route*> Routes() const;
 
-    void Handle(const Request& req, Response& resp) const;
+    // Returns nullptr when no route matches. Does not allocate. When `params` is given it receives
+    // the values of the route's parameter segments, as offsets into `path`.
+    const Route* Match(boost::beast::http::verb method, std::string_view path, PathParams* params = nullptr) const;
+
+    // Runs middleware + handler for a matched route; a null route produces the 404 response.
+    // Async routes must go through HandleAsync, stream routes through HandleStream.
+    void Handle(const Route* route, const Request& req, Response& resp) const;
+    // Matches req.path first, filling req.params.
+    void Handle(Request& req, Response& resp) const;
+
+    // Works for every route kind. Middleware is synchronous: for async routes it runs before the
+    // handler starts, and code after next() runs before the handler has completed.
+    boost::asio::awaitable<void> HandleAsync(const Route* route, const Request& req, Response& resp) const;
+
+    // For stream routes; others are answered through `resp` as in HandleAsync. Middleware runs
+    // first and sees `resp`, so headers it adds are part of the streamed head.
+    boost::asio::awaitable<void> HandleStream(
+        const Route* route, const Request& req, BodyReader& body, Response& resp, ResponseStream& out) const;
 
 private:
     struct RouteKey {
         boost::beast::http::verb method;
         std::string path;
+    };
 
-        bool operator==(const RouteKey& o) const { return method == o.method && path == o.path; }
+    // Borrowed key so Match() can look up a string_view path without building a std::string.
+    struct RouteKeyView {
+        boost::beast::http::verb method;
+        std::string_view path;
     };
 
     struct RouteKeyHash {
-        std::size_t operator()(const RouteKey& k) const;
+        using is_transparent = void;
+        std::size_t operator()(const RouteKey& k) const { return (*this)(RouteKeyView{k.method, k.path}); }
+        std::size_t operator()(const RouteKeyView& k) const;
+    };
+
+    struct RouteKeyEq {
+        using is_transparent = void;
+        template <class A, class B>
+        bool operator()(const A& a, const B& b) const {
+            return a.method == b.method && std::string_view(a.path) == std::string_view(b.path);
+        }
+    };
+
+    struct Node;
+    struct Tree;
+
+    struct NamedMiddleware {
+        std::string name;
+        std::shared_ptr<const Middleware> fn;
     };
 
-    std::vector<Middleware> middleware_;
-    std::unordered_map<RouteKey, Handler, RouteKeyHash> routes_;
+    // Registers `route`, replacing one with the same method and path.
+    void Insert(Route route);
+    void Index(const Route& route);
+    void Flatten(Route& route) const;
+
+    // Runs the route's middleware chain; `terminal` is invoked if every middleware called next().
+    template <class Terminal>
+    static void RunMiddleware(const Route& route, const Request& req, Response& resp, Terminal&& terminal);
+    static void NotFound(Response& resp);
+
+    std::vector<NamedMiddleware> middleware_;
+    // Owns the routes; node-based, so the trees can point into it. Paths without parameters are
+    // looked up here directly before walking a tree.
+    std::unordered_map<RouteKey, Route, RouteKeyHash, RouteKeyEq> routes_;
+    std::vector<std::unique_ptr<Tree>> trees_; // one per method with routes
+    std::vector<Route> prefix_routes_; // longest prefix first
 };
 
 } // namespace chmicro::http
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string_view>
+#include <utility>
+
+#include <boost/asio/awaitable.hpp>
+
+#include <chmicro/core/status.h>
+
+namespace chmicro::http {
+
+// Incremental access to a request body for stream routes. The server reads the body straight from
+// the socket into one buffer of HttpServerOptions::stream_chunk_bytes, so memory use does not grow
+// with the payload size.
+class BodyReader {
+public:
+    virtual ~BodyReader() = default;
+
+    // Next piece of the body, at most stream_chunk_bytes long. An empty view means the body is
+    // complete. The view is valid until the next Read(). Fails with invalid_argument once the body
+    // exceeds the route's RouteOptions::max_body_bytes. The first call answers "Expect: 100-continue".
+    virtual boost::asio::awaitable<chmicro::Result<std::string_view>> Read() = 0;
+
+    // True once the whole body has been read.
+    virtual bool Done() const = 0;
+};
+
+// Chunk-by-chunk response for stream routes. The first Write() sends the status line and headers
+// taken from the route's Response (status, content_type, headers; its body is ignored). The body
+// then goes out with Transfer-Encoding: chunked, or close-delimited for HTTP/1.0 clients. The
+// terminating chunk is sent when the handler returns.
+class ResponseStream {
+public:
+    virtual ~ResponseStream() = default;
+
+    // Completes once the socket has accepted `data`. A producer is therefore never more than one
+    // chunk ahead of a slow client. Empty writes only send the head.
+    virtual boost::asio::awaitable<chmicro::Status> Write(std::string_view data) = 0;
+
+    // True once the head has been sent. After that the Response object is no longer used.
+    virtual bool Started() const = 0;
+};
+
+} // namespace chmicro::http
@@ -1,33 +1,152 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <vector>
 
 #include <boost/beast/http.hpp>
 
 #include <chmicro/core/trace.h>
+#include <chmicro/http/file.h>
 
 namespace chmicro::http {
 
 namespace beast_http = boost::beast::http;
 
+// Allocator over a std::pmr::memory_resource. Unlike std::pmr::polymorphic_allocator it is
+// assignable, which Beast requires of field allocators. Like it, it never propagates, so moving
+// between different resources copies.
+template <class T>
+class ResourceAllocator {
+public:
+    using value_type = T;
+
+    ResourceAllocator() noexcept : mr_(std::pmr::get_default_resource()) {}
+    ResourceAllocator(std::pmr::memory_resource* mr) noexcept : mr_(mr) {}
+    template <class U>
+    ResourceAllocator(const ResourceAllocator<U>& o) noexcept : mr_(o.resource()) {}
+
+    T* allocate(std::size_t n) { return static_cast<T*>(mr_->allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T* p, std::size_t n) noexcept { mr_->deallocate(p, n * sizeof(T), alignof(T)); }
+
+    std::pmr::memory_resource* resource() const noexcept { return mr_; }
+
+    template <class U>
+    bool operator==(const ResourceAllocator<U>& o) const noexcept { return mr_ == o.resource() || mr_->is_equal(*o.resource()); }
+
+private:
+    std::pmr::memory_resource* mr_;
+};
+
+// Requests and responses allocate from a memory resource so the server can back each connection
+// with a monotonic arena (reset after every completed write). Handlers can allocate from the same
+// arena via Request::Resource() and std::pmr containers.
+using Allocator = ResourceAllocator<char>;
+using Fields = beast_http::basic_fields<Allocator>;
+using StringBody = beast_http::basic_string_body<char, std::char_traits<char>, Allocator>;
+using RawRequest = beast_http::request<StringBody, Fields>;
+
+struct QueryParam {
+    std::string_view key;
+    std::string_view value; // not percent-decoded
+};
+
+// Values captured by "{name}" and "*name" route segments, filled in by Router::Match. Stored as
+// offsets into the matched path so they survive copies of the request; names view the Route.
+struct PathParams {
+    static constexpr std::size_t kMax = 8;
+
+    struct Slot {
+        std::string_view name;
+        std::uint32_t offset = 0;
+        std::uint32_t length = 0;
+    };
+
+    std::array<Slot, kMax> slots{};
+    std::size_t count = 0;
+};
+
 struct Request {
-    beast_http::request<beast_http::string_body> raw;
-    std::string path; // target without query
-    std::unordered_map<std::string, std::string> query;
+    RawRequest raw;
+    // Target without query. After BindTarget() this is a view into raw.target(); tests may point it
+    // at any storage that outlives the request.
+    std::string_view path;
     chmicro::TraceContext trace;
+    // Set by the server (or by passing it to Router::Match) for routes with parameter segments.
+    PathParams params;
 
+    Request() = default;
+    // Body and fields of raw allocate from `mr`.
+    explicit Request(std::pmr::memory_resource* mr);
+    // Copies/moves keep path and query views pointing into their own raw message.
+    Request(const Request& o);
+    Request(Request&& o) noexcept;
+    Request& operator=(const Request& o);
+    Request& operator=(Request&& o) noexcept;
+
+    // Points path at raw.target(). Call after setting raw.
+    void BindTarget();
+
+    // Query pairs are split lazily on first lookup, without allocation for up to
+    // kInlineQueryParams pairs. The returned views live as long as raw.
     std::string_view Query(std::string_view key) const;
+
+    // Returns an empty view when the header is absent.
+    std::string_view Header(std::string_view name) const;
+
+    // Value of a "{name}" or "*name" route segment, as a view into path (not percent-decoded).
+    // Returns an empty view when the matched route has no such parameter.
+    std::string_view Param(std::string_view name) const;
+
+    // Memory resource backing this request (the connection arena when served by HttpServer).
+    // Memory allocated from it is released after the response has been written.
+    std::pmr::memory_resource* Resource() const { return raw.get_allocator().resource(); }
+
+    static constexpr std::size_t kInlineQueryParams = 8;
+
+private:
+    void ParseQueryLazily() const;
+    void Rebind(const Request& from);
+
+    bool bound_ = false; // path views raw.target()
+    mutable bool query_parsed_ = false;
+    mutable std::size_t query_count_ = 0;
+    mutable std::array<QueryParam, kInlineQueryParams> query_inline_{};
+    mutable std::vector<QueryParam> query_overflow_;
 };
 
 struct Response {
     unsigned status = 200;
-    std::string body;
-    std::string content_type = "text/plain; charset=utf-8";
-    std::unordered_map<std::string, std::string> headers;
+    std::pmr::string body;
+    std::pmr::string content_type;
+    std::pmr::unordered_map<std::pmr::string, std::pmr::string> headers;
+
+    // Zero-copy body: when set, [file_offset, file_offset + file_length) of the file is sent with
+    // sendfile(2) (or from an mmap'd window) instead of `body`.
+    std::shared_ptr<const File> file;
+    std::uint64_t file_offset = 0;
+    std::uint64_t file_length = 0;
+
+    Response() : Response(std::pmr::get_default_resource()) {}
+    // Body, content type and headers allocate from `mr`.
+    explicit Response(std::pmr::memory_resource* mr);
+
+    void SetJson(std::string_view json);
+
+    // Serves all of `f` as the body; clears `body`.
+    void SetFile(std::shared_ptr<const File> f);
+
+    // Narrows a 200 file body to a single-range Range header: 206 with Content-Range, or 416 when
+    // the range is unsatisfiable. Adds Accept-Ranges either way. No-op for other responses.
+    void ApplyRange(std::string_view range_header);
 
-    void SetJson(std::string json);
+    std::uint64_t BodySize() const { return file ? file_length : body.size(); }
 };
 
 } // namespace chmicro::http
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include <chmicro/core/metrics.h>
+
+namespace chmicro::resilience {
+
+struct AdmissionControllerOptions {
+    std::uint32_t initial_limit = 32;
+    std::uint32_t min_limit = 4;
+    std::uint32_t max_limit = 1024;
+
+    // Gradient limit: once per window the limit is scaled by long-term / short-term latency (at
+    // most halved per window). Short-term latency may exceed the long-term baseline by
+    // `tolerance` before the limit shrinks; `smoothing` damps each step.
+    double tolerance = 1.5;
+    double smoothing = 0.2;
+    std::chrono::milliseconds window{100};
+    std::uint32_t window_min_samples = 10;
+
+    // CoDel-style standing-queue detection: when even the smallest queue delay seen during an
+    // interval is above the target, the queue is not draining and the limit backs off by
+    // `queue_backoff` each interval until it does.
+    std::chrono::milliseconds queue_delay_target{5};
+    std::chrono::milliseconds queue_delay_interval{100};
+    double queue_backoff = 0.9;
+
+    // Sent with shed requests (Retry-After).
+    std::chrono::seconds retry_after{1};
+
+    // Value of the "name" label on the admission_* metrics.
+    std::string name = "http";
+};
+
+// Adaptive in-flight limit for a server. Requests take a slot before they run and return it with
+// their latency; requests arriving while every slot is taken should be shed.
+class AdmissionController {
+public:
+    explicit AdmissionController(AdmissionControllerOptions opts);
+
+    // Thread-safe. False when the request should be shed.
+    bool TryAcquire();
+
+    // Thread-safe. Returns a slot taken by TryAcquire; `latency` runs from admission to response.
+    void Release(std::chrono::steady_clock::duration latency);
+
+    // Thread-safe. Time an admitted request spent queued before its handler started.
+    void OnQueueDelay(std::chrono::steady_clock::duration delay);
+
+    std::uint32_t Limit() const { return limit_.load(std::memory_order_relaxed); }
+    std::uint32_t InFlight() const { return inflight_.load(std::memory_order_relaxed); }
+    // True while a standing queue is detected.
+    bool QueueStanding() const { return standing_.load(std::memory_order_relaxed); }
+    std::chrono::seconds RetryAfter() const { return opts_.retry_after; }
+
+private:
+    void UpdateLimitLocked(std::chrono::steady_clock::time_point now);
+    void SetLimitLocked(double limit);
+
+    AdmissionControllerOptions opts_;
+
+    std::atomic<std::uint32_t> limit_{0};
+    std::atomic<std::uint32_t> inflight_{0};
+    std::atomic<bool> standing_{false};
+    // Peak in-flight count during the current window.
+    std::atomic<std::uint32_t> max_inflight_{0};
+
+    std::mutex mu_;
+    double estimated_limit_ = 0.0;
+    double long_latency_ms_ = 0.0;
+    // Current window.
+    std::chrono::steady_clock::time_point window_start_;
+    double latency_sum_ms_ = 0.0;
+    std::uint32_t samples_ = 0;
+    // Current queue-delay interval.
+    std::chrono::steady_clock::time_point interval_end_;
+    std::chrono::steady_clock::duration interval_min_delay_{};
+    bool interval_has_delay_ = false;
+
+    chmicro::Gauge& limit_gauge_;
+    chmicro::Gauge& inflight_gauge_;
+    chmicro::Counter& rejected_;
+    chmicro::Histogram& queue_delay_ms_;
+};
+
+} // namespace chmicro::resilience
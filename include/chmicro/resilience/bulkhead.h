@@ -0,0 +1,93 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include <chmicro/core/metrics.h>
+
+namespace chmicro::resilience {
+
+struct BulkheadOptions {
+    // Requests running at once.
+    std::uint32_t max_concurrent = 8;
+    // Requests waiting for a slot, in arrival order. Beyond it requests are rejected right away.
+    std::uint32_t max_queue = 0;
+    // Longest a queued request waits before it is rejected; 0 waits for a slot however long.
+    std::chrono::milliseconds max_wait{100};
+
+    // Sent with rejected requests (Retry-After).
+    std::chrono::seconds retry_after{1};
+
+    // Value of the "name" label on the bulkhead_* metrics.
+    std::string name = "default";
+};
+
+enum class BulkheadEntry {
+    admitted = 0, // the caller holds a slot
+    queued,       // on_slot runs once a slot is handed to the caller
+    rejected,     // every slot and queue place is taken
+};
+
+// Fixed concurrency limit with a bounded wait queue, isolating one group of requests (e.g. an
+// expensive route) from the rest: when it is saturated, its own requests wait or are rejected
+// while everything else keeps running.
+class Bulkhead {
+public:
+    using Ticket = std::uint64_t;
+
+    explicit Bulkhead(BulkheadOptions opts);
+
+    // Thread-safe. When queued, `*ticket` names the wait for Cancel() and `on_slot` is later run
+    // by the thread calling Release(), so it should only post the continuation.
+    template <class OnSlot>
+    BulkheadEntry Acquire(OnSlot&& on_slot, Ticket* ticket) {
+        if (TryAcquire()) {
+            return BulkheadEntry::admitted;
+        }
+        return Enqueue(std::function<void()>(std::forward<OnSlot>(on_slot)), ticket);
+    }
+
+    // Thread-safe. Takes a free slot without queueing.
+    bool TryAcquire();
+
+    // Thread-safe. Withdraws a queued wait; `timed_out` counts it as a rejection. False when the
+    // wait already got its slot: on_slot runs (or ran) and the slot must be released as usual.
+    bool Cancel(Ticket ticket, bool timed_out);
+
+    // Thread-safe. Hands the slot to the oldest waiter, or frees it.
+    void Release();
+
+    std::uint32_t InFlight() const;
+    std::uint32_t Queued() const;
+    std::uint32_t MaxConcurrent() const { return opts_.max_concurrent; }
+    std::chrono::milliseconds MaxWait() const { return opts_.max_wait; }
+    std::chrono::seconds RetryAfter() const { return opts_.retry_after; }
+
+private:
+    struct Waiter {
+        Ticket ticket;
+        std::function<void()> on_slot;
+    };
+
+    BulkheadEntry Enqueue(std::function<void()> on_slot, Ticket* ticket);
+    void PublishLocked();
+
+    BulkheadOptions opts_;
+
+    mutable std::mutex mu_;
+    std::uint32_t inflight_ = 0;
+    std::deque<Waiter> waiters_;
+    Ticket next_ticket_ = 1;
+
+    chmicro::Gauge& inflight_gauge_;
+    chmicro::Gauge& queued_gauge_;
+    chmicro::Counter& rejected_full_;
+    chmicro::Counter& rejected_timeout_;
+};
+
+} // namespace chmicro::resilience
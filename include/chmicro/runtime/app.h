@@ -1,6 +1,7 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <cstddef>
 #include <condition_variable>
 #include <memory>
@@ -8,20 +9,44 @@
 #include <string>
 #include <vector>
 
+#include <chmicro/core/status.h>
 #include <chmicro/runtime/io_context_pool.h>
+#include <chmicro/runtime/worker_pool.h>
 
 namespace chmicro {
 
 class IHttpServer {
 public:
     virtual ~IHttpServer() = default;
-    virtual void Start() = 0;
+    // Starts accepting. A failure leaves the server stopped.
+    virtual Status Start() = 0;
     virtual void Stop() = 0;
+
+    // Graceful shutdown: stop accepting; open connections finish their current request and close.
+    virtual void Drain() {}
+    virtual std::size_t ActiveConnections() const { return 0; }
+
+    // Listener handover (POSIX): the listening sockets of a started server, and sockets received
+    // from a predecessor process to serve on instead of binding at the next Start().
+    virtual std::vector<int> ListenerHandles() const { return {}; }
+    virtual void InheritListeners(std::vector<int> handles) { (void)handles; }
 };
 
 struct AppOptions {
     std::size_t io_threads = 0;
     std::string log_level = "info";
+
+    // Pool for handlers registered with ExecutionPolicy::offload.
+    std::size_t worker_threads = 0; // 0 => hardware_concurrency
+    std::size_t worker_queue_capacity = 1024;
+
+    // SIGUSR2 restarts the process without refusing connections (POSIX, see runtime/handover.h):
+    // a successor is started with `argv` and the listening sockets, and once it serves, this
+    // process drains for up to `drain_timeout` and exits. Empty `argv`: this process's own
+    // command line (Linux).
+    std::vector<std::string> argv;
+    std::chrono::milliseconds handover_timeout{10000};
+    std::chrono::milliseconds drain_timeout{10000};
 };
 
 class App {
@@ -33,24 +58,35 @@ public:
     App& operator=(const App&) = delete;
 
     IoContextPool& Io();
+    WorkerPool& Workers();
 
     void AddServer(std::shared_ptr<IHttpServer> server);
 
-    // Blocking until Stop() or ctrl-c
+    // Blocking until Stop(), ctrl-c / SIGTERM, or a completed SIGUSR2 handover. Returns 1 without
+    // serving when a server fails to start; a predecessor handing over then keeps serving.
     int Run();
+    // Thread-safe, including from handlers and signal handlers. While Run() is active this only
+    // requests the stop, which Run() carries out before returning.
     void Stop();
 
 private:
     void SetupLogging();
+    // Runs on the Run() thread. Returns true once a successor serves on our listeners.
+    bool HandOver();
+    void DrainServers();
+    void Shutdown();
 
     AppOptions options_;
     IoContextPool io_;
+    WorkerPool workers_;
     std::vector<std::shared_ptr<IHttpServer>> servers_;
 
-    std::atomic<bool> stop_requested_{false};
     std::mutex stop_mu_;
     std::condition_variable stop_cv_;
-    bool stopped_{false};
+    bool running_{false};
+    bool stop_requested_{false};
+    bool handover_requested_{false};
+    std::atomic<bool> shut_down_{false};
 };
 
 } // namespace chmicro
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <chmicro/core/status.h>
+
+namespace chmicro {
+
+// Zero-downtime restart (POSIX). The running process starts its successor with SpawnSuccessor(),
+// passing its listening sockets over a Unix socket (SCM_RIGHTS); both processes then accept from
+// the same sockets, so no connection is refused while the old one drains.
+//
+// Listeners travel grouped per server, in the order the servers were added to the App.
+
+// Environment variable naming the successor's end of the handover channel.
+inline constexpr const char* kHandoverEnv = "CHMICRO_HANDOVER_FD";
+
+// Starts `argv` (empty: this process's own command line, Linux only) with the handover channel,
+// sends it `listeners` and waits until it calls HandoverReady(). On failure or after `timeout` the
+// successor is killed and this process keeps serving. Returns the successor's pid.
+Result<int> SpawnSuccessor(const std::vector<std::string>& argv, const std::vector<std::vector<int>>& listeners,
+    std::chrono::milliseconds timeout);
+
+// Successor side: the channel inherited from a predecessor, or -1 when started normally.
+int HandoverChannel();
+
+// Successor side: the listeners sent by the predecessor, grouped per server.
+Result<std::vector<std::vector<int>>> ReceiveListeners(int channel);
+
+// Successor side: tells the predecessor this process is serving, so it can drain. Closes `channel`.
+Status HandoverReady(int channel);
+
+// Successor side: closes `channel` without the ready byte; the predecessor stops this process and
+// keeps serving.
+void HandoverFailed(int channel);
+
+} // namespace chmicro
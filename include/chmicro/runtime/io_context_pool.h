@@ -22,9 +22,17 @@ public:
     // Thread-safe
     boost::asio::io_context& Next();
 
+    // Thread-safe. Contexts are created in the constructor and live as long as the pool.
+    std::size_t Size() const { return contexts_.size(); }
+    boost::asio::io_context& At(std::size_t index) { return *contexts_[index]; }
+
     void Start();
     void Stop();
 
+    // Demultiplexer the contexts run on ("epoll", "io_uring", "kqueue", "iocp", ...). Fixed at
+    // build time; Linux builds with CHMICRO_ENABLE_IO_URING use io_uring for all socket I/O.
+    static const char* Backend();
+
 private:
     std::size_t threads_{0};
     std::vector<std::unique_ptr<boost::asio::io_context>> contexts_;
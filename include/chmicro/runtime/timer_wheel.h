@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+namespace chmicro {
+
+// Coarse deadlines for many objects on one reactor, driven by a single steady_timer. Moving a
+// deadline is an atomic store: the wheel only re-files an entry when it reaches the slot the entry
+// was filed under, so objects can re-arm on every I/O operation without touching a timer.
+class TimerWheel : public std::enable_shared_from_this<TimerWheel> {
+public:
+    static constexpr std::int64_t kNever = std::numeric_limits<std::int64_t>::max();
+
+    // A deadline owned by one object and watched by a wheel. Create with std::make_shared.
+    class Deadline : public std::enable_shared_from_this<Deadline> {
+    public:
+        // `on_expired` runs on the wheel's thread, at most one tick late, or on the thread calling
+        // Poke(). The deadline may have moved again since; check Expired() from the owner's own
+        // executor before acting.
+        explicit Deadline(std::function<void()> on_expired) : on_expired_(std::move(on_expired)) {}
+
+        // Thread-safe. (Re)arms the deadline `after` from the wheel's current time.
+        void Arm(TimerWheel& wheel, std::chrono::milliseconds after);
+        // Thread-safe.
+        void Disarm() { at_ms_.store(kNever, std::memory_order_relaxed); }
+
+        bool Expired(const TimerWheel& wheel) const {
+            auto at = at_ms_.load(std::memory_order_relaxed);
+            return at != kNever && at <= wheel.NowMs();
+        }
+
+    private:
+        friend class TimerWheel;
+
+        std::atomic<std::int64_t> at_ms_{kNever};
+        // Has an entry in some slot of the wheel.
+        std::atomic<bool> filed_{false};
+        std::function<void()> on_expired_;
+    };
+
+    TimerWheel(boost::asio::io_context& ioc, std::chrono::milliseconds tick = std::chrono::milliseconds(250), std::size_t slots = 512);
+
+    void Start();
+    void Stop();
+
+    // Thread-safe. Runs on_expired of every filed deadline now, due or not, so owners can look at
+    // their state (e.g. close idle connections at shutdown). The wheel itself is unchanged.
+    void Poke();
+
+    // Steady clock in milliseconds, refreshed once per tick.
+    std::int64_t NowMs() const { return now_ms_.load(std::memory_order_relaxed); }
+    std::chrono::milliseconds Tick() const { return tick_; }
+
+private:
+    using Entry = std::weak_ptr<Deadline>;
+
+    static std::int64_t ClockMs();
+
+    // Thread-safe.
+    void File(const std::shared_ptr<Deadline>& d, std::int64_t at_ms);
+    void Schedule();
+    void OnTick();
+    void Visit(const std::shared_ptr<Deadline>& d, std::int64_t now);
+
+    boost::asio::steady_timer timer_;
+    const std::chrono::milliseconds tick_;
+    std::atomic<std::int64_t> now_ms_;
+    std::atomic<bool> running_{false};
+
+    std::mutex mu_;
+    std::vector<std::vector<Entry>> slots_;
+    std::int64_t current_tick_; // last tick whose slot has been visited
+};
+
+} // namespace chmicro
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <chmicro/core/metrics.h>
+
+namespace chmicro {
+
+struct WorkerPoolOptions {
+    std::size_t threads = 0;           // 0 => hardware_concurrency
+    std::size_t queue_capacity = 1024; // total queued (not yet running) tasks across all workers
+};
+
+// Bounded work-stealing pool for CPU-bound or blocking work that must not run on IO threads.
+// Tasks are spread round-robin over per-worker queues; an idle worker steals the oldest task
+// from its peers before going to sleep.
+class WorkerPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit WorkerPool(WorkerPoolOptions options);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Thread-safe. Returns false (and drops the task) when the queue is full or the pool is stopped.
+    bool TrySubmit(Task task);
+
+    void Start();
+    // Stops the workers; tasks still queued are discarded.
+    void Stop();
+
+    std::size_t Size() const { return workers_.size(); }
+    std::size_t QueueDepth() const { return depth_.load(std::memory_order_relaxed); }
+
+private:
+    struct Item {
+        Task task;
+        std::chrono::steady_clock::time_point enqueued;
+    };
+
+    struct alignas(64) Worker {
+        std::mutex mu;
+        std::deque<Item> queue;
+    };
+
+    void Run(std::size_t index);
+    bool TryPop(std::size_t index, Item& out);
+
+    WorkerPoolOptions options_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+
+    std::atomic<std::size_t> depth_{0};
+    std::atomic<std::size_t> rr_{0};
+    std::atomic<bool> started_{false};
+    std::atomic<bool> stopping_{false};
+
+    std::mutex sleep_mu_;
+    std::condition_variable sleep_cv_;
+
+    chmicro::Gauge& queue_depth_;
+    chmicro::Histogram& wait_ms_;
+    chmicro::Counter& rejected_;
+};
+
+} // namespace chmicro
@@ -1,7 +1,13 @@
 #include <chmicro/core/metrics.h>
 
 #include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <iterator>
+#include <limits>
 #include <sstream>
+#include <thread>
 
 namespace chmicro {
 
@@ -33,43 +39,318 @@ std::string MetricLabels::ToPrometheusLabelText() const {
     return oss.str();
 }
 
+Counter::Counter(CounterLayout layout) {
+    // With a single stripe, value_ is the same cache line without the thread-local lookup.
+    if (layout == CounterLayout::striped && MetricStripeCount() > 1) {
+        auto n = MetricStripeCount();
+        stripes_ = std::make_unique<Stripe[]>(n);
+        stripe_mask_ = n - 1;
+    }
+}
+
+std::int64_t Counter::Value() const {
+    if (stripes_ == nullptr) {
+        return value_.load(std::memory_order_relaxed);
+    }
+    std::int64_t sum = 0;
+    for (std::size_t i = 0; i <= stripe_mask_; ++i) {
+        sum += stripes_[i].value.load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+std::size_t MetricStripeCount() {
+    static const std::size_t count =
+        std::min<std::size_t>(std::bit_ceil(std::max<std::size_t>(std::thread::hardware_concurrency(), 1)), 64);
+    return count;
+}
+
+std::size_t detail::NextStripe() {
+    static std::atomic<std::size_t> next{0};
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+
 void Gauge::Set(double v) {
     std::lock_guard<std::mutex> lk(mu_);
     value_ = v;
 }
 
+void Gauge::Add(double delta) {
+    std::lock_guard<std::mutex> lk(mu_);
+    value_ += delta;
+}
+
 double Gauge::Value() const {
     std::lock_guard<std::mutex> lk(mu_);
     return value_;
 }
 
-Histogram::Histogram(std::vector<double> buckets)
-    : buckets_(std::move(buckets)), bucket_counts_(buckets_.size(), 0) {
+Histogram::Histogram(std::vector<double> buckets) : buckets_(std::move(buckets)) {
     std::sort(buckets_.begin(), buckets_.end());
+    auto shards = MetricStripeCount();
+    lines_per_shard_ = (buckets_.size() + 2 + kCellsPerLine - 1) / kCellsPerLine;
+    shard_mask_ = shards - 1;
+    lines_ = std::make_unique<Line[]>(shards * lines_per_shard_);
 }
 
 void Histogram::Observe(double v) {
-    std::lock_guard<std::mutex> lk(mu_);
-    sum_ += v;
-    ++count_;
-
-    auto it = std::lower_bound(buckets_.begin(), buckets_.end(), v);
-    if (it != buckets_.end()) {
-        size_t idx = static_cast<size_t>(it - buckets_.begin());
-        ++bucket_counts_[idx];
+    auto shard = detail::ThreadStripe() & shard_mask_;
+    auto idx = static_cast<std::size_t>(std::lower_bound(buckets_.begin(), buckets_.end(), v) - buckets_.begin());
+    Cell(shard, idx).fetch_add(1, std::memory_order_relaxed);
+    // Counted, but infinities and NaN have no fixed-point value to add.
+    if (std::isfinite(v)) {
+        Cell(shard, buckets_.size() + 1).fetch_add(std::llround(v * kSumScale), std::memory_order_relaxed);
     }
 }
 
 std::vector<double> Histogram::Buckets() const {
-    std::lock_guard<std::mutex> lk(mu_);
     return buckets_;
 }
 
 void Histogram::Snapshot(std::vector<std::uint64_t>& bucket_counts, double& sum, std::uint64_t& count) const {
-    std::lock_guard<std::mutex> lk(mu_);
-    bucket_counts = bucket_counts_;
-    sum = sum_;
-    count = count_;
+    bucket_counts.assign(buckets_.size(), 0);
+    std::uint64_t above = 0;
+    std::int64_t fixed_sum = 0;
+    for (std::size_t shard = 0; shard <= shard_mask_; ++shard) {
+        for (std::size_t i = 0; i < buckets_.size(); ++i) {
+            bucket_counts[i] += static_cast<std::uint64_t>(Cell(shard, i).load(std::memory_order_relaxed));
+        }
+        above += static_cast<std::uint64_t>(Cell(shard, buckets_.size()).load(std::memory_order_relaxed));
+        fixed_sum += Cell(shard, buckets_.size() + 1).load(std::memory_order_relaxed);
+    }
+    count = above;
+    for (auto c : bucket_counts) {
+        count += c;
+    }
+    sum = static_cast<double>(fixed_sum) / kSumScale;
+}
+
+namespace {
+
+constexpr double kSummaryQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+constexpr std::string_view kOverflowHelp = "Lookups folded into a metric's overflow series by its series limit";
+
+template <class Int>
+void AppendNumber(std::string& out, Int v) {
+    char buf[24];
+    auto end = std::to_chars(buf, buf + sizeof(buf), v).ptr;
+    out.append(buf, end);
+}
+
+void AppendNumber(std::string& out, double v) {
+    if (std::isnan(v)) {
+        out.append("NaN");
+    } else if (std::isinf(v)) {
+        out.append(v > 0 ? "+Inf" : "-Inf");
+    } else {
+        // Shortest text that reads back as `v`.
+        char buf[32];
+        auto end = std::to_chars(buf, buf + sizeof(buf), v).ptr;
+        out.append(buf, end);
+    }
+}
+
+void AppendSumAndCount(std::string& out, std::string_view name, std::string_view label_text, double sum, std::uint64_t count) {
+    out.append(name).append("_sum").append(label_text).append(" ");
+    AppendNumber(out, sum);
+    out.append("\n");
+    out.append(name).append("_count").append(label_text).append(" ");
+    AppendNumber(out, count);
+    out.append("\n");
+}
+
+} // namespace
+
+std::string_view ExpositionContentType(ExpositionFormat format) {
+    return format == ExpositionFormat::openmetrics ? "application/openmetrics-text; version=1.0.0; charset=utf-8"
+                                                   : "text/plain; version=0.0.4; charset=utf-8";
+}
+
+void LogLinearSnapshot::Merge(const LogLinearSnapshot& other) {
+    if (other.counts.empty()) {
+        return;
+    }
+    if (counts.empty()) {
+        *this = other;
+        return;
+    }
+    if (!(options == other.options)) {
+        throw std::invalid_argument("cannot merge log-linear snapshots with different options");
+    }
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+        counts[i] += other.counts[i];
+    }
+    sum += other.sum;
+    count += other.count;
+}
+
+double LogLinearSnapshot::Quantile(double q) const {
+    if (count == 0) {
+        return 0.0;
+    }
+    auto rank = static_cast<std::uint64_t>(std::ceil(std::clamp(q, 0.0, 1.0) * static_cast<double>(count)));
+    rank = std::max<std::uint64_t>(rank, 1);
+    std::uint64_t cumulative = 0;
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+        cumulative += counts[i];
+        if (cumulative >= rank) {
+            return (LogLinearHistogram::BucketLower(options, i) + LogLinearHistogram::BucketUpper(options, i)) / 2;
+        }
+    }
+    return LogLinearHistogram::BucketUpper(options, counts.size() - 1);
+}
+
+LogLinearHistogram::LogLinearHistogram(LogLinearOptions options) : options_(options) {
+    if (!(options_.resolution > 0) || options_.precision_bits < 1 || options_.precision_bits > 16
+        || options_.range_bits <= options_.precision_bits || options_.range_bits > 62) {
+        throw std::invalid_argument("log-linear histogram needs resolution > 0 and 1 <= precision_bits < range_bits <= 62");
+    }
+    buckets_ = BucketCount(options_);
+    auto shards = std::min(MetricStripeCount(), kMaxShards);
+    lines_per_shard_ = (buckets_ + 1 + kCellsPerLine - 1) / kCellsPerLine;
+    shard_mask_ = shards - 1;
+}
+
+LogLinearHistogram::~LogLinearHistogram() {
+    for (auto& shard : shards_) {
+        delete[] shard.load(std::memory_order_relaxed);
+    }
+}
+
+LogLinearHistogram::Line* LogLinearHistogram::Shard(std::size_t shard) {
+    auto* lines = shards_[shard].load(std::memory_order_acquire);
+    if (lines != nullptr) {
+        return lines;
+    }
+    auto fresh = std::make_unique<Line[]>(lines_per_shard_);
+    if (shards_[shard].compare_exchange_strong(lines, fresh.get(), std::memory_order_acq_rel, std::memory_order_acquire)) {
+        return fresh.release();
+    }
+    // Another thread of this shard got there first.
+    return lines;
+}
+
+std::size_t LogLinearHistogram::BucketCount(const LogLinearOptions& options) {
+    return static_cast<std::size_t>(options.range_bits - options.precision_bits + 1) << options.precision_bits;
+}
+
+std::size_t LogLinearHistogram::BucketIndex(const LogLinearOptions& options, double v) {
+    const std::uint64_t max_steps = (std::uint64_t{1} << options.range_bits) - 1;
+    // Negative values and NaN count as zero.
+    double steps = v > 0 ? v / options.resolution : 0.0;
+    std::uint64_t n = steps >= static_cast<double>(max_steps) ? max_steps : static_cast<std::uint64_t>(steps);
+    const std::uint64_t sub_buckets = std::uint64_t{1} << options.precision_bits;
+    if (n < sub_buckets) {
+        return static_cast<std::size_t>(n);
+    }
+    // n has its top bit at `precision_bits + shift`; keep the precision_bits bits below it.
+    auto shift = static_cast<unsigned>(std::bit_width(n)) - 1 - options.precision_bits;
+    return static_cast<std::size_t>((shift + 1) * sub_buckets + ((n >> shift) - sub_buckets));
+}
+
+double LogLinearHistogram::BucketLower(const LogLinearOptions& options, std::size_t i) {
+    const std::size_t sub_buckets = std::size_t{1} << options.precision_bits;
+    if (i < sub_buckets) {
+        return static_cast<double>(i) * options.resolution;
+    }
+    auto shift = i / sub_buckets - 1;
+    auto sub = static_cast<std::uint64_t>(i % sub_buckets + sub_buckets);
+    return static_cast<double>(sub << shift) * options.resolution;
+}
+
+double LogLinearHistogram::BucketUpper(const LogLinearOptions& options, std::size_t i) {
+    const std::size_t sub_buckets = std::size_t{1} << options.precision_bits;
+    if (i < sub_buckets) {
+        return static_cast<double>(i + 1) * options.resolution;
+    }
+    auto shift = i / sub_buckets - 1;
+    auto sub = static_cast<std::uint64_t>(i % sub_buckets + sub_buckets);
+    return static_cast<double>((sub + 1) << shift) * options.resolution;
+}
+
+void LogLinearHistogram::Observe(double v) {
+    auto* lines = Shard(detail::ThreadStripe() & shard_mask_);
+    Cell(lines, BucketIndex(options_, v)).fetch_add(1, std::memory_order_relaxed);
+    if (std::isfinite(v)) {
+        Cell(lines, buckets_).fetch_add(std::llround(v * kSumScale), std::memory_order_relaxed);
+    }
+}
+
+LogLinearSnapshot LogLinearHistogram::Snapshot() const {
+    LogLinearSnapshot snap;
+    Snapshot(snap);
+    return snap;
+}
+
+void LogLinearHistogram::Snapshot(LogLinearSnapshot& snap) const {
+    snap.options = options_;
+    snap.counts.assign(buckets_, 0);
+    snap.count = 0;
+    std::int64_t fixed_sum = 0;
+    for (std::size_t shard = 0; shard <= shard_mask_; ++shard) {
+        auto* lines = shards_[shard].load(std::memory_order_acquire);
+        if (lines == nullptr) {
+            continue;
+        }
+        for (std::size_t i = 0; i < buckets_; ++i) {
+            snap.counts[i] += static_cast<std::uint64_t>(Cell(lines, i).load(std::memory_order_relaxed));
+        }
+        fixed_sum += Cell(lines, buckets_).load(std::memory_order_relaxed);
+    }
+    for (auto c : snap.counts) {
+        snap.count += c;
+    }
+    snap.sum = static_cast<double>(fixed_sum) / kSumScale;
+}
+
+MetricsRegistry::Series::Series(SeriesType type_, std::string_view name_, std::string_view help_, MetricLabels labels_)
+    : type(type_), name(name_), labels(std::move(labels_)), label_text(labels.ToPrometheusLabelText()) {
+    help.reserve(help_.size());
+    for (char c : help_) {
+        if (c == '\\') {
+            help.append("\\\\");
+        } else if (c == '\n') {
+            help.append("\\n");
+        } else {
+            help.push_back(c);
+        }
+    }
+}
+
+bool MetricsRegistry::SeriesOrder::operator()(const Series* a, const Series* b) const {
+    if (a->name != b->name) {
+        return a->name < b->name;
+    }
+    if (a->type != b->type) {
+        return a->type < b->type;
+    }
+    return a->label_text < b->label_text;
+}
+
+MetricsRegistry::HistogramEntry::HistogramEntry(std::string_view name_, std::string_view help_, MetricLabels labels_,
+    std::vector<double> buckets_)
+    : Series(SeriesType::histogram, name_, help_, std::move(labels_)), histogram(std::move(buckets_)) {
+    for (double bound : histogram.Buckets()) {
+        MetricLabels with_le = labels;
+        with_le.kv["le"] = std::to_string(bound);
+        bucket_label_text.push_back(with_le.ToPrometheusLabelText());
+    }
+    MetricLabels with_le = labels;
+    with_le.kv["le"] = "+Inf";
+    bucket_label_text.push_back(with_le.ToPrometheusLabelText());
+}
+
+MetricsRegistry::LogLinearEntry::LogLinearEntry(std::string_view name_, std::string_view help_, MetricLabels labels_,
+    LogLinearOptions options)
+    : Series(SeriesType::summary, name_, help_, std::move(labels_)), histogram(options) {
+    for (double q : kSummaryQuantiles) {
+        MetricLabels with_quantile = labels;
+        std::ostringstream text;
+        text << q;
+        with_quantile.kv["quantile"] = text.str();
+        quantile_label_text.push_back(with_quantile.ToPrometheusLabelText());
+    }
 }
 
 std::string MetricsRegistry::Key(std::string_view name, const MetricLabels& labels) {
@@ -84,98 +365,262 @@ std::string MetricsRegistry::Key(std::string_view name, const MetricLabels& labe
     return key;
 }
 
-Counter& MetricsRegistry::CounterMetric(std::string name, std::string help, MetricLabels labels) {
+void MetricsRegistry::SetSeriesLimit(std::string name, std::size_t limit) {
     std::lock_guard<std::mutex> lk(mu_);
+    series_limits_[std::move(name)] = limit;
+}
+
+void MetricsRegistry::SetDefaultSeriesLimit(std::size_t limit) {
+    std::lock_guard<std::mutex> lk(mu_);
+    default_series_limit_ = limit;
+}
+
+bool MetricsRegistry::AdmitSeries(std::string_view name) {
+    if (name == kOverflowMetric) {
+        return true; // one series per capped name
+    }
+    auto it = series_counts_.find(std::string(name));
+    if (it == series_counts_.end()) {
+        it = series_counts_.emplace(std::string(name), 0).first;
+    }
+    auto limit_it = series_limits_.find(it->first);
+    auto limit = limit_it == series_limits_.end() ? default_series_limit_ : limit_it->second;
+    if (limit != 0 && it->second >= limit) {
+        return false;
+    }
+    ++it->second;
+    return true;
+}
+
+template <class Entry, class... Args>
+Entry& MetricsRegistry::FindSeries(std::unordered_map<std::string, Entry>& entries, std::string_view name,
+    std::string& help, MetricLabels& labels, bool* overflowed, Args&&... args) {
     auto key = Key(name, labels);
-    auto it = counters_.find(key);
-    if (it == counters_.end()) {
-        it = counters_.try_emplace(std::move(key), std::move(help), std::move(labels)).first;
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        return it->second;
     }
-    return it->second.counter;
+    if (!AdmitSeries(name)) {
+        for (auto& [label, value] : labels.kv) {
+            value = kOverflowLabelValue;
+        }
+        key = Key(name, labels);
+        it = entries.find(key);
+        if (overflowed != nullptr) {
+            *overflowed = true;
+        }
+        std::string overflow_help(kOverflowHelp);
+        MetricLabels metric{{{"metric", std::string(name)}}};
+        FindSeries(counters_, kOverflowMetric, overflow_help, metric, nullptr, CounterLayout::single).counter.Inc();
+        if (it != entries.end()) {
+            return it->second;
+        }
+    }
+    it = entries.try_emplace(std::move(key), name, std::move(help), std::move(labels), std::forward<Args>(args)...).first;
+    ordered_.insert(&it->second);
+    return it->second;
+}
+
+Counter& MetricsRegistry::CounterMetric(std::string name, std::string help, MetricLabels labels, CounterLayout layout) {
+    std::lock_guard<std::mutex> lk(mu_);
+    return FindSeries(counters_, name, help, labels, nullptr, layout).counter;
 }
 
 Gauge& MetricsRegistry::GaugeMetric(std::string name, std::string help, MetricLabels labels) {
     std::lock_guard<std::mutex> lk(mu_);
-    auto key = Key(name, labels);
-    auto it = gauges_.find(key);
-    if (it == gauges_.end()) {
-        it = gauges_.try_emplace(std::move(key), std::move(help), std::move(labels)).first;
-    }
-    return it->second.gauge;
+    return FindSeries(gauges_, name, help, labels, nullptr).gauge;
 }
 
 Histogram& MetricsRegistry::HistogramMetric(std::string name, std::string help, std::vector<double> buckets, MetricLabels labels) {
     std::lock_guard<std::mutex> lk(mu_);
-    auto key = Key(name, labels);
-    auto it = histograms_.find(key);
-    if (it == histograms_.end()) {
-        it = histograms_.try_emplace(std::move(key), std::move(help), std::move(labels), std::move(buckets)).first;
-    }
-    return it->second.histogram;
+    return FindSeries(histograms_, name, help, labels, nullptr, std::move(buckets)).histogram;
 }
 
-std::string MetricsRegistry::ToPrometheusText() const {
+LogLinearHistogram& MetricsRegistry::LogLinearMetric(std::string name, std::string help, MetricLabels labels,
+    LogLinearOptions options) {
     std::lock_guard<std::mutex> lk(mu_);
-    std::ostringstream oss;
-
-    // Counters
-    for (const auto& kv : counters_) {
-        // We store the help/name only inside the key, so reconstruct by parsing is not worth it.
-        // Instead, emit using stored fields.
-        // Note: Prometheus type is inferred by suffix; we still emit TYPE.
-        const auto& entry = kv.second;
-        // Extract name from key prefix (until first '\n')
-        auto pos = kv.first.find('\n');
-        std::string name = (pos == std::string::npos) ? kv.first : kv.first.substr(0, pos);
+    return FindSeries(log_linear_, name, help, labels, nullptr, options).histogram;
+}
 
-        oss << "# HELP " << name << " " << entry.help << "\n";
-        oss << "# TYPE " << name << " counter\n";
-        oss << name << entry.labels.ToPrometheusLabelText() << " " << entry.counter.Value() << "\n";
+template <class Metric, class Make>
+Family<Metric>& MetricsRegistry::FindFamily(FamilyMap<Metric>& families, std::string name, Make&& make) {
+    std::lock_guard<std::mutex> lk(mu_);
+    auto& family = families[std::move(name)];
+    if (!family) {
+        family = make();
     }
+    return *family;
+}
 
-    // Gauges
-    for (const auto& kv : gauges_) {
-        const auto& entry = kv.second;
-        auto pos = kv.first.find('\n');
-        std::string name = (pos == std::string::npos) ? kv.first : kv.first.substr(0, pos);
+Family<Counter>& MetricsRegistry::CounterFamily(std::string name, std::string help, std::vector<std::string> label_names,
+    CounterLayout layout) {
+    auto make = [&] {
+        return std::make_unique<Family<Counter>>(std::move(label_names),
+            [this, name, help = std::move(help), layout](MetricLabels labels, bool& overflowed) -> Counter& {
+                std::lock_guard<std::mutex> lk(mu_);
+                std::string h = help;
+                return FindSeries(counters_, name, h, labels, &overflowed, layout).counter;
+            });
+    };
+    return FindFamily(counter_families_, name, make);
+}
 
-        oss << "# HELP " << name << " " << entry.help << "\n";
-        oss << "# TYPE " << name << " gauge\n";
-        oss << name << entry.labels.ToPrometheusLabelText() << " " << entry.gauge.Value() << "\n";
+Family<Gauge>& MetricsRegistry::GaugeFamily(std::string name, std::string help, std::vector<std::string> label_names) {
+    auto make = [&] {
+        return std::make_unique<Family<Gauge>>(std::move(label_names),
+            [this, name, help = std::move(help)](MetricLabels labels, bool& overflowed) -> Gauge& {
+                std::lock_guard<std::mutex> lk(mu_);
+                std::string h = help;
+                return FindSeries(gauges_, name, h, labels, &overflowed).gauge;
+            });
+    };
+    return FindFamily(gauge_families_, name, make);
+}
+
+Family<Histogram>& MetricsRegistry::HistogramFamily(std::string name, std::string help, std::vector<double> buckets,
+    std::vector<std::string> label_names) {
+    auto make = [&] {
+        return std::make_unique<Family<Histogram>>(std::move(label_names),
+            [this, name, help = std::move(help), buckets = std::move(buckets)](MetricLabels labels, bool& overflowed)
+                -> Histogram& {
+                std::lock_guard<std::mutex> lk(mu_);
+                std::string h = help;
+                return FindSeries(histograms_, name, h, labels, &overflowed, buckets).histogram;
+            });
+    };
+    return FindFamily(histogram_families_, name, make);
+}
+
+Family<LogLinearHistogram>& MetricsRegistry::LogLinearFamily(std::string name, std::string help,
+    std::vector<std::string> label_names, LogLinearOptions options) {
+    auto make = [&] {
+        return std::make_unique<Family<LogLinearHistogram>>(std::move(label_names),
+            [this, name, help = std::move(help), options](MetricLabels labels, bool& overflowed) -> LogLinearHistogram& {
+                std::lock_guard<std::mutex> lk(mu_);
+                std::string h = help;
+                return FindSeries(log_linear_, name, h, labels, &overflowed, options).histogram;
+            });
+    };
+    return FindFamily(log_linear_families_, name, make);
+}
+
+std::vector<MetricsRegistry::LogLinearSeries> MetricsRegistry::LogLinearSnapshots() const {
+    std::vector<const LogLinearEntry*> entries;
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        for (const auto* series : ordered_) {
+            if (series->type == SeriesType::summary) {
+                entries.push_back(static_cast<const LogLinearEntry*>(series));
+            }
+        }
+    }
+    std::vector<LogLinearSeries> out;
+    out.reserve(entries.size());
+    for (const auto* entry : entries) {
+        out.push_back({entry->name, entry->labels, entry->histogram.Snapshot()});
     }
+    return out;
+}
 
-    // Histograms
-    for (const auto& kv : histograms_) {
-        const auto& entry = kv.second;
-        auto pos = kv.first.find('\n');
-        std::string name = (pos == std::string::npos) ? kv.first : kv.first.substr(0, pos);
+void MetricsRegistry::WriteText(std::string& out, ExpositionFormat format) const {
+    std::lock_guard<std::mutex> scrape_lk(scrape_mu_);
+    auto& series = scratch_.series;
+    {
+        // Entries are never removed, so the pointers outlive the lock.
+        std::lock_guard<std::mutex> lk(mu_);
+        series.assign(ordered_.begin(), ordered_.end());
+    }
 
-        std::vector<std::uint64_t> bucket_counts;
-        double sum = 0.0;
-        std::uint64_t count = 0;
-        entry.histogram.Snapshot(bucket_counts, sum, count);
-        auto buckets = entry.histogram.Buckets();
+    auto type_name = [](SeriesType type) -> std::string_view {
+        switch (type) {
+        case SeriesType::counter:
+            return "counter";
+        case SeriesType::gauge:
+            return "gauge";
+        case SeriesType::histogram:
+            return "histogram";
+        case SeriesType::summary:
+            return "summary";
+        }
+        return "untyped";
+    };
+    const bool openmetrics = format == ExpositionFormat::openmetrics;
+    const Series* group = nullptr;
+    for (const auto* entry : series) {
+        std::string_view name = entry->name;
+        // OpenMetrics names a counter family without its _total suffix, which every sample carries.
+        std::string_view family = name;
+        std::string_view sample_suffix;
+        if (openmetrics && entry->type == SeriesType::counter) {
+            if (family.ends_with("_total")) {
+                family.remove_suffix(6);
+            } else {
+                sample_suffix = "_total";
+            }
+        }
 
-        oss << "# HELP " << name << " " << entry.help << "\n";
-        oss << "# TYPE " << name << " histogram\n";
+        if (group == nullptr || group->name != entry->name || group->type != entry->type) {
+            group = entry;
+            out.append("# HELP ").append(family).append(" ").append(entry->help).append("\n");
+            out.append("# TYPE ").append(family).append(" ").append(type_name(entry->type)).append("\n");
+        }
 
-        std::uint64_t cumulative = 0;
-        for (size_t i = 0; i < buckets.size(); ++i) {
-            cumulative += bucket_counts[i];
-            MetricLabels labels = entry.labels;
-            labels.kv["le"] = std::to_string(buckets[i]);
-            oss << name << "_bucket" << labels.ToPrometheusLabelText() << " " << cumulative << "\n";
+        switch (entry->type) {
+        case SeriesType::counter: {
+            const auto& e = static_cast<const CounterEntry&>(*entry);
+            out.append(name).append(sample_suffix).append(e.label_text).append(" ");
+            AppendNumber(out, e.counter.Value());
+            out.append("\n");
+            break;
+        }
+        case SeriesType::gauge: {
+            const auto& e = static_cast<const GaugeEntry&>(*entry);
+            out.append(name).append(e.label_text).append(" ");
+            AppendNumber(out, e.gauge.Value());
+            out.append("\n");
+            break;
+        }
+        case SeriesType::histogram: {
+            const auto& e = static_cast<const HistogramEntry&>(*entry);
+            double sum = 0.0;
+            std::uint64_t count = 0;
+            e.histogram.Snapshot(scratch_.bucket_counts, sum, count);
+            std::uint64_t cumulative = 0;
+            for (std::size_t i = 0; i < scratch_.bucket_counts.size(); ++i) {
+                cumulative += scratch_.bucket_counts[i];
+                out.append(name).append("_bucket").append(e.bucket_label_text[i]).append(" ");
+                AppendNumber(out, cumulative);
+                out.append("\n");
+            }
+            out.append(name).append("_bucket").append(e.bucket_label_text.back()).append(" ");
+            AppendNumber(out, count);
+            out.append("\n");
+            AppendSumAndCount(out, name, e.label_text, sum, count);
+            break;
+        }
+        case SeriesType::summary: {
+            const auto& e = static_cast<const LogLinearEntry&>(*entry);
+            auto& snap = scratch_.log_linear;
+            e.histogram.Snapshot(snap);
+            for (std::size_t i = 0; i < std::size(kSummaryQuantiles); ++i) {
+                out.append(name).append(e.quantile_label_text[i]).append(" ");
+                AppendNumber(out, snap.count == 0 ? std::numeric_limits<double>::quiet_NaN() : snap.Quantile(kSummaryQuantiles[i]));
+                out.append("\n");
+            }
+            AppendSumAndCount(out, name, e.label_text, snap.sum, snap.count);
+            break;
         }
-        {
-            MetricLabels labels = entry.labels;
-            labels.kv["le"] = "+Inf";
-            oss << name << "_bucket" << labels.ToPrometheusLabelText() << " " << count << "\n";
         }
-        oss << name << "_sum" << entry.labels.ToPrometheusLabelText() << " " << sum << "\n";
-        oss << name << "_count" << entry.labels.ToPrometheusLabelText() << " " << count << "\n";
     }
+    if (openmetrics) {
+        out.append("# EOF\n");
+    }
+}
 
-    return oss.str();
+std::string MetricsRegistry::ToPrometheusText() const {
+    std::string out;
+    WriteText(out, ExpositionFormat::prometheus);
+    return out;
 }
 
 MetricsRegistry& DefaultMetrics() {
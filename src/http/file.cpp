@@ -0,0 +1,191 @@
+#include <chmicro/http/file.h>
+
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace chmicro::http {
+namespace {
+
+bool ParseU64(std::string_view s, std::uint64_t& out) {
+    if (s.empty()) {
+        return false;
+    }
+    auto res = std::from_chars(s.data(), s.data() + s.size(), out);
+    return res.ec == std::errc() && res.ptr == s.data() + s.size();
+}
+
+std::string_view Trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+} // namespace
+
+chmicro::Result<std::shared_ptr<const File>> File::Open(const std::string& path) {
+#if defined(_WIN32)
+    int fd = ::_open(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+    if (fd < 0) {
+        auto code = errno == ENOENT ? chmicro::StatusCode::not_found : chmicro::StatusCode::unavailable;
+        return chmicro::Status(code, "open " + path + ": " + std::strerror(errno));
+    }
+
+#if defined(_WIN32)
+    struct _stat64 st {};
+    bool stat_ok = ::_fstat64(fd, &st) == 0;
+    bool regular = stat_ok && (st.st_mode & _S_IFREG) != 0;
+#else
+    struct stat st {};
+    bool stat_ok = ::fstat(fd, &st) == 0;
+    bool regular = stat_ok && S_ISREG(st.st_mode);
+#endif
+    if (!regular) {
+#if defined(_WIN32)
+        ::_close(fd);
+#else
+        ::close(fd);
+#endif
+        return chmicro::Status(chmicro::StatusCode::not_found, path + " is not a regular file");
+    }
+
+    return std::shared_ptr<const File>(new File(fd, static_cast<std::uint64_t>(st.st_size)));
+}
+
+File::~File() {
+    if (fd_ >= 0) {
+#if defined(_WIN32)
+        ::_close(fd_);
+#else
+        ::close(fd_);
+#endif
+    }
+}
+
+std::ptrdiff_t File::ReadAt(std::uint64_t offset, char* out, std::size_t n) const {
+#if defined(_WIN32)
+    // No pread on Windows; callers only use this from one session at a time per response.
+    if (::_lseeki64(fd_, static_cast<__int64>(offset), SEEK_SET) < 0) {
+        return -1;
+    }
+    return ::_read(fd_, out, static_cast<unsigned>(n));
+#else
+    return ::pread(fd_, out, n, static_cast<off_t>(offset));
+#endif
+}
+
+RangeStatus ParseRange(std::string_view header, std::uint64_t size, ByteRange& out) {
+    header = Trim(header);
+    constexpr std::string_view kUnit = "bytes=";
+    if (header.substr(0, kUnit.size()) != kUnit) {
+        return RangeStatus::none;
+    }
+    auto spec = Trim(header.substr(kUnit.size()));
+    if (spec.find(',') != std::string_view::npos) {
+        return RangeStatus::none;
+    }
+    auto dash = spec.find('-');
+    if (dash == std::string_view::npos) {
+        return RangeStatus::none;
+    }
+    auto first_s = Trim(spec.substr(0, dash));
+    auto last_s = Trim(spec.substr(dash + 1));
+
+    if (first_s.empty()) {
+        // Suffix range: the last N bytes.
+        std::uint64_t suffix = 0;
+        if (!ParseU64(last_s, suffix)) {
+            return RangeStatus::none;
+        }
+        if (suffix == 0 || size == 0) {
+            return RangeStatus::unsatisfiable;
+        }
+        out.length = suffix < size ? suffix : size;
+        out.offset = size - out.length;
+        return RangeStatus::satisfiable;
+    }
+
+    std::uint64_t first = 0;
+    if (!ParseU64(first_s, first)) {
+        return RangeStatus::none;
+    }
+    std::uint64_t last = size == 0 ? 0 : size - 1;
+    if (!last_s.empty()) {
+        if (!ParseU64(last_s, last) || last < first) {
+            return RangeStatus::none;
+        }
+        if (size > 0 && last >= size) {
+            last = size - 1;
+        }
+    }
+    if (first >= size) {
+        return RangeStatus::unsatisfiable;
+    }
+    out.offset = first;
+    out.length = last - first + 1;
+    return RangeStatus::satisfiable;
+}
+
+std::string_view ContentTypeForPath(std::string_view path) {
+    struct Entry {
+        std::string_view ext;
+        std::string_view type;
+    };
+    static constexpr Entry kTypes[] = {
+        {".html", "text/html; charset=utf-8"},
+        {".htm", "text/html; charset=utf-8"},
+        {".css", "text/css; charset=utf-8"},
+        {".js", "text/javascript; charset=utf-8"},
+        {".json", "application/json; charset=utf-8"},
+        {".txt", "text/plain; charset=utf-8"},
+        {".csv", "text/csv; charset=utf-8"},
+        {".svg", "image/svg+xml"},
+        {".png", "image/png"},
+        {".jpg", "image/jpeg"},
+        {".jpeg", "image/jpeg"},
+        {".gif", "image/gif"},
+        {".wasm", "application/wasm"},
+        {".gz", "application/gzip"},
+    };
+
+    auto slash = path.find_last_of('/');
+    auto dot = path.find_last_of('.');
+    if (dot == std::string_view::npos || (slash != std::string_view::npos && dot < slash)) {
+        return "application/octet-stream";
+    }
+    auto ext = path.substr(dot);
+    for (const auto& e : kTypes) {
+        if (ext.size() == e.ext.size()) {
+            bool same = true;
+            for (std::size_t i = 0; i < ext.size() && same; ++i) {
+                char c = ext[i];
+                if (c >= 'A' && c <= 'Z') {
+                    c = static_cast<char>(c - 'A' + 'a');
+                }
+                same = c == e.ext[i];
+            }
+            if (same) {
+                return e.type;
+            }
+        }
+    }
+    return "application/octet-stream";
+}
+
+} // namespace chmicro::http
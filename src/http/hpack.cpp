@@ -0,0 +1,462 @@
+#include <chmicro/http/hpack.h>
+
+#include <algorithm>
+#include <array>
+#include <utility>
+
+namespace chmicro::http {
+namespace {
+
+constexpr std::size_t kEntryOverhead = 32;
+
+// RFC 7541 Appendix A; index i + 1.
+constexpr std::array<std::pair<std::string_view, std::string_view>, 61> kStaticTable{{
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+}};
+
+// RFC 7541 Appendix B: code (right-aligned) and bit length for every octet.
+constexpr std::uint32_t kHuffmanCodes[256] = {
+    0x1ff8, 0x7fffd8, 0xfffffe2, 0xfffffe3, 0xfffffe4, 0xfffffe5, 0xfffffe6, 0xfffffe7,
+    0xfffffe8, 0xffffea, 0x3ffffffc, 0xfffffe9, 0xfffffea, 0x3ffffffd, 0xfffffeb, 0xfffffec,
+    0xfffffed, 0xfffffee, 0xfffffef, 0xffffff0, 0xffffff1, 0xffffff2, 0x3ffffffe, 0xffffff3,
+    0xffffff4, 0xffffff5, 0xffffff6, 0xffffff7, 0xffffff8, 0xffffff9, 0xffffffa, 0xffffffb,
+    0x14, 0x3f8, 0x3f9, 0xffa, 0x1ff9, 0x15, 0xf8, 0x7fa,
+    0x3fa, 0x3fb, 0xf9, 0x7fb, 0xfa, 0x16, 0x17, 0x18,
+    0x0, 0x1, 0x2, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+    0x1e, 0x1f, 0x5c, 0xfb, 0x7ffc, 0x20, 0xffb, 0x3fc,
+    0x1ffa, 0x21, 0x5d, 0x5e, 0x5f, 0x60, 0x61, 0x62,
+    0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a,
+    0x6b, 0x6c, 0x6d, 0x6e, 0x6f, 0x70, 0x71, 0x72,
+    0xfc, 0x73, 0xfd, 0x1ffb, 0x7fff0, 0x1ffc, 0x3ffc, 0x22,
+    0x7ffd, 0x3, 0x23, 0x4, 0x24, 0x5, 0x25, 0x26,
+    0x27, 0x6, 0x74, 0x75, 0x28, 0x29, 0x2a, 0x7,
+    0x2b, 0x76, 0x2c, 0x8, 0x9, 0x2d, 0x77, 0x78,
+    0x79, 0x7a, 0x7b, 0x7ffe, 0x7fc, 0x3ffd, 0x1ffd, 0xffffffc,
+    0xfffe6, 0x3fffd2, 0xfffe7, 0xfffe8, 0x3fffd3, 0x3fffd4, 0x3fffd5, 0x7fffd9,
+    0x3fffd6, 0x7fffda, 0x7fffdb, 0x7fffdc, 0x7fffdd, 0x7fffde, 0xffffeb, 0x7fffdf,
+    0xffffec, 0xffffed, 0x3fffd7, 0x7fffe0, 0xffffee, 0x7fffe1, 0x7fffe2, 0x7fffe3,
+    0x7fffe4, 0x1fffdc, 0x3fffd8, 0x7fffe5, 0x3fffd9, 0x7fffe6, 0x7fffe7, 0xffffef,
+    0x3fffda, 0x1fffdd, 0xfffe9, 0x3fffdb, 0x3fffdc, 0x7fffe8, 0x7fffe9, 0x1fffde,
+    0x7fffea, 0x3fffdd, 0x3fffde, 0xfffff0, 0x1fffdf, 0x3fffdf, 0x7fffeb, 0x7fffec,
+    0x1fffe0, 0x1fffe1, 0x3fffe0, 0x1fffe2, 0x7fffed, 0x3fffe1, 0x7fffee, 0x7fffef,
+    0xfffea, 0x3fffe2, 0x3fffe3, 0x3fffe4, 0x7ffff0, 0x3fffe5, 0x3fffe6, 0x7ffff1,
+    0x3ffffe0, 0x3ffffe1, 0xfffeb, 0x7fff1, 0x3fffe7, 0x7ffff2, 0x3fffe8, 0x1ffffec,
+    0x3ffffe2, 0x3ffffe3, 0x3ffffe4, 0x7ffffde, 0x7ffffdf, 0x3ffffe5, 0xfffff1, 0x1ffffed,
+    0x7fff2, 0x1fffe3, 0x3ffffe6, 0x7ffffe0, 0x7ffffe1, 0x3ffffe7, 0x7ffffe2, 0xfffff2,
+    0x1fffe4, 0x1fffe5, 0x3ffffe8, 0x3ffffe9, 0xffffffd, 0x7ffffe3, 0x7ffffe4, 0x7ffffe5,
+    0xfffec, 0xfffff3, 0xfffed, 0x1fffe6, 0x3fffe9, 0x1fffe7, 0x1fffe8, 0x7ffff3,
+    0x3fffea, 0x3fffeb, 0x1ffffee, 0x1ffffef, 0xfffff4, 0xfffff5, 0x3ffffea, 0x7ffff4,
+    0x3ffffeb, 0x7ffffe6, 0x3ffffec, 0x3ffffed, 0x7ffffe7, 0x7ffffe8, 0x7ffffe9, 0x7ffffea,
+    0x7ffffeb, 0xffffffe, 0x7ffffec, 0x7ffffed, 0x7ffffee, 0x7ffffef, 0x7fffff0, 0x3ffffee,
+};
+constexpr std::uint8_t kHuffmanCodeLen[256] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+    6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+    5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+    13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+    15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+    6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+};
+
+constexpr std::uint32_t kEosCode = 0x3fffffff;
+constexpr int kEosLength = 30;
+
+// Binary decoding tree over the code above; children index `nodes`, leaves carry the symbol.
+struct HuffmanTree {
+    struct Node {
+        std::array<std::int16_t, 2> child{-1, -1};
+        std::int16_t symbol = -1; // 0-255, or 256 for EOS
+    };
+
+    HuffmanTree() {
+        nodes.emplace_back();
+        for (int sym = 0; sym <= 256; ++sym) {
+            auto code = sym == 256 ? kEosCode : kHuffmanCodes[sym];
+            int len = sym == 256 ? kEosLength : kHuffmanCodeLen[sym];
+            std::size_t n = 0;
+            for (int bit = len - 1; bit >= 0; --bit) {
+                auto b = (code >> bit) & 1;
+                if (nodes[n].child[b] < 0) {
+                    nodes[n].child[b] = static_cast<std::int16_t>(nodes.size());
+                    nodes.emplace_back();
+                }
+                n = static_cast<std::size_t>(nodes[n].child[b]);
+            }
+            nodes[n].symbol = static_cast<std::int16_t>(sym);
+        }
+    }
+
+    std::vector<Node> nodes;
+};
+
+const HuffmanTree& Tree() {
+    static const HuffmanTree tree;
+    return tree;
+}
+
+chmicro::Status CompressionError(std::string message) {
+    return chmicro::Status(chmicro::StatusCode::invalid_argument, "hpack: " + std::move(message));
+}
+
+// Integer with an N-bit prefix (section 5.1); `first` carries the flag bits above the prefix.
+void AppendInteger(std::string& out, std::uint8_t first, int prefix_bits, std::size_t value) {
+    std::size_t max_prefix = (std::size_t{1} << prefix_bits) - 1;
+    if (value < max_prefix) {
+        out.push_back(static_cast<char>(first | value));
+        return;
+    }
+    out.push_back(static_cast<char>(first | max_prefix));
+    value -= max_prefix;
+    while (value >= 128) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+bool ReadInteger(std::string_view& in, int prefix_bits, std::size_t& value) {
+    if (in.empty()) {
+        return false;
+    }
+    std::size_t max_prefix = (std::size_t{1} << prefix_bits) - 1;
+    value = static_cast<std::uint8_t>(in.front()) & max_prefix;
+    in.remove_prefix(1);
+    if (value < max_prefix) {
+        return true;
+    }
+    for (int shift = 0; shift <= 28; shift += 7) {
+        if (in.empty()) {
+            return false;
+        }
+        auto b = static_cast<std::uint8_t>(in.front());
+        in.remove_prefix(1);
+        value += static_cast<std::size_t>(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) {
+            return true;
+        }
+    }
+    // Longer than any length or index this implementation accepts.
+    return false;
+}
+
+void AppendString(std::string& out, std::string_view s) {
+    auto huffman = HuffmanEncodedLength(s);
+    if (huffman < s.size()) {
+        AppendInteger(out, 0x80, 7, huffman);
+        HuffmanEncode(s, out);
+    } else {
+        AppendInteger(out, 0, 7, s.size());
+        out.append(s);
+    }
+}
+
+chmicro::Status ReadString(std::string_view& in, std::string& out) {
+    if (in.empty()) {
+        return CompressionError("truncated string");
+    }
+    bool huffman = (static_cast<std::uint8_t>(in.front()) & 0x80) != 0;
+    std::size_t len = 0;
+    if (!ReadInteger(in, 7, len) || len > in.size()) {
+        return CompressionError("truncated string");
+    }
+    auto raw = in.substr(0, len);
+    in.remove_prefix(len);
+    out.clear();
+    if (!huffman) {
+        out.assign(raw);
+        return chmicro::Status::Ok();
+    }
+    return HuffmanDecode(raw, out);
+}
+
+// Field at 1-based HPACK index, static entries first.
+bool Lookup(const HpackDynamicTable& table, std::size_t index, std::string_view& name, std::string_view& value) {
+    if (index == 0) {
+        return false;
+    }
+    if (index <= kStaticTable.size()) {
+        name = kStaticTable[index - 1].first;
+        value = kStaticTable[index - 1].second;
+        return true;
+    }
+    auto i = index - kStaticTable.size() - 1;
+    if (i >= table.Count()) {
+        return false;
+    }
+    name = table.At(i).name;
+    value = table.At(i).value;
+    return true;
+}
+
+} // namespace
+
+void HpackDynamicTable::Add(std::string_view name, std::string_view value) {
+    auto size = name.size() + value.size() + kEntryOverhead;
+    if (size > capacity_) {
+        // Section 4.4: an entry larger than the table empties it and is not added.
+        Evict(0);
+        return;
+    }
+    Evict(capacity_ - size);
+    entries_.push_front(HeaderField{std::string(name), std::string(value)});
+    size_ += size;
+}
+
+void HpackDynamicTable::SetCapacity(std::size_t capacity) {
+    capacity_ = capacity;
+    Evict(capacity);
+}
+
+void HpackDynamicTable::Evict(std::size_t capacity) {
+    while (size_ > capacity && !entries_.empty()) {
+        const auto& e = entries_.back();
+        size_ -= e.name.size() + e.value.size() + kEntryOverhead;
+        entries_.pop_back();
+    }
+}
+
+HpackDecoder::HpackDecoder(std::size_t max_table_size) : max_table_size_(max_table_size), table_(max_table_size) {}
+
+chmicro::Status HpackDecoder::Decode(std::string_view in, std::vector<HeaderField>& out) {
+    std::size_t list_size = 0;
+    bool fields_seen = false;
+    std::string name_buf;
+    std::string value_buf;
+
+    while (!in.empty()) {
+        auto b = static_cast<std::uint8_t>(in.front());
+        std::size_t index = 0;
+
+        if ((b & 0x80) != 0) {
+            // Indexed field.
+            std::string_view name;
+            std::string_view value;
+            if (!ReadInteger(in, 7, index) || !Lookup(table_, index, name, value)) {
+                return CompressionError("bad index");
+            }
+            out.push_back(HeaderField{std::string(name), std::string(value)});
+        } else if ((b & 0xe0) == 0x20) {
+            // Dynamic table size update: only before the first field of a block.
+            std::size_t size = 0;
+            if (fields_seen || !ReadInteger(in, 5, size) || size > max_table_size_) {
+                return CompressionError("bad table size update");
+            }
+            table_.SetCapacity(size);
+            continue;
+        } else {
+            // Literal: with incremental indexing (01), without (0000) or never indexed (0001).
+            bool indexing = (b & 0xc0) == 0x40;
+            int prefix = indexing ? 6 : 4;
+            if (!ReadInteger(in, prefix, index)) {
+                return CompressionError("truncated literal");
+            }
+            if (index != 0) {
+                std::string_view name;
+                std::string_view value;
+                if (!Lookup(table_, index, name, value)) {
+                    return CompressionError("bad name index");
+                }
+                name_buf.assign(name);
+            } else if (auto st = ReadString(in, name_buf); !st.ok()) {
+                return st;
+            }
+            if (auto st = ReadString(in, value_buf); !st.ok()) {
+                return st;
+            }
+            if (indexing) {
+                table_.Add(name_buf, value_buf);
+            }
+            out.push_back(HeaderField{name_buf, value_buf});
+        }
+
+        fields_seen = true;
+        list_size += out.back().name.size() + out.back().value.size() + kEntryOverhead;
+        if (list_size > max_list_size_) {
+            return CompressionError("header list too large");
+        }
+    }
+    return chmicro::Status::Ok();
+}
+
+void HpackEncoder::SetMaxTableSize(std::size_t bytes) {
+    pending_size_update_ = bytes;
+    size_update_pending_ = true;
+}
+
+void HpackEncoder::Begin(std::string& out) {
+    if (size_update_pending_) {
+        size_update_pending_ = false;
+        // Keep the default 4096 unless the peer allows less.
+        auto size = std::min<std::size_t>(pending_size_update_, 4096);
+        table_.SetCapacity(size);
+        AppendInteger(out, 0x20, 5, size);
+    }
+}
+
+void HpackEncoder::Encode(std::string_view name, std::string_view value, std::string& out, bool index) {
+    std::size_t name_index = 0;
+    for (std::size_t i = 0; i < kStaticTable.size(); ++i) {
+        if (kStaticTable[i].first != name) {
+            continue;
+        }
+        if (kStaticTable[i].second == value) {
+            return AppendInteger(out, 0x80, 7, i + 1);
+        }
+        if (name_index == 0) {
+            name_index = i + 1;
+        }
+    }
+    for (std::size_t i = 0; i < table_.Count(); ++i) {
+        const auto& e = table_.At(i);
+        if (e.name == name && e.value == value) {
+            return AppendInteger(out, 0x80, 7, kStaticTable.size() + i + 1);
+        }
+        if (name_index == 0 && e.name == name) {
+            name_index = kStaticTable.size() + i + 1;
+        }
+    }
+
+    if (index) {
+        AppendInteger(out, 0x40, 6, name_index);
+    } else {
+        AppendInteger(out, 0x00, 4, name_index);
+    }
+    if (name_index == 0) {
+        AppendString(out, name);
+    }
+    AppendString(out, value);
+    if (index) {
+        table_.Add(name, value);
+    }
+}
+
+std::size_t HuffmanEncodedLength(std::string_view in) {
+    std::size_t bits = 0;
+    for (unsigned char c : in) {
+        bits += kHuffmanCodeLen[c];
+    }
+    return (bits + 7) / 8;
+}
+
+void HuffmanEncode(std::string_view in, std::string& out) {
+    std::uint64_t acc = 0;
+    int bits = 0;
+    for (unsigned char c : in) {
+        acc = (acc << kHuffmanCodeLen[c]) | kHuffmanCodes[c];
+        bits += kHuffmanCodeLen[c];
+        while (bits >= 8) {
+            bits -= 8;
+            out.push_back(static_cast<char>(acc >> bits));
+        }
+    }
+    if (bits > 0) {
+        // Pad with the most significant bits of EOS (all ones).
+        out.push_back(static_cast<char>((acc << (8 - bits)) | (0xff >> bits)));
+    }
+}
+
+chmicro::Status HuffmanDecode(std::string_view in, std::string& out) {
+    const auto& nodes = Tree().nodes;
+    std::size_t n = 0;
+    // Bits read since the last complete symbol, and whether all of them were ones.
+    int pending = 0;
+    bool all_ones = true;
+    for (unsigned char c : in) {
+        for (int bit = 7; bit >= 0; --bit) {
+            auto b = (c >> bit) & 1;
+            auto next = nodes[n].child[b];
+            if (next < 0) {
+                return CompressionError("invalid huffman code");
+            }
+            n = static_cast<std::size_t>(next);
+            ++pending;
+            all_ones = all_ones && b == 1;
+            if (nodes[n].symbol >= 0) {
+                if (nodes[n].symbol == 256) {
+                    return CompressionError("huffman EOS in string");
+                }
+                out.push_back(static_cast<char>(nodes[n].symbol));
+                n = 0;
+                pending = 0;
+                all_ones = true;
+            }
+        }
+    }
+    // Section 5.2: at most 7 bits of padding, taken from EOS.
+    if (pending > 7 || !all_ones) {
+        return CompressionError("invalid huffman padding");
+    }
+    return chmicro::Status::Ok();
+}
+
+} // namespace chmicro::http
@@ -0,0 +1,1442 @@
+#include <chmicro/http/http2.h>
+
+#include <chmicro/core/metrics.h>
+#include <chmicro/core/trace.h>
+#include <chmicro/http/file.h>
+#include <chmicro/http/http_server.h>
+#include <chmicro/http/response_writer.h>
+#include <chmicro/http/router.h>
+#include <chmicro/http/stream.h>
+#include <chmicro/http/types.h>
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory_resource>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+namespace chmicro::http::detail {
+namespace {
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+using tcp = boost::asio::ip::tcp;
+using chmicro::resilience::Bulkhead;
+using chmicro::resilience::BulkheadEntry;
+
+// RFC 9113 section 6.
+enum class FrameType : std::uint8_t {
+    data = 0,
+    headers = 1,
+    priority = 2,
+    rst_stream = 3,
+    settings = 4,
+    push_promise = 5,
+    ping = 6,
+    goaway = 7,
+    window_update = 8,
+    continuation = 9,
+};
+
+constexpr std::uint8_t kEndStream = 0x1;
+constexpr std::uint8_t kAck = 0x1;
+constexpr std::uint8_t kEndHeaders = 0x4;
+constexpr std::uint8_t kPadded = 0x8;
+constexpr std::uint8_t kPriority = 0x20;
+
+// RFC 9113 section 7.
+enum class ErrorCode : std::uint32_t {
+    no_error = 0,
+    protocol_error = 1,
+    internal_error = 2,
+    flow_control_error = 3,
+    stream_closed = 5,
+    frame_size_error = 6,
+    refused_stream = 7,
+    cancel = 8,
+    compression_error = 9,
+    enhance_your_calm = 11,
+};
+
+enum Setting : std::uint16_t {
+    header_table_size = 1,
+    enable_push = 2,
+    max_concurrent_streams = 3,
+    initial_window_size = 4,
+    max_frame_size = 5,
+    max_header_list_size = 6,
+};
+
+constexpr std::size_t kFrameHeaderBytes = 9;
+// Largest frame payload accepted; the protocol default, which this server never raises.
+constexpr std::size_t kMaxFrameBytes = 16384;
+constexpr std::size_t kMaxPeerFrameBytes = 16777215;
+constexpr std::int64_t kDefaultWindow = 65535;
+constexpr std::int64_t kMaxWindow = 0x7fffffff;
+// Connection-level receive window. Streams are bounded by their own windows and body limits, so
+// this only has to stay out of their way.
+constexpr std::int64_t kConnectionWindow = 16 * 1024 * 1024;
+// Largest header block (HEADERS plus CONTINUATION) accepted before decoding.
+constexpr std::size_t kMaxHeaderBlock = 64 * 1024;
+// Frames waiting for the socket; DATA is held back past this so streams share the write fairly.
+constexpr std::size_t kMaxQueuedBytes = 256 * 1024;
+// Past this much unsent output, which DATA alone never reaches, the session stops reading until
+// the socket has taken it: a peer that does not read cannot make the queue grow with its requests.
+constexpr std::size_t kMaxUnsentBytes = 2 * kMaxQueuedBytes;
+// PING, SETTINGS and RST_STREAM frames a peer may send per second (and in a burst). They carry no
+// request but cost a reply or a stream teardown; past the budget the connection ends with
+// ENHANCE_YOUR_CALM.
+constexpr std::int64_t kControlFramesPerSecond = 1000;
+constexpr std::uint64_t kUnlimitedBody = std::numeric_limits<std::uint64_t>::max();
+
+std::uint32_t ReadU32(const char* p) {
+    auto b = reinterpret_cast<const unsigned char*>(p);
+    return std::uint32_t{b[0]} << 24 | std::uint32_t{b[1]} << 16 | std::uint32_t{b[2]} << 8 | b[3];
+}
+
+void AppendU32(std::string& out, std::uint32_t v) {
+    out.push_back(static_cast<char>(v >> 24));
+    out.push_back(static_cast<char>(v >> 16));
+    out.push_back(static_cast<char>(v >> 8));
+    out.push_back(static_cast<char>(v));
+}
+
+void AppendFrameHeader(std::string& out, std::size_t length, FrameType type, std::uint8_t flags, std::uint32_t stream) {
+    out.push_back(static_cast<char>(length >> 16));
+    out.push_back(static_cast<char>(length >> 8));
+    out.push_back(static_cast<char>(length));
+    out.push_back(static_cast<char>(type));
+    out.push_back(static_cast<char>(flags));
+    AppendU32(out, stream & 0x7fffffff);
+}
+
+class Http2Session;
+
+// One request/response exchange. Its request and response live on the stream's own arena, which
+// goes away with the stream. Also the BodyReader and ResponseStream of stream routes.
+class Http2Stream : public BodyReader, public ResponseStream {
+public:
+    Http2Stream(Http2Session& session, std::uint32_t id, std::int64_t send_window, std::int64_t recv_window);
+
+    boost::asio::awaitable<chmicro::Result<std::string_view>> Read() override;
+    bool Done() const override { return remote_closed && in_chunks.empty(); }
+    boost::asio::awaitable<chmicro::Status> Write(std::string_view data) override;
+    bool Started() const override { return headers_sent; }
+
+    // Suspends the handler coroutine until Wake().
+    boost::asio::awaitable<void> Wait() {
+        wake.expires_at(std::chrono::steady_clock::time_point::max());
+        beast::error_code ec;
+        co_await wake.async_wait(boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+    }
+    void Wake() { wake.cancel(); }
+
+    // Response body bytes not yet framed as DATA.
+    std::uint64_t Pending() const { return body.size() + file_left + (out_chunks.size() - out_offset); }
+
+    Http2Session& session;
+    const std::uint32_t id;
+    std::pmr::monotonic_buffer_resource arena;
+    std::optional<Request> request;
+    std::optional<Response> response;
+    const Route* route = nullptr;
+    std::chrono::steady_clock::time_point start;
+    boost::asio::steady_timer wake;
+
+    std::int64_t send_window;
+    std::int64_t recv_window;
+    std::int64_t recv_unacked = 0; // consumed, not yet returned with WINDOW_UPDATE
+    std::uint64_t body_limit = kUnlimitedBody;
+    std::uint64_t body_bytes = 0;
+    // Request body progress for body_timeout and min_transfer_rate, counting only time the peer
+    // was allowed to send (recv_window open): since the last DATA, and in total.
+    std::chrono::steady_clock::time_point body_from;
+    std::chrono::steady_clock::duration body_wait{};
+
+    bool remote_closed = false;   // END_STREAM received
+    bool dispatched = false;      // handed to the route, or answered without it
+    bool headers_sent = false;
+    bool finished = false;        // handler done; END_STREAM follows the pending body
+    bool closed = false;          // gone from the session, by END_STREAM, reset or connection loss
+    bool queued = false;          // in the session's send queue
+    bool too_large = false;
+    bool holds_slot = false;
+
+    // Slot in the route's bulkhead, or the place in its queue (until bulkhead_deadline).
+    Bulkhead* bulkhead = nullptr;
+    bool waiting_bulkhead = false;
+    Bulkhead::Ticket bulkhead_ticket = 0;
+    std::chrono::steady_clock::time_point bulkhead_deadline;
+
+    // Request body of stream routes, in arrival order; Read() hands out in_current.
+    std::deque<std::string> in_chunks;
+    std::string in_current;
+
+    // Response body: the buffered body, a file range, or what Write() queued.
+    std::string_view body;
+    std::shared_ptr<const File> file;
+    std::uint64_t file_offset = 0;
+    std::uint64_t file_left = 0;
+    std::string out_chunks;
+    std::size_t out_offset = 0;
+};
+
+class Http2Session : public std::enable_shared_from_this<Http2Session> {
+public:
+    Http2Session(beast::tcp_stream stream, beast::flat_buffer buffered, const ServerContext& ctx)
+        : stream_(std::move(stream)),
+          in_(std::move(buffered)),
+          owner_(ctx.owner),
+          router_(ctx.router),
+          options_(ctx.options),
+          connections_(ctx.connections),
+          wheel_(ctx.wheel),
+          open_(ctx.open),
+          draining_(ctx.draining),
+          metrics_(ctx.metrics) {
+        connections_.Add(1);
+        open_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~Http2Session() {
+        connections_.Add(-1);
+        open_.fetch_sub(1, std::memory_order_release);
+    }
+
+    void Run(std::vector<HeaderField> upgrade, std::string settings) {
+        // Frames of one stream go out while another's are still unacknowledged; Nagle would hold
+        // them back for a delayed ACK.
+        beast::error_code ec;
+        stream_.socket().set_option(tcp::no_delay(true), ec);
+
+        deadline_ = std::make_shared<chmicro::TimerWheel::Deadline>(
+            [weak = weak_from_this(), executor = stream_.get_executor()] {
+                boost::asio::post(executor, [weak] {
+                    if (auto self = weak.lock()) {
+                        self->OnDeadline();
+                    }
+                });
+            });
+        control_refilled_ms_ = wheel_->NowMs();
+
+        // Server preface: our SETTINGS, then the connection window opened past the default.
+        std::string payload;
+        auto setting = [&payload](Setting id, std::uint32_t value) {
+            payload.push_back(static_cast<char>(id >> 8));
+            payload.push_back(static_cast<char>(id));
+            AppendU32(payload, value);
+        };
+        setting(max_concurrent_streams, options_.http2_max_streams);
+        setting(initial_window_size, options_.http2_stream_window);
+        setting(enable_push, 0);
+        AppendFrameHeader(out_, payload.size(), FrameType::settings, 0, 0);
+        out_.append(payload);
+        AppendFrameHeader(out_, 4, FrameType::window_update, 0, 0);
+        AppendU32(out_, static_cast<std::uint32_t>(kConnectionWindow - kDefaultWindow));
+
+        if (!upgrade.empty()) {
+            // HTTP2-Settings counts as the client's first SETTINGS frame; it is never acknowledged.
+            if (settings.size() % 6 != 0 || !ApplySettings(settings)) {
+                return Abort();
+            }
+            last_stream_ = 1;
+            OpenStream(1, upgrade, true);
+        }
+
+        Arm(TimeoutReason::header, options_.header_timeout);
+        OnInput();
+    }
+
+    // Stream callbacks; all on the session strand.
+
+    bool Closed() const { return closing_; }
+
+    // A stream route handler took `n` bytes of its body; the client may send that much more.
+    void Consumed(Http2Stream& s, std::size_t n) {
+        s.recv_unacked += static_cast<std::int64_t>(n);
+        if (!s.remote_closed && s.recv_unacked >= options_.http2_stream_window / 2) {
+            SendWindowUpdate(s.id, s.recv_unacked);
+            if (s.recv_window <= 0) {
+                // The body clock stood still while the window was shut.
+                s.body_from = std::chrono::steady_clock::now();
+            }
+            s.recv_window += s.recv_unacked;
+            s.recv_unacked = 0;
+            UpdateIdle();
+            Flush();
+        }
+    }
+
+    // `s` has body bytes or its END_STREAM to send.
+    void Schedule(Http2Stream& s) {
+        if (s.queued || s.closed || !s.headers_sent || (s.Pending() == 0 && !s.finished)) {
+            return;
+        }
+        s.queued = true;
+        ready_.push_back(FindStream(s));
+        PumpData();
+        Flush();
+    }
+
+    // HEADERS for the response of `s`. Content-Length is sent unless the body is streamed or the
+    // status has none.
+    void SendResponseHeaders(Http2Stream& s, bool streamed, bool end_stream) {
+        const auto& resp = *s.response;
+        const auto& req = *s.request;
+        std::string block;
+        encoder_.Begin(block);
+        auto status = resp.status >= 100 && resp.status <= 599 ? resp.status : 500;
+        encoder_.Encode(":status", std::to_string(status), block);
+        encoder_.Encode("server", "chmicro/0.1", block);
+        auto date = HttpDate::Line();
+        // "Date: <value>\r\n"
+        encoder_.Encode("date", date.substr(6, date.size() - 8), block);
+        if (!resp.content_type.empty()) {
+            encoder_.Encode("content-type", resp.content_type, block);
+        }
+        if (req.trace.valid()) {
+            std::string tp = "00-";
+            tp.append(req.trace.trace_id);
+            tp.push_back('-');
+            tp.append(req.trace.span_id);
+            tp.push_back('-');
+            tp.append(req.trace.flags);
+            encoder_.Encode("traceparent", tp, block, false);
+        }
+        std::string name;
+        for (const auto& h : resp.headers) {
+            name.assign(h.first.data(), h.first.size());
+            std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+            // Connection-specific fields do not exist in HTTP/2 (RFC 9113 section 8.2.2).
+            if (name == "connection" || name == "keep-alive" || name == "transfer-encoding" || name == "upgrade" ||
+                name == "proxy-connection") {
+                continue;
+            }
+            encoder_.Encode(name, h.second, block, false);
+        }
+        if (!streamed && StatusHasBody(status)) {
+            encoder_.Encode("content-length", std::to_string(resp.BodySize()), block, false);
+        }
+
+        // Split to the peer's frame size: HEADERS, then CONTINUATION frames.
+        std::string_view rest = block;
+        bool first = true;
+        do {
+            auto n = std::min(rest.size(), peer_max_frame_);
+            std::uint8_t flags = n == rest.size() ? kEndHeaders : 0;
+            if (first && end_stream) {
+                flags |= kEndStream;
+            }
+            AppendFrameHeader(out_, n, first ? FrameType::headers : FrameType::continuation, flags, s.id);
+            out_.append(rest.substr(0, n));
+            rest.remove_prefix(n);
+            first = false;
+        } while (!rest.empty());
+        s.headers_sent = true;
+        Flush();
+    }
+
+    // Route completion, on the strand. `e` is an exception the handler escaped with.
+    void Finish(Http2Stream& s, std::exception_ptr e) {
+        s.finished = true;
+        if (s.closed) {
+            // Reset by the client or lost with the connection; nobody is waiting for the answer.
+            ReleaseSlot(s);
+            return;
+        }
+        RecordRequest(s);
+        if (!s.headers_sent) {
+            if (e) {
+                InternalError(s);
+            }
+            auto& resp = *s.response;
+            if (resp.file && s.request->raw.method() == http::verb::get) {
+                resp.ApplyRange(s.request->Header("Range"));
+            }
+            if (!StatusHasBody(resp.status)) {
+                // 1xx, 204 and 304 end with the HEADERS frame.
+            } else if (resp.file) {
+                s.file = resp.file;
+                s.file_offset = resp.file_offset;
+                s.file_left = resp.file_length;
+            } else {
+                s.body = resp.body;
+            }
+            bool empty = s.Pending() == 0;
+            SendResponseHeaders(s, false, empty);
+            if (empty) {
+                return CloseStream(s);
+            }
+        } else if (e) {
+            // A streamed body cannot be completed; the client sees the stream fail.
+            return ResetStream(s.id, ErrorCode::internal_error);
+        }
+        Schedule(s);
+    }
+
+    const HttpServerOptions& Options() const { return options_; }
+    boost::asio::any_io_executor Executor() { return stream_.get_executor(); }
+
+private:
+    std::shared_ptr<Http2Stream> FindStream(const Http2Stream& s) {
+        auto it = streams_.find(s.id);
+        return it != streams_.end() ? it->second : nullptr;
+    }
+
+    // Reads on unless closing or too much output waits for the socket; OnWrite resumes.
+    void ReadMore() {
+        if (reading_ || closing_ || out_.size() >= kMaxUnsentBytes) {
+            return;
+        }
+        reading_ = true;
+        stream_.async_read_some(in_.prepare(kFrameHeaderBytes + kMaxFrameBytes),
+            beast::bind_front_handler(&Http2Session::OnRead, shared_from_this()));
+    }
+
+    void OnRead(beast::error_code ec, std::size_t n) {
+        reading_ = false;
+        if (ec) {
+            return Abort();
+        }
+        in_.commit(n);
+        OnInput();
+    }
+
+    // Handles every complete frame in in_, then writes what they produced and reads on.
+    void OnInput() {
+        while (!closing_) {
+            auto buffered = in_.data();
+            std::string_view data(static_cast<const char*>(buffered.data()), buffered.size());
+            if (!preface_received_) {
+                auto n = std::min(data.size(), kHttp2Preface.size());
+                if (data.substr(0, n) != kHttp2Preface.substr(0, n)) {
+                    return Abort();
+                }
+                if (n < kHttp2Preface.size()) {
+                    break;
+                }
+                in_.consume(n);
+                preface_received_ = true;
+                UpdateIdle();
+                continue;
+            }
+            if (data.size() < kFrameHeaderBytes) {
+                break;
+            }
+            auto length = std::size_t{static_cast<unsigned char>(data[0])} << 16 |
+                std::size_t{static_cast<unsigned char>(data[1])} << 8 | static_cast<unsigned char>(data[2]);
+            if (length > kMaxFrameBytes) {
+                ConnectionError(ErrorCode::frame_size_error);
+                break;
+            }
+            if (data.size() < kFrameHeaderBytes + length) {
+                break;
+            }
+            auto type = static_cast<FrameType>(data[3]);
+            auto flags = static_cast<std::uint8_t>(data[4]);
+            auto id = ReadU32(data.data() + 5) & 0x7fffffff;
+            OnFrame(type, flags, id, data.substr(kFrameHeaderBytes, length));
+            in_.consume(kFrameHeaderBytes + length);
+        }
+
+        if (!closing_ && Draining() && !goaway_sent_) {
+            SendGoAway(ErrorCode::no_error);
+            CloseIfDone();
+        }
+        UpdateIdle();
+        PumpData();
+        Flush();
+        ReadMore();
+    }
+
+    void OnFrame(FrameType type, std::uint8_t flags, std::uint32_t id, std::string_view payload) {
+        if (continuation_stream_ != 0 && (type != FrameType::continuation || id != continuation_stream_)) {
+            return ConnectionError(ErrorCode::protocol_error);
+        }
+        switch (type) {
+        case FrameType::data:
+            return OnData(flags, id, payload);
+        case FrameType::headers:
+            return OnHeaders(flags, id, payload);
+        case FrameType::priority:
+            if (id == 0) {
+                return ConnectionError(ErrorCode::protocol_error);
+            }
+            if (payload.size() != 5) {
+                return ResetStream(id, ErrorCode::frame_size_error);
+            }
+            // Scheduling is plain round-robin; priority signals are ignored.
+            return;
+        case FrameType::rst_stream:
+            if (id == 0 || id > last_stream_) {
+                return ConnectionError(ErrorCode::protocol_error);
+            }
+            if (!ChargeControlFrame()) {
+                return;
+            }
+            if (payload.size() != 4) {
+                return ConnectionError(ErrorCode::frame_size_error);
+            }
+            if (auto it = streams_.find(id); it != streams_.end()) {
+                CloseStream(*it->second, false);
+            }
+            return;
+        case FrameType::settings:
+            return OnSettings(flags, id, payload);
+        case FrameType::ping:
+            if (id != 0) {
+                return ConnectionError(ErrorCode::protocol_error);
+            }
+            if (payload.size() != 8) {
+                return ConnectionError(ErrorCode::frame_size_error);
+            }
+            if ((flags & kAck) == 0 && ChargeControlFrame()) {
+                AppendFrameHeader(out_, 8, FrameType::ping, kAck, 0);
+                out_.append(payload);
+            }
+            return;
+        case FrameType::goaway:
+            if (id != 0) {
+                return ConnectionError(ErrorCode::protocol_error);
+            }
+            // The client opens no more streams; finish the open ones, then close.
+            goaway_received_ = true;
+            return CloseIfDone();
+        case FrameType::window_update:
+            return OnWindowUpdate(id, payload);
+        case FrameType::continuation:
+            if (continuation_stream_ == 0) {
+                return ConnectionError(ErrorCode::protocol_error);
+            }
+            header_block_.append(payload);
+            if (header_block_.size() > kMaxHeaderBlock) {
+                return ConnectionError(ErrorCode::enhance_your_calm);
+            }
+            if ((flags & kEndHeaders) != 0) {
+                continuation_stream_ = 0;
+                OnHeaderBlock(id, header_block_, header_end_stream_);
+                header_block_.clear();
+            }
+            return;
+        case FrameType::push_promise:
+            // Clients cannot push.
+            return ConnectionError(ErrorCode::protocol_error);
+        }
+        // Unknown frame types are ignored (section 4.1).
+    }
+
+    // Strips the padding, and with it the pad length octet, of DATA and HEADERS payloads.
+    bool Unpad(std::uint8_t flags, std::string_view& payload) {
+        if ((flags & kPadded) == 0) {
+            return true;
+        }
+        if (payload.empty()) {
+            return false;
+        }
+        auto pad = static_cast<unsigned char>(payload.front());
+        payload.remove_prefix(1);
+        if (pad > payload.size()) {
+            return false;
+        }
+        payload.remove_suffix(pad);
+        return true;
+    }
+
+    void OnData(std::uint8_t flags, std::uint32_t id, std::string_view payload) {
+        if (id == 0 || id > last_stream_) {
+            return ConnectionError(ErrorCode::protocol_error);
+        }
+        // Flow control counts the whole payload, padding included.
+        auto counted = static_cast<std::int64_t>(payload.size());
+        conn_recv_window_ -= counted;
+        if (conn_recv_window_ < 0) {
+            return ConnectionError(ErrorCode::flow_control_error);
+        }
+        ReturnConnectionWindow(counted);
+        if (!Unpad(flags, payload)) {
+            return ConnectionError(ErrorCode::protocol_error);
+        }
+
+        auto it = streams_.find(id);
+        if (it == streams_.end()) {
+            // Already closed on our side (answered early, or reset); the client may not know yet.
+            return;
+        }
+        auto& s = *it->second;
+        if (s.remote_closed) {
+            return ResetStream(id, ErrorCode::stream_closed);
+        }
+        s.recv_window -= counted;
+        if (s.recv_window < 0) {
+            return ResetStream(id, ErrorCode::flow_control_error);
+        }
+        auto now = std::chrono::steady_clock::now();
+        s.body_wait += now - s.body_from;
+        s.body_from = now;
+
+        bool streamed = s.route != nullptr && s.route->is_stream() && s.dispatched && !s.finished;
+        // Only what a stream route has yet to read holds its window; everything else is returned now.
+        Consumed(s, streamed ? counted - static_cast<std::int64_t>(payload.size()) : counted);
+
+        s.body_bytes += payload.size();
+        if ((flags & kEndStream) == 0 && BelowMinRate(s)) {
+            return TimedOut(TimeoutReason::min_rate);
+        }
+        if (!s.dispatched) {
+            if (s.body_bytes > s.body_limit) {
+                return Reject(s, 413, "{\"error\":\"request body too large\"}", RejectReason::body_too_large);
+            }
+            s.request->raw.body().append(payload.data(), payload.size());
+        } else if (streamed) {
+            if (s.body_bytes > s.body_limit) {
+                if (!s.too_large) {
+                    s.too_large = true;
+                    metrics_.Rejected(RejectReason::body_too_large);
+                }
+            } else if (!payload.empty()) {
+                s.in_chunks.emplace_back(payload);
+            }
+            s.Wake();
+        }
+        // Otherwise the stream was answered before its body; the rest is dropped.
+
+        if ((flags & kEndStream) != 0) {
+            OnRemoteClosed(s);
+        }
+    }
+
+    void OnHeaders(std::uint8_t flags, std::uint32_t id, std::string_view payload) {
+        if (id == 0 || id % 2 == 0) {
+            return ConnectionError(ErrorCode::protocol_error);
+        }
+        if (!Unpad(flags, payload)) {
+            return ConnectionError(ErrorCode::protocol_error);
+        }
+        if ((flags & kPriority) != 0) {
+            if (payload.size() < 5) {
+                return ConnectionError(ErrorCode::frame_size_error);
+            }
+            payload.remove_prefix(5);
+        }
+        bool end_stream = (flags & kEndStream) != 0;
+        if ((flags & kEndHeaders) != 0) {
+            return OnHeaderBlock(id, payload, end_stream);
+        }
+        continuation_stream_ = id;
+        header_end_stream_ = end_stream;
+        header_block_.assign(payload);
+    }
+
+    void OnHeaderBlock(std::uint32_t id, std::string_view block, bool end_stream) {
+        // The block must be decoded even when the stream is refused: it updates the shared table.
+        std::vector<HeaderField> fields;
+        if (!decoder_.Decode(block, fields).ok()) {
+            return ConnectionError(ErrorCode::compression_error);
+        }
+
+        if (auto it = streams_.find(id); it != streams_.end()) {
+            // Trailers. They are not passed on, but end the request body.
+            auto& s = *it->second;
+            if (s.remote_closed) {
+                return ConnectionError(ErrorCode::stream_closed);
+            }
+            if (!end_stream) {
+                return ResetStream(id, ErrorCode::protocol_error);
+            }
+            return OnRemoteClosed(s);
+        }
+        if (id <= last_stream_) {
+            // Trailers racing our RST_STREAM on a stream answered before its body ended.
+            return;
+        }
+        if (goaway_sent_) {
+            // Above the last stream id announced in GOAWAY: the client retries it elsewhere.
+            return;
+        }
+        last_stream_ = id;
+        if (streams_.size() >= options_.http2_max_streams) {
+            metrics_.Rejected(RejectReason::streams);
+            return ResetStream(id, ErrorCode::refused_stream);
+        }
+        OpenStream(id, fields, end_stream);
+    }
+
+    void OpenStream(std::uint32_t id, const std::vector<HeaderField>& fields, bool end_stream) {
+        auto stream = std::make_shared<Http2Stream>(*this, id, peer_initial_window_, options_.http2_stream_window);
+        auto& s = *stream;
+        s.start = std::chrono::steady_clock::now();
+        s.body_from = s.start;
+        s.remote_closed = end_stream;
+
+        auto& raw = s.request->raw;
+        raw.version(20);
+        bool has_method = false;
+        bool has_path = false;
+        for (const auto& f : fields) {
+            if (!f.name.empty() && f.name.front() == ':') {
+                if (f.name == ":method") {
+                    raw.method_string(f.value);
+                    has_method = true;
+                } else if (f.name == ":path") {
+                    raw.target(f.value);
+                    has_path = !f.value.empty();
+                } else if (f.name == ":authority") {
+                    raw.set(http::field::host, f.value);
+                } else if (f.name != ":scheme") {
+                    has_method = false;
+                    break;
+                }
+            } else {
+                raw.insert(f.name, f.value);
+            }
+        }
+        if (!has_method || !has_path) {
+            // Malformed request (section 8.1.1).
+            return ResetStream(id, ErrorCode::protocol_error);
+        }
+
+        s.request->BindTarget();
+        if (auto tp = s.request->Header("traceparent"); !tp.empty()) {
+            s.request->trace = chmicro::TraceContext::ParseTraceParent(tp);
+        }
+        if (!s.request->trace.valid()) {
+            s.request->trace = chmicro::TraceContext::NewRoot();
+        }
+        s.route = router_.Match(raw.method(), s.request->path, &s.request->params);
+        if (s.route != nullptr && s.route->options.max_body_bytes != 0) {
+            s.body_limit = s.route->options.max_body_bytes;
+        } else if (s.route == nullptr || !s.route->is_stream()) {
+            s.body_limit = options_.max_body_bytes;
+        }
+
+        streams_.emplace(id, stream);
+        UpdateIdle();
+        if (!Admit(s)) {
+            return;
+        }
+        if (end_stream || (s.route != nullptr && s.route->is_stream())) {
+            Dispatch(s);
+        }
+    }
+
+    // Same checks, in the same order, as an HTTP/1.1 request head gets.
+    bool Admit(Http2Stream& s) {
+        std::uint64_t length = 0;
+        auto cl = s.request->Header("content-length");
+        if (!cl.empty() && std::from_chars(cl.data(), cl.data() + cl.size(), length).ec == std::errc{} &&
+            length > s.body_limit) {
+            Reject(s, 413, "{\"error\":\"request body too large\"}", RejectReason::body_too_large);
+            return false;
+        }
+        if (options_.admission && !options_.admission(*s.request, s.route, *s.response)) {
+            Reject(s, 0, {}, RejectReason::admission);
+            return false;
+        }
+        if (auto* controller = options_.admission_controller.get();
+            controller != nullptr && !(s.route != nullptr && s.route->options.bypass_admission)) {
+            if (!controller->TryAcquire()) {
+                s.response->headers["Retry-After"] = std::to_string(controller->RetryAfter().count());
+                Reject(s, 503, "{\"error\":\"overloaded\"}", RejectReason::overload);
+                return false;
+            }
+            s.holds_slot = true;
+        }
+        return true;
+    }
+
+    // Answers `s` without running its route; a status of 0 keeps what the admission hook set.
+    void Reject(Http2Stream& s, unsigned status, std::string_view body, RejectReason reason) {
+        metrics_.Rejected(reason);
+        s.dispatched = true;
+        if (status != 0) {
+            s.response->status = status;
+            s.response->content_type = "application/json; charset=utf-8";
+            s.response->body = body;
+        }
+        Finish(s, nullptr);
+    }
+
+    void Dispatch(Http2Stream& s) {
+        s.dispatched = true;
+        auto* bulkhead = s.route != nullptr ? s.route->options.bulkhead.get() : nullptr;
+        if (bulkhead == nullptr) {
+            return RunRoute(s);
+        }
+        auto entry = bulkhead->Acquire(
+            [self = shared_from_this(), stream = FindStream(s)] {
+                boost::asio::post(self->stream_.get_executor(), [self, stream] { self->OnBulkheadSlot(*stream); });
+            },
+            &s.bulkhead_ticket);
+        switch (entry) {
+        case BulkheadEntry::admitted:
+            s.bulkhead = bulkhead;
+            return RunRoute(s);
+        case BulkheadEntry::queued:
+            s.waiting_bulkhead = true;
+            if (bulkhead->MaxWait().count() != 0) {
+                s.bulkhead_deadline = std::chrono::steady_clock::now() + bulkhead->MaxWait();
+                WaitForBulkhead(s);
+            }
+            return;
+        case BulkheadEntry::rejected:
+            return RejectBulkhead(s, *bulkhead);
+        }
+    }
+
+    // Times out the queued wait of `s`. The stream's timer is free until the route runs, but is
+    // also woken by arriving DATA, so it re-arms until the deadline has passed.
+    void WaitForBulkhead(Http2Stream& s) {
+        s.wake.expires_at(s.bulkhead_deadline);
+        s.wake.async_wait([self = shared_from_this(), stream = FindStream(s)](beast::error_code) {
+            auto& s = *stream;
+            if (!s.waiting_bulkhead || s.closed) {
+                return;
+            }
+            if (std::chrono::steady_clock::now() < s.bulkhead_deadline) {
+                return self->WaitForBulkhead(s);
+            }
+            // Unless the slot is already on its way to OnBulkheadSlot.
+            auto& bulkhead = *s.route->options.bulkhead;
+            if (bulkhead.Cancel(s.bulkhead_ticket, true)) {
+                s.waiting_bulkhead = false;
+                self->RejectBulkhead(s, bulkhead);
+            }
+        });
+    }
+
+    void OnBulkheadSlot(Http2Stream& s) {
+        s.waiting_bulkhead = false;
+        s.bulkhead = s.route->options.bulkhead.get();
+        if (s.closed) {
+            return ReleaseSlot(s);
+        }
+        s.wake.cancel();
+        RunRoute(s);
+    }
+
+    // A stream closed while queued gives up its place.
+    void LeaveBulkhead(Http2Stream& s) {
+        if (s.waiting_bulkhead && s.route->options.bulkhead->Cancel(s.bulkhead_ticket, false)) {
+            s.waiting_bulkhead = false;
+            ReleaseSlot(s);
+        }
+    }
+
+    void RejectBulkhead(Http2Stream& s, const Bulkhead& bulkhead) {
+        s.response->headers["Retry-After"] = std::to_string(bulkhead.RetryAfter().count());
+        Reject(s, 503, "{\"error\":\"overloaded\"}", RejectReason::bulkhead);
+    }
+
+    void RunRoute(Http2Stream& s) {
+        auto self = shared_from_this();
+        auto stream = FindStream(s);
+        const auto* route = s.route;
+        if (route != nullptr && route->is_stream()) {
+            boost::asio::co_spawn(stream_.get_executor(),
+                router_.HandleStream(route, *s.request, s, *s.response, s),
+                [self, stream](std::exception_ptr e) { self->Finish(*stream, e); });
+            return;
+        }
+        if (route != nullptr && route->is_async()) {
+            boost::asio::co_spawn(stream_.get_executor(), router_.HandleAsync(route, *s.request, *s.response),
+                [self, stream](std::exception_ptr e) { self->Finish(*stream, e); });
+            return;
+        }
+        if (route != nullptr && route->options.execution == ExecutionPolicy::offload && options_.workers != nullptr) {
+            // Nothing else touches the stream's request and response until the worker posts back.
+            bool queued = options_.workers->TrySubmit([self, stream, enqueued = std::chrono::steady_clock::now()] {
+                if (stream->holds_slot) {
+                    self->options_.admission_controller->OnQueueDelay(std::chrono::steady_clock::now() - enqueued);
+                }
+                self->router_.Handle(stream->route, *stream->request, *stream->response);
+                boost::asio::post(self->stream_.get_executor(), [self, stream] { self->Finish(*stream, nullptr); });
+            });
+            if (!queued) {
+                s.response->status = 503;
+                s.response->content_type = "application/json; charset=utf-8";
+                s.response->body = "{\"error\":\"overloaded\"}";
+                Finish(s, nullptr);
+            }
+            return;
+        }
+        {
+            InlineHandlerScope on_reactor;
+            router_.Handle(route, *s.request, *s.response);
+        }
+        Finish(s, nullptr);
+    }
+
+    void OnRemoteClosed(Http2Stream& s) {
+        s.remote_closed = true;
+        if (!s.dispatched) {
+            return Dispatch(s);
+        }
+        s.Wake();
+    }
+
+    void OnSettings(std::uint8_t flags, std::uint32_t id, std::string_view payload) {
+        if (id != 0) {
+            return ConnectionError(ErrorCode::protocol_error);
+        }
+        if ((flags & kAck) != 0) {
+            if (!payload.empty()) {
+                ConnectionError(ErrorCode::frame_size_error);
+            }
+            return;
+        }
+        if (payload.size() % 6 != 0) {
+            return ConnectionError(ErrorCode::frame_size_error);
+        }
+        if (!ChargeControlFrame() || !ApplySettings(payload)) {
+            return;
+        }
+        AppendFrameHeader(out_, 0, FrameType::settings, kAck, 0);
+    }
+
+    // Applies a SETTINGS payload; false after a connection error.
+    bool ApplySettings(std::string_view payload) {
+        for (; payload.size() >= 6; payload.remove_prefix(6)) {
+            auto key = static_cast<std::uint16_t>(static_cast<unsigned char>(payload[0]) << 8 | static_cast<unsigned char>(payload[1]));
+            auto value = ReadU32(payload.data() + 2);
+            switch (key) {
+            case header_table_size:
+                encoder_.SetMaxTableSize(value);
+                break;
+            case enable_push:
+                if (value > 1) {
+                    ConnectionError(ErrorCode::protocol_error);
+                    return false;
+                }
+                break;
+            case initial_window_size: {
+                if (value > kMaxWindow) {
+                    ConnectionError(ErrorCode::flow_control_error);
+                    return false;
+                }
+                // Applies retroactively to every open stream (section 6.9.2).
+                auto delta = static_cast<std::int64_t>(value) - peer_initial_window_;
+                peer_initial_window_ = value;
+                for (auto& [sid, s] : streams_) {
+                    s->send_window += delta;
+                    if (s->send_window > kMaxWindow) {
+                        ConnectionError(ErrorCode::flow_control_error);
+                        return false;
+                    }
+                }
+                ScheduleAll();
+                break;
+            }
+            case max_frame_size:
+                if (value < kMaxFrameBytes || value > kMaxPeerFrameBytes) {
+                    ConnectionError(ErrorCode::protocol_error);
+                    return false;
+                }
+                peer_max_frame_ = value;
+                break;
+            default:
+                // MAX_CONCURRENT_STREAMS limits pushes, which this server never sends.
+                break;
+            }
+        }
+        return true;
+    }
+
+    void OnWindowUpdate(std::uint32_t id, std::string_view payload) {
+        if (payload.size() != 4) {
+            return ConnectionError(ErrorCode::frame_size_error);
+        }
+        auto increment = static_cast<std::int64_t>(ReadU32(payload.data()) & 0x7fffffff);
+        if (id == 0) {
+            if (increment == 0) {
+                return ConnectionError(ErrorCode::protocol_error);
+            }
+            conn_send_window_ += increment;
+            if (conn_send_window_ > kMaxWindow) {
+                return ConnectionError(ErrorCode::flow_control_error);
+            }
+            return ScheduleAll();
+        }
+        auto it = streams_.find(id);
+        if (it == streams_.end()) {
+            return;
+        }
+        auto& s = *it->second;
+        if (increment == 0) {
+            return ResetStream(id, ErrorCode::protocol_error);
+        }
+        s.send_window += increment;
+        if (s.send_window > kMaxWindow) {
+            return ResetStream(id, ErrorCode::flow_control_error);
+        }
+        Schedule(s);
+    }
+
+    void ScheduleAll() {
+        for (auto& [id, s] : streams_) {
+            if (s->headers_sent && !s->queued && (s->Pending() > 0 || s->finished)) {
+                s->queued = true;
+                ready_.push_back(s);
+            }
+        }
+    }
+
+    // Frames queued response bodies as DATA, one frame per stream in turn, within the flow-control
+    // windows and until kMaxQueuedBytes is waiting for the socket.
+    void PumpData() {
+        while (!ready_.empty() && out_.size() < kMaxQueuedBytes && !closing_) {
+            auto stream = std::move(ready_.front());
+            ready_.pop_front();
+            if (!stream) {
+                continue;
+            }
+            auto& s = *stream;
+            s.queued = false;
+            if (s.closed) {
+                continue;
+            }
+            auto pending = s.Pending();
+            if (pending == 0) {
+                if (s.finished) {
+                    AppendFrameHeader(out_, 0, FrameType::data, kEndStream, s.id);
+                    CloseStream(s);
+                }
+                continue;
+            }
+            auto n = std::min<std::int64_t>({static_cast<std::int64_t>(std::min<std::uint64_t>(pending, peer_max_frame_)),
+                s.send_window, conn_send_window_});
+            if (n <= 0) {
+                // Waits for a WINDOW_UPDATE, which schedules it again.
+                continue;
+            }
+            bool last = static_cast<std::uint64_t>(n) == pending && s.finished;
+            if (!AppendData(s, static_cast<std::size_t>(n), last)) {
+                ResetStream(s.id, ErrorCode::internal_error);
+                continue;
+            }
+            s.send_window -= n;
+            conn_send_window_ -= n;
+            // A producer waiting in Write() may queue more now.
+            s.Wake();
+            if (last) {
+                CloseStream(s);
+            } else if (s.Pending() > 0 || s.finished) {
+                s.queued = true;
+                ready_.push_back(stream);
+            }
+        }
+    }
+
+    // One DATA frame of `n` bytes from the stream's body source. False if a file read fails.
+    bool AppendData(Http2Stream& s, std::size_t n, bool end_stream) {
+        auto header_at = out_.size();
+        AppendFrameHeader(out_, n, FrameType::data, end_stream ? kEndStream : 0, s.id);
+        auto left = n;
+        if (!s.body.empty()) {
+            auto take = std::min(left, s.body.size());
+            out_.append(s.body.substr(0, take));
+            s.body.remove_prefix(take);
+            left -= take;
+        }
+        if (left > 0 && s.file_left > 0) {
+            auto take = static_cast<std::size_t>(std::min<std::uint64_t>(left, s.file_left));
+            auto at = out_.size();
+            out_.resize(at + take);
+            std::size_t got = 0;
+            while (got < take) {
+                auto r = s.file->ReadAt(s.file_offset + got, out_.data() + at + got, take - got);
+                if (r <= 0) {
+                    out_.resize(header_at);
+                    return false;
+                }
+                got += static_cast<std::size_t>(r);
+            }
+            s.file_offset += take;
+            s.file_left -= take;
+            left -= take;
+        }
+        if (left > 0) {
+            out_.append(s.out_chunks, s.out_offset, left);
+            s.out_offset += left;
+            if (s.out_offset == s.out_chunks.size()) {
+                s.out_chunks.clear();
+                s.out_offset = 0;
+            }
+        }
+        return true;
+    }
+
+    void Flush() {
+        if (writing_) {
+            return;
+        }
+        if (out_.empty()) {
+            if (closing_) {
+                DoClose();
+            }
+            return;
+        }
+        std::swap(out_, writing_buffer_);
+        writing_ = true;
+        Arm(TimeoutReason::write, WriteBudget(writing_buffer_.size()));
+        boost::asio::async_write(stream_, boost::asio::buffer(writing_buffer_),
+            beast::bind_front_handler(&Http2Session::OnWrite, shared_from_this()));
+    }
+
+    void OnWrite(beast::error_code ec, std::size_t) {
+        writing_ = false;
+        writing_buffer_.clear();
+        if (ec) {
+            return Abort();
+        }
+        UpdateIdle();
+        PumpData();
+        Flush();
+        ReadMore();
+    }
+
+    // Ends `s` on our side. After our END_STREAM, a client still sending the body is told to stop.
+    void CloseStream(Http2Stream& s, bool notify_peer = true) {
+        if (s.closed) {
+            return;
+        }
+        if (notify_peer && !s.remote_closed) {
+            AppendFrameHeader(out_, 4, FrameType::rst_stream, 0, s.id);
+            AppendU32(out_, static_cast<std::uint32_t>(ErrorCode::no_error));
+        }
+        s.closed = true;
+        s.Wake();
+        if (!s.dispatched) {
+            ReleaseSlot(s);
+        }
+        LeaveBulkhead(s);
+        auto keep = FindStream(s);
+        streams_.erase(s.id);
+        CloseIfDone();
+        UpdateIdle();
+    }
+
+    void ResetStream(std::uint32_t id, ErrorCode code) {
+        AppendFrameHeader(out_, 4, FrameType::rst_stream, 0, id);
+        AppendU32(out_, static_cast<std::uint32_t>(code));
+        if (auto it = streams_.find(id); it != streams_.end()) {
+            CloseStream(*it->second, false);
+        }
+    }
+
+    // After a GOAWAY either way, the connection closes once its last stream is done.
+    void CloseIfDone() {
+        if ((goaway_sent_ || goaway_received_) && streams_.empty() && !closing_) {
+            closing_ = true;
+            Flush();
+        }
+    }
+
+    void SendGoAway(ErrorCode code) {
+        goaway_sent_ = true;
+        AppendFrameHeader(out_, 8, FrameType::goaway, 0, 0);
+        AppendU32(out_, last_stream_);
+        AppendU32(out_, static_cast<std::uint32_t>(code));
+    }
+
+    void ConnectionError(ErrorCode code) {
+        if (!goaway_sent_ || code != ErrorCode::no_error) {
+            SendGoAway(code);
+        }
+        closing_ = true;
+        DropStreams();
+    }
+
+    // Takes one frame from the control budget, refilled at kControlFramesPerSecond; false after
+    // ending the connection for a peer over it.
+    bool ChargeControlFrame() {
+        auto now = wheel_->NowMs();
+        auto refill = (now - control_refilled_ms_) * kControlFramesPerSecond / 1000;
+        if (refill > 0) {
+            control_budget_ = std::min(control_budget_ + refill, kControlFramesPerSecond);
+            control_refilled_ms_ = now;
+        }
+        if (control_budget_ == 0) {
+            ConnectionError(ErrorCode::enhance_your_calm);
+            return false;
+        }
+        --control_budget_;
+        return true;
+    }
+
+    void SendWindowUpdate(std::uint32_t id, std::int64_t increment) {
+        AppendFrameHeader(out_, 4, FrameType::window_update, 0, id);
+        AppendU32(out_, static_cast<std::uint32_t>(increment));
+    }
+
+    void ReturnConnectionWindow(std::int64_t n) {
+        conn_recv_unacked_ += n;
+        if (conn_recv_unacked_ >= kConnectionWindow / 2) {
+            SendWindowUpdate(0, conn_recv_unacked_);
+            conn_recv_window_ += conn_recv_unacked_;
+            conn_recv_unacked_ = 0;
+        }
+    }
+
+    // Fails every open stream; handlers still running see their Read() and Write() fail.
+    void DropStreams() {
+        auto streams = std::move(streams_);
+        streams_.clear();
+        ready_.clear();
+        for (auto& [id, s] : streams) {
+            s->closed = true;
+            s->Wake();
+            if (!s->dispatched) {
+                ReleaseSlot(*s);
+            }
+            LeaveBulkhead(*s);
+        }
+    }
+
+    // The socket failed or the client broke the protocol beyond answering.
+    void Abort() {
+        closing_ = true;
+        DropStreams();
+        Disarm();
+        beast::error_code ec;
+        stream_.socket().close(ec);
+    }
+
+    void DoClose() {
+        Disarm();
+        beast::error_code ec;
+        stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
+    }
+
+    void InternalError(Http2Stream& s) {
+        s.response.emplace(&s.arena);
+        s.response->status = 500;
+        s.response->content_type = "application/json; charset=utf-8";
+        s.response->body = "{\"error\":\"internal\"}";
+    }
+
+    void ReleaseSlot(Http2Stream& s) {
+        if (s.holds_slot) {
+            s.holds_slot = false;
+            options_.admission_controller->Release(std::chrono::steady_clock::now() - s.start);
+        }
+        if (s.bulkhead != nullptr) {
+            std::exchange(s.bulkhead, nullptr)->Release();
+        }
+    }
+
+    void RecordRequest(Http2Stream& s) {
+        ReleaseSlot(s);
+        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - s.start).count();
+        metrics_.Record(s.route, s.response->status, elapsed);
+    }
+
+    // Deadlines: the preface and idle waits while no stream is open, every write, and
+    // body_timeout for the stream that has waited longest for more of its request body. Streams
+    // with their body in are bounded by the handlers, as HTTP/1.1 requests are once dispatched.
+    void UpdateIdle() {
+        if (closing_ || writing_ || !preface_received_) {
+            return;
+        }
+        if (streams_.empty()) {
+            return Arm(TimeoutReason::idle, options_.idle_timeout);
+        }
+        std::optional<std::chrono::steady_clock::time_point> oldest;
+        for (const auto& [id, s] : streams_) {
+            if (AwaitingBody(*s) && (!oldest || s->body_from < *oldest)) {
+                oldest = s->body_from;
+            }
+        }
+        if (!oldest || options_.body_timeout.count() == 0) {
+            return Disarm();
+        }
+        auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - *oldest);
+        Arm(TimeoutReason::body, std::max(options_.body_timeout - waited, std::chrono::milliseconds(1)));
+    }
+
+    // The peer still owes `s` body and may send it.
+    static bool AwaitingBody(const Http2Stream& s) {
+        return !s.remote_closed && s.recv_window > 0;
+    }
+
+    // The body of `s` has arrived slower than min_transfer_rate, as HttpSession::BelowMinRate.
+    bool BelowMinRate(const Http2Stream& s) const {
+        if (options_.min_transfer_rate == 0 || s.body_wait < options_.min_rate_grace) {
+            return false;
+        }
+        auto waited_ms = std::chrono::duration_cast<std::chrono::milliseconds>(s.body_wait).count();
+        return s.body_bytes * 1000 < options_.min_transfer_rate * static_cast<std::uint64_t>(waited_ms);
+    }
+
+    void Arm(TimeoutReason reason, std::chrono::milliseconds timeout) {
+        if (timeout.count() == 0) {
+            return Disarm();
+        }
+        deadline_reason_ = reason;
+        deadline_->Arm(*wheel_, timeout);
+    }
+
+    void Disarm() {
+        deadline_->Disarm();
+    }
+
+    std::chrono::milliseconds WriteBudget(std::size_t bytes) const {
+        if (options_.write_timeout.count() == 0) {
+            return {};
+        }
+        auto extra = options_.min_transfer_rate == 0 ? 0 : bytes * 1000 / options_.min_transfer_rate;
+        return options_.write_timeout + std::chrono::milliseconds(extra);
+    }
+
+    bool Draining() const {
+        return draining_.load(std::memory_order_relaxed);
+    }
+
+    void OnDeadline() {
+        if (closing_) {
+            return;
+        }
+        if (Draining()) {
+            // Poked by Drain(): announce the last stream served and close once it is answered.
+            if (!goaway_sent_) {
+                SendGoAway(ErrorCode::no_error);
+            }
+            CloseIfDone();
+            return Flush();
+        }
+        if (deadline_->Expired(*wheel_)) {
+            TimedOut(deadline_reason_);
+        }
+    }
+
+    void TimedOut(TimeoutReason reason) {
+        Disarm();
+        metrics_.TimedOut(reason);
+        Abort();
+    }
+
+    beast::tcp_stream stream_;
+    beast::flat_buffer in_;
+    std::shared_ptr<const void> owner_;
+    Router& router_;
+    const HttpServerOptions& options_;
+    chmicro::Gauge& connections_;
+    std::shared_ptr<chmicro::TimerWheel> wheel_;
+    std::shared_ptr<chmicro::TimerWheel::Deadline> deadline_;
+    TimeoutReason deadline_reason_ = TimeoutReason::idle;
+    std::atomic<std::size_t>& open_;
+    const std::atomic<bool>& draining_;
+    RequestMetrics& metrics_;
+
+    HpackDecoder decoder_;
+    HpackEncoder encoder_;
+    std::unordered_map<std::uint32_t, std::shared_ptr<Http2Stream>> streams_;
+    // Streams with DATA to send, served round-robin.
+    std::deque<std::shared_ptr<Http2Stream>> ready_;
+    std::uint32_t last_stream_ = 0;
+
+    // Header block split over CONTINUATION frames.
+    std::uint32_t continuation_stream_ = 0;
+    bool header_end_stream_ = false;
+    std::string header_block_;
+
+    std::int64_t conn_send_window_ = kDefaultWindow;
+    std::int64_t conn_recv_window_ = kConnectionWindow;
+    std::int64_t conn_recv_unacked_ = 0;
+    std::int64_t peer_initial_window_ = kDefaultWindow;
+    std::size_t peer_max_frame_ = kMaxFrameBytes;
+
+    // Frames produced since the last write, and the write in flight.
+    std::string out_;
+    std::string writing_buffer_;
+    bool writing_ = false;
+    bool reading_ = false;
+
+    std::int64_t control_budget_ = kControlFramesPerSecond;
+    std::int64_t control_refilled_ms_ = 0;
+
+    bool preface_received_ = false;
+    bool goaway_sent_ = false;
+    bool goaway_received_ = false;
+    // No more reads; the socket closes once the queued frames are written.
+    bool closing_ = false;
+};
+
+Http2Stream::Http2Stream(Http2Session& session, std::uint32_t id, std::int64_t send_window, std::int64_t recv_window)
+    : session(session),
+      id(id),
+      wake(session.Executor()),
+      send_window(send_window),
+      recv_window(recv_window) {
+    request.emplace(&arena);
+    response.emplace(&arena);
+}
+
+boost::asio::awaitable<chmicro::Result<std::string_view>> Http2Stream::Read() {
+    while (true) {
+        if (closed) {
+            co_return chmicro::Status(chmicro::StatusCode::unavailable, "stream closed");
+        }
+        if (too_large) {
+            co_return chmicro::Status(chmicro::StatusCode::invalid_argument, "request body too large");
+        }
+        if (!in_chunks.empty()) {
+            in_current = std::move(in_chunks.front());
+            in_chunks.pop_front();
+            session.Consumed(*this, in_current.size());
+            co_return std::string_view(in_current);
+        }
+        if (remote_closed) {
+            co_return std::string_view{};
+        }
+        co_await Wait();
+    }
+}
+
+boost::asio::awaitable<chmicro::Status> Http2Stream::Write(std::string_view data) {
+    if (closed || session.Closed()) {
+        co_return chmicro::Status(chmicro::StatusCode::unavailable, "stream closed");
+    }
+    if (!headers_sent) {
+        session.SendResponseHeaders(*this, true, false);
+    }
+    if (data.empty() || !StatusHasBody(response->status)) {
+        co_return chmicro::Status::Ok();
+    }
+    out_chunks.append(data);
+    session.Schedule(*this);
+    // Like the HTTP/1.1 stream, stay at most about one chunk ahead of the client.
+    auto limit = std::max<std::size_t>(session.Options().stream_chunk_bytes, 1);
+    while (!closed && out_chunks.size() - out_offset > limit) {
+        co_await Wait();
+    }
+    if (closed) {
+        co_return chmicro::Status(chmicro::StatusCode::unavailable, "stream closed");
+    }
+    co_return chmicro::Status::Ok();
+}
+
+} // namespace
+
+void ServeHttp2(beast::tcp_stream stream, beast::flat_buffer buffered, const ServerContext& ctx,
+    std::vector<HeaderField> upgrade, std::string settings) {
+    std::make_shared<Http2Session>(std::move(stream), std::move(buffered), ctx)->Run(std::move(upgrade), std::move(settings));
+}
+
+} // namespace chmicro::http::detail
@@ -2,7 +2,10 @@
 
 #include <boost/asio/connect.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/redirect_error.hpp>
 #include <boost/asio/steady_timer.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/use_awaitable.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 
@@ -24,6 +27,13 @@ struct ClientOpState {
     bool timed_out = false;
 };
 
+chmicro::Status ErrorStatus(const beast::error_code& ec) {
+    if (ec == beast::error::timeout) {
+        return chmicro::Status(chmicro::StatusCode::timeout, "http client timeout");
+    }
+    return chmicro::Status(chmicro::StatusCode::unavailable, ec.message());
+}
+
 } // namespace
 
 chmicro::Result<HttpClientResponse> HttpClient::Get(std::string host, std::string port, std::string target, std::chrono::milliseconds timeout) {
@@ -88,4 +98,52 @@ chmicro::Result<HttpClientResponse> HttpClient::Get(std::string host, std::strin
     return out;
 }
 
+boost::asio::awaitable<chmicro::Result<HttpClientResponse>> HttpClient::AsyncGet(
+    std::string host, std::string port, std::string target, std::chrono::milliseconds timeout) {
+    auto ex = co_await boost::asio::this_coro::executor;
+    beast::error_code ec;
+    auto token = boost::asio::redirect_error(boost::asio::use_awaitable, ec);
+
+    tcp::resolver resolver(ex);
+    beast::tcp_stream stream(ex);
+
+    auto results = co_await resolver.async_resolve(host, port, token);
+    if (ec) {
+        co_return ErrorStatus(ec);
+    }
+
+    // One deadline for the whole exchange; tcp_stream applies it to every following operation.
+    stream.expires_after(timeout);
+    co_await stream.async_connect(results, token);
+    if (ec) {
+        co_return ErrorStatus(ec);
+    }
+
+    http::request<http::empty_body> req{http::verb::get, target, 11};
+    req.set(http::field::host, host);
+    req.set(http::field::user_agent, "chmicro/0.1");
+    co_await http::async_write(stream, req, token);
+    if (ec) {
+        co_return ErrorStatus(ec);
+    }
+
+    beast::flat_buffer buffer;
+    http::response<http::string_body> resp;
+    co_await http::async_read(stream, buffer, resp, token);
+    if (ec) {
+        co_return ErrorStatus(ec);
+    }
+
+    beast::error_code ec2;
+    stream.socket().shutdown(tcp::socket::shutdown_both, ec2);
+
+    HttpClientResponse out;
+    out.status = static_cast<int>(resp.result_int());
+    out.body = std::move(resp.body());
+    if (auto it = resp.find(http::field::content_type); it != resp.end()) {
+        out.content_type = std::string(it->value().data(), it->value().size());
+    }
+    co_return out;
+}
+
 } // namespace chmicro::http
@@ -2,9 +2,19 @@
 
 #include <chmicro/core/metrics.h>
 #include <chmicro/core/trace.h>
+#include <chmicro/http/file.h>
+#include <chmicro/http/http2.h>
+#include <chmicro/http/response_writer.h>
+#include <chmicro/http/stream.h>
 #include <chmicro/http/types.h>
 
+#include <boost/asio/co_spawn.hpp>
 #include <boost/asio/dispatch.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/write.hpp>
 #include <boost/asio/strand.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
@@ -12,8 +22,30 @@
 
 #include <chmicro/core/log.h>
 
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <optional>
 #include <string_view>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <signal.h>
+#include <sys/sendfile.h>
+#include <time.h>
+#endif
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 namespace chmicro::http {
 namespace {
@@ -21,191 +53,1420 @@ namespace {
 namespace beast = boost::beast;
 namespace http = beast::http;
 using tcp = boost::asio::ip::tcp;
+using chmicro::resilience::Bulkhead;
+using chmicro::resilience::BulkheadEntry;
+using detail::RejectReason;
+using detail::TimeoutReason;
+
+using RequestParser = http::request_parser<StringBody, Allocator>;
+// Stream routes switch to this after the header: the body lands in a caller-provided buffer.
+using StreamParser = http::request_parser<http::buffer_body, Allocator>;
+
+enum class Parsed { done, need_more, too_large, error };
+
+#if defined(__linux__)
+// True if SIGPIPE is pending for this thread or the process.
+bool SigPipePending() {
+    sigset_t pending;
+    return sigpending(&pending) == 0 && sigismember(&pending, SIGPIPE) == 1;
+}
+
+// sendfile(2) with no SIGPIPE when the peer has gone: it takes no MSG_NOSIGNAL, so SIGPIPE is
+// blocked on this thread for the call and one it raised is discarded, leaving only EPIPE. The
+// signal can come with a partial count as well as with EPIPE.
+ssize_t SendFileNoSignal(int socket, int fd, off_t* offset, std::size_t count) {
+    sigset_t pipe;
+    sigset_t old;
+    sigemptyset(&pipe);
+    sigaddset(&pipe, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe, &old);
+    bool was_pending = SigPipePending();
 
-std::string_view ExtractPath(std::string_view target) {
-    auto q = target.find('?');
-    if (q == std::string_view::npos) {
-        return target;
+    auto n = ::sendfile(socket, fd, offset, count);
+    int saved = errno;
+    if (!was_pending && SigPipePending()) {
+        timespec zero{};
+        while (sigtimedwait(&pipe, nullptr, &zero) < 0 && errno == EINTR) {
+        }
     }
-    return target.substr(0, q);
+    pthread_sigmask(SIG_SETMASK, &old, nullptr);
+    errno = saved;
+    return n;
 }
+#endif
 
-void ParseQuery(std::string_view target, std::unordered_map<std::string, std::string>& out) {
-    auto q = target.find('?');
-    if (q == std::string_view::npos || q + 1 >= target.size()) {
-        return;
+// Upstream of a session arena: the default resource, plus a count of the bytes the arena has taken
+// from it beyond its inline buffer.
+class ArenaUpstream : public std::pmr::memory_resource {
+public:
+    std::size_t bytes() const { return bytes_; }
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+        void* p = std::pmr::get_default_resource()->allocate(bytes, alignment);
+        bytes_ += bytes;
+        return p;
     }
 
-    std::string_view s = target.substr(q + 1);
-    while (!s.empty()) {
-        auto amp = s.find('&');
-        auto part = (amp == std::string_view::npos) ? s : s.substr(0, amp);
-        auto eq = part.find('=');
-        if (eq != std::string_view::npos) {
-            out.emplace(std::string(part.substr(0, eq)), std::string(part.substr(eq + 1)));
-        } else if (!part.empty()) {
-            out.emplace(std::string(part), "");
-        }
-        if (amp == std::string_view::npos) {
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+        bytes_ -= bytes;
+        std::pmr::get_default_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    std::size_t bytes_ = 0;
+};
+
+// HTTP2-Settings is base64url without padding (RFC 7540 section 3.2.1); padding is tolerated.
+bool DecodeBase64Url(std::string_view in, std::string& out) {
+    std::uint32_t acc = 0;
+    int bits = 0;
+    for (char c : in) {
+        int v;
+        if (c >= 'A' && c <= 'Z') {
+            v = c - 'A';
+        } else if (c >= 'a' && c <= 'z') {
+            v = c - 'a' + 26;
+        } else if (c >= '0' && c <= '9') {
+            v = c - '0' + 52;
+        } else if (c == '-' || c == '+') {
+            v = 62;
+        } else if (c == '_' || c == '/') {
+            v = 63;
+        } else if (c == '=') {
             break;
+        } else {
+            return false;
+        }
+        acc = acc << 6 | static_cast<std::uint32_t>(v);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out.push_back(static_cast<char>(acc >> bits));
         }
-        s.remove_prefix(amp + 1);
     }
+    return true;
 }
 
-class HttpSession : public std::enable_shared_from_this<HttpSession> {
+class HttpSession : public std::enable_shared_from_this<HttpSession>, public BodyReader, public ResponseStream {
 public:
-    HttpSession(tcp::socket socket, Router& router)
-        : stream_(std::move(socket)), router_(router) {}
+    // `owner` keeps the server holding router, options and counters alive as long as the session.
+    HttpSession(tcp::socket socket, std::shared_ptr<const void> owner, Router& router, const HttpServerOptions& options,
+        chmicro::Gauge& connections, std::shared_ptr<chmicro::TimerWheel> wheel, std::atomic<std::size_t>& open,
+        const std::atomic<bool>& draining, detail::RequestMetrics& metrics)
+        : stream_(std::move(socket)),
+          owner_(std::move(owner)),
+          router_(router),
+          options_(options),
+          connections_(connections),
+          wheel_(std::move(wheel)),
+          open_(open),
+          draining_(draining),
+          metrics_(metrics),
+          arena_(arena_buffer_.data(), arena_buffer_.size(), &arena_upstream_) {
+        connections_.Add(1);
+        open_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~HttpSession() {
+        // The connection failed while a request was still running.
+        ReleaseSlot();
+        connections_.Add(-1);
+        open_.fetch_sub(1, std::memory_order_release);
+    }
 
     void Run() {
-        Read();
+        deadline_ = std::make_shared<chmicro::TimerWheel::Deadline>(
+            [weak = weak_from_this(), executor = stream_.get_executor()] {
+                boost::asio::post(executor, [weak] {
+                    if (auto self = weak.lock()) {
+                        self->OnDeadline();
+                    }
+                });
+            });
+        ReadHeader();
+    }
+
+    // BodyReader and ResponseStream for stream routes. Only the handler coroutine calls these, on
+    // the session strand, while the session is otherwise idle.
+    boost::asio::awaitable<chmicro::Result<std::string_view>> Read() override {
+        auto& parser = *body_parser_;
+        if (continue_pending_ && !parser.is_done()) {
+            continue_pending_ = false;
+            if (!stream_started_) {
+                beast::error_code ec;
+                Arm(TimeoutReason::write, WriteBudget(kContinue.size()));
+                co_await boost::asio::async_write(stream_, boost::asio::buffer(kContinue.data(), kContinue.size()),
+                    boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+                Disarm();
+                if (ec) {
+                    co_return chmicro::Status(chmicro::StatusCode::unavailable, ec.message());
+                }
+            }
+        }
+        while (!parser.is_done()) {
+            parser.get().body().data = chunk_;
+            parser.get().body().size = chunk_size_;
+            beast::error_code ec;
+            auto waited_from = std::chrono::steady_clock::now();
+            Arm(TimeoutReason::body, options_.body_timeout);
+            co_await http::async_read(stream_, buffer_, parser, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+            Disarm();
+            body_wait_ += std::chrono::steady_clock::now() - waited_from;
+            if (ec == http::error::need_buffer) {
+                ec = {};
+            }
+            if (ec == http::error::body_limit) {
+                metrics_.Rejected(RejectReason::body_too_large);
+                co_return chmicro::Status(chmicro::StatusCode::invalid_argument, "request body too large");
+            }
+            if (ec) {
+                co_return chmicro::Status(chmicro::StatusCode::unavailable, ec.message());
+            }
+            auto n = chunk_size_ - parser.get().body().size;
+            body_bytes_ += n;
+            if (!parser.is_done() && BelowMinRate()) {
+                TimedOut(TimeoutReason::min_rate);
+                co_return chmicro::Status(chmicro::StatusCode::timeout, "request body below minimum transfer rate");
+            }
+            if (n > 0) {
+                co_return std::string_view(chunk_, n);
+            }
+        }
+        co_return std::string_view{};
+    }
+
+    bool Done() const override {
+        return !body_parser_ || body_parser_->is_done();
+    }
+
+    boost::asio::awaitable<chmicro::Status> Write(std::string_view data) override {
+        beast::error_code ec;
+        if (!stream_started_) {
+            stream_started_ = true;
+            const auto& req = *request_;
+            stream_chunked_ = req.raw.version() == 11 && StatusHasBody(response_->status);
+            std::pmr::string head(&arena_);
+            head.reserve(kHeadReserveBytes);
+            AppendResponseHead(head, req.raw.version(), *response_, req.trace, req.raw.keep_alive(),
+                stream_chunked_ ? BodyFraming::chunked : BodyFraming::close);
+            Arm(TimeoutReason::write, WriteBudget(head.size()));
+            co_await boost::asio::async_write(stream_, boost::asio::buffer(head.data(), head.size()),
+                boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+            Disarm();
+            if (ec) {
+                stream_failed_ = true;
+            }
+        }
+        if (stream_failed_) {
+            co_return chmicro::Status(chmicro::StatusCode::unavailable, ec ? ec.message() : "response stream closed");
+        }
+        if (data.empty() || !StatusHasBody(response_->status)) {
+            co_return chmicro::Status::Ok();
+        }
+
+        Arm(TimeoutReason::write, WriteBudget(data.size()));
+        if (stream_chunked_) {
+            std::array<char, 20> size_line;
+            auto res = std::to_chars(size_line.data(), size_line.data() + size_line.size() - 2, data.size(), 16);
+            *res.ptr++ = '\r';
+            *res.ptr++ = '\n';
+            std::array<boost::asio::const_buffer, 3> buffers{
+                boost::asio::const_buffer(size_line.data(), static_cast<std::size_t>(res.ptr - size_line.data())),
+                boost::asio::const_buffer(data.data(), data.size()),
+                boost::asio::const_buffer("\r\n", 2),
+            };
+            co_await boost::asio::async_write(stream_, buffers, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+        } else {
+            co_await boost::asio::async_write(stream_, boost::asio::buffer(data.data(), data.size()),
+                boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+        }
+        Disarm();
+        if (ec) {
+            stream_failed_ = true;
+            co_return chmicro::Status(chmicro::StatusCode::unavailable, ec.message());
+        }
+        co_return chmicro::Status::Ok();
+    }
+
+    bool Started() const override {
+        return stream_started_;
     }
 
 private:
-    void Read() {
-        req_ = {};
-        http::async_read(stream_, buffer_, req_,
-            beast::bind_front_handler(&HttpSession::OnRead, shared_from_this()));
+    // One serialized response waiting in the write batch.
+    struct Outgoing {
+        explicit Outgoing(std::pmr::memory_resource* mr) : head(mr), body(mr) {}
+
+        std::pmr::string head;
+        std::pmr::string body;
+        // File body, sent after the gather write; only ever the last entry of a batch.
+        std::shared_ptr<const File> file = nullptr;
+        std::uint64_t file_offset = 0;
+        std::uint64_t file_length = 0;
+    };
+
+    // Everything a write batch needs; allocated from arena_ and destroyed before it is reset.
+    struct Batch {
+        explicit Batch(std::pmr::memory_resource* mr) : outgoing(mr), buffers(mr) {}
+
+        std::pmr::vector<Outgoing> outgoing;
+        std::pmr::vector<boost::asio::const_buffer> buffers;
+    };
+
+    RequestParser& NewParser() {
+        Allocator alloc(&arena_);
+        auto& parser = parser_.emplace(std::piecewise_construct, std::make_tuple(alloc), std::make_tuple(alloc));
+        // Otherwise beast rejects a large Content-Length while parsing the header, before the
+        // route (which decides whether the body is buffered at all) is known. Not boost::none:
+        // Beast 1.74 compares Content-Length against the optional and treats none as exceeded.
+        parser.body_limit(kUnlimitedBody);
+        return parser;
+    }
+
+    // Feeds bytes already sitting in buffer_ to `parser` until it has the header, or the whole
+    // message when `whole_message` is set. Consumed bytes leave buffer_ even when more are needed,
+    // so a following async read resumes where this stopped.
+    template <class Parser>
+    Parsed PutBuffered(Parser& parser, bool whole_message) {
+        parser.eager(whole_message);
+        while (whole_message ? !parser.is_done() : !parser.is_header_done()) {
+            auto data = buffer_.data();
+            if (data.size() == 0) {
+                return Parsed::need_more;
+            }
+            beast::error_code ec;
+            auto n = parser.put(data, ec);
+            buffer_.consume(n);
+            if (ec == http::error::need_more || (!ec && n == 0)) {
+                return Parsed::need_more;
+            }
+            if (ec == http::error::body_limit) {
+                return Parsed::too_large;
+            }
+            if (ec) {
+                return Parsed::error;
+            }
+        }
+        return Parsed::done;
+    }
+
+    // Starts the next request. Only the header is read up front; how the body is read depends on
+    // the matched route.
+    void ReadHeader() {
+        NewParser();
+        if (buffer_.size() == 0) {
+            if (MayCloseIdle()) {
+                return DoClose();
+            }
+            // Idle until the first byte of the next request, then the header deadline applies.
+            idle_ = true;
+            Arm(TimeoutReason::idle, options_.idle_timeout);
+            stream_.async_read_some(buffer_.prepare(kReadBytes),
+                beast::bind_front_handler(&HttpSession::OnFirstBytes, shared_from_this()));
+            return;
+        }
+        ContinueHeader();
+    }
+
+    void OnFirstBytes(beast::error_code ec, std::size_t n) {
+        idle_ = false;
+        if (ec == boost::asio::error::eof) {
+            return DoClose();
+        }
+        if (ec) {
+            return;
+        }
+        buffer_.commit(n);
+        if (options_.http2 && !served_ && OnHttp2Preface()) {
+            return;
+        }
+        ContinueHeader();
+    }
+
+    // Prior-knowledge HTTP/2: the connection opens with the preface instead of a request line.
+    // Returns true once it has been handed over, or while the bytes so far could be either.
+    bool OnHttp2Preface() {
+        auto data = buffer_.data();
+        std::string_view head(static_cast<const char*>(data.data()), data.size());
+        auto n = std::min(head.size(), kHttp2Preface.size());
+        if (head.substr(0, n) != kHttp2Preface.substr(0, n)) {
+            return false;
+        }
+        if (n == kHttp2Preface.size()) {
+            StartHttp2({}, {});
+            return true;
+        }
+        // A lone "P" may still turn out to be POST.
+        Arm(TimeoutReason::header, options_.header_timeout);
+        stream_.async_read_some(buffer_.prepare(kReadBytes),
+            beast::bind_front_handler(&HttpSession::OnFirstBytes, shared_from_this()));
+        return true;
+    }
+
+    // "Upgrade: h2c" on the first request of a connection. Only bodyless requests are upgraded;
+    // the others are answered over HTTP/1.1 as if the header were absent.
+    bool UpgradeToHttp2() {
+        const auto& h = parser_->get();
+        if (h.version() != 11 || !parser_->is_done() ||
+            !http::token_list(h[http::field::upgrade]).exists("h2c")) {
+            return false;
+        }
+        auto encoded = h["HTTP2-Settings"];
+        std::string settings;
+        if (encoded.empty() || !DecodeBase64Url(std::string_view(encoded.data(), encoded.size()), settings)) {
+            return false;
+        }
+
+        // The request is answered on stream 1, so it is carried over as HTTP/2 fields.
+        std::vector<HeaderField> fields;
+        auto target = h.target();
+        auto method = h.method_string();
+        fields.push_back({":method", std::string(method.data(), method.size())});
+        fields.push_back({":scheme", "http"});
+        fields.push_back({":path", std::string(target.data(), target.size())});
+        for (const auto& f : h) {
+            auto name_view = f.name_string();
+            std::string name(name_view.data(), name_view.size());
+            std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+            auto value = f.value();
+            if (name == "host") {
+                fields.push_back({":authority", std::string(value.data(), value.size())});
+            } else if (name != "connection" && name != "upgrade" && name != "http2-settings" &&
+                name != "keep-alive" && name != "transfer-encoding" && name != "proxy-connection") {
+                fields.push_back({std::move(name), std::string(value.data(), value.size())});
+            }
+        }
+        parser_.reset();
+
+        static constexpr std::string_view kSwitching =
+            "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+        Arm(TimeoutReason::write, WriteBudget(kSwitching.size()));
+        boost::asio::async_write(stream_, boost::asio::buffer(kSwitching.data(), kSwitching.size()),
+            [self = shared_from_this(), fields = std::move(fields), settings = std::move(settings)](
+                beast::error_code ec, std::size_t) mutable {
+                if (!ec) {
+                    self->StartHttp2(std::move(fields), std::move(settings));
+                }
+            });
+        return true;
     }
 
-    void OnRead(beast::error_code ec, std::size_t) {
+    // Hands the socket and whatever it already delivered to an HTTP/2 session; this one ends.
+    void StartHttp2(std::vector<HeaderField> upgrade, std::string settings) {
+        Disarm();
+        detail::ServeHttp2(std::move(stream_), std::move(buffer_),
+            detail::ServerContext{owner_, router_, options_, connections_, wheel_, open_, draining_, metrics_},
+            std::move(upgrade), std::move(settings));
+    }
+
+    void ContinueHeader() {
+        Arm(TimeoutReason::header, options_.header_timeout);
+        switch (PutBuffered(*parser_, false)) {
+        case Parsed::done:
+            return OnHeader();
+        case Parsed::too_large:
+        case Parsed::error:
+            return DoClose();
+        case Parsed::need_more:
+            break;
+        }
+        http::async_read_header(stream_, buffer_, *parser_,
+            beast::bind_front_handler(&HttpSession::OnReadHeader, shared_from_this()));
+    }
+
+    void OnReadHeader(beast::error_code ec, std::size_t) {
         if (ec == http::error::end_of_stream) {
             return DoClose();
         }
         if (ec) {
             return;
         }
+        OnHeader();
+    }
+
+    void OnHeader() {
+        Disarm();
+        if (options_.http2 && !served_ && !head_admitted_ && UpgradeToHttp2()) {
+            return;
+        }
+        // A pipelined head may have been admitted already, before the previous batch was flushed.
+        if (!head_admitted_) {
+            MatchRoute();
+            if (!Admit()) {
+                return;
+            }
+        }
+        head_admitted_ = false;
+        if (route_ != nullptr && route_->is_stream()) {
+            return EnterBulkhead(&HttpSession::StartStream);
+        }
+        ReadBody();
+    }
+
+    void MatchRoute() {
+        start_ = std::chrono::steady_clock::now();
+        const auto& h = parser_->get();
+        auto target = h.target();
+        std::string_view path(target.data(), target.size());
+        route_ = router_.Match(h.method(), path.substr(0, path.find('?')), &params_);
+    }
+
+    std::uint64_t BodyLimit() const {
+        if (route_ != nullptr && route_->options.max_body_bytes != 0) {
+            return route_->options.max_body_bytes;
+        }
+        return route_ != nullptr && route_->is_stream() ? kUnlimitedBody : options_.max_body_bytes;
+    }
+
+    // Header-phase checks: the route's body limit, then the admission hook. Returns false once the
+    // request has been answered instead; its body, if any, is never read.
+    bool Admit() {
+        auto length = parser_->content_length();
+        if (length && *length > BodyLimit()) {
+            Reject(413, "{\"error\":\"request body too large\"}", RejectReason::body_too_large);
+            return false;
+        }
+        if (options_.admission) {
+            BeginExchange();
+            if (!options_.admission(*request_, route_, *response_)) {
+                Reject(0, {}, RejectReason::admission);
+                return false;
+            }
+        }
+        if (auto* controller = options_.admission_controller.get();
+            controller != nullptr && !(route_ != nullptr && route_->options.bypass_admission)) {
+            if (!controller->TryAcquire()) {
+                BeginExchange();
+                response_->headers["Retry-After"] = std::to_string(controller->RetryAfter().count());
+                Reject(503, "{\"error\":\"overloaded\"}", RejectReason::overload);
+                return false;
+            }
+            holds_slot_ = true;
+        }
+        continue_pending_ = !parser_->is_done() && parser_->get().version() == 11 &&
+            beast::iequals(parser_->get()[http::field::expect], "100-continue");
+        return true;
+    }
+
+    // Answers the request whose head is in parser_ without running its route. A status of 0 keeps
+    // what the admission hook put into response_.
+    void Reject(unsigned status, std::string_view body, RejectReason reason) {
+        metrics_.Rejected(reason);
+        BeginExchange();
+        if (status != 0) {
+            response_->status = status;
+            response_->content_type = "application/json; charset=utf-8";
+            response_->body = body;
+        }
+        // The unread body is still on the wire, so the connection cannot be reused.
+        force_close_ = parser_ && !parser_->is_done();
+        parser_.reset();
+        Respond();
+    }
+
+    // Buffers the whole body (string_body) for regular routes.
+    void ReadBody() {
+        parser_->body_limit(BodyLimit());
+        switch (PutBuffered(*parser_, true)) {
+        case Parsed::done:
+            return Dispatch();
+        case Parsed::too_large:
+            return Reject(413, "{\"error\":\"request body too large\"}", RejectReason::body_too_large);
+        case Parsed::error:
+            return DoClose();
+        case Parsed::need_more:
+            break;
+        }
+        body_wait_ = {};
+        body_bytes_ = 0;
+        if (continue_pending_) {
+            // The client holds the body back until it sees the interim response.
+            continue_pending_ = false;
+            Arm(TimeoutReason::write, WriteBudget(kContinue.size()));
+            return boost::asio::async_write(stream_, boost::asio::buffer(kContinue.data(), kContinue.size()),
+                [self = shared_from_this()](beast::error_code ec, std::size_t) {
+                    if (!ec) {
+                        self->ReadRestOfBody();
+                    }
+                });
+        }
+        ReadRestOfBody();
+    }
+
+    // Reads piece by piece so every read re-arms the body deadline and the rate can be checked.
+    void ReadRestOfBody() {
+        Arm(TimeoutReason::body, options_.body_timeout);
+        body_read_from_ = std::chrono::steady_clock::now();
+        http::async_read_some(stream_, buffer_, *parser_,
+            beast::bind_front_handler(&HttpSession::OnReadBody, shared_from_this()));
+    }
+
+    void OnReadBody(beast::error_code ec, std::size_t n) {
+        if (ec == http::error::body_limit) {
+            return Reject(413, "{\"error\":\"request body too large\"}", RejectReason::body_too_large);
+        }
+        if (ec) {
+            return;
+        }
+        if (!parser_->is_done()) {
+            body_wait_ += std::chrono::steady_clock::now() - body_read_from_;
+            body_bytes_ += n;
+            if (BelowMinRate()) {
+                return TimedOut(TimeoutReason::min_rate);
+            }
+            return ReadRestOfBody();
+        }
+        Disarm();
+        Dispatch();
+    }
+
+    // True once buffer_ holds a complete header block.
+    bool HeadBuffered() const {
+        auto data = buffer_.data();
+        std::string_view buffered(static_cast<const char*>(data.data()), data.size());
+        return buffered.find("\r\n\r\n") != std::string_view::npos;
+    }
+
+    // Runs the next pipelined request inline if it is already completely buffered. When only its
+    // header is, the parsed header stays in parser_ and OnWrite continues it after the flush.
+    bool DispatchBuffered() {
+        // Beast consumes the complete lines of a partial head, which would then be lost with the
+        // parser; such a head is left to ReadHeader after the flush.
+        if (!HeadBuffered()) {
+            return false;
+        }
+        NewParser();
+        switch (PutBuffered(*parser_, false)) {
+        case Parsed::need_more:
+            parser_.reset();
+            return false;
+        case Parsed::too_large:
+        case Parsed::error:
+            parser_.reset();
+            close_after_write_ = true;
+            return false;
+        case Parsed::done:
+            break;
+        }
+
+        MatchRoute();
+        if (!Admit()) {
+            // Answered; Respond() has already continued the pipeline or flushed.
+            return true;
+        }
+        // Whatever happens next, OnHeader must not run the checks again for this head.
+        head_admitted_ = true;
+        if (route_ != nullptr && route_->is_stream()) {
+            // Streams write to the socket directly, so earlier responses must go out first.
+            return false;
+        }
+        parser_->body_limit(BodyLimit());
+        switch (PutBuffered(*parser_, true)) {
+        case Parsed::done:
+            head_admitted_ = false;
+            Dispatch();
+            return true;
+        case Parsed::too_large:
+            head_admitted_ = false;
+            Reject(413, "{\"error\":\"request body too large\"}", RejectReason::body_too_large);
+            return true;
+        case Parsed::error:
+            head_admitted_ = false;
+            parser_.reset();
+            request_.reset();
+            response_.reset();
+            close_after_write_ = true;
+            return false;
+        case Parsed::need_more:
+            // Left for ReadBody after the flush.
+            return false;
+        }
+        return false;
+    }
 
-        auto start = std::chrono::steady_clock::now();
+    // Creates the request/response pair on the arena.
+    void NewExchange() {
+        request_.emplace(&arena_);
+        response_.emplace(&arena_);
+    }
 
-        Request req;
-        req.raw = std::move(req_);
-        auto target_sv = std::string_view(req.raw.target().data(), req.raw.target().size());
-        req.path = std::string(ExtractPath(target_sv));
-        ParseQuery(target_sv, req.query);
+    // Request with a copy of the head in parser_, for consumers that run before the body is read.
+    // No-op when it already exists.
+    void BeginExchange() {
+        if (request_) {
+            return;
+        }
+        NewExchange();
+        request_->raw.base() = parser_->get().base();
+        BindRequest();
+    }
+
+    // Call once request_->raw holds the parsed header.
+    void BindRequest() {
+        request_->BindTarget();
+        request_->params = params_;
 
         // traceparent
-        if (auto it = req.raw.find("traceparent"); it != req.raw.end()) {
-            req.trace = chmicro::TraceContext::ParseTraceParent({it->value().data(), it->value().size()});
+        if (auto tp = request_->Header("traceparent"); !tp.empty()) {
+            request_->trace = chmicro::TraceContext::ParseTraceParent(tp);
+        }
+        if (!request_->trace.valid()) {
+            request_->trace = chmicro::TraceContext::NewRoot();
+        }
+    }
+
+    void Dispatch() {
+        if (request_) {
+            // The head was copied for the admission hook; only the body is left to move.
+            request_->raw.body() = std::move(parser_->get().body());
+            parser_.reset();
+        } else {
+            // Same allocator on both sides, so this moves the message without copying.
+            NewExchange();
+            request_->raw = parser_->release();
+            parser_.reset();
+            BindRequest();
+        }
+        EnterBulkhead(&HttpSession::RunRoute);
+    }
+
+    // Runs `run` once the route's bulkhead, if any, has a slot for this request: right away, or
+    // from its queue. A full bulkhead or a wait past its max_wait is answered with 503.
+    void EnterBulkhead(void (HttpSession::*run)()) {
+        auto* bulkhead = route_ != nullptr ? route_->options.bulkhead.get() : nullptr;
+        if (bulkhead == nullptr) {
+            return (this->*run)();
         }
-        if (!req.trace.valid()) {
-            req.trace = chmicro::TraceContext::NewRoot();
+        auto entry = bulkhead->Acquire(
+            [self = shared_from_this(), run] {
+                boost::asio::post(self->stream_.get_executor(), [self, run] { self->OnBulkheadSlot(run); });
+            },
+            &bulkhead_ticket_);
+        switch (entry) {
+        case BulkheadEntry::admitted:
+            bulkhead_ = bulkhead;
+            return (this->*run)();
+        case BulkheadEntry::queued:
+            waiting_bulkhead_ = true;
+            if (bulkhead->MaxWait().count() != 0) {
+                WaitForBulkhead(bulkhead->MaxWait());
+            }
+            return;
+        case BulkheadEntry::rejected:
+            return RejectBulkhead(*bulkhead);
+        }
+    }
+
+    // A timer of its own: waits are short, and the wheel only notices a deadline moved earlier
+    // once it reaches the slot filed for the previous one.
+    void WaitForBulkhead(std::chrono::milliseconds max_wait) {
+        if (!bulkhead_timer_) {
+            bulkhead_timer_.emplace(stream_.get_executor());
+        }
+        bulkhead_timer_->expires_after(max_wait);
+        bulkhead_timer_->async_wait([self = shared_from_this()](beast::error_code ec) {
+            if (ec || !self->waiting_bulkhead_) {
+                return;
+            }
+            // Unless the slot is already on its way to OnBulkheadSlot.
+            auto& bulkhead = *self->route_->options.bulkhead;
+            if (bulkhead.Cancel(self->bulkhead_ticket_, true)) {
+                self->waiting_bulkhead_ = false;
+                self->RejectBulkhead(bulkhead);
+            }
+        });
+    }
+
+    void OnBulkheadSlot(void (HttpSession::*run)()) {
+        waiting_bulkhead_ = false;
+        if (bulkhead_timer_) {
+            bulkhead_timer_->cancel();
         }
+        bulkhead_ = route_->options.bulkhead.get();
+        (this->*run)();
+    }
 
-        Response resp;
-        router_.Handle(req, resp);
+    void RejectBulkhead(const Bulkhead& bulkhead) {
+        BeginExchange();
+        response_->headers["Retry-After"] = std::to_string(bulkhead.RetryAfter().count());
+        Reject(503, "{\"error\":\"overloaded\"}", RejectReason::bulkhead);
+    }
 
-        http::response<http::string_body> out{http::status(resp.status), req.raw.version()};
-        out.keep_alive(req.raw.keep_alive());
-        out.set(http::field::server, "chmicro/0.1");
-        out.set(http::field::content_type, resp.content_type);
-        out.set("traceparent", req.trace.ToTraceParent());
-        for (const auto& h : resp.headers) {
-            out.set(h.first, h.second);
+    void RunRoute() {
+        if (route_ != nullptr && route_->is_async()) {
+            return HandleAsync(route_);
+        }
+        if (route_ != nullptr && route_->options.execution == ExecutionPolicy::offload && options_.workers != nullptr) {
+            return Offload(route_);
         }
-        out.body() = std::move(resp.body);
-        out.prepare_payload();
 
-        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
         {
-            auto& hist = chmicro::DefaultMetrics().HistogramMetric(
-                "http_server_request_ms",
-                "HTTP server request latency (ms)",
-                {0.25, 0.5, 1, 2, 5, 10, 25, 50, 100},
-                MetricLabels{{{"path", req.path}}});
-            hist.Observe(elapsed);
-            chmicro::DefaultMetrics().CounterMetric(
-                "http_server_requests_total",
-                "HTTP server requests total",
-                MetricLabels{{{"path", req.path}, {"status", std::to_string(resp.status)}}})
-                .Inc(1);
+            InlineHandlerScope on_reactor;
+            router_.Handle(route_, *request_, *response_);
+        }
+        Respond();
+    }
+
+    void HandleAsync(const Route* route) {
+        // The coroutine runs on the session strand; the session stays idle until it completes.
+        auto self = shared_from_this();
+        boost::asio::co_spawn(stream_.get_executor(), router_.HandleAsync(route, *request_, *response_),
+            [self](std::exception_ptr e) {
+                if (e) {
+                    self->InternalError();
+                }
+                self->Respond();
+            });
+    }
+
+    void Offload(const Route* route) {
+        // The session is idle until the worker posts back, so the request, response and arena
+        // are only touched by one thread at a time.
+        auto self = shared_from_this();
+        bool queued = options_.workers->TrySubmit([self, route, enqueued = std::chrono::steady_clock::now()] {
+            if (self->holds_slot_) {
+                self->options_.admission_controller->OnQueueDelay(std::chrono::steady_clock::now() - enqueued);
+            }
+            self->router_.Handle(route, *self->request_, *self->response_);
+            boost::asio::post(self->stream_.get_executor(), [self] { self->Respond(); });
+        });
+        if (!queued) {
+            response_->status = 503;
+            response_->content_type = "application/json; charset=utf-8";
+            response_->body = "{\"error\":\"overloaded\"}";
+            Respond();
+        }
+    }
+
+    void StartStream() {
+        BeginExchange();
+
+        // Same parser state with a buffer_body: Read() pulls the body through chunk_.
+        body_parser_.emplace(std::move(*parser_));
+        parser_.reset();
+        body_parser_->body_limit(BodyLimit());
+        chunk_size_ = std::max<std::size_t>(options_.stream_chunk_bytes, 1);
+        chunk_ = static_cast<char*>(arena_.allocate(chunk_size_, 1));
+        stream_started_ = false;
+        stream_failed_ = false;
+        body_wait_ = {};
+        body_bytes_ = 0;
+
+        auto self = shared_from_this();
+        boost::asio::co_spawn(stream_.get_executor(), router_.HandleStream(route_, *request_, *this, *response_, *this),
+            [self](std::exception_ptr e) { self->FinishStream(e); });
+    }
+
+    void FinishStream(std::exception_ptr e) {
+        // Unread body bytes are still on the wire, so the connection cannot carry another request.
+        force_close_ = !body_parser_->is_done();
+        body_parser_.reset();
+        continue_pending_ = false;
+
+        if (!stream_started_) {
+            if (e) {
+                InternalError();
+            }
+            return Respond();
+        }
+
+        RecordRequest(response_->status);
+        // A bodyless status ended with its head; any other close-delimited body needs the close.
+        bool delimited = stream_chunked_ || !StatusHasBody(response_->status);
+        bool keep_alive = request_->raw.keep_alive() && delimited && !force_close_ && !Draining();
+        bool clean = !e && !stream_failed_;
+        response_.reset();
+        request_.reset();
+        force_close_ = false;
+
+        close_after_write_ = !(clean && keep_alive);
+        if (!clean || !stream_chunked_) {
+            // Closing ends a close-delimited body, or truncates a failed chunked one.
+            return OnWrite({}, 0);
+        }
+        static constexpr std::string_view kLastChunk = "0\r\n\r\n";
+        Arm(TimeoutReason::write, WriteBudget(kLastChunk.size()));
+        boost::asio::async_write(stream_, boost::asio::buffer(kLastChunk.data(), kLastChunk.size()),
+            beast::bind_front_handler(&HttpSession::OnWrite, shared_from_this()));
+    }
+
+    void InternalError() {
+        response_.emplace(&arena_);
+        response_->status = 500;
+        response_->content_type = "application/json; charset=utf-8";
+        response_->body = "{\"error\":\"internal\"}";
+    }
+
+    // Returns the admission slot taken by Admit() and the bulkhead slot, if any.
+    void ReleaseSlot() {
+        if (holds_slot_) {
+            holds_slot_ = false;
+            options_.admission_controller->Release(std::chrono::steady_clock::now() - start_);
         }
+        if (bulkhead_ != nullptr) {
+            std::exchange(bulkhead_, nullptr)->Release();
+        }
+    }
+
+    void RecordRequest(unsigned status) {
+        ReleaseSlot();
+        served_ = true;
+        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+        metrics_.Record(route_, status, elapsed);
+    }
+
+    // Serializes the current response into the write batch, then either runs the next pipelined
+    // request already in buffer_ or flushes the batch.
+    void Respond() {
+        const auto& req = *request_;
+        auto& resp = *response_;
+
+        bool keep_alive = req.raw.keep_alive() && !force_close_ && !Draining();
+        unsigned version = req.raw.version();
+        force_close_ = false;
+        continue_pending_ = false;
+
+        if (resp.file && req.raw.method() == http::verb::get) {
+            resp.ApplyRange(req.Header("Range"));
+        }
+        RecordRequest(resp.status);
+
+        if (!batch_) {
+            batch_.emplace(&arena_);
+        }
+        // The header block is emitted straight into the batch; the body moves over as-is and goes
+        // out as its own gather buffer.
+        auto& o = batch_->outgoing.emplace_back(&arena_);
+        o.head.reserve(kHeadReserveBytes);
+        AppendResponseHead(o.head, version, resp, req.trace, keep_alive);
+        if (!StatusHasBody(resp.status)) {
+            // A body here would be read as the start of the next response.
+        } else if (resp.file) {
+            o.file = std::move(resp.file);
+            o.file_offset = resp.file_offset;
+            o.file_length = resp.file_length;
+        } else {
+            o.body = std::move(resp.body);
+        }
+        close_after_write_ = !keep_alive;
+        bool has_file = static_cast<bool>(o.file);
 
-        auto sp = std::make_shared<http::response<http::string_body>>(std::move(out));
-        http::async_write(stream_, *sp,
-            beast::bind_front_handler(&HttpSession::OnWrite, shared_from_this(), sp->need_eof(), sp));
+        response_.reset();
+        request_.reset();
+
+        if (!close_after_write_ && !has_file && batch_->outgoing.size() < options_.max_pipeline_depth &&
+            arena_upstream_.bytes() < kArenaPipelineBytes && DispatchBuffered()) {
+            return;
+        }
+        Flush();
     }
 
-    void OnWrite(bool close, std::shared_ptr<void>, beast::error_code ec, std::size_t) {
+    // Writes every batched response with one gather write.
+    void Flush() {
+        auto& buffers = batch_->buffers;
+        buffers.reserve(batch_->outgoing.size() * 2);
+        std::size_t bytes = 0;
+        for (const auto& o : batch_->outgoing) {
+            buffers.emplace_back(o.head.data(), o.head.size());
+            if (!o.body.empty()) {
+                buffers.emplace_back(o.body.data(), o.body.size());
+            }
+            bytes += o.head.size() + o.body.size();
+        }
+        Arm(TimeoutReason::write, WriteBudget(bytes));
+        boost::asio::async_write(stream_, buffers,
+            beast::bind_front_handler(&HttpSession::OnWrite, shared_from_this()));
+    }
+
+    void OnWrite(beast::error_code ec, std::size_t) {
+        Disarm();
+        if (!ec && batch_ && !batch_->outgoing.empty() && batch_->outgoing.back().file) {
+            // Heads and string bodies are out; the file body follows.
+            return SendFile();
+        }
+
+        batch_.reset();
+        // A pipelined header parsed before the flush still lives on the arena; it is rewound
+        // after the next write instead. Respond() stops pipelining once the arena has grown past
+        // kArenaPipelineBytes, so a client that always keeps a head pending cannot defer that forever.
+        if (!parser_) {
+            arena_.release();
+        }
+
         if (ec) {
             return;
         }
-        if (close) {
+        if (close_after_write_) {
             return DoClose();
         }
-        Read();
+        if (parser_) {
+            return OnHeader();
+        }
+        ReadHeader();
+    }
+
+    void SendFile() {
+#if defined(__linux__)
+        if (options_.use_sendfile && !sendfile_unsupported_) {
+            return SendFileSome();
+        }
+#endif
+        SendFileCopy();
+    }
+
+    // The last batch entry finished sending its file.
+    void FileSent() {
+        batch_->outgoing.back().file.reset();
+        OnWrite({}, 0);
+    }
+
+#if defined(__linux__)
+    // One sendfile(2) call per writable event, so a large file does not monopolize the reactor.
+    void SendFileSome() {
+        auto& o = batch_->outgoing.back();
+        if (o.file_length == 0) {
+            return FileSent();
+        }
+
+        auto& socket = stream_.socket();
+        beast::error_code ec;
+        if (!socket.native_non_blocking()) {
+            socket.native_non_blocking(true, ec);
+            if (ec) {
+                return OnWrite(ec, 0);
+            }
+        }
+
+        auto offset = static_cast<off_t>(o.file_offset);
+        auto want = static_cast<std::size_t>(std::min<std::uint64_t>(o.file_length, kFileChunkBytes));
+        auto n = SendFileNoSignal(socket.native_handle(), o.file->fd(), &offset, want);
+        if (n > 0) {
+            o.file_offset += static_cast<std::uint64_t>(n);
+            o.file_length -= static_cast<std::uint64_t>(n);
+        } else if (n == 0) {
+            // The file shrank underneath us; the promised Content-Length cannot be met.
+            return OnWrite(boost::asio::error::eof, 0);
+        } else if (errno == EINVAL || errno == ENOSYS) {
+            // Not supported for this file or socket; mmap works everywhere sendfile does not.
+            sendfile_unsupported_ = true;
+            return SendFileCopy();
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            return OnWrite(beast::error_code(errno, boost::system::system_category()), 0);
+        }
+
+        if (o.file_length == 0) {
+            return FileSent();
+        }
+        Arm(TimeoutReason::write, WriteBudget(static_cast<std::size_t>(std::min<std::uint64_t>(o.file_length, kFileChunkBytes))));
+        socket.async_wait(tcp::socket::wait_write, [self = shared_from_this()](beast::error_code wait_ec) {
+            if (wait_ec) {
+                return self->OnWrite(wait_ec, 0);
+            }
+            self->SendFileSome();
+        });
+    }
+#endif
+
+    // Fallback without sendfile: the file goes out through a bounded window, mmap'd where
+    // available and read into the arena otherwise.
+    void SendFileCopy() {
+        auto& o = batch_->outgoing.back();
+        if (o.file_length == 0) {
+            return FileSent();
+        }
+        auto len = static_cast<std::size_t>(std::min<std::uint64_t>(o.file_length, kFileChunkBytes));
+
+#if defined(_WIN32)
+        if (copy_buffer_ == nullptr) {
+            copy_buffer_ = static_cast<char*>(arena_.allocate(kFileChunkBytes, 1));
+        }
+        auto n = o.file->ReadAt(o.file_offset, copy_buffer_, len);
+        if (n <= 0) {
+            return OnWrite(boost::asio::error::eof, 0);
+        }
+        auto data = boost::asio::buffer(copy_buffer_, static_cast<std::size_t>(n));
+        auto release = [] {};
+#else
+        static const auto kPage = static_cast<std::uint64_t>(::sysconf(_SC_PAGESIZE));
+        auto aligned = o.file_offset - o.file_offset % kPage;
+        auto delta = static_cast<std::size_t>(o.file_offset - aligned);
+        auto map_len = len + delta;
+        void* map = ::mmap(nullptr, map_len, PROT_READ, MAP_PRIVATE, o.file->fd(), static_cast<off_t>(aligned));
+        if (map == MAP_FAILED) {
+            return OnWrite(beast::error_code(errno, boost::system::system_category()), 0);
+        }
+        auto data = boost::asio::buffer(static_cast<const char*>(map) + delta, len);
+        auto release = [map, map_len] { ::munmap(map, map_len); };
+#endif
+
+        Arm(TimeoutReason::write, WriteBudget(len));
+        boost::asio::async_write(stream_, data,
+            [self = shared_from_this(), release](beast::error_code ec, std::size_t n) {
+                release();
+                if (ec) {
+                    return self->OnWrite(ec, 0);
+                }
+                auto& o = self->batch_->outgoing.back();
+                o.file_offset += n;
+                o.file_length -= n;
+                self->SendFileCopy();
+            });
     }
 
     void DoClose() {
+        Disarm();
         beast::error_code ec;
         stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
     }
 
+    // Deadlines. `reason` labels the timeout if this one expires; a zero timeout disables it.
+    void Arm(TimeoutReason reason, std::chrono::milliseconds timeout) {
+        if (timeout.count() == 0) {
+            return Disarm();
+        }
+        deadline_reason_ = reason;
+        deadline_->Arm(*wheel_, timeout);
+    }
+
+    void Disarm() {
+        deadline_->Disarm();
+    }
+
+    // Time allowed for writing `bytes`: write_timeout plus their transfer time at the minimum rate.
+    std::chrono::milliseconds WriteBudget(std::size_t bytes) const {
+        if (options_.write_timeout.count() == 0) {
+            return {};
+        }
+        auto extra = options_.min_transfer_rate == 0 ? 0 : bytes * 1000 / options_.min_transfer_rate;
+        return options_.write_timeout + std::chrono::milliseconds(extra);
+    }
+
+    // The request body has arrived slower than min_transfer_rate, counting only time the server
+    // spent waiting for it.
+    bool BelowMinRate() const {
+        if (options_.min_transfer_rate == 0 || body_wait_ < options_.min_rate_grace) {
+            return false;
+        }
+        auto waited_ms = std::chrono::duration_cast<std::chrono::milliseconds>(body_wait_).count();
+        return body_bytes_ * 1000 < options_.min_transfer_rate * static_cast<std::uint64_t>(waited_ms);
+    }
+
+    bool Draining() const {
+        return draining_.load(std::memory_order_relaxed);
+    }
+
+    // Draining, and this connection has had an answer. One that has not sent a request yet is
+    // still served: its client may already be sending one and could not tell a close from a failure.
+    bool MayCloseIdle() const {
+        return served_ && Draining();
+    }
+
+    void OnDeadline() {
+        if (idle_ && MayCloseIdle()) {
+            // Poked by Drain(): nothing in flight, close now rather than at the idle deadline.
+            Disarm();
+            beast::error_code ec;
+            stream_.socket().close(ec);
+            return;
+        }
+        // The deadline may have moved since the wheel saw it expire.
+        if (deadline_->Expired(*wheel_)) {
+            TimedOut(deadline_reason_);
+        }
+    }
+
+    // Closing the socket fails whatever operation is pending, which ends the session.
+    void TimedOut(TimeoutReason reason) {
+        Disarm();
+        metrics_.TimedOut(reason);
+        beast::error_code ec;
+        stream_.socket().close(ec);
+    }
+
 private:
+    static constexpr std::size_t kArenaInlineBytes = 8 * 1024;
+    // Past this much growth the pipeline is not continued inline, so the next write leaves no head
+    // pending on the arena and rewinds it.
+    static constexpr std::size_t kArenaPipelineBytes = 256 * 1024;
+    static constexpr std::size_t kHeadReserveBytes = 256;
+    static constexpr std::string_view kContinue = "HTTP/1.1 100 Continue\r\n\r\n";
+    // Read size while waiting for a new request.
+    static constexpr std::size_t kReadBytes = 4096;
+    static constexpr std::uint64_t kUnlimitedBody = std::numeric_limits<std::uint64_t>::max();
+    // Bytes per sendfile(2) call or copy window for file bodies.
+    static constexpr std::size_t kFileChunkBytes = 1024 * 1024;
+
     beast::tcp_stream stream_;
     beast::flat_buffer buffer_;
-    http::request<http::string_body> req_;
+    std::shared_ptr<const void> owner_;
     Router& router_;
+    const HttpServerOptions& options_;
+    chmicro::Gauge& connections_;
+    std::shared_ptr<chmicro::TimerWheel> wheel_;
+    std::shared_ptr<chmicro::TimerWheel::Deadline> deadline_;
+    TimeoutReason deadline_reason_ = TimeoutReason::idle;
+    std::atomic<std::size_t>& open_;
+    const std::atomic<bool>& draining_;
+    detail::RequestMetrics& metrics_;
+
+    // Per-connection arena: starts in the inline buffer, grows from the default resource when a
+    // batch needs more, and is rewound after every completed write that leaves no head pending.
+    std::array<std::byte, kArenaInlineBytes> arena_buffer_;
+    ArenaUpstream arena_upstream_;
+    std::pmr::monotonic_buffer_resource arena_;
+
+    // Declared after arena_ so they are destroyed before it.
+    std::optional<RequestParser> parser_;
+    std::optional<StreamParser> body_parser_;
+    std::optional<Request> request_;
+    std::optional<Response> response_;
+    std::optional<Batch> batch_;
+    const Route* route_ = nullptr;
+    // Captured by MatchRoute alongside route_, for the request built from the same head.
+    PathParams params_;
+    std::chrono::steady_clock::time_point start_;
+    bool close_after_write_ = false;
+    // The response must close the connection even if the request allowed keep-alive.
+    bool force_close_ = false;
+    // The head in parser_ passed Admit() before the previous batch was flushed.
+    bool head_admitted_ = false;
+    // "Expect: 100-continue" is owed before the body is read.
+    bool continue_pending_ = false;
+    // The current request holds an admission_controller slot.
+    bool holds_slot_ = false;
+    // Slot of the current request in its route's bulkhead.
+    Bulkhead* bulkhead_ = nullptr;
+    // Queued in the route's bulkhead under bulkhead_ticket_, until bulkhead_timer_ expires.
+    bool waiting_bulkhead_ = false;
+    Bulkhead::Ticket bulkhead_ticket_ = 0;
+    std::optional<boost::asio::steady_timer> bulkhead_timer_;
+    // Waiting for the first byte of a request.
+    bool idle_ = false;
+    // At least one response has been produced on this connection.
+    bool served_ = false;
+
+    // Request body progress, for min_transfer_rate.
+    std::chrono::steady_clock::duration body_wait_{};
+    std::chrono::steady_clock::time_point body_read_from_;
+    std::uint64_t body_bytes_ = 0;
+
+    // Stream route state.
+    char* chunk_ = nullptr; // chunk_size_ bytes on the arena
+    std::size_t chunk_size_ = 0;
+    bool stream_started_ = false;
+    bool stream_chunked_ = false;
+    bool stream_failed_ = false;
+
+    // File body state.
+    bool sendfile_unsupported_ = false;
+#if defined(_WIN32)
+    char* copy_buffer_ = nullptr; // kFileChunkBytes on the arena
+#endif
 };
 
 } // namespace
 
-std::string_view Request::Query(std::string_view key) const {
-    auto it = query.find(std::string(key));
-    if (it == query.end()) {
-        return {};
+namespace detail {
+
+RequestMetrics::RequestMetrics(const Router& router)
+    : latency_(chmicro::DefaultMetrics().LogLinearFamily(
+          "http_server_request_ms", "HTTP server request latency (ms)", {"path"})),
+      requests_(chmicro::DefaultMetrics().CounterFamily(
+          "http_server_requests_total", "HTTP server requests total", {"path", "status"}, CounterLayout::striped)) {
+    for (const auto* route : router.Routes()) {
+        auto series = std::make_unique<RouteSeries>();
+        series->label = route->path;
+        series->latency = &latency_.WithLabelValues({route->path});
+        routes_.emplace(route, std::move(series));
+    }
+    unmatched_.label = kUnmatched;
+    unmatched_.latency = &latency_.WithLabelValues({kUnmatched});
+
+    // In enum order.
+    constexpr std::array<std::string_view, 5> kRejectLabels{"body_too_large", "admission", "overload", "bulkhead", "streams"};
+    constexpr std::array<std::string_view, 5> kTimeoutLabels{"idle", "header", "body", "write", "min_rate"};
+    for (std::size_t i = 0; i < rejected_.size(); ++i) {
+        rejected_[i] = &chmicro::DefaultMetrics().CounterMetric("http_server_rejected_total",
+            "HTTP server requests answered before their body was read", MetricLabels{{{"reason", std::string(kRejectLabels[i])}}});
+    }
+    for (std::size_t i = 0; i < timeouts_.size(); ++i) {
+        timeouts_[i] = &chmicro::DefaultMetrics().CounterMetric("http_server_timeouts_total",
+            "HTTP server connections closed by a deadline", MetricLabels{{{"reason", std::string(kTimeoutLabels[i])}}});
     }
-    return it->second;
 }
 
-void Response::SetJson(std::string json) {
-    content_type = "application/json; charset=utf-8";
-    body = std::move(json);
+RequestMetrics::RouteSeries& RequestMetrics::Series(const Route* route) {
+    if (route == nullptr) {
+        return unmatched_;
+    }
+    auto it = routes_.find(route);
+    return it == routes_.end() ? unmatched_ : *it->second;
 }
 
-HttpServer::HttpServer(boost::asio::io_context& ioc, ListenAddress addr, Router router)
-    : ioc_(ioc), addr_(std::move(addr)), router_(std::move(router)), acceptor_(ioc) {}
+void RequestMetrics::Record(const Route* route, unsigned status, double elapsed_ms) {
+    auto& series = Series(route);
+    series.latency->Observe(elapsed_ms);
+    bool known = status >= kMinStatus && status <= kMaxStatus;
+    auto& slot = series.requests[known ? status - kMinStatus : series.requests.size() - 1];
+    auto* counter = slot.load(std::memory_order_acquire);
+    if (counter == nullptr) {
+        // Racing threads resolve the same child.
+        counter = &requests_.WithLabelValues({series.label, known ? std::to_string(status) : "other"});
+        slot.store(counter, std::memory_order_release);
+    }
+    counter->Inc();
+}
 
-void HttpServer::Start() {
-    bool expected = false;
-    if (!running_.compare_exchange_strong(expected, true)) {
-        return;
+} // namespace detail
+
+HttpServer::HttpServer(boost::asio::io_context& ioc, ListenAddress addr, Router router, HttpServerOptions options)
+    : contexts_{&ioc},
+      addr_(std::move(addr)),
+      router_(std::move(router)),
+      options_(std::move(options)),
+      metrics_(std::make_unique<detail::RequestMetrics>(router_)) {
+    connections_.push_back(&chmicro::DefaultMetrics().GaugeMetric(
+        "http_server_connections", "HTTP server open connections per IO context", MetricLabels{{{"context", "0"}}}));
+}
+
+HttpServer::HttpServer(chmicro::IoContextPool& pool, ListenAddress addr, Router router, HttpServerOptions options)
+    : addr_(std::move(addr)),
+      router_(std::move(router)),
+      options_(std::move(options)),
+      metrics_(std::make_unique<detail::RequestMetrics>(router_)) {
+    contexts_.reserve(pool.Size());
+    connections_.reserve(pool.Size());
+    for (std::size_t i = 0; i < pool.Size(); ++i) {
+        contexts_.push_back(&pool.At(i));
+        connections_.push_back(&chmicro::DefaultMetrics().GaugeMetric(
+            "http_server_connections", "HTTP server open connections per IO context", MetricLabels{{{"context", std::to_string(i)}}}));
     }
+}
 
+chmicro::Status HttpServer::OpenListener(Listener& l, const tcp::endpoint& endpoint, bool reuse_port) {
+    auto& acceptor = *l.acceptor;
     beast::error_code ec;
-    auto address = boost::asio::ip::make_address(addr_.host, ec);
+
+    acceptor.open(endpoint.protocol(), ec);
     if (ec) {
-        chmicro::log::error("invalid listen address {}: {}", addr_.host, ec.message());
-        return;
+        return chmicro::Status(chmicro::StatusCode::unavailable, "acceptor open failed: " + ec.message());
     }
-    tcp::endpoint endpoint{address, addr_.port};
 
-    acceptor_.open(endpoint.protocol(), ec);
+    acceptor.set_option(boost::asio::socket_base::reuse_address(true), ec);
     if (ec) {
-        chmicro::log::error("acceptor open failed: {}", ec.message());
-        return;
+        chmicro::log::warn("acceptor set_option failed: {}", ec.message());
+    }
+
+#if defined(SO_REUSEPORT)
+    if (reuse_port) {
+        acceptor.set_option(boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true), ec);
+        if (ec) {
+            return chmicro::Status(chmicro::StatusCode::unavailable, "acceptor SO_REUSEPORT failed: " + ec.message());
+        }
     }
+#else
+    (void)reuse_port;
+#endif
 
-    acceptor_.set_option(boost::asio::socket_base::reuse_address(true), ec);
+    acceptor.bind(endpoint, ec);
     if (ec) {
-        chmicro::log::warn("acceptor set_option failed: {}", ec.message());
+        return chmicro::Status(chmicro::StatusCode::unavailable, "acceptor bind failed: " + ec.message());
     }
 
-    acceptor_.bind(endpoint, ec);
+    acceptor.listen(boost::asio::socket_base::max_listen_connections, ec);
     if (ec) {
-        chmicro::log::error("acceptor bind failed: {}", ec.message());
-        return;
+        return chmicro::Status(chmicro::StatusCode::unavailable, "acceptor listen failed: " + ec.message());
+    }
+    return chmicro::Status::Ok();
+}
+
+chmicro::Status HttpServer::Start() {
+    bool expected = false;
+    if (!running_.compare_exchange_strong(expected, true)) {
+        return chmicro::Status::Ok();
+    }
+
+    wheels_.clear();
+    for (auto* ctx : contexts_) {
+        wheels_.push_back(std::make_shared<chmicro::TimerWheel>(*ctx, options_.timer_tick));
+        wheels_.back()->Start();
     }
 
-    acceptor_.listen(boost::asio::socket_base::max_listen_connections, ec);
+    listeners_.clear();
+    draining_.store(false, std::memory_order_relaxed);
+    auto inherited = std::move(inherited_);
+    inherited_.clear();
+
+    // Leaves the server stopped, with the listeners it did not take over closed.
+    auto fail = [&](std::size_t adopted, std::string message) {
+#ifndef _WIN32
+        for (std::size_t i = adopted; i < inherited.size(); ++i) {
+            ::close(inherited[i]);
+        }
+#else
+        (void)adopted;
+#endif
+        listeners_.clear();
+        for (auto& w : wheels_) {
+            w->Stop();
+        }
+        running_.store(false);
+        return chmicro::Status(chmicro::StatusCode::unavailable, std::move(message));
+    };
+
+    beast::error_code ec;
+    auto address = boost::asio::ip::make_address(addr_.host, ec);
     if (ec) {
-        chmicro::log::error("acceptor listen failed: {}", ec.message());
-        return;
+        return fail(0, "invalid listen address " + addr_.host + ": " + ec.message());
+    }
+    tcp::endpoint endpoint{address, addr_.port};
+
+    bool reuse_port = options_.reuse_port && contexts_.size() > 1;
+#if !defined(SO_REUSEPORT)
+    if (reuse_port) {
+        chmicro::log::warn("SO_REUSEPORT is not supported on this platform; using a single acceptor");
+        reuse_port = false;
     }
+#endif
 
-    chmicro::log::info("HTTP server listening on {}:{}", addr_.host, addr_.port);
-    DoAccept();
+    if (!inherited.empty()) {
+        // Sockets from a predecessor are already bound and listening; connections queued on them
+        // are accepted here as they would have been there.
+        bool spread = inherited.size() == contexts_.size() && contexts_.size() > 1;
+        for (std::size_t i = 0; i < inherited.size(); ++i) {
+            Listener l;
+            l.acceptor = std::make_unique<tcp::acceptor>(*contexts_[spread ? i : 0]);
+            l.context = spread ? i : (contexts_.size() > 1 ? kRoundRobin : 0);
+            l.acceptor->assign(endpoint.protocol(), inherited[i], ec);
+            if (ec) {
+                return fail(i, "inherited listener " + std::to_string(inherited[i]) + " unusable: " + ec.message());
+            }
+            listeners_.push_back(std::move(l));
+        }
+    } else {
+        // Either one SO_REUSEPORT acceptor per context, or a single acceptor on the first context
+        // that distributes sessions across all of them.
+        std::size_t count = reuse_port ? contexts_.size() : 1;
+        listeners_.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            Listener l;
+            l.acceptor = std::make_unique<tcp::acceptor>(*contexts_[i]);
+            l.context = reuse_port ? i : (contexts_.size() > 1 ? kRoundRobin : 0);
+            if (auto st = OpenListener(l, endpoint, reuse_port); !st.ok()) {
+                return fail(0, st.message());
+            }
+            listeners_.push_back(std::move(l));
+        }
+    }
+
+    chmicro::log::info("HTTP server listening on {}:{} (reactors={}, acceptors={}{})",
+        addr_.host, addr_.port, contexts_.size(), listeners_.size(), inherited.empty() ? "" : ", inherited");
+    for (std::size_t i = 0; i < listeners_.size(); ++i) {
+        DoAccept(i);
+    }
+    return chmicro::Status::Ok();
 }
 
 void HttpServer::Stop() {
@@ -215,23 +1476,83 @@ void HttpServer::Stop() {
     }
 
     beast::error_code ec;
-    acceptor_.cancel(ec);
-    acceptor_.close(ec);
+    for (auto& l : listeners_) {
+        l.acceptor->cancel(ec);
+        l.acceptor->close(ec);
+    }
+    for (auto& w : wheels_) {
+        w->Stop();
+    }
+}
+
+void HttpServer::Drain() {
+    if (!running_.load(std::memory_order_relaxed) || draining_.exchange(true)) {
+        return;
+    }
+    // Acceptors are not thread-safe; close each on its own reactor. With the sockets handed over,
+    // this only drops our reference and the successor keeps accepting.
+    for (auto& l : listeners_) {
+        boost::asio::post(l.acceptor->get_executor(), [self = shared_from_this(), acceptor = l.acceptor.get()] {
+            beast::error_code ec;
+            acceptor->close(ec);
+        });
+    }
+    // Every waiting keep-alive connection has an idle deadline on its reactor's wheel.
+    for (auto& w : wheels_) {
+        w->Poke();
+    }
+}
+
+std::size_t HttpServer::ActiveConnections() const {
+    return open_.load(std::memory_order_acquire);
+}
+
+std::vector<int> HttpServer::ListenerHandles() const {
+    std::vector<int> handles;
+#ifndef _WIN32
+    for (const auto& l : listeners_) {
+        if (l.acceptor->is_open()) {
+            handles.push_back(static_cast<int>(l.acceptor->native_handle()));
+        }
+    }
+#endif
+    return handles;
+}
+
+void HttpServer::InheritListeners(std::vector<int> handles) {
+    inherited_ = std::move(handles);
+}
+
+std::uint16_t HttpServer::LocalPort() const {
+    if (listeners_.empty()) {
+        return addr_.port;
+    }
+    beast::error_code ec;
+    auto endpoint = listeners_.front().acceptor->local_endpoint(ec);
+    return ec ? addr_.port : endpoint.port();
 }
 
-void HttpServer::DoAccept() {
-    acceptor_.async_accept(boost::asio::make_strand(ioc_),
-        [self = shared_from_this()](beast::error_code ec, tcp::socket socket) {
+void HttpServer::DoAccept(std::size_t listener) {
+    auto& l = listeners_[listener];
+    std::size_t ctx = l.context;
+    if (ctx == kRoundRobin) {
+        ctx = rr_.fetch_add(1, std::memory_order_relaxed) % contexts_.size();
+    }
+
+    // The socket is bound to the chosen context, so the session runs on that reactor.
+    l.acceptor->async_accept(boost::asio::make_strand(*contexts_[ctx]),
+        [self = shared_from_this(), listener, ctx](beast::error_code ec, tcp::socket socket) {
             if (ec) {
-                if (self->running_.load(std::memory_order_relaxed)) {
+                if (self->running_.load(std::memory_order_relaxed) && !self->draining_.load(std::memory_order_relaxed)) {
                     chmicro::log::warn("accept failed: {}", ec.message());
-                    self->DoAccept();
+                    self->DoAccept(listener);
                 }
                 return;
             }
 
-            std::make_shared<HttpSession>(std::move(socket), self->router_)->Run();
-            self->DoAccept();
+            std::make_shared<HttpSession>(std::move(socket), self, self->router_, self->options_, *self->connections_[ctx],
+                self->wheels_[ctx], self->open_, self->draining_, *self->metrics_)->Run();
+            self->DoAccept(listener);
         });
 }
 
@@ -0,0 +1,273 @@
+#include <chmicro/http/response_cache.h>
+
+#include <algorithm>
+
+namespace chmicro::http {
+namespace {
+
+// Bookkeeping charged to each entry on top of its key and data: list and map nodes, Entry itself.
+constexpr std::size_t kEntryOverhead = 128;
+
+} // namespace
+
+void ResponseCache::Entry::ApplyTo(Response& resp) const {
+    resp.status = status;
+    resp.file.reset();
+    std::string_view rest(data);
+    resp.content_type.assign(rest.substr(0, content_type_len));
+    rest.remove_prefix(content_type_len);
+    for (auto [name_len, value_len] : headers) {
+        std::pmr::string name(rest.substr(0, name_len), resp.headers.get_allocator().resource());
+        rest.remove_prefix(name_len);
+        resp.headers[std::move(name)].assign(rest.substr(0, value_len));
+        rest.remove_prefix(value_len);
+    }
+    resp.body.assign(rest);
+}
+
+ResponseCache::ResponseCache(ResponseCacheOptions opts)
+    : opts_(std::move(opts)),
+      hits_(DefaultMetrics().CounterMetric("http_cache_hits_total", "GET responses served from the response cache",
+          MetricLabels{{{"cache", opts_.name}}}, CounterLayout::striped)),
+      misses_(DefaultMetrics().CounterMetric("http_cache_misses_total", "Cacheable GETs that ran their handler",
+          MetricLabels{{{"cache", opts_.name}}}, CounterLayout::striped)),
+      coalesced_(DefaultMetrics().CounterMetric(
+          "http_cache_coalesced_total", "Cache misses answered by a concurrent handler run for the same key",
+          MetricLabels{{{"cache", opts_.name}}})),
+      stale_(DefaultMetrics().CounterMetric(
+          "http_cache_stale_total", "Cache misses on a reactor answered with the expired entry being refreshed",
+          MetricLabels{{{"cache", opts_.name}}})),
+      evictions_(DefaultMetrics().CounterMetric(
+          "http_cache_evictions_total", "Entries evicted to stay within the response cache budget",
+          MetricLabels{{{"cache", opts_.name}}})),
+      bytes_(DefaultMetrics().GaugeMetric(
+          "http_cache_bytes", "Bytes held by the response cache", MetricLabels{{{"cache", opts_.name}}})) {
+    opts_.shards = std::max<std::size_t>(opts_.shards, 1);
+    shard_budget_ = opts_.max_bytes / opts_.shards;
+    shards_.reserve(opts_.shards);
+    for (std::size_t i = 0; i < opts_.shards; ++i) {
+        shards_.push_back(std::make_unique<Shard>());
+    }
+    paths_.insert(opts_.paths.begin(), opts_.paths.end());
+}
+
+Middleware ResponseCache::AsMiddleware() {
+    return [this](const Request& req, Response& resp, Next next) { Serve(req, resp, next); };
+}
+
+bool ResponseCache::Cacheable(const Request& req) const {
+    if (req.raw.method() != boost::beast::http::verb::get) {
+        return false;
+    }
+    return paths_.empty() || paths_.find(req.path) != paths_.end();
+}
+
+ResponseCache::Shard& ResponseCache::ShardFor(std::string_view key) {
+    return *shards_[KeyHash{}(key) % shards_.size()];
+}
+
+void ResponseCache::Serve(const Request& req, Response& resp, const Next& next) {
+    if (!Cacheable(req)) {
+        next();
+        return;
+    }
+
+    std::string key = opts_.key ? opts_.key(req) : std::string(req.raw.target());
+    Shard& shard = ShardFor(key);
+    std::shared_ptr<const Entry> hit;
+    std::shared_ptr<const Entry> expired;
+    std::shared_ptr<Flight> flight;
+    bool leader = false;
+    {
+        std::lock_guard<std::mutex> lk(shard.mu);
+        if (auto it = shard.index.find(key); it != shard.index.end()) {
+            if (it->second->entry->expires > std::chrono::steady_clock::now()) {
+                hit = it->second->entry;
+                shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            } else {
+                expired = it->second->entry;
+                EraseLocked(shard, it->second);
+            }
+        }
+        if (!hit) {
+            auto [it, inserted] = shard.flights.try_emplace(key);
+            if (inserted) {
+                it->second = std::make_shared<Flight>();
+                it->second->stale = std::move(expired);
+            }
+            flight = it->second;
+            leader = inserted;
+        }
+    }
+
+    if (hit) {
+        hits_.Inc();
+        hit->ApplyTo(resp);
+        return;
+    }
+
+    if (!leader && InlineOnReactor()) {
+        // Waiting here would stall every connection of this reactor until the other run finishes.
+        if (flight->stale) {
+            stale_.Inc();
+            flight->stale->ApplyTo(resp);
+            return;
+        }
+        misses_.Inc();
+        next();
+        return;
+    }
+
+    if (!leader) {
+        std::shared_ptr<const Entry> shared;
+        {
+            std::unique_lock<std::mutex> lk(flight->mu);
+            flight->cv.wait_for(lk, opts_.coalesce_wait, [&] { return flight->done; });
+            shared = flight->entry;
+        }
+        if (shared) {
+            coalesced_.Inc();
+            shared->ApplyTo(resp);
+            return;
+        }
+        // The other run is slow or its response is not cacheable: answer this request directly.
+        misses_.Inc();
+        next();
+        return;
+    }
+
+    misses_.Inc();
+    // Headers set before the handler (e.g. request ids) belong to this request only.
+    std::vector<std::pair<std::string, std::string>> before;
+    before.reserve(resp.headers.size());
+    for (const auto& [name, value] : resp.headers) {
+        before.emplace_back(std::string(name), std::string(value));
+    }
+
+    try {
+        next();
+    } catch (...) {
+        Complete(shard, key, flight, nullptr);
+        throw;
+    }
+    Complete(shard, key, flight, Capture(resp, before));
+}
+
+std::shared_ptr<const ResponseCache::Entry> ResponseCache::Capture(
+    const Response& resp, const std::vector<std::pair<std::string, std::string>>& before) const {
+    if (resp.file || std::find(opts_.statuses.begin(), opts_.statuses.end(), resp.status) == opts_.statuses.end()) {
+        return nullptr;
+    }
+
+    auto entry = std::make_shared<Entry>();
+    entry->status = resp.status;
+    entry->content_type_len = resp.content_type.size();
+    std::size_t size = resp.content_type.size() + resp.body.size();
+    for (const auto& [name, value] : resp.headers) {
+        size += name.size() + value.size();
+    }
+    if (size > opts_.max_entry_bytes) {
+        return nullptr;
+    }
+
+    entry->data.reserve(size);
+    entry->data.append(resp.content_type);
+    for (const auto& [name, value] : resp.headers) {
+        bool preset = std::any_of(before.begin(), before.end(), [&](const auto& h) {
+            return std::string_view(h.first) == name && std::string_view(h.second) == value;
+        });
+        if (preset) {
+            continue;
+        }
+        entry->headers.emplace_back(static_cast<std::uint32_t>(name.size()), static_cast<std::uint32_t>(value.size()));
+        entry->data.append(name);
+        entry->data.append(value);
+    }
+    entry->data.append(resp.body);
+    entry->expires = std::chrono::steady_clock::now() + opts_.ttl;
+    return entry;
+}
+
+void ResponseCache::Complete(
+    Shard& shard, const std::string& key, const std::shared_ptr<Flight>& flight, std::shared_ptr<const Entry> entry) {
+    {
+        std::lock_guard<std::mutex> lk(shard.mu);
+        if (auto it = shard.flights.find(key); it != shard.flights.end() && it->second == flight) {
+            shard.flights.erase(it);
+        }
+        std::size_t bytes = entry ? key.size() + entry->data.size() + kEntryOverhead : 0;
+        if (entry && !flight->invalidated && bytes <= shard_budget_) {
+            if (auto it = shard.index.find(key); it != shard.index.end()) {
+                EraseLocked(shard, it->second);
+            }
+            shard.lru.push_front(Node{key, entry, bytes});
+            shard.index.emplace(key, shard.lru.begin());
+            shard.bytes += bytes;
+            bytes_.Add(static_cast<double>(bytes));
+            while (shard.bytes > shard_budget_) {
+                EraseLocked(shard, std::prev(shard.lru.end()));
+                evictions_.Inc();
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lk(flight->mu);
+        flight->done = true;
+        flight->entry = std::move(entry);
+    }
+    flight->cv.notify_all();
+}
+
+void ResponseCache::EraseLocked(Shard& shard, std::list<Node>::iterator it) {
+    shard.bytes -= it->bytes;
+    bytes_.Add(-static_cast<double>(it->bytes));
+    shard.index.erase(it->key);
+    shard.lru.erase(it);
+}
+
+void ResponseCache::Invalidate(std::string_view key) {
+    Shard& shard = ShardFor(key);
+    std::lock_guard<std::mutex> lk(shard.mu);
+    if (auto it = shard.index.find(key); it != shard.index.end()) {
+        EraseLocked(shard, it->second);
+    }
+    // A run that started before the write must not store what it read; later misses start afresh.
+    if (auto it = shard.flights.find(key); it != shard.flights.end()) {
+        it->second->invalidated = true;
+        shard.flights.erase(it);
+    }
+}
+
+void ResponseCache::Clear() {
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lk(shard->mu);
+        while (!shard->lru.empty()) {
+            EraseLocked(*shard, shard->lru.begin());
+        }
+        for (auto& [key, flight] : shard->flights) {
+            flight->invalidated = true;
+        }
+        shard->flights.clear();
+    }
+}
+
+std::size_t ResponseCache::Size() const {
+    std::size_t n = 0;
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lk(shard->mu);
+        n += shard->index.size();
+    }
+    return n;
+}
+
+std::size_t ResponseCache::Bytes() const {
+    std::size_t n = 0;
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lk(shard->mu);
+        n += shard->bytes;
+    }
+    return n;
+}
+
+} // namespace chmicro::http
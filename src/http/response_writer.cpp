@@ -0,0 +1,166 @@
+#include <chmicro/http/response_writer.h>
+
+#include <boost/beast/http/status.hpp>
+
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+
+namespace chmicro::http {
+namespace {
+
+constexpr unsigned kMinStatus = 100;
+constexpr unsigned kMaxStatus = 599;
+constexpr std::string_view kServerLine = "Server: chmicro/0.1\r\n";
+
+std::string BuildPrefix(unsigned version, unsigned status) {
+    std::string s(version == 10 ? "HTTP/1.0 " : "HTTP/1.1 ");
+    s += std::to_string(status);
+    s.push_back(' ');
+    auto reason = boost::beast::http::obsolete_reason(static_cast<boost::beast::http::status>(status));
+    s.append(reason.data(), reason.size());
+    s += "\r\n";
+    s += kServerLine;
+    return s;
+}
+
+struct PrefixTable {
+    PrefixTable() {
+        for (unsigned code = kMinStatus; code <= kMaxStatus; ++code) {
+            http10[code - kMinStatus] = BuildPrefix(10, code);
+            http11[code - kMinStatus] = BuildPrefix(11, code);
+        }
+    }
+
+    std::array<std::string, kMaxStatus - kMinStatus + 1> http10;
+    std::array<std::string, kMaxStatus - kMinStatus + 1> http11;
+};
+
+const PrefixTable& Prefixes() {
+    static const PrefixTable table;
+    return table;
+}
+
+// Content types the built-in handlers use, with their full header line.
+std::string_view KnownContentTypeLine(std::string_view type) {
+    if (type == "application/json; charset=utf-8") {
+        return "Content-Type: application/json; charset=utf-8\r\n";
+    }
+    if (type == "text/plain; charset=utf-8") {
+        return "Content-Type: text/plain; charset=utf-8\r\n";
+    }
+    if (type == "text/plain; version=0.0.4; charset=utf-8") {
+        return "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n";
+    }
+    return {};
+}
+
+void AppendField(std::pmr::string& out, std::string_view name, std::string_view value) {
+    out.append(name);
+    out.append(": ");
+    out.append(value);
+    out.append("\r\n");
+}
+
+} // namespace
+
+std::string HttpDate::Format(std::time_t t) {
+    static constexpr const char* kDays[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+    static constexpr const char* kMonths[] = {
+        "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+    std::tm tm{};
+#if defined(_WIN32)
+    gmtime_s(&tm, &t);
+#else
+    gmtime_r(&t, &tm);
+#endif
+    char buf[64];
+    int n = std::snprintf(buf, sizeof(buf), "Date: %s, %02d %s %04d %02d:%02d:%02d GMT\r\n",
+        kDays[tm.tm_wday], tm.tm_mday, kMonths[tm.tm_mon], tm.tm_year + 1900, tm.tm_hour, tm.tm_min, tm.tm_sec);
+    return std::string(buf, n > 0 ? static_cast<std::size_t>(n) : 0);
+}
+
+std::string_view HttpDate::Line() {
+    struct Cache {
+        std::time_t second = -1;
+        std::string line;
+    };
+    thread_local Cache cache;
+
+    auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    if (now != cache.second) {
+        cache.second = now;
+        cache.line = Format(now);
+    }
+    return cache.line;
+}
+
+std::string_view StatusPrefix(unsigned version, unsigned status) {
+    if (status < kMinStatus || status > kMaxStatus) {
+        status = 500;
+    }
+    const auto& table = Prefixes();
+    return version == 10 ? table.http10[status - kMinStatus] : table.http11[status - kMinStatus];
+}
+
+bool StatusHasBody(unsigned status) {
+    return status >= 200 && status != 204 && status != 304;
+}
+
+void AppendResponseHead(
+    std::pmr::string& out,
+    unsigned version,
+    const Response& resp,
+    const chmicro::TraceContext& trace,
+    bool keep_alive,
+    BodyFraming framing) {
+    out.append(StatusPrefix(version, resp.status));
+    out.append(HttpDate::Line());
+
+    if (!resp.content_type.empty()) {
+        if (auto line = KnownContentTypeLine(resp.content_type); !line.empty()) {
+            out.append(line);
+        } else {
+            AppendField(out, "Content-Type", resp.content_type);
+        }
+    }
+
+    if (trace.valid()) {
+        out.append("traceparent: 00-");
+        out.append(trace.trace_id);
+        out.push_back('-');
+        out.append(trace.span_id);
+        out.push_back('-');
+        out.append(trace.flags);
+        out.append("\r\n");
+    }
+
+    for (const auto& h : resp.headers) {
+        AppendField(out, h.first, h.second);
+    }
+
+    if (!StatusHasBody(resp.status)) {
+        // The message ends here whatever the framing, so the connection can stay open.
+    } else if (framing == BodyFraming::content_length) {
+        char len[24];
+        auto res = std::to_chars(len, len + sizeof(len), resp.BodySize());
+        out.append("Content-Length: ");
+        out.append(len, static_cast<std::size_t>(res.ptr - len));
+        out.append("\r\n");
+    } else if (framing == BodyFraming::chunked) {
+        out.append("Transfer-Encoding: chunked\r\n");
+    } else {
+        keep_alive = false;
+    }
+
+    if (version == 10 && keep_alive) {
+        out.append("Connection: keep-alive\r\n");
+    } else if (version == 11 && !keep_alive) {
+        out.append("Connection: close\r\n");
+    }
+    out.append("\r\n");
+}
+
+} // namespace chmicro::http
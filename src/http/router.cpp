@@ -2,47 +2,470 @@
 
 #include <boost/functional/hash.hpp>
 
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <type_traits>
+
 namespace chmicro::http {
+namespace {
+
+// A relative path that cannot leave the directory it is joined to.
+bool IsSafeRelativePath(std::string_view rel) {
+    if (rel.empty() || rel.front() == '/') {
+        return false;
+    }
+    while (!rel.empty()) {
+        auto slash = rel.find('/');
+        auto segment = rel.substr(0, slash);
+        if (segment.empty() || segment == "." || segment == ".." ||
+            segment.find('\\') != std::string_view::npos || segment.find('\0') != std::string_view::npos) {
+            return false;
+        }
+        if (slash == std::string_view::npos) {
+            break;
+        }
+        rel.remove_prefix(slash + 1);
+    }
+    return true;
+}
+
+// One piece of a route pattern: literal text, or the name of a "{param}" / "*wildcard" segment.
+struct PatternPiece {
+    enum class Kind { literal, param, wildcard } kind;
+    std::string_view text;
+};
+
+std::vector<PatternPiece> ParsePattern(std::string_view path) {
+    std::vector<PatternPiece> pieces;
+    std::size_t literal_start = 0;
+    std::size_t params = 0;
+    std::size_t pos = 0;
+    while (true) {
+        auto end = std::min(path.find('/', pos), path.size());
+        auto segment = path.substr(pos, end - pos);
+        bool param = !segment.empty() && segment.front() == '{';
+        bool wildcard = !segment.empty() && segment.front() == '*';
+        if (param || wildcard) {
+            auto name = param ? segment.substr(1, segment.size() - 2) : segment.substr(1);
+            if ((param && segment.back() != '}') || name.empty() || name.find_first_of("{}*") != std::string_view::npos) {
+                throw std::invalid_argument("malformed route parameter in " + std::string(path));
+            }
+            if (wildcard && end != path.size()) {
+                throw std::invalid_argument("route wildcard must be the last segment in " + std::string(path));
+            }
+            if (++params > PathParams::kMax) {
+                throw std::invalid_argument("too many route parameters in " + std::string(path));
+            }
+            if (pos > literal_start) {
+                pieces.push_back({PatternPiece::Kind::literal, path.substr(literal_start, pos - literal_start)});
+            }
+            pieces.push_back({param ? PatternPiece::Kind::param : PatternPiece::Kind::wildcard, name});
+            literal_start = end;
+        } else if (segment.find_first_of("{}") != std::string_view::npos) {
+            throw std::invalid_argument("route parameter must span a whole segment in " + std::string(path));
+        }
+        if (end == path.size()) {
+            break;
+        }
+        pos = end + 1;
+    }
+    if (literal_start < path.size()) {
+        pieces.push_back({PatternPiece::Kind::literal, path.substr(literal_start)});
+    }
+    return pieces;
+}
+
+} // namespace
+
+struct Router::Node {
+    std::string prefix;  // literal bytes matched on the way into this node
+    std::string indices; // first byte of each of `children`
+    std::vector<std::unique_ptr<Node>> children;
+    std::unique_ptr<Node> param;    // "{name}": one non-empty segment
+    std::unique_ptr<Node> wildcard; // "*name": the rest of the path
+    const Route* route = nullptr;
+};
+
+struct Router::Tree {
+    boost::beast::http::verb method;
+    Node root;
+    // Without parameter routes the exact lookup in routes_ already had the only possible answer.
+    bool has_params = false;
+};
+
+namespace {
+
+// Offset and length of a captured segment.
+using Capture = std::pair<std::uint32_t, std::uint32_t>;
+
+thread_local bool t_inline_on_reactor = false;
+
+} // namespace
+
+InlineHandlerScope::InlineHandlerScope() : outer_(t_inline_on_reactor) {
+    t_inline_on_reactor = true;
+}
+
+InlineHandlerScope::~InlineHandlerScope() {
+    t_inline_on_reactor = outer_;
+}
+
+bool InlineOnReactor() {
+    return t_inline_on_reactor;
+}
+
+Router::Router() = default;
+Router::~Router() = default;
+Router::Router(Router&&) noexcept = default;
+Router& Router::operator=(Router&&) noexcept = default;
+
+Router::Router(const Router& o) : middleware_(o.middleware_), routes_(o.routes_), prefix_routes_(o.prefix_routes_) {
+    for (const auto& [key, route] : routes_) {
+        Index(route);
+    }
+}
+
+Router& Router::operator=(const Router& o) {
+    if (this != &o) {
+        Router copy(o);
+        *this = std::move(copy);
+    }
+    return *this;
+}
 
-std::size_t Router::RouteKeyHash::operator()(const RouteKey& k) const {
+std::size_t Router::RouteKeyHash::operator()(const RouteKeyView& k) const {
     std::size_t seed = 0;
     boost::hash_combine(seed, static_cast<unsigned>(k.method));
-    boost::hash_combine(seed, k.path);
+    boost::hash_combine(seed, std::hash<std::string_view>{}(k.path));
     return seed;
 }
 
+void Next::operator()() const {
+    if (remaining_ == 0) {
+        terminal_fn_(terminal_);
+        return;
+    }
+    (**chain_)(*req_, *resp_, Next(chain_ + 1, remaining_ - 1, *req_, *resp_, terminal_, terminal_fn_));
+}
+
 void Router::Use(Middleware mw) {
-    middleware_.push_back(std::move(mw));
+    Use(std::string(), std::move(mw));
+}
+
+void Router::Use(std::string name, Middleware mw) {
+    middleware_.push_back(NamedMiddleware{std::move(name), std::make_shared<const Middleware>(std::move(mw))});
+    for (auto& [key, route] : routes_) {
+        Flatten(route);
+    }
+    for (auto& route : prefix_routes_) {
+        Flatten(route);
+    }
+}
+
+void Router::Flatten(Route& route) const {
+    route.chain.clear();
+    const auto& skip = route.options.skip_middleware;
+    for (const auto& mw : middleware_) {
+        if (mw.name.empty() || std::find(skip.begin(), skip.end(), mw.name) == skip.end()) {
+            route.chain.push_back(mw.fn);
+        }
+    }
+    for (const auto& mw : route.options.middleware) {
+        route.chain.push_back(std::make_shared<const Middleware>(mw));
+    }
+}
+
+void Router::Insert(Route route) {
+    for (const auto& piece : ParsePattern(route.path)) {
+        if (piece.kind != PatternPiece::Kind::literal) {
+            route.params.emplace_back(piece.text);
+        }
+    }
+    Flatten(route);
+    RouteKey key{route.method, route.path};
+    auto [it, inserted] = routes_.insert_or_assign(std::move(key), std::move(route));
+    Index(it->second);
+}
+
+void Router::Index(const Route& route) {
+    auto tree = std::find_if(trees_.begin(), trees_.end(), [&](const auto& t) { return t->method == route.method; });
+    if (tree == trees_.end()) {
+        trees_.push_back(std::make_unique<Tree>());
+        trees_.back()->method = route.method;
+        tree = std::prev(trees_.end());
+    }
+
+    if (!route.params.empty()) {
+        (*tree)->has_params = true;
+    }
+    Node* n = &(*tree)->root;
+    for (const auto& piece : ParsePattern(route.path)) {
+        if (piece.kind == PatternPiece::Kind::param || piece.kind == PatternPiece::Kind::wildcard) {
+            auto& next = piece.kind == PatternPiece::Kind::param ? n->param : n->wildcard;
+            if (!next) {
+                next = std::make_unique<Node>();
+            }
+            n = next.get();
+            continue;
+        }
+        std::string_view text = piece.text;
+        while (!text.empty()) {
+            auto i = n->indices.find(text.front());
+            if (i == std::string::npos) {
+                auto child = std::make_unique<Node>();
+                child->prefix = std::string(text);
+                n->indices.push_back(text.front());
+                n->children.push_back(std::move(child));
+                n = n->children.back().get();
+                break;
+            }
+            Node* child = n->children[i].get();
+            std::size_t common = 0;
+            while (common < child->prefix.size() && common < text.size() && child->prefix[common] == text[common]) {
+                ++common;
+            }
+            if (common < child->prefix.size()) {
+                // Split: the shared part becomes a new node above the existing child.
+                auto mid = std::make_unique<Node>();
+                mid->prefix = child->prefix.substr(0, common);
+                child->prefix.erase(0, common);
+                mid->indices.push_back(child->prefix.front());
+                mid->children.push_back(std::move(n->children[i]));
+                n->children[i] = std::move(mid);
+                child = n->children[i].get();
+            }
+            n = child;
+            text.remove_prefix(common);
+        }
+    }
+
+    // A pattern differing only in parameter names takes over the node.
+    if (n->route != nullptr && n->route != &route) {
+        routes_.erase(RouteKey{n->route->method, n->route->path});
+    }
+    n->route = &route;
+}
+
+void Router::AddRoute(boost::beast::http::verb method, std::string path, Handler handler, RouteOptions options) {
+    Insert(Route{method, std::move(path), std::move(handler), nullptr, nullptr, std::move(options), {}, {}});
+}
+
+void Router::AddAsyncRoute(boost::beast::http::verb method, std::string path, AsyncHandler handler, RouteOptions options) {
+    Insert(Route{method, std::move(path), nullptr, std::move(handler), nullptr, std::move(options), {}, {}});
+}
+
+void Router::AddStreamRoute(boost::beast::http::verb method, std::string path, StreamHandler handler, RouteOptions options) {
+    Insert(Route{method, std::move(path), nullptr, nullptr, std::move(handler), std::move(options), {}, {}});
+}
+
+void Router::AddPrefixRoute(boost::beast::http::verb method, std::string prefix, Handler handler, RouteOptions options) {
+    auto it = std::find_if(prefix_routes_.begin(), prefix_routes_.end(), [&](const Route& r) {
+        return r.method == method && r.path == prefix;
+    });
+    Route route{method, std::move(prefix), std::move(handler), nullptr, nullptr, std::move(options), {}, {}};
+    Flatten(route);
+    if (it != prefix_routes_.end()) {
+        *it = std::move(route);
+        return;
+    }
+    prefix_routes_.push_back(std::move(route));
+    std::stable_sort(prefix_routes_.begin(), prefix_routes_.end(), [](const Route& a, const Route& b) {
+        return a.path.size() > b.path.size();
+    });
+}
+
+void Router::Static(std::string prefix, std::string dir, RouteOptions options) {
+    while (dir.size() > 1 && dir.back() == '/') {
+        dir.pop_back();
+    }
+    auto prefix_len = prefix.size();
+    AddPrefixRoute(boost::beast::http::verb::get, std::move(prefix), [prefix_len, dir = std::move(dir)](const Request& req, Response& resp) {
+        auto rel = req.path.substr(prefix_len);
+        if (!IsSafeRelativePath(rel)) {
+            return NotFound(resp);
+        }
+        auto file = File::Open(dir + "/" + std::string(rel));
+        if (!file.ok()) {
+            return NotFound(resp);
+        }
+        resp.status = 200;
+        resp.content_type = ContentTypeForPath(rel);
+        resp.SetFile(std::move(file).value());
+    }, options);
+}
+
+namespace {
+
+// Walks `node`, whose prefix has been matched up to `pos`. Literal children are tried first, then
+// a "{param}" child, then a "*wildcard" child, backtracking on dead ends.
+template <class Node>
+const Route* Find(const Node* node, std::string_view path, std::size_t pos, std::array<Capture, PathParams::kMax>& caps,
+    std::size_t depth, std::size_t& count) {
+    while (true) {
+        const Node& n = *node;
+        if (pos == path.size() && n.route != nullptr) {
+            count = depth;
+            return n.route;
+        }
+        if (pos < path.size()) {
+            const Node* child = nullptr;
+            for (std::size_t i = 0; i < n.indices.size(); ++i) {
+                if (n.indices[i] == path[pos]) {
+                    child = n.children[i].get();
+                    break;
+                }
+            }
+            if (child != nullptr && path.compare(pos, child->prefix.size(), child->prefix) == 0) {
+                if (!n.param && !n.wildcard) {
+                    // Nothing to fall back to here, so descend without recursing.
+                    node = child;
+                    pos += child->prefix.size();
+                    continue;
+                }
+                if (auto r = Find(child, path, pos + child->prefix.size(), caps, depth, count)) {
+                    return r;
+                }
+            }
+            if (n.param && depth < caps.size()) {
+                auto end = std::min(path.find('/', pos), path.size());
+                if (end > pos) {
+                    caps[depth] = {static_cast<std::uint32_t>(pos), static_cast<std::uint32_t>(end - pos)};
+                    if (auto r = Find(n.param.get(), path, end, caps, depth + 1, count)) {
+                        return r;
+                    }
+                }
+            }
+        }
+        if (n.wildcard && n.wildcard->route != nullptr && depth < caps.size()) {
+            caps[depth] = {static_cast<std::uint32_t>(pos), static_cast<std::uint32_t>(path.size() - pos)};
+            count = depth + 1;
+            return n.wildcard->route;
+        }
+        return nullptr;
+    }
+}
+
+} // namespace
+
+std::vector<const Route*> Router::Routes() const {
+    std::vector<const Route*> out;
+    out.reserve(routes_.size() + prefix_routes_.size());
+    for (const auto& [key, route] : routes_) {
+        out.push_back(&route);
+    }
+    for (const auto& route : prefix_routes_) {
+        out.push_back(&route);
+    }
+    return out;
 }
 
-void Router::AddRoute(boost::beast::http::verb method, std::string path, Handler handler) {
-    routes_[RouteKey{method, std::move(path)}] = std::move(handler);
+const Route* Router::Match(boost::beast::http::verb method, std::string_view path, PathParams* params) const {
+    // A literal route matching the whole path is what the tree walk would find first.
+    if (auto it = routes_.find(RouteKeyView{method, path}); it != routes_.end() && it->second.params.empty()) {
+        if (params != nullptr) {
+            params->count = 0;
+        }
+        return &it->second;
+    }
+    for (const auto& tree : trees_) {
+        if (tree->method != method || !tree->has_params) {
+            continue;
+        }
+        std::array<Capture, PathParams::kMax> caps;
+        std::size_t count = 0;
+        if (auto r = Find(&tree->root, path, 0, caps, 0, count)) {
+            if (params != nullptr) {
+                params->count = count;
+                for (std::size_t i = 0; i < count; ++i) {
+                    params->slots[i] = PathParams::Slot{r->params[i], caps[i].first, caps[i].second};
+                }
+            }
+            return r;
+        }
+        break;
+    }
+    for (const auto& r : prefix_routes_) {
+        if (r.method == method && path.substr(0, r.path.size()) == r.path) {
+            return &r;
+        }
+    }
+    return nullptr;
 }
 
-void Router::Handle(const Request& req, Response& resp) const {
-    auto it = routes_.find(RouteKey{req.raw.method(), req.path});
-    if (it == routes_.end()) {
-        resp.status = 404;
+void Router::NotFound(Response& resp) {
+    resp.status = 404;
+    resp.content_type = "application/json; charset=utf-8";
+    resp.body = "{\"error\":\"not_found\"}";
+}
+
+template <class Terminal>
+void Router::RunMiddleware(const Route& route, const Request& req, Response& resp, Terminal&& terminal) {
+    if (route.chain.empty()) {
+        terminal();
+        return;
+    }
+    using T = std::remove_reference_t<Terminal>;
+    Next(route.chain.data(), route.chain.size(), req, resp, const_cast<void*>(static_cast<const void*>(&terminal)),
+        [](void* t) { (*static_cast<T*>(t))(); })();
+}
+
+void Router::Handle(Request& req, Response& resp) const {
+    Handle(Match(req.raw.method(), req.path, &req.params), req, resp);
+}
+
+void Router::Handle(const Route* route, const Request& req, Response& resp) const {
+    if (route == nullptr) {
+        return NotFound(resp);
+    }
+
+    if (route->is_async()) {
+        resp.status = 500;
         resp.content_type = "application/json; charset=utf-8";
-        resp.body = "{\"error\":\"not_found\"}";
+        resp.body = "{\"error\":\"async route requires HandleAsync\"}";
+        return;
+    }
+    if (route->is_stream()) {
+        resp.status = 500;
+        resp.content_type = "application/json; charset=utf-8";
+        resp.body = "{\"error\":\"stream route requires HandleStream\"}";
         return;
     }
 
-    const auto& handler = it->second;
+    RunMiddleware(*route, req, resp, [&] { route->handler(req, resp); });
+}
 
-    // Build middleware chain.
-    std::size_t idx = 0;
-    std::function<void()> run;
-    run = [&]() {
-        if (idx < middleware_.size()) {
-            auto& mw = middleware_[idx++];
-            mw(req, resp, run);
-            return;
+boost::asio::awaitable<void> Router::HandleAsync(const Route* route, const Request& req, Response& resp) const {
+    // Coroutine routes run on the reactor; so does their middleware, up to the first co_await.
+    bool reached = false;
+    {
+        InlineHandlerScope on_reactor;
+        if (route == nullptr || !route->is_async()) {
+            Handle(route, req, resp);
+            co_return;
         }
-        handler(req, resp);
-    };
+        RunMiddleware(*route, req, resp, [&] { reached = true; });
+    }
+    if (reached) {
+        co_await route->async_handler(req, resp);
+    }
+}
 
-    run();
+boost::asio::awaitable<void> Router::HandleStream(
+    const Route* route, const Request& req, BodyReader& body, Response& resp, ResponseStream& out) const {
+    if (route == nullptr || !route->is_stream()) {
+        co_await HandleAsync(route, req, resp);
+        co_return;
+    }
+
+    bool reached = false;
+    {
+        InlineHandlerScope on_reactor;
+        RunMiddleware(*route, req, resp, [&] { reached = true; });
+    }
+    if (reached) {
+        co_await route->stream_handler(req, body, resp, out);
+    }
 }
 
 } // namespace chmicro::http
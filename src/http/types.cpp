@@ -0,0 +1,177 @@
+#include <chmicro/http/types.h>
+
+namespace chmicro::http {
+namespace {
+
+std::string_view TargetOf(const RawRequest& raw) {
+    auto t = raw.target();
+    return std::string_view(t.data(), t.size());
+}
+
+} // namespace
+
+Request::Request(std::pmr::memory_resource* mr)
+    : raw(std::piecewise_construct, std::make_tuple(Allocator(mr)), std::make_tuple(Allocator(mr))) {}
+
+Request::Request(const Request& o) : raw(o.raw), trace(o.trace), params(o.params) {
+    Rebind(o);
+}
+
+Request::Request(Request&& o) noexcept : raw(std::move(o.raw)), trace(std::move(o.trace)), params(o.params) {
+    Rebind(o);
+}
+
+Request& Request::operator=(const Request& o) {
+    if (this != &o) {
+        raw = o.raw;
+        trace = o.trace;
+        params = o.params;
+        Rebind(o);
+    }
+    return *this;
+}
+
+Request& Request::operator=(Request&& o) noexcept {
+    if (this != &o) {
+        raw = std::move(o.raw);
+        trace = std::move(o.trace);
+        params = o.params;
+        Rebind(o);
+    }
+    return *this;
+}
+
+void Request::Rebind(const Request& from) {
+    query_parsed_ = false;
+    query_count_ = 0;
+    query_overflow_.clear();
+    if (from.bound_) {
+        BindTarget();
+    } else {
+        bound_ = false;
+        path = from.path;
+    }
+}
+
+void Request::BindTarget() {
+    auto target = TargetOf(raw);
+    path = target.substr(0, target.find('?'));
+    bound_ = true;
+    query_parsed_ = false;
+    query_count_ = 0;
+    query_overflow_.clear();
+}
+
+void Request::ParseQueryLazily() const {
+    query_parsed_ = true;
+    auto target = TargetOf(raw);
+    auto q = target.find('?');
+    if (q == std::string_view::npos || q + 1 >= target.size()) {
+        return;
+    }
+
+    std::string_view s = target.substr(q + 1);
+    while (!s.empty()) {
+        auto amp = s.find('&');
+        auto part = (amp == std::string_view::npos) ? s : s.substr(0, amp);
+        if (!part.empty()) {
+            auto eq = part.find('=');
+            QueryParam p = (eq == std::string_view::npos) ? QueryParam{part, {}} : QueryParam{part.substr(0, eq), part.substr(eq + 1)};
+            if (query_count_ < kInlineQueryParams) {
+                query_inline_[query_count_] = p;
+            } else {
+                query_overflow_.push_back(p);
+            }
+            ++query_count_;
+        }
+        if (amp == std::string_view::npos) {
+            break;
+        }
+        s.remove_prefix(amp + 1);
+    }
+}
+
+std::string_view Request::Query(std::string_view key) const {
+    if (!query_parsed_) {
+        ParseQueryLazily();
+    }
+    // First occurrence wins, as with the previous map-based lookup.
+    auto inline_count = query_count_ < kInlineQueryParams ? query_count_ : kInlineQueryParams;
+    for (std::size_t i = 0; i < inline_count; ++i) {
+        if (query_inline_[i].key == key) {
+            return query_inline_[i].value;
+        }
+    }
+    for (const auto& p : query_overflow_) {
+        if (p.key == key) {
+            return p.value;
+        }
+    }
+    return {};
+}
+
+std::string_view Request::Param(std::string_view name) const {
+    for (std::size_t i = 0; i < params.count; ++i) {
+        const auto& slot = params.slots[i];
+        if (slot.name == name) {
+            return path.substr(slot.offset, slot.length);
+        }
+    }
+    return {};
+}
+
+std::string_view Request::Header(std::string_view name) const {
+    auto it = raw.find(boost::beast::string_view(name.data(), name.size()));
+    if (it == raw.end()) {
+        return {};
+    }
+    return std::string_view(it->value().data(), it->value().size());
+}
+
+Response::Response(std::pmr::memory_resource* mr)
+    : body(mr), content_type("text/plain; charset=utf-8", mr), headers(mr) {}
+
+void Response::SetJson(std::string_view json) {
+    content_type = "application/json; charset=utf-8";
+    body = json;
+}
+
+void Response::SetFile(std::shared_ptr<const File> f) {
+    body.clear();
+    file_offset = 0;
+    file_length = f ? f->size() : 0;
+    file = std::move(f);
+}
+
+void Response::ApplyRange(std::string_view range_header) {
+    if (!file || status != 200) {
+        return;
+    }
+    headers["Accept-Ranges"] = "bytes";
+    if (range_header.empty()) {
+        return;
+    }
+
+    ByteRange range;
+    auto size = file_length;
+    switch (ParseRange(range_header, size, range)) {
+    case RangeStatus::none:
+        return;
+    case RangeStatus::unsatisfiable:
+        status = 416;
+        headers["Content-Range"] = "bytes */" + std::to_string(size);
+        file.reset();
+        file_offset = 0;
+        file_length = 0;
+        return;
+    case RangeStatus::satisfiable:
+        status = 206;
+        headers["Content-Range"] = "bytes " + std::to_string(range.offset) + "-" +
+            std::to_string(range.offset + range.length - 1) + "/" + std::to_string(size);
+        file_offset += range.offset;
+        file_length = range.length;
+        return;
+    }
+}
+
+} // namespace chmicro::http
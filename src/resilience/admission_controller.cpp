@@ -0,0 +1,124 @@
+#include <chmicro/resilience/admission_controller.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace chmicro::resilience {
+namespace {
+
+double ToMs(std::chrono::steady_clock::duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+} // namespace
+
+AdmissionController::AdmissionController(AdmissionControllerOptions opts)
+    : opts_(std::move(opts)),
+      limit_gauge_(DefaultMetrics().GaugeMetric(
+          "admission_limit", "Current adaptive concurrency limit", MetricLabels{{{"name", opts_.name}}})),
+      inflight_gauge_(DefaultMetrics().GaugeMetric(
+          "admission_inflight", "Admitted requests in flight (sampled once per window)", MetricLabels{{{"name", opts_.name}}})),
+      rejected_(DefaultMetrics().CounterMetric(
+          "admission_rejected_total", "Requests shed by the admission controller", MetricLabels{{{"name", opts_.name}}})),
+      queue_delay_ms_(DefaultMetrics().HistogramMetric(
+          "admission_queue_delay_ms",
+          "Time admitted requests spent queued before their handler started (ms)",
+          {0.1, 0.5, 1, 2, 5, 10, 25, 50, 100, 250},
+          MetricLabels{{{"name", opts_.name}}})) {
+    if (opts_.min_limit == 0) {
+        opts_.min_limit = 1;
+    }
+    if (opts_.max_limit < opts_.min_limit) {
+        opts_.max_limit = opts_.min_limit;
+    }
+    opts_.smoothing = std::clamp(opts_.smoothing, 0.01, 1.0);
+    opts_.queue_backoff = std::clamp(opts_.queue_backoff, 0.1, 1.0);
+
+    auto now = std::chrono::steady_clock::now();
+    window_start_ = now;
+    interval_end_ = now + opts_.queue_delay_interval;
+    SetLimitLocked(static_cast<double>(opts_.initial_limit));
+}
+
+bool AdmissionController::TryAcquire() {
+    auto cur = inflight_.load(std::memory_order_relaxed);
+    do {
+        if (cur >= limit_.load(std::memory_order_relaxed)) {
+            rejected_.Inc();
+            return false;
+        }
+    } while (!inflight_.compare_exchange_weak(cur, cur + 1, std::memory_order_relaxed));
+
+    auto seen = max_inflight_.load(std::memory_order_relaxed);
+    while (cur + 1 > seen && !max_inflight_.compare_exchange_weak(seen, cur + 1, std::memory_order_relaxed)) {
+    }
+    return true;
+}
+
+void AdmissionController::Release(std::chrono::steady_clock::duration latency) {
+    inflight_.fetch_sub(1, std::memory_order_relaxed);
+
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lk(mu_);
+    latency_sum_ms_ += ToMs(latency);
+    ++samples_;
+    if (samples_ >= opts_.window_min_samples && now - window_start_ >= opts_.window) {
+        UpdateLimitLocked(now);
+    }
+}
+
+void AdmissionController::OnQueueDelay(std::chrono::steady_clock::duration delay) {
+    queue_delay_ms_.Observe(ToMs(delay));
+
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lk(mu_);
+    if (now >= interval_end_) {
+        bool standing = interval_has_delay_ && interval_min_delay_ > opts_.queue_delay_target;
+        standing_.store(standing, std::memory_order_relaxed);
+        if (standing) {
+            SetLimitLocked(estimated_limit_ * opts_.queue_backoff);
+        }
+        interval_end_ = now + opts_.queue_delay_interval;
+        interval_has_delay_ = false;
+    }
+    if (!interval_has_delay_ || delay < interval_min_delay_) {
+        interval_min_delay_ = delay;
+        interval_has_delay_ = true;
+    }
+}
+
+void AdmissionController::UpdateLimitLocked(std::chrono::steady_clock::time_point now) {
+    double short_ms = latency_sum_ms_ / samples_;
+    auto peak = max_inflight_.exchange(inflight_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    latency_sum_ms_ = 0.0;
+    samples_ = 0;
+    window_start_ = now;
+    inflight_gauge_.Set(static_cast<double>(inflight_.load(std::memory_order_relaxed)));
+
+    if (long_latency_ms_ <= 0.0) {
+        long_latency_ms_ = short_ms;
+    } else {
+        long_latency_ms_ = long_latency_ms_ * 0.95 + short_ms * 0.05;
+        if (long_latency_ms_ > 2 * short_ms) {
+            // Latency dropped well below the baseline (load went away); catch up faster.
+            long_latency_ms_ *= 0.9;
+        }
+    }
+
+    // Using less than half of the limit says nothing about whether it could be higher.
+    if (peak < estimated_limit_ / 2) {
+        return;
+    }
+    double gradient = short_ms > 0.0 ? std::clamp(opts_.tolerance * long_latency_ms_ / short_ms, 0.5, 1.0) : 1.0;
+    double target = estimated_limit_ * gradient + std::sqrt(estimated_limit_);
+    SetLimitLocked(estimated_limit_ * (1.0 - opts_.smoothing) + target * opts_.smoothing);
+}
+
+void AdmissionController::SetLimitLocked(double limit) {
+    estimated_limit_ = std::clamp(limit, static_cast<double>(opts_.min_limit), static_cast<double>(opts_.max_limit));
+    auto rounded = static_cast<std::uint32_t>(estimated_limit_);
+    limit_.store(rounded, std::memory_order_relaxed);
+    limit_gauge_.Set(static_cast<double>(rounded));
+}
+
+} // namespace chmicro::resilience
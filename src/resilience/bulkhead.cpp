@@ -0,0 +1,101 @@
+#include <chmicro/resilience/bulkhead.h>
+
+#include <algorithm>
+
+namespace chmicro::resilience {
+
+Bulkhead::Bulkhead(BulkheadOptions opts)
+    : opts_(std::move(opts)),
+      inflight_gauge_(DefaultMetrics().GaugeMetric(
+          "bulkhead_inflight", "Requests holding a bulkhead slot", MetricLabels{{{"name", opts_.name}}})),
+      queued_gauge_(DefaultMetrics().GaugeMetric(
+          "bulkhead_queued", "Requests waiting for a bulkhead slot", MetricLabels{{{"name", opts_.name}}})),
+      rejected_full_(DefaultMetrics().CounterMetric(
+          "bulkhead_rejected_total", "Requests rejected by a bulkhead",
+          MetricLabels{{{"name", opts_.name}, {"reason", "full"}}})),
+      rejected_timeout_(DefaultMetrics().CounterMetric(
+          "bulkhead_rejected_total", "Requests rejected by a bulkhead",
+          MetricLabels{{{"name", opts_.name}, {"reason", "timeout"}}})) {
+    opts_.max_concurrent = std::max<std::uint32_t>(opts_.max_concurrent, 1);
+    DefaultMetrics()
+        .GaugeMetric("bulkhead_max_concurrent", "Slots of a bulkhead", MetricLabels{{{"name", opts_.name}}})
+        .Set(static_cast<double>(opts_.max_concurrent));
+}
+
+bool Bulkhead::TryAcquire() {
+    std::lock_guard<std::mutex> lk(mu_);
+    // Queued requests were first.
+    if (inflight_ >= opts_.max_concurrent || !waiters_.empty()) {
+        return false;
+    }
+    ++inflight_;
+    PublishLocked();
+    return true;
+}
+
+BulkheadEntry Bulkhead::Enqueue(std::function<void()> on_slot, Ticket* ticket) {
+    std::lock_guard<std::mutex> lk(mu_);
+    // A slot may have been released since TryAcquire().
+    if (inflight_ < opts_.max_concurrent && waiters_.empty()) {
+        ++inflight_;
+        PublishLocked();
+        return BulkheadEntry::admitted;
+    }
+    if (waiters_.size() >= opts_.max_queue) {
+        rejected_full_.Inc();
+        return BulkheadEntry::rejected;
+    }
+    *ticket = next_ticket_++;
+    waiters_.push_back(Waiter{*ticket, std::move(on_slot)});
+    PublishLocked();
+    return BulkheadEntry::queued;
+}
+
+bool Bulkhead::Cancel(Ticket ticket, bool timed_out) {
+    std::lock_guard<std::mutex> lk(mu_);
+    auto it = std::find_if(waiters_.begin(), waiters_.end(), [&](const Waiter& w) { return w.ticket == ticket; });
+    if (it == waiters_.end()) {
+        return false;
+    }
+    waiters_.erase(it);
+    if (timed_out) {
+        rejected_timeout_.Inc();
+    }
+    PublishLocked();
+    return true;
+}
+
+void Bulkhead::Release() {
+    std::function<void()> next;
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        if (waiters_.empty()) {
+            --inflight_;
+        } else {
+            // The slot passes to the oldest waiter; inflight_ stays.
+            next = std::move(waiters_.front().on_slot);
+            waiters_.pop_front();
+        }
+        PublishLocked();
+    }
+    if (next) {
+        next();
+    }
+}
+
+std::uint32_t Bulkhead::InFlight() const {
+    std::lock_guard<std::mutex> lk(mu_);
+    return inflight_;
+}
+
+std::uint32_t Bulkhead::Queued() const {
+    std::lock_guard<std::mutex> lk(mu_);
+    return static_cast<std::uint32_t>(waiters_.size());
+}
+
+void Bulkhead::PublishLocked() {
+    inflight_gauge_.Set(static_cast<double>(inflight_));
+    queued_gauge_.Set(static_cast<double>(waiters_.size()));
+}
+
+} // namespace chmicro::resilience
@@ -1,10 +1,14 @@
 #include <chmicro/runtime/app.h>
 
 #include <chmicro/core/log.h>
+#include <chmicro/runtime/handover.h>
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <csignal>
+#include <functional>
+#include <string>
 #include <thread>
 
 #ifdef _WIN32
@@ -19,6 +23,17 @@ std::atomic<App*> g_app{nullptr};
 
 #ifdef _WIN32
 BOOL WINAPI ConsoleCtrlHandler(DWORD ctrlType);
+#else
+// Runs `on_signal` for every delivery, not just the first. The handler keeps the set alive.
+void WatchSignals(std::shared_ptr<boost::asio::signal_set> signals, std::function<void()> on_signal) {
+    signals->async_wait([signals, on_signal = std::move(on_signal)](const boost::system::error_code& ec, int) mutable {
+        if (ec) {
+            return;
+        }
+        on_signal();
+        WatchSignals(signals, std::move(on_signal));
+    });
+}
 #endif
 
 struct ScopedAppRegistration {
@@ -82,7 +97,8 @@ App::App(AppOptions options)
           }
           auto hc = static_cast<std::size_t>(std::thread::hardware_concurrency());
           return hc == 0 ? static_cast<std::size_t>(1) : hc;
-      }()) {
+      }()),
+      workers_(WorkerPoolOptions{options_.worker_threads, options_.worker_queue_capacity}) {
     if (io_.Next().stopped()) {
         // no-op: silence -Wmaybe-uninitialized in some compilers
     }
@@ -101,6 +117,10 @@ IoContextPool& App::Io() {
     return io_;
 }
 
+WorkerPool& App::Workers() {
+    return workers_;
+}
+
 void App::AddServer(std::shared_ptr<IHttpServer> server) {
     servers_.push_back(std::move(server));
 }
@@ -110,37 +130,164 @@ int App::Run() {
 
     {
         std::lock_guard<std::mutex> lk(stop_mu_);
-        stopped_ = false;
+        running_ = true;
+        stop_requested_ = false;
+        handover_requested_ = false;
     }
-    stop_requested_.store(false, std::memory_order_release);
+    shut_down_.store(false, std::memory_order_release);
+    Status started;
 
 #ifndef _WIN32
-    // POSIX: stop the app on Ctrl+C / SIGTERM.
-    // Keep the signal_set alive by capturing it.
-    auto signals = std::make_shared<boost::asio::signal_set>(io_.Next(), SIGINT, SIGTERM);
-    signals->async_wait([this, signals](const boost::system::error_code&, int) {
-        this->Stop();
+    // POSIX: stop the app on Ctrl+C / SIGTERM; hand over to a successor on SIGUSR2. The handlers
+    // only raise a request: Run() carries it out on this thread, never on an IO thread it would
+    // have to join.
+    WatchSignals(std::make_shared<boost::asio::signal_set>(io_.Next(), SIGINT, SIGTERM), [this] { Stop(); });
+    WatchSignals(std::make_shared<boost::asio::signal_set>(io_.Next(), SIGUSR2), [this] {
+        {
+            std::lock_guard<std::mutex> lk(stop_mu_);
+            handover_requested_ = true;
+        }
+        stop_cv_.notify_all();
     });
+
+    // A successor only reports ready once every server serves on its predecessor's listeners;
+    // anything less and the predecessor keeps serving.
+    int channel = HandoverChannel();
+    if (channel >= 0) {
+        auto inherited = ReceiveListeners(channel);
+        if (!inherited.ok()) {
+            started = Status(inherited.status().code(), "listener handover failed: " + inherited.status().message());
+        } else {
+            auto& groups = inherited.value();
+            for (std::size_t i = 0; i < groups.size() && i < servers_.size(); ++i) {
+                servers_[i]->InheritListeners(std::move(groups[i]));
+            }
+            if (groups.size() != servers_.size()) {
+                started = Status(StatusCode::invalid_argument, "received listeners for " + std::to_string(groups.size()) +
+                    " servers, have " + std::to_string(servers_.size()));
+            }
+        }
+    }
 #endif
 
+    chmicro::log::info("IO: {} reactor threads on {}", io_.Size(), IoContextPool::Backend());
     io_.Start();
+    workers_.Start();
 
     for (auto& s : servers_) {
-        s->Start();
+        if (!started.ok()) {
+            break;
+        }
+        started = s->Start();
     }
 
-    // Block until Stop() completes.
-    {
+#ifndef _WIN32
+    if (channel >= 0) {
+        if (started.ok()) {
+            auto st = HandoverReady(channel);
+            if (!st.ok()) {
+                chmicro::log::warn("could not signal handover readiness: {}", st.message());
+            }
+        } else {
+            HandoverFailed(channel);
+        }
+    }
+#endif
+
+    if (!started.ok()) {
+        chmicro::log::error("could not start serving: {}", started.message());
+        // Servers that did start may have accepted connections already; let those finish.
+        DrainServers();
+        Shutdown();
+        std::lock_guard<std::mutex> lk(stop_mu_);
+        running_ = false;
+        return 1;
+    }
+
+    bool drain = false;
+    while (true) {
         std::unique_lock<std::mutex> lk(stop_mu_);
-        stop_cv_.wait(lk, [&] { return stopped_; });
+        stop_cv_.wait(lk, [&] { return stop_requested_ || handover_requested_; });
+        if (stop_requested_) {
+            break;
+        }
+        handover_requested_ = false;
+        lk.unlock();
+        if (HandOver()) {
+            drain = true;
+            break;
+        }
+    }
+    if (drain) {
+        DrainServers();
     }
+    Shutdown();
 
+    {
+        std::lock_guard<std::mutex> lk(stop_mu_);
+        running_ = false;
+    }
     return 0;
 }
 
 void App::Stop() {
-    // idempotent
-    if (stop_requested_.exchange(true, std::memory_order_acq_rel)) {
+    {
+        std::lock_guard<std::mutex> lk(stop_mu_);
+        stop_requested_ = true;
+        if (running_) {
+            stop_cv_.notify_all();
+            return;
+        }
+    }
+    Shutdown();
+}
+
+bool App::HandOver() {
+    std::vector<std::vector<int>> listeners;
+    listeners.reserve(servers_.size());
+    for (auto& s : servers_) {
+        listeners.push_back(s->ListenerHandles());
+    }
+
+    chmicro::log::info("Handing listeners over to a new process...");
+    auto pid = SpawnSuccessor(options_.argv, listeners, options_.handover_timeout);
+    if (!pid.ok()) {
+        chmicro::log::error("handover failed, still serving: {}", pid.status().message());
+        return false;
+    }
+    chmicro::log::info("Process {} is serving; draining connections.", pid.value());
+    return true;
+}
+
+void App::DrainServers() {
+    for (auto& s : servers_) {
+        s->Drain();
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + options_.drain_timeout;
+    auto active = [&] {
+        std::size_t n = 0;
+        for (auto& s : servers_) {
+            n += s->ActiveConnections();
+        }
+        return n;
+    };
+    std::unique_lock<std::mutex> lk(stop_mu_);
+    // Poll: connections close on IO threads, and a second stop request cuts the drain short.
+    while (!stop_requested_ && active() > 0) {
+        if (stop_cv_.wait_until(lk, std::min(deadline, std::chrono::steady_clock::now() + std::chrono::milliseconds(20)),
+                [&] { return stop_requested_; })) {
+            break;
+        }
+        if (std::chrono::steady_clock::now() >= deadline) {
+            chmicro::log::warn("drain timed out with {} connections open", active());
+            break;
+        }
+    }
+}
+
+void App::Shutdown() {
+    if (shut_down_.exchange(true, std::memory_order_acq_rel)) {
         return;
     }
 
@@ -150,14 +297,9 @@ void App::Stop() {
     for (auto& s : servers_) {
         s->Stop();
     }
+    workers_.Stop();
     io_.Stop();
     chmicro::log::info("Stopped.");
-
-    {
-        std::lock_guard<std::mutex> lk(stop_mu_);
-        stopped_ = true;
-    }
-    stop_cv_.notify_all();
 }
 
 } // namespace chmicro
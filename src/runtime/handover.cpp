@@ -0,0 +1,323 @@
+#include <chmicro/runtime/handover.h>
+
+#include <chmicro/core/log.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fstream>
+#include <iterator>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+namespace chmicro {
+
+#ifdef _WIN32
+
+Result<int> SpawnSuccessor(const std::vector<std::string>&, const std::vector<std::vector<int>>&, std::chrono::milliseconds) {
+    return Status(StatusCode::unavailable, "listener handover is not supported on this platform");
+}
+
+int HandoverChannel() {
+    return -1;
+}
+
+Result<std::vector<std::vector<int>>> ReceiveListeners(int) {
+    return Status(StatusCode::unavailable, "listener handover is not supported on this platform");
+}
+
+Status HandoverReady(int) {
+    return Status(StatusCode::unavailable, "listener handover is not supported on this platform");
+}
+
+void HandoverFailed(int) {}
+
+#else
+
+namespace {
+
+// The successor finds the channel here, whatever number it had in the parent.
+constexpr int kChildChannelFd = 3;
+// One SCM_RIGHTS message; well below the kernel's per-message limit.
+constexpr std::size_t kMaxListeners = 64;
+constexpr char kReady = 'R';
+
+Status Errno(std::string_view what) {
+    return Status(StatusCode::unavailable, std::string(what) + ": " + std::strerror(errno));
+}
+
+std::vector<std::string> OwnCommandLine() {
+    std::vector<std::string> argv;
+    std::ifstream in("/proc/self/cmdline", std::ios::binary);
+    std::string all((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::size_t pos = 0;
+    while (pos < all.size()) {
+        auto end = all.find('\0', pos);
+        if (end == std::string::npos) {
+            end = all.size();
+        }
+        argv.emplace_back(all, pos, end - pos);
+        pos = end + 1;
+    }
+    return argv;
+}
+
+// execve() does not search PATH, and execvp() is not async-signal-safe, so resolve before fork().
+std::string ResolveExecutable(const std::string& name) {
+    if (name.find('/') != std::string::npos) {
+        return name;
+    }
+    const char* path = std::getenv("PATH");
+    std::string_view dirs = path != nullptr ? path : "/usr/bin:/bin";
+    while (!dirs.empty()) {
+        auto sep = dirs.find(':');
+        auto dir = dirs.substr(0, sep);
+        std::string candidate = std::string(dir.empty() ? "." : dir) + "/" + name;
+        if (::access(candidate.c_str(), X_OK) == 0) {
+            return candidate;
+        }
+        dirs = sep == std::string_view::npos ? std::string_view{} : dirs.substr(sep + 1);
+    }
+    return name;
+}
+
+// Header: server count, then the listener count of each server; the descriptors ride along in
+// one SCM_RIGHTS control message.
+Status SendListeners(int channel, const std::vector<std::vector<int>>& listeners) {
+    std::vector<std::uint32_t> header{static_cast<std::uint32_t>(listeners.size())};
+    std::vector<int> fds;
+    for (const auto& group : listeners) {
+        header.push_back(static_cast<std::uint32_t>(group.size()));
+        fds.insert(fds.end(), group.begin(), group.end());
+    }
+    if (fds.empty() || fds.size() > kMaxListeners) {
+        return Status(StatusCode::invalid_argument, "handover needs between 1 and 64 listeners");
+    }
+
+    iovec iov{header.data(), header.size() * sizeof(std::uint32_t)};
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * fds.size()));
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+    auto* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    std::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+
+    ssize_t n;
+    do {
+        n = ::sendmsg(channel, &msg, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    if (n != static_cast<ssize_t>(iov.iov_len)) {
+        return Errno("handover sendmsg");
+    }
+    return Status::Ok();
+}
+
+// Waits for the successor's ready byte. EOF means it exited (or closed the channel) first.
+Status AwaitReady(int channel, std::chrono::milliseconds timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (true) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (left.count() <= 0) {
+            return Status(StatusCode::timeout, "successor did not become ready in time");
+        }
+        pollfd p{channel, POLLIN, 0};
+        int r = ::poll(&p, 1, static_cast<int>(left.count()));
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r < 0) {
+            return Errno("handover poll");
+        }
+        if (r == 0) {
+            continue;
+        }
+        char c = 0;
+        auto n = ::read(channel, &c, 1);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n == 1 && c == kReady) {
+            return Status::Ok();
+        }
+        return Status(StatusCode::unavailable, "successor exited before becoming ready");
+    }
+}
+
+} // namespace
+
+Result<int> SpawnSuccessor(const std::vector<std::string>& argv_in, const std::vector<std::vector<int>>& listeners,
+    std::chrono::milliseconds timeout) {
+    auto args = argv_in.empty() ? OwnCommandLine() : argv_in;
+    if (args.empty()) {
+        return Status(StatusCode::invalid_argument, "no command line to start the successor with");
+    }
+
+    // Everything the child needs is built before fork(): between fork() and exec() a threaded
+    // process may only make async-signal-safe calls.
+    auto path = ResolveExecutable(args.front());
+    std::vector<char*> argv;
+    for (auto& a : args) {
+        argv.push_back(a.data());
+    }
+    argv.push_back(nullptr);
+
+    std::string channel_env = std::string(kHandoverEnv) + "=" + std::to_string(kChildChannelFd);
+    std::string_view prefix = kHandoverEnv;
+    std::vector<char*> envp;
+    for (char** e = environ; *e != nullptr; ++e) {
+        std::string_view entry(*e);
+        if (entry.size() > prefix.size() && entry.substr(0, prefix.size()) == prefix && entry[prefix.size()] == '=') {
+            continue;
+        }
+        envp.push_back(*e);
+    }
+    envp.push_back(channel_env.data());
+    envp.push_back(nullptr);
+
+    int sv[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0) {
+        return Errno("handover socketpair");
+    }
+    long max_fd = ::sysconf(_SC_OPEN_MAX);
+    if (max_fd < 0) {
+        max_fd = 1024;
+    }
+
+    pid_t pid = ::fork();
+    if (pid < 0) {
+        auto st = Errno("handover fork");
+        ::close(sv[0]);
+        ::close(sv[1]);
+        return st;
+    }
+    if (pid == 0) {
+        // Child. Keep stdio and the channel (as fd 3, without CLOEXEC); drop every other
+        // descriptor, above all client connections that must close when the parent closes them.
+        if (::dup2(sv[1], kChildChannelFd) < 0 || ::fcntl(kChildChannelFd, F_SETFD, 0) < 0) {
+            ::_exit(127);
+        }
+#if defined(__linux__) && defined(SYS_close_range)
+        if (::syscall(SYS_close_range, kChildChannelFd + 1, ~0U, 0) != 0)
+#endif
+        {
+            for (long fd = kChildChannelFd + 1; fd < max_fd; ++fd) {
+                ::close(static_cast<int>(fd));
+            }
+        }
+        ::execve(path.c_str(), argv.data(), envp.data());
+        ::_exit(127);
+    }
+
+    ::close(sv[1]);
+    auto st = SendListeners(sv[0], listeners);
+    if (st.ok()) {
+        st = AwaitReady(sv[0], timeout);
+    }
+    ::close(sv[0]);
+    if (!st.ok()) {
+        ::kill(pid, SIGKILL);
+        ::waitpid(pid, nullptr, 0);
+        return st;
+    }
+    return static_cast<int>(pid);
+}
+
+int HandoverChannel() {
+    const char* v = std::getenv(kHandoverEnv);
+    if (v == nullptr || *v == '\0') {
+        return -1;
+    }
+    int fd = std::atoi(v);
+    // Not passed on to this process's own successors or children.
+    ::unsetenv(kHandoverEnv);
+    if (fd < 0 || ::fcntl(fd, F_GETFD) < 0) {
+        chmicro::log::warn("{} names no open descriptor; starting without handover", kHandoverEnv);
+        return -1;
+    }
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+Result<std::vector<std::vector<int>>> ReceiveListeners(int channel) {
+    std::uint32_t header[1 + kMaxListeners];
+    iovec iov{header, sizeof(header)};
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * kMaxListeners));
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+
+    ssize_t n;
+    do {
+        n = ::recvmsg(channel, &msg, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        return Errno("handover recvmsg");
+    }
+
+    std::vector<int> fds;
+    for (auto* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            auto count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            auto* data = reinterpret_cast<const int*>(CMSG_DATA(cmsg));
+            fds.insert(fds.end(), data, data + count);
+        }
+    }
+
+    auto words = static_cast<std::size_t>(n) / sizeof(std::uint32_t);
+    std::vector<std::vector<int>> listeners;
+    std::size_t next = 0;
+    bool valid = words >= 1 && words == 1 + header[0] && (msg.msg_flags & MSG_CTRUNC) == 0;
+    for (std::size_t i = 1; valid && i < words; ++i) {
+        if (next + header[i] > fds.size()) {
+            valid = false;
+            break;
+        }
+        listeners.emplace_back(fds.begin() + static_cast<std::ptrdiff_t>(next), fds.begin() + static_cast<std::ptrdiff_t>(next + header[i]));
+        next += header[i];
+    }
+    if (!valid || next != fds.size()) {
+        for (int fd : fds) {
+            ::close(fd);
+        }
+        return Status(StatusCode::invalid_argument, "malformed handover message");
+    }
+    return listeners;
+}
+
+Status HandoverReady(int channel) {
+    ssize_t n;
+    do {
+        n = ::send(channel, &kReady, 1, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    auto st = n == 1 ? Status::Ok() : Errno("handover ready");
+    ::close(channel);
+    return st;
+}
+
+void HandoverFailed(int channel) {
+    ::close(channel);
+}
+
+#endif
+
+} // namespace chmicro
@@ -1,5 +1,7 @@
 #include <chmicro/runtime/io_context_pool.h>
 
+#include <chmicro/core/metrics.h>
+
 #include <stdexcept>
 
 namespace chmicro {
@@ -17,6 +19,24 @@ IoContextPool::IoContextPool(std::size_t threads) : threads_(threads) {
         guards_.push_back(boost::asio::make_work_guard(*ctx));
         contexts_.push_back(std::move(ctx));
     }
+    DefaultMetrics().GaugeMetric("io_backend", "IO demultiplexer used by the reactors (always 1)",
+        MetricLabels{{{"backend", Backend()}}}).Set(1);
+}
+
+const char* IoContextPool::Backend() {
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_DISABLE_EPOLL)
+    return "io_uring";
+#elif defined(BOOST_ASIO_HAS_IOCP)
+    return "iocp";
+#elif defined(BOOST_ASIO_HAS_EPOLL)
+    return "epoll";
+#elif defined(BOOST_ASIO_HAS_KQUEUE)
+    return "kqueue";
+#elif defined(BOOST_ASIO_HAS_DEV_POLL)
+    return "dev_poll";
+#else
+    return "select";
+#endif
 }
 
 IoContextPool::~IoContextPool() {
@@ -0,0 +1,130 @@
+#include <chmicro/runtime/timer_wheel.h>
+
+#include <boost/asio/post.hpp>
+
+#include <algorithm>
+
+namespace chmicro {
+
+void TimerWheel::Deadline::Arm(TimerWheel& wheel, std::chrono::milliseconds after) {
+    auto at = wheel.NowMs() + after.count();
+    at_ms_.store(at, std::memory_order_relaxed);
+    if (!filed_.exchange(true, std::memory_order_acq_rel)) {
+        wheel.File(shared_from_this(), at);
+    }
+}
+
+TimerWheel::TimerWheel(boost::asio::io_context& ioc, std::chrono::milliseconds tick, std::size_t slots)
+    : timer_(ioc),
+      tick_(std::max(tick, std::chrono::milliseconds(1))),
+      now_ms_(ClockMs()),
+      slots_(std::max<std::size_t>(slots, 2)),
+      current_tick_(now_ms_.load() / tick_.count()) {}
+
+std::int64_t TimerWheel::ClockMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void TimerWheel::Start() {
+    if (running_.exchange(true)) {
+        return;
+    }
+    Schedule();
+}
+
+void TimerWheel::Stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    boost::asio::post(timer_.get_executor(), [self = shared_from_this()] { self->timer_.cancel(); });
+}
+
+void TimerWheel::Poke() {
+    std::vector<std::shared_ptr<Deadline>> live;
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        for (const auto& slot : slots_) {
+            for (const auto& e : slot) {
+                if (auto d = e.lock()) {
+                    live.push_back(std::move(d));
+                }
+            }
+        }
+    }
+    // Outside the lock: owners may re-arm from on_expired.
+    for (auto& d : live) {
+        d->on_expired_();
+    }
+}
+
+void TimerWheel::File(const std::shared_ptr<Deadline>& d, std::int64_t at_ms) {
+    std::lock_guard<std::mutex> lk(mu_);
+    // Due ticks land in the next slot to be visited; far ones in the furthest slot, to be re-filed
+    // from there.
+    auto n = static_cast<std::int64_t>(slots_.size());
+    auto t = std::clamp(at_ms / tick_.count(), current_tick_ + 1, current_tick_ + n);
+    slots_[static_cast<std::size_t>(t % n)].push_back(d);
+}
+
+void TimerWheel::Schedule() {
+    timer_.expires_after(tick_);
+    timer_.async_wait([self = shared_from_this()](const boost::system::error_code& ec) {
+        if (ec || !self->running_.load(std::memory_order_relaxed)) {
+            return;
+        }
+        self->OnTick();
+        self->Schedule();
+    });
+}
+
+void TimerWheel::OnTick() {
+    auto now = ClockMs();
+    now_ms_.store(now, std::memory_order_relaxed);
+
+    auto n = static_cast<std::int64_t>(slots_.size());
+    std::vector<Entry> due;
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            // A stalled reactor may skip ticks; visiting every slot once covers all of them.
+            if (current_tick_ >= now / tick_.count()) {
+                break;
+            }
+            if (now / tick_.count() - current_tick_ > n) {
+                current_tick_ = now / tick_.count() - n;
+            }
+            ++current_tick_;
+            due.swap(slots_[static_cast<std::size_t>(current_tick_ % n)]);
+        }
+        for (auto& e : due) {
+            if (auto d = e.lock()) {
+                Visit(d, now);
+            }
+        }
+        due.clear();
+    }
+}
+
+void TimerWheel::Visit(const std::shared_ptr<Deadline>& d, std::int64_t now) {
+    auto at = d->at_ms_.load(std::memory_order_relaxed);
+    if (at != kNever && at > now) {
+        // Moved later since it was filed.
+        return File(d, at);
+    }
+    d->filed_.store(false, std::memory_order_release);
+    // Re-read: an Arm() racing with the store above either sees filed_ == false and files the
+    // entry itself, or has already stored a deadline that is visible here.
+    at = d->at_ms_.load(std::memory_order_acquire);
+    if (at == kNever) {
+        return;
+    }
+    if (at > now) {
+        if (!d->filed_.exchange(true, std::memory_order_acq_rel)) {
+            File(d, at);
+        }
+        return;
+    }
+    d->on_expired_();
+}
+
+} // namespace chmicro
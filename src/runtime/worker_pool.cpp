@@ -0,0 +1,137 @@
+#include <chmicro/runtime/worker_pool.h>
+
+namespace chmicro {
+
+WorkerPool::WorkerPool(WorkerPoolOptions options)
+    : options_(options),
+      queue_depth_(DefaultMetrics().GaugeMetric("worker_pool_queue_depth", "Tasks waiting in the worker pool")),
+      wait_ms_(DefaultMetrics().HistogramMetric(
+          "worker_pool_wait_ms",
+          "Time tasks spent queued before a worker picked them up (ms)",
+          {0.05, 0.1, 0.25, 0.5, 1, 2, 5, 10, 25, 50, 100})),
+      rejected_(DefaultMetrics().CounterMetric("worker_pool_rejected_total", "Tasks rejected because the worker pool queue was full")) {
+    auto n = options_.threads;
+    if (n == 0) {
+        n = static_cast<std::size_t>(std::thread::hardware_concurrency());
+        if (n == 0) {
+            n = 1;
+        }
+    }
+    if (options_.queue_capacity == 0) {
+        options_.queue_capacity = 1;
+    }
+
+    workers_.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    Stop();
+}
+
+bool WorkerPool::TrySubmit(Task task) {
+    auto& w = *workers_[rr_.fetch_add(1, std::memory_order_relaxed) % workers_.size()];
+    {
+        // The stop check, the reservation and the push happen under the queue lock, so Stop()
+        // either sees the task in the queue and discards it, or this sees stopping_ and refuses.
+        std::lock_guard<std::mutex> lk(w.mu);
+        if (stopping_.load(std::memory_order_acquire)) {
+            rejected_.Inc();
+            return false;
+        }
+        // Reserve a slot first so the capacity bound holds under concurrent submitters.
+        if (depth_.fetch_add(1, std::memory_order_acq_rel) >= options_.queue_capacity) {
+            depth_.fetch_sub(1, std::memory_order_acq_rel);
+            rejected_.Inc();
+            return false;
+        }
+        w.queue.push_back(Item{std::move(task), std::chrono::steady_clock::now()});
+    }
+    queue_depth_.Set(static_cast<double>(depth_.load(std::memory_order_acquire)));
+
+    {
+        std::lock_guard<std::mutex> lk(sleep_mu_);
+    }
+    sleep_cv_.notify_one();
+    return true;
+}
+
+bool WorkerPool::TryPop(std::size_t index, Item& out) {
+    // Own queue first, then steal from peers starting at the next worker.
+    for (std::size_t k = 0; k < workers_.size(); ++k) {
+        auto& w = *workers_[(index + k) % workers_.size()];
+        std::lock_guard<std::mutex> lk(w.mu);
+        if (!w.queue.empty()) {
+            out = std::move(w.queue.front());
+            w.queue.pop_front();
+            depth_.fetch_sub(1, std::memory_order_acq_rel);
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkerPool::Run(std::size_t index) {
+    Item item;
+    while (true) {
+        if (TryPop(index, item)) {
+            queue_depth_.Set(static_cast<double>(depth_.load(std::memory_order_acquire)));
+            wait_ms_.Observe(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - item.enqueued).count());
+
+            item.task();
+            item.task = nullptr;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lk(sleep_mu_);
+        sleep_cv_.wait(lk, [&] {
+            return stopping_.load(std::memory_order_acquire) || depth_.load(std::memory_order_acquire) > 0;
+        });
+        if (stopping_.load(std::memory_order_acquire)) {
+            return;
+        }
+    }
+}
+
+void WorkerPool::Start() {
+    bool expected = false;
+    if (!started_.compare_exchange_strong(expected, true)) {
+        return;
+    }
+    stopping_.store(false, std::memory_order_release);
+
+    threads_.reserve(workers_.size());
+    for (std::size_t i = 0; i < workers_.size(); ++i) {
+        threads_.emplace_back([this, i] { Run(i); });
+    }
+}
+
+void WorkerPool::Stop() {
+    bool expected = true;
+    if (!started_.compare_exchange_strong(expected, false)) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lk(sleep_mu_);
+        stopping_.store(true, std::memory_order_release);
+    }
+    sleep_cv_.notify_all();
+    for (auto& t : threads_) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+    threads_.clear();
+
+    for (auto& w : workers_) {
+        std::lock_guard<std::mutex> lk(w->mu);
+        depth_.fetch_sub(w->queue.size(), std::memory_order_acq_rel);
+        w->queue.clear();
+    }
+    queue_depth_.Set(static_cast<double>(depth_.load(std::memory_order_acquire)));
+}
+
+} // namespace chmicro
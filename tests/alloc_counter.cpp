@@ -0,0 +1,70 @@
+#include "alloc_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+// The full set of replaceable non-aligned forms, all on malloc/free, in a translation unit of their
+// own: defined next to new-expressions, GCC inlines them and reports -Wmismatched-new-delete.
+
+namespace {
+
+thread_local long t_allocs = 0;
+
+void* Allocate(std::size_t n) noexcept {
+    ++t_allocs;
+    return std::malloc(n == 0 ? 1 : n);
+}
+
+} // namespace
+
+AllocationCounter::AllocationCounter() : start_(t_allocs) {}
+
+long AllocationCounter::Count() const {
+    return t_allocs - start_;
+}
+
+void* operator new(std::size_t n) {
+    if (void* p = Allocate(n)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t n) {
+    if (void* p = Allocate(n)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t n, const std::nothrow_t&) noexcept {
+    return Allocate(n);
+}
+
+void* operator new[](std::size_t n, const std::nothrow_t&) noexcept {
+    return Allocate(n);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+// Counts global operator new calls made on the current thread from construction on. The
+// replacement operators live in alloc_counter.cpp and serve the whole test binary; only the
+// counting is per thread, so servers running on other threads do not disturb a measurement.
+class AllocationCounter {
+public:
+    AllocationCounter();
+
+    AllocationCounter(const AllocationCounter&) = delete;
+    AllocationCounter& operator=(const AllocationCounter&) = delete;
+
+    // Allocations on this thread since construction.
+    long Count() const;
+
+private:
+    long start_;
+};
@@ -0,0 +1,61 @@
+#!/bin/sh
+# Floods chmicro_kv with requests for random unmatched paths and checks that its RSS levels off and
+# that /metrics keeps one "__unmatched__" series instead of one per path.
+# Usage: cardinality_soak.sh <chmicro_kv> <chmicro_loadgen> [port] [seconds]
+set -eu
+
+KV=$1
+LOADGEN=$2
+PORT=${3:-18098}
+SECONDS_FLOOD=${4:-10}
+# Allowed growth between the end of the warmup flood and the end of the main one.
+MAX_GROWTH_KB=8192
+DIR=$(mktemp -d)
+trap 'kill -9 $(cat "$DIR/pids" 2>/dev/null) 2>/dev/null || true; rm -rf "$DIR"' EXIT
+
+fail() {
+    echo "FAIL: $*"
+    echo "--- server log"
+    cat "$DIR/kv.log"
+    exit 1
+}
+
+rss_kb() {
+    sed -n 's/^VmRSS:[^0-9]*\([0-9]*\).*/\1/p' "/proc/$1/status"
+}
+
+# Requests the flood sent: every one is a 404.
+sent() {
+    sed -n 's/^ok=[0-9]* non2xx=\([0-9]*\) .*/\1/p' "$1"
+}
+
+"$KV" --listen "127.0.0.1:$PORT" --threads 1 --log warn >"$DIR/kv.log" 2>&1 &
+KV_PID=$!
+echo $KV_PID >"$DIR/pids"
+i=0
+until "$LOADGEN" --port "$PORT" --target /health --threads 1 --concurrency 1 --warmup 0 --duration 1 >/dev/null 2>&1; do
+    i=$((i + 1))
+    [ $i -le 10 ] || fail "server did not start"
+done
+
+"$LOADGEN" --port "$PORT" --target /scan --random-paths --threads 1 --concurrency 16 --warmup 0 --duration 3 >"$DIR/warmup.log" 2>&1
+BEFORE=$(rss_kb $KV_PID)
+"$LOADGEN" --port "$PORT" --target /scan --random-paths --threads 1 --concurrency 16 --warmup 0 \
+    --duration "$SECONDS_FLOOD" >"$DIR/flood.log" 2>&1
+AFTER=$(rss_kb $KV_PID)
+SENT=$(sent "$DIR/flood.log")
+echo "random paths: $(sent "$DIR/warmup.log") warmup + $SENT flood; RSS ${BEFORE} kB -> ${AFTER} kB"
+
+[ "${SENT:-0}" -ge 10000 ] || fail "flood sent too few requests: ${SENT:-0}"
+[ $((AFTER - BEFORE)) -le $MAX_GROWTH_KB ] || fail "RSS grew by $((AFTER - BEFORE)) kB under the flood"
+
+# The exposition checks need curl; the RSS check above does not.
+if command -v curl >/dev/null 2>&1; then
+    curl -s "http://127.0.0.1:$PORT/metrics" >"$DIR/metrics.txt"
+    grep -q 'http_server_requests_total{path="__unmatched__",status="404"}' "$DIR/metrics.txt" \
+        || fail "no __unmatched__ series"
+    ! grep -q 'path="/scan/' "$DIR/metrics.txt" || fail "raw paths leaked into labels"
+fi
+
+kill $KV_PID
+echo "PASS: RSS stayed within ${MAX_GROWTH_KB} kB under a random-path flood"
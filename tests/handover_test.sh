@@ -0,0 +1,88 @@
+#!/bin/sh
+# Restarts chmicro_kv with SIGUSR2 under load and checks that no request failed: first to a
+# successor that cannot serve (the old process must keep serving), then to a working one.
+# Usage: handover_test.sh <chmicro_kv> <chmicro_loadgen> [port]
+set -eu
+
+KV=$1
+LOADGEN=$2
+PORT=${3:-18097}
+DIR=$(mktemp -d)
+trap 'kill -9 $(cat "$DIR/pids" 2>/dev/null) 2>/dev/null || true; rm -rf "$DIR"' EXIT
+
+fail() {
+    echo "FAIL: $*"
+    echo "--- server log"
+    cat "$DIR/kv.log"
+    exit 1
+}
+
+# Waits up to ~10 s for `pattern` to show up in the server log.
+await_log() {
+    i=0
+    until grep -q "$1" "$DIR/kv.log"; do
+        i=$((i + 1))
+        [ $i -le 100 ] || fail "timed out waiting for '$1'"
+        sleep 0.1
+    done
+}
+
+# Succeeds when a loadgen summary shows traffic, no errors and only 2xx answers.
+clean_run() {
+    grep -q "^ok=[1-9][0-9]* non2xx=0 (503=0) err=0 " "$1"
+}
+
+# The server runs from a copy so that the program a handover re-executes can be swapped.
+install_successor() {
+    cp "$1" "$DIR/kv.new"
+    chmod +x "$DIR/kv.new"
+    mv "$DIR/kv.new" "$DIR/kv"
+}
+
+install_successor "$KV"
+"$DIR/kv" --listen "127.0.0.1:$PORT" --threads 2 >"$DIR/kv.log" 2>&1 &
+OLD=$!
+echo $OLD >"$DIR/pids"
+await_log "HTTP server listening"
+
+# A successor that receives the listeners but cannot serve (its listen address does not resolve)
+# must not report ready: the old process keeps serving.
+printf '#!/bin/sh\nexec "%s" --listen "no-such-host:%s" --threads 2\n' "$KV" "$PORT" >"$DIR/broken"
+install_successor "$DIR/broken"
+"$LOADGEN" --port "$PORT" --target /health --threads 1 --concurrency 16 --warmup 0 --duration 3 >"$DIR/load.log" 2>&1 &
+LOAD=$!
+sleep 1
+kill -USR2 $OLD
+await_log "handover failed, still serving"
+wait $LOAD || true
+cat "$DIR/load.log"
+kill -0 $OLD 2>/dev/null || fail "old process exited after a failed handover"
+grep -q "is serving; draining" "$DIR/kv.log" && fail "old process drained for a successor that did not start"
+clean_run "$DIR/load.log" || fail "requests failed across the failed handover"
+install_successor "$KV"
+
+"$LOADGEN" --port "$PORT" --target /health --threads 1 --concurrency 16 --warmup 0 --duration 6 >"$DIR/load.log" 2>&1 &
+LOAD=$!
+sleep 2
+kill -USR2 $OLD
+await_log "is serving; draining"
+NEW=$(sed -n 's/.*Process \([0-9]*\) is serving.*/\1/p' "$DIR/kv.log" | head -n 1)
+echo "$OLD $NEW" >"$DIR/pids"
+
+i=0
+while kill -0 $OLD 2>/dev/null; do
+    i=$((i + 1))
+    [ $i -le 150 ] || fail "old process did not exit after draining"
+    sleep 0.1
+done
+wait $LOAD || true
+cat "$DIR/load.log"
+clean_run "$DIR/load.log" || fail "requests failed across the handover"
+
+# Only the successor is left, still serving on the same port.
+"$LOADGEN" --port "$PORT" --target /health --threads 1 --concurrency 4 --warmup 0 --duration 1 >"$DIR/after.log" 2>&1
+clean_run "$DIR/after.log" || fail "successor is not serving"
+grep -q "inherited" "$DIR/kv.log" || fail "successor did not inherit the listener"
+
+kill $NEW
+echo "PASS: handover from $OLD to $NEW without failed requests, after a failed one"
@@ -0,0 +1,96 @@
+#include <chtest.hpp>
+
+#include <chmicro/resilience/admission_controller.h>
+
+#include <chrono>
+#include <thread>
+
+using chmicro::resilience::AdmissionController;
+using chmicro::resilience::AdmissionControllerOptions;
+
+namespace {
+
+// Fills the controller up to its limit, then completes every request with `latency`.
+void SaturatedWindow(AdmissionController& ac, std::chrono::milliseconds latency) {
+    std::uint32_t taken = 0;
+    while (ac.TryAcquire()) {
+        ++taken;
+    }
+    for (std::uint32_t i = 0; i < taken; ++i) {
+        ac.Release(latency);
+    }
+}
+
+} // namespace
+
+TEST_CASE("AdmissionController sheds requests over the limit") {
+    AdmissionControllerOptions opt;
+    opt.name = "test_shed";
+    opt.initial_limit = 2;
+    opt.min_limit = 1;
+    opt.window = std::chrono::hours(1); // keep the limit fixed
+
+    AdmissionController ac(opt);
+    REQUIRE(ac.TryAcquire());
+    REQUIRE(ac.TryAcquire());
+    REQUIRE(!ac.TryAcquire());
+    REQUIRE(ac.InFlight() == 2);
+
+    ac.Release(std::chrono::milliseconds(1));
+    REQUIRE(ac.TryAcquire());
+}
+
+TEST_CASE("AdmissionController gradient follows latency") {
+    AdmissionControllerOptions opt;
+    opt.name = "test_gradient";
+    opt.initial_limit = 20;
+    opt.min_limit = 2;
+    opt.window = std::chrono::milliseconds(0);
+    opt.window_min_samples = 5;
+
+    AdmissionController ac(opt);
+    // Steady latency: the limit probes upwards.
+    SaturatedWindow(ac, std::chrono::milliseconds(1));
+    SaturatedWindow(ac, std::chrono::milliseconds(1));
+    auto grown = ac.Limit();
+    REQUIRE(grown > 20);
+
+    // Latency far above the baseline: the limit backs off (until the baseline catches up).
+    SaturatedWindow(ac, std::chrono::milliseconds(20));
+    SaturatedWindow(ac, std::chrono::milliseconds(20));
+    REQUIRE(ac.Limit() < 20);
+    REQUIRE(ac.Limit() >= 2);
+
+    // An idle controller (no saturation) keeps its limit.
+    auto before = ac.Limit();
+    for (int i = 0; i < 10; ++i) {
+        REQUIRE(ac.TryAcquire());
+        ac.Release(std::chrono::milliseconds(50));
+    }
+    REQUIRE(ac.Limit() == before);
+}
+
+TEST_CASE("AdmissionController backs off on a standing queue") {
+    AdmissionControllerOptions opt;
+    opt.name = "test_codel";
+    opt.initial_limit = 100;
+    opt.window = std::chrono::hours(1);
+    opt.queue_delay_target = std::chrono::milliseconds(1);
+    opt.queue_delay_interval = std::chrono::milliseconds(10);
+
+    AdmissionController ac(opt);
+    // Every delay of the interval is above target.
+    ac.OnQueueDelay(std::chrono::milliseconds(5));
+    ac.OnQueueDelay(std::chrono::milliseconds(3));
+    std::this_thread::sleep_for(std::chrono::milliseconds(15));
+    ac.OnQueueDelay(std::chrono::milliseconds(4));
+    REQUIRE(ac.QueueStanding());
+    REQUIRE(ac.Limit() == 90);
+
+    // One short wait is enough to show the queue drains.
+    ac.OnQueueDelay(std::chrono::microseconds(100));
+    std::this_thread::sleep_for(std::chrono::milliseconds(15));
+    ac.OnQueueDelay(std::chrono::milliseconds(4));
+    REQUIRE(!ac.QueueStanding());
+    REQUIRE(ac.Limit() == 90);
+}
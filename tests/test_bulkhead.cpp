@@ -0,0 +1,73 @@
+#include <chtest.hpp>
+
+#include <chmicro/resilience/bulkhead.h>
+
+#include <vector>
+
+using chmicro::resilience::Bulkhead;
+using chmicro::resilience::BulkheadEntry;
+using chmicro::resilience::BulkheadOptions;
+
+TEST_CASE("Bulkhead queues requests over its limit and rejects beyond the queue") {
+    BulkheadOptions opt;
+    opt.name = "test_queue";
+    opt.max_concurrent = 2;
+    opt.max_queue = 2;
+    Bulkhead b(opt);
+
+    std::vector<int> granted;
+    Bulkhead::Ticket t1 = 0;
+    Bulkhead::Ticket t2 = 0;
+    Bulkhead::Ticket unused = 0;
+    REQUIRE(b.Acquire([] {}, &unused) == BulkheadEntry::admitted);
+    REQUIRE(b.TryAcquire());
+    REQUIRE(b.Acquire([&] { granted.push_back(1); }, &t1) == BulkheadEntry::queued);
+    REQUIRE(b.Acquire([&] { granted.push_back(2); }, &t2) == BulkheadEntry::queued);
+    REQUIRE(b.Acquire([&] { granted.push_back(3); }, &unused) == BulkheadEntry::rejected);
+    // Newcomers do not overtake the queue.
+    REQUIRE(!b.TryAcquire());
+    REQUIRE(b.InFlight() == 2);
+    REQUIRE(b.Queued() == 2);
+
+    // Slots pass to waiters in arrival order without ever becoming free.
+    b.Release();
+    REQUIRE(granted == std::vector<int>{1});
+    REQUIRE(b.InFlight() == 2);
+    REQUIRE(b.Queued() == 1);
+
+    b.Release();
+    b.Release();
+    REQUIRE(granted == (std::vector<int>{1, 2}));
+    REQUIRE(b.InFlight() == 1);
+    b.Release();
+    REQUIRE(b.InFlight() == 0);
+}
+
+TEST_CASE("Bulkhead cancels queued waits that have not been granted") {
+    BulkheadOptions opt;
+    opt.name = "test_cancel";
+    opt.max_concurrent = 1;
+    opt.max_queue = 4;
+    Bulkhead b(opt);
+
+    int granted = 0;
+    Bulkhead::Ticket first = 0;
+    Bulkhead::Ticket second = 0;
+    REQUIRE(b.TryAcquire());
+    REQUIRE(b.Acquire([&] { ++granted; }, &first) == BulkheadEntry::queued);
+    REQUIRE(b.Acquire([&] { ++granted; }, &second) == BulkheadEntry::queued);
+    REQUIRE(first != second);
+
+    REQUIRE(b.Cancel(second, true));
+    REQUIRE(!b.Cancel(second, true));
+    REQUIRE(b.Queued() == 1);
+
+    b.Release();
+    REQUIRE(granted == 1);
+    // Already handed its slot: the waiter owns it now.
+    REQUIRE(!b.Cancel(first, true));
+    REQUIRE(b.InFlight() == 1);
+    b.Release();
+    REQUIRE(b.InFlight() == 0);
+    REQUIRE(b.Queued() == 0);
+}
@@ -0,0 +1,146 @@
+#include <chtest.hpp>
+
+#include <chmicro/http/hpack.h>
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+using chmicro::http::HeaderField;
+
+std::string FromHex(std::string_view hex) {
+    std::string out;
+    int hi = -1;
+    for (char c : hex) {
+        int v;
+        if (c >= '0' && c <= '9') {
+            v = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            v = c - 'a' + 10;
+        } else {
+            continue;
+        }
+        if (hi < 0) {
+            hi = v;
+        } else {
+            out.push_back(static_cast<char>(hi << 4 | v));
+            hi = -1;
+        }
+    }
+    return out;
+}
+
+bool Has(const std::vector<HeaderField>& fields, std::size_t i, std::string_view name, std::string_view value) {
+    return i < fields.size() && fields[i].name == name && fields[i].value == value;
+}
+
+} // namespace
+
+TEST_CASE("HPACK decodes the RFC 7541 request examples with Huffman coding") {
+    chmicro::http::HpackDecoder decoder;
+
+    // C.4.1
+    std::vector<HeaderField> fields;
+    REQUIRE(decoder.Decode(FromHex("8286 8441 8cf1 e3c2 e5f2 3a6b a0ab 90f4 ff"), fields).ok());
+    REQUIRE(fields.size() == 4);
+    REQUIRE(Has(fields, 0, ":method", "GET"));
+    REQUIRE(Has(fields, 1, ":scheme", "http"));
+    REQUIRE(Has(fields, 2, ":path", "/"));
+    REQUIRE(Has(fields, 3, ":authority", "www.example.com"));
+    REQUIRE(decoder.Table().Size() == 57);
+
+    // C.4.2: the authority now comes from the dynamic table.
+    fields.clear();
+    REQUIRE(decoder.Decode(FromHex("8286 84be 5886 a8eb 1064 9cbf"), fields).ok());
+    REQUIRE(fields.size() == 5);
+    REQUIRE(Has(fields, 3, ":authority", "www.example.com"));
+    REQUIRE(Has(fields, 4, "cache-control", "no-cache"));
+    REQUIRE(decoder.Table().Size() == 110);
+
+    // C.4.3
+    fields.clear();
+    REQUIRE(decoder.Decode(FromHex("8287 85bf 4088 25a8 49e9 5ba9 7d7f 8925 a849 e95b b8e8 b4bf"), fields).ok());
+    REQUIRE(fields.size() == 5);
+    REQUIRE(Has(fields, 1, ":scheme", "https"));
+    REQUIRE(Has(fields, 2, ":path", "/index.html"));
+    REQUIRE(Has(fields, 4, "custom-key", "custom-value"));
+    REQUIRE(decoder.Table().Size() == 164);
+    REQUIRE(decoder.Table().Count() == 3);
+}
+
+TEST_CASE("HPACK evicts from a small table as in the RFC 7541 response examples") {
+    chmicro::http::HpackDecoder decoder(256);
+    std::vector<HeaderField> fields;
+    // C.6.1 and C.6.2 (Huffman, 256-byte table).
+    REQUIRE(decoder.Decode(FromHex(
+        "4882 6402 5885 aec3 771a 4b61 96d0 7abe 9410 54d4 44a8 2005 9504 0b81 66e0 82a6"
+        "2d1b ff6e 919d 29ad 1718 63c7 8f0b 97c8 e9ae 82ae 43d3"), fields).ok());
+    REQUIRE(Has(fields, 0, ":status", "302"));
+    REQUIRE(Has(fields, 3, "location", "https://www.example.com"));
+    REQUIRE(decoder.Table().Size() == 222);
+
+    fields.clear();
+    REQUIRE(decoder.Decode(FromHex("4883 640e ffc1 c0bf"), fields).ok());
+    REQUIRE(Has(fields, 0, ":status", "307"));
+    REQUIRE(Has(fields, 1, "cache-control", "private"));
+    REQUIRE(decoder.Table().Size() == 222);
+    REQUIRE(decoder.Table().Count() == 4);
+    REQUIRE(decoder.Table().At(0).value == "307");
+}
+
+TEST_CASE("HPACK encoder output round-trips through the decoder") {
+    chmicro::http::HpackEncoder encoder;
+    chmicro::http::HpackDecoder decoder;
+    for (int round = 0; round < 3; ++round) {
+        std::string block;
+        encoder.Begin(block);
+        encoder.Encode(":status", "200", block);
+        encoder.Encode("content-type", "application/json; charset=utf-8", block);
+        encoder.Encode("x-request-id", "r" + std::to_string(round), block, false);
+        encoder.Encode("content-length", "", block);
+
+        std::vector<HeaderField> fields;
+        REQUIRE(decoder.Decode(block, fields).ok());
+        REQUIRE(fields.size() == 4);
+        REQUIRE(Has(fields, 0, ":status", "200"));
+        REQUIRE(Has(fields, 1, "content-type", "application/json; charset=utf-8"));
+        REQUIRE(Has(fields, 2, "x-request-id", "r" + std::to_string(round)));
+        REQUIRE(Has(fields, 3, "content-length", ""));
+        if (round > 0) {
+            // Only the unindexed field is spelled out again; the rest are one-byte indexes.
+            REQUIRE(block.size() < 24);
+        }
+    }
+    REQUIRE(encoder.Table().Size() == decoder.Table().Size());
+
+    // A smaller peer table is announced at the start of the next block.
+    encoder.SetMaxTableSize(0);
+    std::string block;
+    encoder.Begin(block);
+    encoder.Encode("content-type", "text/plain", block);
+    std::vector<HeaderField> fields;
+    REQUIRE(decoder.Decode(block, fields).ok());
+    REQUIRE(decoder.Table().Count() == 0);
+}
+
+TEST_CASE("HPACK rejects malformed blocks") {
+    std::vector<HeaderField> fields;
+    // Index 70 is past the static table with an empty dynamic table.
+    REQUIRE(!chmicro::http::HpackDecoder().Decode(FromHex("c6"), fields).ok());
+    // String length runs past the end of the block.
+    REQUIRE(!chmicro::http::HpackDecoder().Decode(FromHex("400a 6162"), fields).ok());
+    // Table size update above the advertised maximum.
+    REQUIRE(!chmicro::http::HpackDecoder(4096).Decode(FromHex("3fe1 3f"), fields).ok());
+
+    std::string decoded;
+    REQUIRE(!chmicro::http::HuffmanDecode(FromHex("ff ff ff ff"), decoded).ok());
+    std::string encoded;
+    chmicro::http::HuffmanEncode("www.example.com", encoded);
+    REQUIRE(encoded == FromHex("f1e3 c2e5 f23a 6ba0 ab90 f4ff"));
+    decoded.clear();
+    REQUIRE(chmicro::http::HuffmanDecode(encoded, decoded).ok());
+    REQUIRE(decoded == "www.example.com");
+}
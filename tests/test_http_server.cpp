@@ -0,0 +1,740 @@
+#include <chtest.hpp>
+
+#include <chmicro/core/metrics.h>
+#include <chmicro/http/hpack.h>
+#include <chmicro/http/http2.h>
+#include <chmicro/http/http_server.h>
+#include <chmicro/http/response_cache.h>
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/write.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using tcp = boost::asio::ip::tcp;
+
+// Real server on an ephemeral loopback port, run on its own thread.
+struct TestServer {
+    TestServer(chmicro::http::Router router, chmicro::http::HttpServerOptions options = {}) {
+        server = std::make_shared<chmicro::http::HttpServer>(ioc, chmicro::http::ListenAddress{"127.0.0.1", 0}, std::move(router), std::move(options));
+        REQUIRE(server->Start().ok());
+        thread = std::thread([this] { ioc.run(); });
+    }
+    ~TestServer() {
+        server->Stop();
+        ioc.stop();
+        thread.join();
+    }
+
+    tcp::socket Connect() {
+        tcp::socket s(client_ioc);
+        s.connect(tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), server->LocalPort()));
+        return s;
+    }
+
+    boost::asio::io_context ioc;
+    boost::asio::io_context client_ioc;
+    std::shared_ptr<chmicro::http::HttpServer> server;
+    std::thread thread;
+};
+
+void Send(tcp::socket& s, std::string_view data) {
+    boost::asio::write(s, boost::asio::buffer(data.data(), data.size()));
+}
+
+// Reads until the peer closes the connection.
+std::string ReadAll(tcp::socket& s) {
+    std::string out;
+    boost::system::error_code ec;
+    boost::asio::read(s, boost::asio::dynamic_buffer(out), ec);
+    return out;
+}
+
+// Reads exactly one header block (through the blank line).
+std::string ReadHead(tcp::socket& s) {
+    std::string out;
+    char c;
+    while (out.size() < 4 || out.compare(out.size() - 4, 4, "\r\n\r\n") != 0) {
+        boost::system::error_code ec;
+        if (boost::asio::read(s, boost::asio::buffer(&c, 1), ec) != 1) {
+            break;
+        }
+        out.push_back(c);
+    }
+    return out;
+}
+
+// Reads one response with a Content-Length body; returns the body.
+std::string ReadBody(tcp::socket& s) {
+    auto head = ReadHead(s);
+    auto at = head.find("Content-Length: ");
+    if (at == std::string::npos) {
+        return {};
+    }
+    std::string body(std::stoul(head.substr(at + 16)), '\0');
+    boost::system::error_code ec;
+    body.resize(boost::asio::read(s, boost::asio::buffer(body), ec));
+    return body;
+}
+
+bool Contains(std::string_view haystack, std::string_view needle) {
+    return haystack.find(needle) != std::string_view::npos;
+}
+
+// Minimal HTTP/2 client side: raw frames plus an HPACK codec.
+struct Frame {
+    std::uint8_t type = 0;
+    std::uint8_t flags = 0;
+    std::uint32_t stream = 0;
+    std::string payload;
+};
+
+std::string EncodeFrame(std::uint8_t type, std::uint8_t flags, std::uint32_t stream, std::string_view payload) {
+    std::string out;
+    out.push_back(static_cast<char>(payload.size() >> 16));
+    out.push_back(static_cast<char>(payload.size() >> 8));
+    out.push_back(static_cast<char>(payload.size()));
+    out.push_back(static_cast<char>(type));
+    out.push_back(static_cast<char>(flags));
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        out.push_back(static_cast<char>(stream >> shift));
+    }
+    out.append(payload);
+    return out;
+}
+
+std::string U32(std::uint32_t v) {
+    return {static_cast<char>(v >> 24), static_cast<char>(v >> 16), static_cast<char>(v >> 8), static_cast<char>(v)};
+}
+
+bool ReadFrame(tcp::socket& s, Frame& f) {
+    unsigned char head[9];
+    boost::system::error_code ec;
+    if (boost::asio::read(s, boost::asio::buffer(head), ec) != sizeof(head)) {
+        return false;
+    }
+    f.type = head[3];
+    f.flags = head[4];
+    f.stream = (std::uint32_t{head[5]} << 24 | std::uint32_t{head[6]} << 16 | std::uint32_t{head[7]} << 8 | head[8]) & 0x7fffffff;
+    f.payload.resize(std::size_t{head[0]} << 16 | std::size_t{head[1]} << 8 | head[2]);
+    return boost::asio::read(s, boost::asio::buffer(f.payload), ec) == f.payload.size();
+}
+
+struct H2Response {
+    std::vector<chmicro::http::HeaderField> headers;
+    std::string body;
+    bool done = false;
+
+    std::string_view Header(std::string_view name) const {
+        for (const auto& h : headers) {
+            if (h.name == name) {
+                return h.value;
+            }
+        }
+        return {};
+    }
+};
+
+struct H2Client {
+    explicit H2Client(tcp::socket socket) : s(std::move(socket)) {}
+
+    // Client preface and an empty SETTINGS frame.
+    void Start() { Send(s, std::string(chmicro::http::kHttp2Preface) + EncodeFrame(4, 0, 0, "")); }
+
+    void Request(std::uint32_t id, std::string_view method, std::string_view path, std::string_view body = {}) {
+        std::string out = EncodeFrame(1, body.empty() ? 0x5 : 0x4, id, Block(method, path));
+        if (!body.empty()) {
+            out += EncodeFrame(0, 0x1, id, body);
+        }
+        Send(s, out);
+    }
+
+    // HEADERS only; the body follows in DATA frames sent by the caller.
+    void Open(std::uint32_t id, std::string_view method, std::string_view path) {
+        Send(s, EncodeFrame(1, 0x4, id, Block(method, path)));
+    }
+
+    std::string Block(std::string_view method, std::string_view path) {
+        std::string block;
+        encoder.Begin(block);
+        encoder.Encode(":method", method, block);
+        encoder.Encode(":scheme", "http", block);
+        encoder.Encode(":path", path, block);
+        encoder.Encode(":authority", "t", block);
+        return block;
+    }
+
+    // Handles frames until `id` has ended; returns false if the connection ends first.
+    bool Await(std::uint32_t id) {
+        Frame f;
+        while (!responses[id].done && ReadFrame(s, f)) {
+            if (f.type == 1) {
+                decoder.Decode(f.payload, responses[f.stream].headers);
+            } else if (f.type == 0) {
+                responses[f.stream].body += f.payload;
+            } else if (f.type == 4 && (f.flags & 0x1) == 0) {
+                // The server may have closed already; what it sent is still read to the end.
+                boost::system::error_code ec;
+                auto ack = EncodeFrame(4, 0x1, 0, "");
+                boost::asio::write(s, boost::asio::buffer(ack), ec);
+            } else if (f.type == 7) {
+                goaway = true;
+            }
+            if ((f.type == 0 || f.type == 1) && (f.flags & 0x1) != 0) {
+                responses[f.stream].done = true;
+            }
+        }
+        return responses[id].done;
+    }
+
+    tcp::socket s;
+    chmicro::http::HpackEncoder encoder;
+    chmicro::http::HpackDecoder decoder;
+    std::map<std::uint32_t, H2Response> responses;
+    bool goaway = false;
+};
+
+} // namespace
+
+TEST_CASE("HttpServer answers oversized bodies with 413 before reading them") {
+    std::atomic<int> calls{0};
+    chmicro::http::Router r;
+    chmicro::http::RouteOptions small;
+    small.max_body_bytes = 16;
+    r.Post("/small", [&](const chmicro::http::Request&, chmicro::http::Response& resp) {
+        ++calls;
+        resp.body = "ok";
+    }, small);
+    TestServer srv(std::move(r));
+
+    // Announced length above the route cap: rejected from the head alone, and no 100 Continue.
+    auto s = srv.Connect();
+    Send(s, "POST /small HTTP/1.1\r\nHost: t\r\nContent-Length: 1000000\r\nExpect: 100-continue\r\n\r\n");
+    auto reply = ReadAll(s);
+    REQUIRE(reply.rfind("HTTP/1.1 413", 0) == 0);
+    REQUIRE(!Contains(reply, "100 Continue"));
+    REQUIRE(Contains(reply, "Connection: close"));
+
+    // Chunked body crossing the cap while it is read.
+    auto c = srv.Connect();
+    Send(c, "POST /small HTTP/1.1\r\nHost: t\r\nTransfer-Encoding: chunked\r\n\r\n20\r\n0123456789abcdef0123456789abcdef\r\n0\r\n\r\n");
+    REQUIRE(ReadAll(c).rfind("HTTP/1.1 413", 0) == 0);
+
+    // Within the cap the route runs and the connection stays usable.
+    auto k = srv.Connect();
+    Send(k, "POST /small HTTP/1.1\r\nHost: t\r\nContent-Length: 5\r\n\r\nhello"
+            "POST /small HTTP/1.1\r\nHost: t\r\nContent-Length: 5\r\nConnection: close\r\n\r\nhello");
+    auto both = ReadAll(k);
+    REQUIRE(both.rfind("HTTP/1.1 200", 0) == 0);
+    REQUIRE(Contains(std::string_view(both).substr(1), "HTTP/1.1 200"));
+    REQUIRE(calls.load() == 2);
+}
+
+TEST_CASE("HttpServer resumes a pipelined head that arrived in pieces") {
+    chmicro::http::Router r;
+    r.Post("/echo", [](const chmicro::http::Request& req, chmicro::http::Response& resp) {
+        resp.body = req.raw.body();
+    });
+    r.Get("/hi", [](const chmicro::http::Request&, chmicro::http::Response& resp) {
+        resp.body = "hi";
+    });
+    TestServer srv(std::move(r));
+
+    // The second request's head is cut after its first field when the first response is flushed.
+    auto s = srv.Connect();
+    for (int round = 0; round < 20; ++round) {
+        Send(s, "GET /hi HTTP/1.1\r\nHost: t\r\n\r\nPOST /echo HTTP/1.1\r\nHost: t\r\n");
+        REQUIRE(ReadBody(s) == "hi");
+        Send(s, "Content-Length: 5\r\n\r\nhello");
+        REQUIRE(ReadBody(s) == "hello");
+    }
+}
+
+TEST_CASE("HttpServer sends 100 Continue only to admitted requests") {
+    chmicro::http::Router r;
+    r.Post("/echo", [](const chmicro::http::Request& req, chmicro::http::Response& resp) {
+        resp.body = req.raw.body();
+    });
+    chmicro::http::HttpServerOptions opt;
+    opt.admission = [](const chmicro::http::Request& head, const chmicro::http::Route* route, chmicro::http::Response& resp) {
+        if (route == nullptr || head.Header("x-tenant") != "blocked") {
+            return true;
+        }
+        resp.status = 429;
+        resp.headers["Retry-After"] = "1";
+        return false;
+    };
+    TestServer srv(std::move(r), std::move(opt));
+
+    auto blocked = srv.Connect();
+    Send(blocked, "POST /echo HTTP/1.1\r\nHost: t\r\nx-tenant: blocked\r\nContent-Length: 5\r\nExpect: 100-continue\r\n\r\n");
+    auto reply = ReadAll(blocked);
+    REQUIRE(reply.rfind("HTTP/1.1 429", 0) == 0);
+    REQUIRE(Contains(reply, "Retry-After: 1\r\n"));
+    REQUIRE(!Contains(reply, "100 Continue"));
+
+    auto allowed = srv.Connect();
+    Send(allowed, "POST /echo HTTP/1.1\r\nHost: t\r\nContent-Length: 5\r\nExpect: 100-continue\r\nConnection: close\r\n\r\n");
+    REQUIRE(ReadHead(allowed) == "HTTP/1.1 100 Continue\r\n\r\n");
+    Send(allowed, "hello");
+    auto echoed = ReadAll(allowed);
+    REQUIRE(echoed.rfind("HTTP/1.1 200", 0) == 0);
+    REQUIRE(echoed.size() >= 5 && echoed.compare(echoed.size() - 5, 5, "hello") == 0);
+}
+
+TEST_CASE("HttpServer closes idle and slow connections") {
+    chmicro::http::Router r;
+    r.Post("/echo", [](const chmicro::http::Request& req, chmicro::http::Response& resp) {
+        resp.body = req.raw.body();
+    });
+    chmicro::http::HttpServerOptions opt;
+    opt.timer_tick = std::chrono::milliseconds(10);
+    opt.idle_timeout = std::chrono::milliseconds(100);
+    opt.header_timeout = std::chrono::milliseconds(100);
+    opt.body_timeout = std::chrono::milliseconds(100);
+    opt.min_rate_grace = std::chrono::milliseconds(150);
+    TestServer srv(std::move(r), std::move(opt));
+
+    auto timeouts = [](const char* reason) {
+        return chmicro::DefaultMetrics()
+            .CounterMetric("http_server_timeouts_total", "HTTP server connections closed by a deadline",
+                chmicro::MetricLabels{{{"reason", reason}}})
+            .Value();
+    };
+    auto idle = timeouts("idle");
+    auto header = timeouts("header");
+    auto body = timeouts("body");
+    auto min_rate = timeouts("min_rate");
+
+    // Nothing sent: the idle deadline closes the connection.
+    auto quiet = srv.Connect();
+    auto start = std::chrono::steady_clock::now();
+    REQUIRE(ReadAll(quiet).empty());
+    REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(2));
+    REQUIRE(timeouts("idle") == idle + 1);
+
+    // A head that never completes.
+    auto slow_head = srv.Connect();
+    Send(slow_head, "POST /echo HTTP/1.1\r\nHost: t\r\n");
+    REQUIRE(ReadAll(slow_head).empty());
+    REQUIRE(timeouts("header") == header + 1);
+
+    // A body that stops arriving.
+    auto slow_body = srv.Connect();
+    Send(slow_body, "POST /echo HTTP/1.1\r\nHost: t\r\nContent-Length: 10\r\n\r\nhel");
+    REQUIRE(ReadAll(slow_body).empty());
+    REQUIRE(timeouts("body") == body + 1);
+
+    // HTTP/2: an open stream does not keep the connection alive while its body stalls...
+    H2Client stalled(srv.Connect());
+    stalled.Start();
+    stalled.Open(1, "POST", "/echo");
+    start = std::chrono::steady_clock::now();
+    REQUIRE(!stalled.Await(1));
+    REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(2));
+    REQUIRE(timeouts("body") == body + 2);
+
+    // ...or trickles in below min_transfer_rate.
+    H2Client trickle(srv.Connect());
+    trickle.Start();
+    trickle.Open(1, "POST", "/echo");
+    for (int i = 0; i < 50; ++i) {
+        boost::system::error_code ec;
+        auto frame = EncodeFrame(0, 0, 1, "x");
+        boost::asio::write(trickle.s, boost::asio::buffer(frame), ec);
+        if (ec) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(40));
+    }
+    REQUIRE(!trickle.Await(1));
+    REQUIRE(timeouts("min_rate") == min_rate + 1);
+
+    // Requests that keep up are unaffected, including across keep-alive.
+    auto ok = srv.Connect();
+    Send(ok, "POST /echo HTTP/1.1\r\nHost: t\r\nContent-Length: 5\r\n\r\nhello");
+    REQUIRE(ReadHead(ok).rfind("HTTP/1.1 200", 0) == 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    Send(ok, "POST /echo HTTP/1.1\r\nHost: t\r\nContent-Length: 5\r\nConnection: close\r\n\r\nworld");
+    REQUIRE(Contains(ReadAll(ok), "HTTP/1.1 200"));
+}
+
+TEST_CASE("HttpServer drains connections without cutting requests") {
+    chmicro::http::Router r;
+    r.Get("/hi", [](const chmicro::http::Request&, chmicro::http::Response& resp) {
+        resp.body = "hi";
+    });
+    TestServer srv(std::move(r));
+
+    // One keep-alive connection that has been answered, one that has not sent anything yet.
+    auto served = srv.Connect();
+    Send(served, "GET /hi HTTP/1.1\r\nHost: t\r\n\r\n");
+    REQUIRE(ReadHead(served).rfind("HTTP/1.1 200", 0) == 0);
+    auto fresh = srv.Connect();
+    for (int i = 0; i < 200 && srv.server->ActiveConnections() < 2; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    REQUIRE(srv.server->ActiveConnections() == 2);
+
+    auto port = srv.server->LocalPort();
+    srv.server->Drain();
+
+    // The idle keep-alive connection is closed right away (its 2-byte body is still unread).
+    auto start = std::chrono::steady_clock::now();
+    REQUIRE(ReadAll(served) == "hi");
+    REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(2));
+
+    // The fresh one still gets its answer, marked as the last on the connection.
+    Send(fresh, "GET /hi HTTP/1.1\r\nHost: t\r\n\r\n");
+    auto reply = ReadAll(fresh);
+    REQUIRE(reply.rfind("HTTP/1.1 200", 0) == 0);
+    REQUIRE(Contains(reply, "Connection: close"));
+
+    // Nothing accepts any more.
+    boost::system::error_code ec;
+    tcp::socket late(srv.client_ioc);
+    late.connect(tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), port), ec);
+    REQUIRE(ec);
+
+    for (int i = 0; i < 200 && srv.server->ActiveConnections() > 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    REQUIRE(srv.server->ActiveConnections() == 0);
+}
+
+TEST_CASE("HttpServer survives clients that leave in the middle of a file") {
+    auto dir = std::filesystem::temp_directory_path() / ("chmicro_sendfile_" + std::to_string(std::rand()));
+    std::filesystem::create_directories(dir);
+    std::ofstream(dir / "big.bin", std::ios::binary) << std::string(16 * 1024 * 1024, 'x');
+    chmicro::http::Router r;
+    r.Static("/files/", dir.string());
+    r.Get("/hi", [](const chmicro::http::Request&, chmicro::http::Response& resp) {
+        resp.body = "hi";
+    });
+    {
+        TestServer srv(std::move(r));
+
+        // Closing with the body unread resets the connection while sendfile(2) is mid-file.
+        for (int i = 0; i < 4; ++i) {
+            auto s = srv.Connect();
+            Send(s, "GET /files/big.bin HTTP/1.1\r\nHost: t\r\n\r\n");
+            REQUIRE(ReadHead(s).rfind("HTTP/1.1 200", 0) == 0);
+            s.close();
+        }
+
+        auto k = srv.Connect();
+        Send(k, "GET /hi HTTP/1.1\r\nHost: t\r\nConnection: close\r\n\r\n");
+        REQUIRE(ReadAll(k).rfind("HTTP/1.1 200", 0) == 0);
+    }
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+}
+
+TEST_CASE("HttpServer does not wait on a reactor for a cached key being refreshed") {
+    chmicro::http::ResponseCacheOptions cache_opt;
+    cache_opt.name = "test_server_cache";
+    cache_opt.ttl = std::chrono::milliseconds(50);
+    cache_opt.coalesce_wait = std::chrono::seconds(5);
+    chmicro::http::ResponseCache cache(cache_opt);
+
+    std::mutex mu;
+    std::condition_variable cv;
+    bool hold = false;
+    bool entered = false;
+    std::atomic<int> calls{0};
+    auto handler = [&](const chmicro::http::Request& req, chmicro::http::Response& resp) {
+        {
+            std::unique_lock<std::mutex> lk(mu);
+            if (hold && !entered) {
+                entered = true;
+                cv.notify_all();
+                cv.wait(lk, [&] { return !hold; });
+            }
+        }
+        resp.body = std::string(req.raw.target()) + "#" + std::to_string(calls.fetch_add(1));
+    };
+    auto make_router = [&] {
+        chmicro::http::Router r;
+        r.Use(cache.AsMiddleware());
+        r.Get("/kv", handler);
+        return r;
+    };
+    TestServer srv(make_router());
+    auto get = [&](std::string_view target) {
+        auto s = srv.Connect();
+        Send(s, "GET " + std::string(target) + " HTTP/1.1\r\nHost: t\r\nConnection: close\r\n\r\n");
+        return ReadBody(s);
+    };
+
+    auto cached = get("/kv?key=a");
+    REQUIRE(cached == "/kv?key=a#0");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // Another thread refreshes the expired "a" and stalls in the handler.
+    auto side = make_router();
+    {
+        std::lock_guard<std::mutex> lk(mu);
+        hold = true;
+    }
+    std::thread leader([&] {
+        chmicro::http::Request req;
+        req.raw.method(boost::beast::http::verb::get);
+        req.raw.target("/kv?key=a");
+        req.BindTarget();
+        chmicro::http::Response resp;
+        side.Handle(req, resp);
+    });
+    {
+        std::unique_lock<std::mutex> lk(mu);
+        cv.wait(lk, [&] { return entered; });
+    }
+
+    // The reactor answers "a" from the expired copy and "b" normally, without waiting for the refresh.
+    auto start = std::chrono::steady_clock::now();
+    REQUIRE(get("/kv?key=a") == cached);
+    REQUIRE(get("/kv?key=b") == "/kv?key=b#1");
+    REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+    REQUIRE(cache.Stale() >= 1);
+
+    {
+        std::lock_guard<std::mutex> lk(mu);
+        hold = false;
+    }
+    cv.notify_all();
+    leader.join();
+    REQUIRE(get("/kv?key=a") == "/kv?key=a#2");
+}
+
+TEST_CASE("HttpServer multiplexes HTTP/2 streams over one connection") {
+    chmicro::http::Router r;
+    r.Get("/a", [](const chmicro::http::Request&, chmicro::http::Response& resp) {
+        resp.body = "alpha";
+    });
+    r.Post("/echo", [](const chmicro::http::Request& req, chmicro::http::Response& resp) {
+        resp.content_type = "text/plain; charset=utf-8";
+        resp.body = req.raw.body();
+    });
+    r.Get("/big", [](const chmicro::http::Request&, chmicro::http::Response& resp) {
+        resp.body.assign(100000, 'x');
+    });
+    TestServer srv(std::move(r));
+
+    H2Client c(srv.Connect());
+    c.Start();
+    c.Request(1, "GET", "/a");
+    c.Request(3, "POST", "/echo", "hello");
+    c.Request(5, "GET", "/missing");
+    REQUIRE(c.Await(1));
+    REQUIRE(c.Await(3));
+    REQUIRE(c.Await(5));
+    REQUIRE(c.responses[1].Header(":status") == "200");
+    REQUIRE(c.responses[1].body == "alpha");
+    REQUIRE(c.responses[3].Header("content-type") == "text/plain; charset=utf-8");
+    REQUIRE(c.responses[3].body == "hello");
+    REQUIRE(c.responses[5].Header(":status") == "404");
+
+    // On a fresh connection, the default 65535-byte windows stop the body until the client opens
+    // them further.
+    H2Client b(srv.Connect());
+    b.Start();
+    b.Request(1, "GET", "/big");
+    Frame f;
+    std::size_t received = 0;
+    while (received < 65535 && ReadFrame(b.s, f)) {
+        if (f.type == 0) {
+            received += f.payload.size();
+        }
+    }
+    REQUIRE(received == 65535);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    REQUIRE(b.s.available() == 0);
+    Send(b.s, EncodeFrame(8, 0, 0, U32(100000)) + EncodeFrame(8, 0, 1, U32(100000)));
+    REQUIRE(b.Await(1));
+    REQUIRE(received + b.responses[1].body.size() == 100000);
+}
+
+TEST_CASE("HttpServer ends HTTP/2 connections that flood it with control frames") {
+    chmicro::http::Router r;
+    r.Get("/hello", [](const chmicro::http::Request&, chmicro::http::Response& resp) {
+        resp.body = "hello";
+    });
+    TestServer srv(std::move(r));
+
+    // A few PINGs are answered and leave the connection usable.
+    H2Client polite(srv.Connect());
+    polite.Start();
+    Send(polite.s, EncodeFrame(6, 0, 0, "12345678") + EncodeFrame(6, 0, 0, "abcdefgh"));
+    polite.Request(1, "GET", "/hello");
+    REQUIRE(polite.Await(1));
+    REQUIRE(polite.responses[1].body == "hello");
+    REQUIRE(!polite.goaway);
+
+    // Thousands at once exceed the budget: GOAWAY with ENHANCE_YOUR_CALM, then the connection closes.
+    H2Client flood(srv.Connect());
+    std::string burst(chmicro::http::kHttp2Preface);
+    burst += EncodeFrame(4, 0, 0, "");
+    for (int i = 0; i < 5000; ++i) {
+        burst += EncodeFrame(6, 0, 0, "12345678");
+    }
+    boost::system::error_code ec;
+    boost::asio::write(flood.s, boost::asio::buffer(burst), ec);
+    Frame f;
+    std::uint32_t code = 0;
+    int pongs = 0;
+    bool goaway = false;
+    while (ReadFrame(flood.s, f)) {
+        if (f.type == 6) {
+            ++pongs;
+        } else if (f.type == 7 && f.payload.size() >= 8) {
+            goaway = true;
+            code = static_cast<std::uint32_t>(static_cast<unsigned char>(f.payload[7]));
+        }
+    }
+    REQUIRE(goaway);
+    REQUIRE(code == 11);
+    REQUIRE(pongs < 5000);
+}
+
+TEST_CASE("HttpServer upgrades h2c requests and refuses streams over the limit") {
+    chmicro::http::Router r;
+    r.Get("/a", [](const chmicro::http::Request& req, chmicro::http::Response& resp) {
+        resp.body = std::string(req.Header("x-tag"));
+    });
+    std::atomic<bool> release{false};
+    r.GetAsync("/wait", [&](const chmicro::http::Request&, chmicro::http::Response& resp) -> boost::asio::awaitable<void> {
+        boost::asio::steady_timer t(co_await boost::asio::this_coro::executor);
+        while (!release.load()) {
+            t.expires_after(std::chrono::milliseconds(5));
+            co_await t.async_wait(boost::asio::use_awaitable);
+        }
+        resp.body = "done";
+    });
+    chmicro::http::HttpServerOptions opt;
+    opt.http2_max_streams = 1;
+    TestServer srv(std::move(r), opt);
+
+    auto s = srv.Connect();
+    // SETTINGS_MAX_CONCURRENT_STREAMS = 100, SETTINGS_INITIAL_WINDOW_SIZE = 65535.
+    Send(s, "GET /a HTTP/1.1\r\nHost: t\r\nx-tag: up\r\nConnection: Upgrade, HTTP2-Settings\r\n"
+            "Upgrade: h2c\r\nHTTP2-Settings: AAMAAABkAAQAAP__\r\n\r\n");
+    REQUIRE(ReadHead(s).rfind("HTTP/1.1 101", 0) == 0);
+    H2Client c(std::move(s));
+    c.Start();
+    REQUIRE(c.Await(1));
+    REQUIRE(c.responses[1].Header(":status") == "200");
+    REQUIRE(c.responses[1].body == "up");
+
+    // Stream 3 holds the only slot, so stream 5 is refused.
+    c.Request(3, "GET", "/wait");
+    c.Request(5, "GET", "/a");
+    Frame f;
+    bool refused = false;
+    while (!refused && ReadFrame(c.s, f)) {
+        refused = f.type == 3 && f.stream == 5 && f.payload == U32(7);
+    }
+    REQUIRE(refused);
+    release = true;
+    REQUIRE(c.Await(3));
+    REQUIRE(c.responses[3].body == "done");
+
+    // Draining sends GOAWAY; the idle connection then closes.
+    srv.server->Drain();
+    REQUIRE(!c.Await(9));
+    REQUIRE(c.goaway);
+}
+
+TEST_CASE("HttpServer isolates a saturated route behind its bulkhead") {
+    chmicro::resilience::BulkheadOptions bulk_opt;
+    bulk_opt.name = "test_server";
+    bulk_opt.max_concurrent = 1;
+    bulk_opt.max_queue = 1;
+    bulk_opt.max_wait = std::chrono::milliseconds(100);
+    chmicro::http::RouteOptions slow_opt;
+    slow_opt.bulkhead = std::make_shared<chmicro::resilience::Bulkhead>(bulk_opt);
+
+    chmicro::http::Router r;
+    r.GetAsync("/slow", [](const chmicro::http::Request&, chmicro::http::Response& resp) -> boost::asio::awaitable<void> {
+        boost::asio::steady_timer t(co_await boost::asio::this_coro::executor, std::chrono::milliseconds(400));
+        co_await t.async_wait(boost::asio::use_awaitable);
+        resp.body = "slow";
+    }, slow_opt);
+    r.Get("/fast", [](const chmicro::http::Request&, chmicro::http::Response& resp) {
+        resp.body = "fast";
+    });
+    TestServer srv(std::move(r));
+    auto& bulkhead = *slow_opt.bulkhead;
+
+    auto get = [&](std::string_view path) {
+        auto s = srv.Connect();
+        Send(s, "GET " + std::string(path) + " HTTP/1.1\r\nHost: t\r\nConnection: close\r\n\r\n");
+        return s;
+    };
+    auto wait_for = [&](auto done) {
+        for (int i = 0; i < 200 && !done(); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    };
+
+    auto running = get("/slow");
+    wait_for([&] { return bulkhead.InFlight() == 1; });
+    auto queued = get("/slow");
+    wait_for([&] { return bulkhead.Queued() == 1; });
+    REQUIRE(bulkhead.Queued() == 1);
+
+    // Past the queue: answered at once.
+    auto full = get("/slow");
+    auto rejected = ReadAll(full);
+    REQUIRE(rejected.rfind("HTTP/1.1 503", 0) == 0);
+    REQUIRE(Contains(rejected, "Retry-After: 1"));
+
+    // Other routes do not wait for the saturated one.
+    auto start = std::chrono::steady_clock::now();
+    auto fast = get("/fast");
+    REQUIRE(Contains(ReadAll(fast), "fast"));
+    REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(200));
+
+    // The queued request gives up after max_wait.
+    REQUIRE(ReadAll(queued).rfind("HTTP/1.1 503", 0) == 0);
+    REQUIRE(Contains(ReadAll(running), "slow"));
+    wait_for([&] { return bulkhead.InFlight() == 0; });
+    REQUIRE(bulkhead.InFlight() == 0);
+
+    // HTTP/2 streams queue the same way: 1 runs, 3 waits for it, 5 is rejected, 7 is unaffected.
+    H2Client c(srv.Connect());
+    c.Start();
+    c.Request(1, "GET", "/slow");
+    wait_for([&] { return bulkhead.InFlight() == 1; });
+    c.Request(3, "GET", "/slow");
+    wait_for([&] { return bulkhead.Queued() == 1; });
+    c.Request(5, "GET", "/slow");
+    c.Request(7, "GET", "/fast");
+    REQUIRE(c.Await(5));
+    REQUIRE(c.Await(7));
+    REQUIRE(c.responses[5].Header(":status") == "503");
+    REQUIRE(c.responses[7].body == "fast");
+    REQUIRE(!c.responses[1].done);
+    REQUIRE(c.Await(3));
+    REQUIRE(c.responses[3].Header(":status") == "503");
+    REQUIRE(c.Await(1));
+    REQUIRE(c.responses[1].body == "slow");
+}
@@ -0,0 +1,224 @@
+#include <chtest.hpp>
+
+#include <chmicro/core/metrics.h>
+#include <chmicro/http/http_server.h>
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("Striped counters sum increments from every thread") {
+    chmicro::Counter counter(chmicro::CounterLayout::striped);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 10000; ++i) {
+                counter.Inc();
+            }
+            counter.Inc(5);
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    REQUIRE(counter.Value() == 8 * 10005);
+
+    // The layout is fixed by the first registration and does not change the exposition.
+    chmicro::MetricsRegistry registry;
+    auto& c = registry.CounterMetric("test_requests_total", "Requests", {{{"path", "/a"}}}, chmicro::CounterLayout::striped);
+    c.Inc(3);
+    REQUIRE(&registry.CounterMetric("test_requests_total", "Requests", {{{"path", "/a"}}}) == &c);
+    REQUIRE(registry.ToPrometheusText().find("test_requests_total{path=\"/a\"} 3\n") != std::string::npos);
+}
+
+TEST_CASE("Histogram merges concurrent observations into the same exposition") {
+    chmicro::MetricsRegistry registry;
+    auto& h = registry.HistogramMetric("test_latency_ms", "Latency", {1, 5, 10}, {{{"path", "/a"}}});
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 1000; ++i) {
+                h.Observe(0.5);  // le=1
+                h.Observe(7.25); // le=10
+                h.Observe(50);   // +Inf only
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    std::vector<std::uint64_t> counts;
+    double sum = 0.0;
+    std::uint64_t count = 0;
+    h.Snapshot(counts, sum, count);
+    REQUIRE(counts == (std::vector<std::uint64_t>{4000, 0, 4000}));
+    REQUIRE(count == 12000);
+    REQUIRE(sum == 4000 * (0.5 + 7.25 + 50));
+
+    auto text = registry.ToPrometheusText();
+    REQUIRE(text.find("# TYPE test_latency_ms histogram\n") != std::string::npos);
+    REQUIRE(text.find("test_latency_ms_bucket{le=\"1.000000\",path=\"/a\"} 4000\n") != std::string::npos);
+    REQUIRE(text.find("test_latency_ms_bucket{le=\"5.000000\",path=\"/a\"} 4000\n") != std::string::npos);
+    REQUIRE(text.find("test_latency_ms_bucket{le=\"10.000000\",path=\"/a\"} 8000\n") != std::string::npos);
+    REQUIRE(text.find("test_latency_ms_bucket{le=\"+Inf\",path=\"/a\"} 12000\n") != std::string::npos);
+    REQUIRE(text.find("test_latency_ms_sum{path=\"/a\"} 231000\n") != std::string::npos);
+    REQUIRE(text.find("test_latency_ms_count{path=\"/a\"} 12000\n") != std::string::npos);
+}
+
+TEST_CASE("Metric families hand out cached children shared with the registry") {
+    chmicro::MetricsRegistry registry;
+    auto& family = registry.CounterFamily("test_family_total", "Requests", {"path", "status"});
+    auto& ok = family.WithLabelValues({"/a", "200"});
+    REQUIRE(&family.WithLabelValues({"/a", "200"}) == &ok);
+    REQUIRE(&family.WithLabelValues({"/a", "404"}) != &ok);
+    REQUIRE(&registry.CounterFamily("test_family_total", "Requests", {"path", "status"}) == &family);
+    REQUIRE(&registry.CounterMetric("test_family_total", "Requests", {{{"path", "/a"}, {"status", "200"}}}) == &ok);
+    ok.Inc(2);
+    REQUIRE(registry.ToPrometheusText().find("test_family_total{path=\"/a\",status=\"200\"} 2\n") != std::string::npos);
+
+    bool threw = false;
+    try {
+        family.WithLabelValues({"/a"});
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    REQUIRE(threw);
+}
+
+TEST_CASE("Request metrics are labeled by route template") {
+    chmicro::http::Router router;
+    router.Get("/test_metrics/{id}", [](const chmicro::http::Request&, chmicro::http::Response&) {});
+    chmicro::http::detail::RequestMetrics metrics(router);
+
+    std::string_view path = "/test_metrics/42";
+    const auto* route = router.Match(boost::beast::http::verb::get, path);
+    REQUIRE(route != nullptr);
+    metrics.Record(route, 200, 0.1);
+    metrics.Record(route, 200, 0.1);
+    metrics.Record(route, 999, 0.1);
+    for (int i = 0; i < 3; ++i) {
+        metrics.Record(nullptr, 404, 0.1);
+    }
+
+    auto text = chmicro::DefaultMetrics().ToPrometheusText();
+    REQUIRE(text.find("http_server_requests_total{path=\"/test_metrics/{id}\",status=\"200\"} 2\n") != std::string::npos);
+    REQUIRE(text.find("http_server_request_ms_count{path=\"/test_metrics/{id}\"} 3\n") != std::string::npos);
+    REQUIRE(text.find("path=\"/test_metrics/42\"") == std::string::npos);
+    REQUIRE(text.find("http_server_requests_total{path=\"/test_metrics/{id}\",status=\"other\"} 1\n") != std::string::npos);
+    REQUIRE(text.find("http_server_requests_total{path=\"__unmatched__\",status=\"404\"} ") != std::string::npos);
+}
+
+TEST_CASE("LogLinearHistogram answers quantiles within its relative error") {
+    chmicro::LogLinearOptions opt;
+    REQUIRE(chmicro::LogLinearHistogram::BucketCount(opt) == 28 * 32);
+    for (double v : {0.0, 0.0005, 0.031, 1.0, 99.9, 100.1, 12345.678, 4e6}) {
+        auto i = chmicro::LogLinearHistogram::BucketIndex(opt, v);
+        REQUIRE(chmicro::LogLinearHistogram::BucketLower(opt, i) <= v);
+        REQUIRE(v < chmicro::LogLinearHistogram::BucketUpper(opt, i));
+    }
+
+    // 1..100000 us in ms: every quantile is known exactly.
+    chmicro::LogLinearHistogram a(opt);
+    chmicro::LogLinearHistogram b(opt);
+    for (int i = 1; i <= 100000; ++i) {
+        (i % 2 == 0 ? a : b).Observe(i / 1000.0);
+    }
+    auto snap = a.Snapshot();
+    snap.Merge(b.Snapshot());
+    REQUIRE(snap.count == 100000);
+    for (double q : {0.01, 0.5, 0.9, 0.99, 0.999, 1.0}) {
+        double exact = q * 100;
+        REQUIRE(std::abs(snap.Quantile(q) - exact) <= exact / 64);
+    }
+    // Far above the old fixed buckets' 100 ms.
+    chmicro::LogLinearHistogram slow(opt);
+    slow.Observe(2500);
+    REQUIRE(std::abs(slow.Snapshot().Quantile(0.99) - 2500) <= 2500.0 / 64);
+
+    chmicro::LogLinearOptions other;
+    other.precision_bits = 7;
+    auto mismatched = chmicro::LogLinearHistogram(other).Snapshot();
+    mismatched.count = 1;
+    bool threw = false;
+    try {
+        snap.Merge(mismatched);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    REQUIRE(threw);
+
+    chmicro::MetricsRegistry registry;
+    auto& h = registry.LogLinearFamily("test_log_linear_ms", "Latency", {"path"}).WithLabelValues({"/a"});
+    for (int i = 1; i <= 100; ++i) {
+        h.Observe(i);
+    }
+    auto text = registry.ToPrometheusText();
+    REQUIRE(text.find("# TYPE test_log_linear_ms summary\n") != std::string::npos);
+    REQUIRE(text.find("test_log_linear_ms{path=\"/a\",quantile=\"0.99\"} ") != std::string::npos);
+    REQUIRE(text.find("test_log_linear_ms_sum{path=\"/a\"} 5050\n") != std::string::npos);
+    REQUIRE(text.find("test_log_linear_ms_count{path=\"/a\"} 100\n") != std::string::npos);
+    auto series = registry.LogLinearSnapshots();
+    REQUIRE(series.size() == 1);
+    REQUIRE(series[0].name == "test_log_linear_ms");
+    REQUIRE(series[0].snapshot.Quantile(0.5) >= 49);
+    REQUIRE(series[0].snapshot.Quantile(0.5) <= 51);
+}
+
+TEST_CASE("Exposition groups series by name and renders OpenMetrics") {
+    chmicro::MetricsRegistry registry;
+    registry.CounterMetric("test_hits_total", "Hits", {{{"path", "/b"}}}).Inc(2);
+    registry.GaugeMetric("test_depth", "Queue\ndepth").Set(1.5);
+    registry.CounterMetric("test_hits_total", "Hits", {{{"path", "/a"}}}).Inc(1);
+    registry.CounterMetric("test_errors", "Errors").Inc(4);
+
+    auto text = registry.ToPrometheusText();
+    REQUIRE(text.find("# HELP test_depth Queue\\ndepth\n# TYPE test_depth gauge\ntest_depth 1.5\n") != std::string::npos);
+    REQUIRE(text.find("# HELP test_hits_total Hits\n# TYPE test_hits_total counter\n"
+                      "test_hits_total{path=\"/a\"} 1\ntest_hits_total{path=\"/b\"} 2\n")
+        != std::string::npos);
+    REQUIRE(text.find("# EOF") == std::string::npos);
+
+    std::string buffer = "kept:";
+    registry.WriteText(buffer, chmicro::ExpositionFormat::openmetrics);
+    REQUIRE(buffer.starts_with("kept:# HELP test_depth "));
+    REQUIRE(buffer.find("# TYPE test_hits counter\ntest_hits_total{path=\"/a\"} 1\n") != std::string::npos);
+    REQUIRE(buffer.find("# TYPE test_errors counter\ntest_errors_total 4\n") != std::string::npos);
+    REQUIRE(buffer.ends_with("# EOF\n"));
+    REQUIRE(chmicro::ExpositionContentType(chmicro::ExpositionFormat::openmetrics).starts_with("application/openmetrics-text"));
+}
+
+TEST_CASE("Series beyond a metric's limit fold into its overflow series") {
+    chmicro::MetricsRegistry registry;
+    registry.SetSeriesLimit("test_paths_total", 2);
+    auto& a = registry.CounterMetric("test_paths_total", "Paths", {{{"path", "/a"}}});
+    auto& b = registry.CounterMetric("test_paths_total", "Paths", {{{"path", "/b"}}});
+    REQUIRE(&a != &b);
+    auto& c = registry.CounterMetric("test_paths_total", "Paths", {{{"path", "/c"}}});
+    auto& d = registry.CounterMetric("test_paths_total", "Paths", {{{"path", "/d"}}});
+    REQUIRE(&c == &d);
+    // Existing series still resolve to themselves.
+    REQUIRE(&registry.CounterMetric("test_paths_total", "Paths", {{{"path", "/a"}}}) == &a);
+    c.Inc(2);
+
+    // Families stop caching once the limit is reached, so their children stay bounded too.
+    auto& family = registry.CounterFamily("test_family_paths_total", "Paths", {"path"});
+    registry.SetSeriesLimit("test_family_paths_total", 1);
+    auto& first = family.WithLabelValues({"/x"});
+    for (int i = 0; i < 100; ++i) {
+        REQUIRE(&family.WithLabelValues({"/y" + std::to_string(i)}) != &first);
+    }
+
+    // Other names keep the default limit.
+    REQUIRE(&registry.CounterMetric("test_other_total", "Other", {{{"path", "/c"}}})
+        != &registry.CounterMetric("test_other_total", "Other", {{{"path", "/d"}}}));
+
+    auto text = registry.ToPrometheusText();
+    REQUIRE(text.find("test_paths_total{path=\"__overflow__\"} 2\n") != std::string::npos);
+    REQUIRE(text.find("test_paths_total{path=\"/c\"}") == std::string::npos);
+    REQUIRE(text.find("metrics_series_overflow_total{metric=\"test_paths_total\"} 2\n") != std::string::npos);
+    REQUIRE(text.find("metrics_series_overflow_total{metric=\"test_family_paths_total\"} 100\n") != std::string::npos);
+    REQUIRE(text.find("path=\"/y") == std::string::npos);
+}
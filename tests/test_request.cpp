@@ -0,0 +1,119 @@
+#include <chtest.hpp>
+
+#include <chmicro/http/router.h>
+
+#include <memory_resource>
+#include <string>
+
+#include "alloc_counter.h"
+
+TEST_CASE("Request parses path and query lazily as views") {
+    chmicro::http::Request req;
+    req.raw.method(boost::beast::http::verb::get);
+    req.raw.target("/get?key=hot&empty=&flag&a=1&b=2&c=3&d=4&e=5&f=6&g=7");
+    req.BindTarget();
+
+    REQUIRE(req.path == "/get");
+    REQUIRE(req.Query("key") == "hot");
+    REQUIRE(req.Query("empty").empty());
+    REQUIRE(req.Query("g") == "7"); // beyond the inline capacity
+    REQUIRE(req.Query("missing").empty());
+
+    auto copy = req;
+    req.raw.target("/other");
+    req.BindTarget();
+    REQUIRE(copy.path == "/get");
+    REQUIRE(copy.Query("key") == "hot");
+}
+
+TEST_CASE("GET /get?key=hot path performs no heap allocation") {
+    chmicro::http::Router r;
+    int passed = 0;
+    auto count = [&](const chmicro::http::Request&, chmicro::http::Response&, auto next) {
+        ++passed;
+        next();
+    };
+    r.Use("first", count);
+    r.Use("second", count);
+    chmicro::http::RouteOptions opt;
+    opt.middleware = {chmicro::http::Compose(count, count)};
+    std::string_view seen;
+    r.Get("/get", [&](const chmicro::http::Request& req, chmicro::http::Response& resp) {
+        seen = req.Query("key");
+        resp.status = 200;
+    }, opt);
+
+    chmicro::http::Request req;
+    req.raw.method(boost::beast::http::verb::get);
+    req.raw.target("/get?key=hot");
+    req.raw.set(boost::beast::http::field::host, "localhost");
+    chmicro::http::Response resp;
+
+    AllocationCounter allocs;
+    req.BindTarget();
+    const auto* route = r.Match(req.raw.method(), req.path);
+    r.Handle(route, req, resp);
+    auto host = req.Header("host");
+    auto allocations = allocs.Count();
+
+    REQUIRE(route != nullptr);
+    REQUIRE(passed == 4);
+    REQUIRE(seen == "hot");
+    REQUIRE(host == "localhost");
+    REQUIRE(allocations == 0);
+}
+
+TEST_CASE("Matching a parameterized route performs no heap allocation") {
+    chmicro::http::Router r;
+    for (int i = 0; i < 50; ++i) {
+        r.Get("/api/v1/resource" + std::to_string(i) + "/{id}", [](const chmicro::http::Request&, chmicro::http::Response&) {});
+    }
+    std::string_view seen;
+    r.Get("/kv/{key}/meta/*rest", [&](const chmicro::http::Request& req, chmicro::http::Response&) {
+        seen = req.Param("rest");
+    });
+
+    chmicro::http::Request req;
+    req.raw.method(boost::beast::http::verb::get);
+    req.raw.target("/kv/hot/meta/a/b?x=1");
+    chmicro::http::Response resp;
+
+    AllocationCounter allocs;
+    req.BindTarget();
+    const auto* route = r.Match(req.raw.method(), req.path, &req.params);
+    r.Handle(route, req, resp);
+    auto key = req.Param("key");
+    auto allocations = allocs.Count();
+
+    REQUIRE(route != nullptr);
+    REQUIRE(key == "hot");
+    REQUIRE(seen == "a/b");
+    REQUIRE(allocations == 0);
+
+    // Params are offsets, so they follow the copied target.
+    auto copy = req;
+    req.raw.target("/elsewhere");
+    req.BindTarget();
+    REQUIRE(copy.Param("key") == "hot");
+}
+
+TEST_CASE("Request and Response allocate from the supplied arena") {
+    std::pmr::monotonic_buffer_resource arena;
+    chmicro::http::Request req(&arena);
+    chmicro::http::Response resp(&arena);
+
+    req.raw.target("/a/fairly/long/target/that/does/not/fit/in/sso?key=value");
+    req.BindTarget();
+    resp.SetJson("{\"message\":\"long enough to leave the small string buffer\"}");
+    resp.headers["x-request-id"] = "0123456789abcdef0123456789abcdef";
+
+    REQUIRE(req.Resource() == &arena);
+    REQUIRE(resp.body.get_allocator().resource() == &arena);
+
+    // Everything above came from the arena, not the global heap.
+    AllocationCounter allocs;
+    std::pmr::string scratch("handler scratch space that outgrows SSO", req.Resource());
+    resp.headers["x-extra"] = scratch;
+    auto allocations = allocs.Count();
+    REQUIRE(allocations == 0);
+}
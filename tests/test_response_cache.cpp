@@ -0,0 +1,220 @@
+#include <chtest.hpp>
+
+#include <chmicro/http/response_cache.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace {
+
+chmicro::http::Request MakeGet(std::string_view target) {
+    chmicro::http::Request req;
+    req.raw.method(boost::beast::http::verb::get);
+    req.raw.target({target.data(), target.size()});
+    req.BindTarget();
+    return req;
+}
+
+std::string Header(const chmicro::http::Response& resp, std::string_view name) {
+    auto it = resp.headers.find(std::pmr::string(name));
+    return it == resp.headers.end() ? std::string() : std::string(it->second);
+}
+
+} // namespace
+
+TEST_CASE("ResponseCache serves repeated GETs until the entry expires or is invalidated") {
+    chmicro::http::ResponseCacheOptions opt;
+    opt.ttl = std::chrono::milliseconds(50);
+    opt.name = "test_basic";
+    chmicro::http::ResponseCache cache(opt);
+
+    int calls = 0;
+    int seq = 0;
+    chmicro::http::Router r;
+    r.Use([&](const chmicro::http::Request&, chmicro::http::Response& resp, chmicro::http::Next next) {
+        resp.headers["x-request-id"] = std::to_string(++seq);
+        next();
+    });
+    r.Use(cache.AsMiddleware());
+    r.Get("/get", [&](const chmicro::http::Request& req, chmicro::http::Response& resp) {
+        ++calls;
+        resp.content_type = "text/plain";
+        resp.headers["x-version"] = std::to_string(calls);
+        resp.body = "value of " + std::string(req.Query("key"));
+    });
+
+    auto get = [&](std::string_view target) {
+        auto req = MakeGet(target);
+        chmicro::http::Response resp;
+        r.Handle(req, resp);
+        return resp;
+    };
+
+    auto first = get("/get?key=a");
+    auto second = get("/get?key=a");
+    REQUIRE(calls == 1);
+    REQUIRE(second.status == 200);
+    REQUIRE(second.body == "value of a");
+    REQUIRE(second.content_type == "text/plain");
+    REQUIRE(Header(second, "x-version") == "1");
+    // Set before the cache ran, so it stays per request.
+    REQUIRE(Header(second, "x-request-id") == "2");
+    REQUIRE(cache.Hits() == 1);
+    REQUIRE(cache.Misses() == 1);
+
+    get("/get?key=b");
+    REQUIRE(calls == 2);
+    REQUIRE(cache.Size() == 2);
+
+    cache.Invalidate("/get?key=a");
+    REQUIRE(get("/get?key=a").body == "value of a");
+    REQUIRE(calls == 3);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(80));
+    REQUIRE(Header(get("/get?key=a"), "x-version") == "4");
+
+    cache.Clear();
+    REQUIRE(cache.Size() == 0);
+    REQUIRE(cache.Bytes() == 0);
+}
+
+TEST_CASE("ResponseCache only stores cacheable responses") {
+    chmicro::http::ResponseCacheOptions opt;
+    opt.paths = {"/get"};
+    opt.name = "test_filter";
+    // Cache by key only, the way the KV example invalidates.
+    opt.key = [](const chmicro::http::Request& req) { return std::string(req.Query("key")); };
+    chmicro::http::ResponseCache cache(opt);
+
+    int calls = 0;
+    chmicro::http::Router r;
+    r.Use(cache.AsMiddleware());
+    auto handler = [&](const chmicro::http::Request& req, chmicro::http::Response& resp) {
+        ++calls;
+        resp.status = req.Query("key") == "missing" ? 404 : 200;
+        resp.body = "x";
+    };
+    r.Get("/get", handler);
+    r.Get("/other", handler);
+    r.Post("/get", handler);
+
+    auto run = [&](boost::beast::http::verb method, std::string_view target) {
+        auto req = MakeGet(target);
+        req.raw.method(method);
+        chmicro::http::Response resp;
+        r.Handle(req, resp);
+    };
+
+    for (int i = 0; i < 2; ++i) {
+        run(boost::beast::http::verb::get, "/get?key=missing");
+        run(boost::beast::http::verb::get, "/other?key=k");
+        run(boost::beast::http::verb::post, "/get?key=k");
+    }
+    REQUIRE(calls == 6);
+    REQUIRE(cache.Size() == 0);
+
+    run(boost::beast::http::verb::get, "/get?key=k&extra=1");
+    run(boost::beast::http::verb::get, "/get?key=k");
+    REQUIRE(calls == 7);
+    cache.Invalidate("k");
+    REQUIRE(cache.Size() == 0);
+}
+
+TEST_CASE("ResponseCache evicts least recently used entries beyond its budget") {
+    chmicro::http::ResponseCacheOptions opt;
+    opt.shards = 1;
+    opt.max_bytes = 3 * (1024 + 256);
+    opt.max_entry_bytes = 2048;
+    opt.name = "test_lru";
+    chmicro::http::ResponseCache cache(opt);
+
+    chmicro::http::Router r;
+    r.Use(cache.AsMiddleware());
+    r.Get("/blob", [&](const chmicro::http::Request& req, chmicro::http::Response& resp) {
+        resp.body.assign(req.Query("big") == "1" ? 4096 : 1024, 'x');
+    });
+    auto get = [&](std::string_view target) {
+        auto req = MakeGet(target);
+        chmicro::http::Response resp;
+        r.Handle(req, resp);
+    };
+
+    get("/blob?n=1");
+    get("/blob?n=2");
+    get("/blob?n=3");
+    REQUIRE(cache.Size() == 3);
+    get("/blob?n=1"); // now most recently used
+    get("/blob?n=4");
+    REQUIRE(cache.Size() == 3);
+    REQUIRE(cache.Bytes() <= opt.max_bytes);
+
+    auto hits = cache.Hits();
+    get("/blob?n=1");
+    REQUIRE(cache.Hits() == hits + 1);
+    get("/blob?n=2");
+    REQUIRE(cache.Hits() == hits + 1);
+
+    // Over max_entry_bytes: served but never stored.
+    get("/blob?big=1");
+    get("/blob?big=1");
+    REQUIRE(cache.Hits() == hits + 1);
+}
+
+TEST_CASE("ResponseCache coalesces concurrent misses and drops runs invalidated midway") {
+    chmicro::http::ResponseCacheOptions opt;
+    opt.name = "test_coalesce";
+    chmicro::http::ResponseCache cache(opt);
+
+    std::atomic<int> calls{0};
+    std::atomic<bool> entered{false};
+    std::atomic<bool> invalidate{false};
+    std::atomic<int> answered{0};
+    chmicro::http::Router r;
+    r.Use(cache.AsMiddleware());
+    r.Get("/slow", [&](const chmicro::http::Request&, chmicro::http::Response& resp) {
+        calls.fetch_add(1);
+        entered = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        if (invalidate) {
+            // A write lands while this response is being built.
+            cache.Invalidate("/slow");
+        }
+        resp.body = "slow";
+    });
+
+    auto get = [&] {
+        auto req = MakeGet("/slow");
+        chmicro::http::Response resp;
+        r.Handle(req, resp);
+        if (resp.body == "slow") {
+            answered.fetch_add(1);
+        }
+    };
+
+    std::thread leader(get);
+    while (!entered) {
+        std::this_thread::yield();
+    }
+    std::thread a(get);
+    std::thread b(get);
+    leader.join();
+    a.join();
+    b.join();
+    REQUIRE(answered == 3);
+    REQUIRE(calls == 1);
+    REQUIRE(cache.Misses() == 1);
+    REQUIRE(cache.Coalesced() + cache.Hits() == 2);
+
+    cache.Clear();
+    invalidate = true;
+    get();
+    REQUIRE(calls == 2);
+    REQUIRE(cache.Size() == 0);
+    invalidate = false;
+    get();
+    get();
+    REQUIRE(calls == 3);
+}
@@ -0,0 +1,111 @@
+#include <chtest.hpp>
+
+#include <chmicro/http/response_writer.h>
+
+#include <boost/beast/http.hpp>
+
+#include <string>
+
+namespace {
+
+namespace beast_http = boost::beast::http;
+
+// Round-trips head + body through beast's parser.
+beast_http::response<beast_http::string_body> Parse(const std::pmr::string& head, const std::string& body) {
+    beast_http::response_parser<beast_http::string_body> parser;
+    parser.eager(true);
+    std::string wire(head.data(), head.size());
+    wire += body;
+    boost::beast::error_code ec;
+    parser.put(boost::asio::buffer(wire), ec);
+    REQUIRE(!ec);
+    REQUIRE(parser.is_done());
+    return parser.release();
+}
+
+} // namespace
+
+TEST_CASE("AppendResponseHead produces a parseable header block") {
+    chmicro::http::Response resp;
+    resp.status = 404;
+    resp.SetJson("{\"error\":\"not_found\"}");
+    resp.headers["x-request-id"] = "abc";
+    auto trace = chmicro::TraceContext::NewRoot();
+
+    std::pmr::string head;
+    chmicro::http::AppendResponseHead(head, 11, resp, trace, true);
+    auto msg = Parse(head, std::string(resp.body));
+
+    REQUIRE(msg.result_int() == 404);
+    REQUIRE(msg.reason() == "Not Found");
+    REQUIRE(msg[beast_http::field::server] == "chmicro/0.1");
+    REQUIRE(msg[beast_http::field::content_type] == "application/json; charset=utf-8");
+    REQUIRE(msg["traceparent"] == trace.ToTraceParent());
+    REQUIRE(msg["x-request-id"] == "abc");
+    REQUIRE(msg.body() == "{\"error\":\"not_found\"}");
+    REQUIRE(msg.keep_alive());
+    REQUIRE(msg[beast_http::field::date].size() == 29);
+}
+
+TEST_CASE("AppendResponseHead follows HTTP/1.0 and 1.1 keep-alive rules") {
+    chmicro::http::Response resp;
+    resp.body = "ok";
+    chmicro::TraceContext none;
+
+    std::pmr::string close11;
+    chmicro::http::AppendResponseHead(close11, 11, resp, none, false);
+    REQUIRE(close11.find("Connection: close\r\n") != std::pmr::string::npos);
+    REQUIRE(close11.find("traceparent") == std::pmr::string::npos);
+
+    std::pmr::string keep10;
+    chmicro::http::AppendResponseHead(keep10, 10, resp, none, true);
+    REQUIRE(keep10.rfind("HTTP/1.0 200 OK\r\n", 0) == 0);
+    REQUIRE(keep10.find("Connection: keep-alive\r\n") != std::pmr::string::npos);
+
+    std::pmr::string keep11;
+    chmicro::http::AppendResponseHead(keep11, 11, resp, none, true);
+    REQUIRE(keep11.find("Connection:") == std::pmr::string::npos);
+}
+
+TEST_CASE("AppendResponseHead omits body framing for 204, 304 and 1xx") {
+    chmicro::http::Response resp;
+    resp.status = 204;
+    chmicro::TraceContext none;
+
+    std::pmr::string head;
+    chmicro::http::AppendResponseHead(head, 11, resp, none, true);
+    REQUIRE(head.rfind("HTTP/1.1 204 No Content\r\n", 0) == 0);
+    REQUIRE(head.find("Content-Length") == std::pmr::string::npos);
+    REQUIRE(head.find("Transfer-Encoding") == std::pmr::string::npos);
+    REQUIRE(head.find("Connection:") == std::pmr::string::npos);
+    auto msg = Parse(head, "");
+    REQUIRE(msg.result_int() == 204);
+    REQUIRE(msg.keep_alive());
+
+    std::pmr::string streamed;
+    chmicro::http::AppendResponseHead(streamed, 11, resp, none, true, chmicro::http::BodyFraming::chunked);
+    REQUIRE(streamed.find("Transfer-Encoding") == std::pmr::string::npos);
+    REQUIRE(streamed.find("Connection:") == std::pmr::string::npos);
+
+    resp.status = 304;
+    std::pmr::string not_modified;
+    chmicro::http::AppendResponseHead(not_modified, 11, resp, none, true);
+    REQUIRE(not_modified.find("Content-Length") == std::pmr::string::npos);
+
+    REQUIRE(!chmicro::http::StatusHasBody(100));
+    REQUIRE(!chmicro::http::StatusHasBody(204));
+    REQUIRE(!chmicro::http::StatusHasBody(304));
+    REQUIRE(chmicro::http::StatusHasBody(200));
+    REQUIRE(chmicro::http::StatusHasBody(404));
+}
+
+TEST_CASE("HttpDate formats IMF-fixdate and caches per second") {
+    REQUIRE(chmicro::http::HttpDate::Format(784111777) == "Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n");
+
+    auto a = chmicro::http::HttpDate::Line();
+    auto b = chmicro::http::HttpDate::Line();
+    REQUIRE(a.data() == b.data());
+    REQUIRE(a.size() == 37);
+
+    REQUIRE(chmicro::http::StatusPrefix(11, 999) == chmicro::http::StatusPrefix(11, 500));
+}
@@ -2,6 +2,15 @@
 
 #include <chmicro/http/router.h>
 
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+
+#include <string>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
 TEST_CASE("Router routes exact path") {
     chmicro::http::Router r;
     bool called = false;
@@ -36,3 +45,288 @@ TEST_CASE("Router returns 404 when missing") {
 
     REQUIRE(resp.status == 404);
 }
+
+TEST_CASE("Router runs async routes after middleware") {
+    chmicro::http::Router r;
+    int order = 0;
+    int mw_seen = 0;
+    int handler_seen = 0;
+
+    r.Use([&](const chmicro::http::Request&, chmicro::http::Response&, chmicro::http::Next next) {
+        mw_seen = ++order;
+        next();
+    });
+    r.GetAsync("/async", [&](const chmicro::http::Request&, chmicro::http::Response& resp) -> boost::asio::awaitable<void> {
+        handler_seen = ++order;
+        resp.status = 202;
+        co_return;
+    });
+
+    chmicro::http::Request req;
+    req.raw.method(boost::beast::http::verb::get);
+    req.path = "/async";
+    chmicro::http::Response resp;
+
+    const auto* route = r.Match(boost::beast::http::verb::get, "/async");
+    REQUIRE(route != nullptr);
+    REQUIRE(route->is_async());
+
+    boost::asio::io_context ioc;
+    boost::asio::co_spawn(ioc, r.HandleAsync(route, req, resp), boost::asio::detached);
+    ioc.run();
+
+    REQUIRE(mw_seen == 1);
+    REQUIRE(handler_seen == 2);
+    REQUIRE(resp.status == 202);
+}
+
+namespace {
+
+// Serves a fixed body in pieces and records what the handler streams back.
+class FakeBody final : public chmicro::http::BodyReader {
+public:
+    explicit FakeBody(std::vector<std::string> pieces) : pieces_(std::move(pieces)) {}
+
+    boost::asio::awaitable<chmicro::Result<std::string_view>> Read() override {
+        if (next_ == pieces_.size()) {
+            co_return std::string_view{};
+        }
+        co_return std::string_view(pieces_[next_++]);
+    }
+    bool Done() const override { return next_ == pieces_.size(); }
+
+private:
+    std::vector<std::string> pieces_;
+    std::size_t next_ = 0;
+};
+
+class FakeStream final : public chmicro::http::ResponseStream {
+public:
+    boost::asio::awaitable<chmicro::Status> Write(std::string_view data) override {
+        started_ = true;
+        written.emplace_back(data);
+        co_return chmicro::Status::Ok();
+    }
+    bool Started() const override { return started_; }
+
+    std::vector<std::string> written;
+
+private:
+    bool started_ = false;
+};
+
+} // namespace
+
+TEST_CASE("Router streams request and response bodies") {
+    chmicro::http::Router r;
+    r.Use([&](const chmicro::http::Request&, chmicro::http::Response& resp, chmicro::http::Next next) {
+        resp.headers["x-mw"] = "1";
+        next();
+    });
+    r.PostStream("/echo", [](const chmicro::http::Request&, chmicro::http::BodyReader& body, chmicro::http::Response& resp,
+                             chmicro::http::ResponseStream& out) -> boost::asio::awaitable<void> {
+        resp.content_type = "text/plain";
+        while (true) {
+            auto chunk = co_await body.Read();
+            if (!chunk.ok() || chunk.value().empty()) {
+                break;
+            }
+            co_await out.Write(chunk.value());
+        }
+    });
+
+    const auto* route = r.Match(boost::beast::http::verb::post, "/echo");
+    REQUIRE(route != nullptr);
+    REQUIRE(route->is_stream());
+
+    chmicro::http::Request req;
+    req.raw.method(boost::beast::http::verb::post);
+    req.path = "/echo";
+    chmicro::http::Response resp;
+    FakeBody body({"ab", "cde", "f"});
+    FakeStream out;
+
+    boost::asio::io_context ioc;
+    boost::asio::co_spawn(ioc, r.HandleStream(route, req, body, resp, out), boost::asio::detached);
+    ioc.run();
+
+    REQUIRE(body.Done());
+    REQUIRE(out.Started());
+    REQUIRE(out.written.size() == 3);
+    REQUIRE(out.written[1] == "cde");
+    REQUIRE(resp.headers["x-mw"] == "1");
+
+    // The synchronous entry point refuses stream routes instead of calling them without a body.
+    chmicro::http::Response sync_resp;
+    r.Handle(route, req, sync_resp);
+    REQUIRE(sync_resp.status == 500);
+}
+
+namespace {
+
+// Matches `path` against `r` and returns the handler's body, or "404".
+std::string Dispatch(const chmicro::http::Router& r, boost::beast::http::verb method, std::string_view path) {
+    chmicro::http::Request req;
+    req.raw.method(method);
+    req.path = path;
+    chmicro::http::Response resp;
+    r.Handle(req, resp);
+    return resp.status == 404 ? "404" : std::string(resp.body);
+}
+
+chmicro::http::Handler Echo(std::string name, std::vector<std::string> params = {}) {
+    return [name = std::move(name), params = std::move(params)](const chmicro::http::Request& req, chmicro::http::Response& resp) {
+        std::string body = name;
+        for (const auto& p : params) {
+            body += " " + p + "=" + std::string(req.Param(p));
+        }
+        resp.body = body;
+    };
+}
+
+} // namespace
+
+TEST_CASE("Router captures parameter and wildcard segments") {
+    chmicro::http::Router r;
+    r.Get("/kv/{key}", Echo("get", {"key"}));
+    r.Get("/users/{id}/posts/{post}", Echo("post", {"id", "post"}));
+    r.Get("/files/*path", Echo("file", {"path"}));
+    r.Post("/kv/{key}", Echo("put", {"key"}));
+
+    const auto get = boost::beast::http::verb::get;
+    REQUIRE(Dispatch(r, get, "/kv/hot") == "get key=hot");
+    REQUIRE(Dispatch(r, boost::beast::http::verb::post, "/kv/hot") == "put key=hot");
+    REQUIRE(Dispatch(r, get, "/users/7/posts/42") == "post id=7 post=42");
+    REQUIRE(Dispatch(r, get, "/files/a/b/c.txt") == "file path=a/b/c.txt");
+    REQUIRE(Dispatch(r, get, "/files/") == "file path=");
+
+    // A parameter is one non-empty segment.
+    REQUIRE(Dispatch(r, get, "/kv/") == "404");
+    REQUIRE(Dispatch(r, get, "/kv/a/b") == "404");
+    REQUIRE(Dispatch(r, get, "/users/7/posts") == "404");
+    REQUIRE(Dispatch(r, get, "/files") == "404");
+
+    chmicro::http::PathParams params;
+    const auto* route = r.Match(get, "/users/alice/posts/1", &params);
+    REQUIRE(route != nullptr);
+    REQUIRE(route->path == "/users/{id}/posts/{post}");
+    REQUIRE(params.count == 2);
+    REQUIRE(params.slots[0].name == "id");
+    REQUIRE(params.slots[0].offset == 7);
+    REQUIRE(params.slots[0].length == 5);
+}
+
+TEST_CASE("Router prefers literal segments and backtracks") {
+    chmicro::http::Router r;
+    r.Get("/users/me", Echo("me"));
+    r.Get("/users/{id}", Echo("user", {"id"}));
+    r.Get("/users/{id}/settings", Echo("settings", {"id"}));
+    r.Get("/users/me/settings/{tab}", Echo("tab", {"tab"}));
+    r.Get("/static/*rest", Echo("static", {"rest"}));
+    r.Get("/static/index.html", Echo("index"));
+    r.Get("/", Echo("root"));
+
+    const auto get = boost::beast::http::verb::get;
+    REQUIRE(Dispatch(r, get, "/users/me") == "me");
+    REQUIRE(Dispatch(r, get, "/users/mel") == "user id=mel");
+    REQUIRE(Dispatch(r, get, "/users/m") == "user id=m");
+    // "/users/me/settings" has no literal route, so it falls back to the parameter branch.
+    REQUIRE(Dispatch(r, get, "/users/me/settings") == "settings id=me");
+    REQUIRE(Dispatch(r, get, "/users/me/settings/privacy") == "tab tab=privacy");
+    REQUIRE(Dispatch(r, get, "/static/index.html") == "index");
+    REQUIRE(Dispatch(r, get, "/static/index.htm") == "static rest=index.htm");
+    REQUIRE(Dispatch(r, get, "/") == "root");
+    REQUIRE(Dispatch(r, get, "") == "404");
+
+    // Same shape with another parameter name replaces the earlier route.
+    r.Get("/users/{name}", Echo("renamed", {"name"}));
+    REQUIRE(Dispatch(r, get, "/users/bob") == "renamed name=bob");
+
+    // Copies index their own routes.
+    chmicro::http::Router copy = r;
+    r = chmicro::http::Router();
+    REQUIRE(Dispatch(copy, get, "/users/5/settings") == "settings id=5");
+    REQUIRE(Dispatch(r, get, "/users/5/settings") == "404");
+}
+
+TEST_CASE("Router rejects malformed patterns") {
+    chmicro::http::Router r;
+    auto rejects = [&](std::string path) {
+        try {
+            r.Get(std::move(path), Echo("x"));
+        } catch (const std::invalid_argument&) {
+            return true;
+        }
+        return false;
+    };
+    REQUIRE(rejects("/files/*path/more"));
+    REQUIRE(rejects("/file.{ext}"));
+    REQUIRE(rejects("/a/{}"));
+    REQUIRE(rejects("/a/{id"));
+    REQUIRE(rejects("/{a}/{b}/{c}/{d}/{e}/{f}/{g}/{h}/{i}"));
+    REQUIRE(!rejects("/{a}/{b}/{c}/{d}/{e}/{f}/{g}/{h}"));
+}
+
+TEST_CASE("Router flattens middleware per route with named skips") {
+    chmicro::http::Router r;
+    std::string trace;
+    auto tag = [&](std::string name) {
+        return [&trace, name](const chmicro::http::Request&, chmicro::http::Response&, chmicro::http::Next next) {
+            trace += name + " ";
+            next();
+        };
+    };
+    r.Use("request-id", tag("id"));
+
+    chmicro::http::RouteOptions health;
+    health.skip_middleware = {"request-id"};
+    r.Get("/health", Echo("health"), health);
+
+    chmicro::http::RouteOptions cached;
+    cached.middleware = {tag("route")};
+    r.Get("/get", Echo("get"), cached);
+
+    // Added after the routes, still applies to them.
+    r.Use(tag("late"));
+
+    // Statically composed stages run in order and may stop the chain.
+    r.Get("/composed", Echo("composed"), [&] {
+        chmicro::http::RouteOptions o;
+        o.middleware = {chmicro::http::Compose(
+            [&](const chmicro::http::Request&, chmicro::http::Response&, auto next) {
+                trace += "a ";
+                next();
+            },
+            [&](const chmicro::http::Request& req, chmicro::http::Response& resp, auto next) {
+                trace += "b ";
+                if (req.Query("deny") == "1") {
+                    resp.status = 403;
+                    return;
+                }
+                next();
+            })};
+        return o;
+    }());
+
+    auto get = [&](std::string_view target) {
+        trace.clear();
+        chmicro::http::Request req;
+        req.raw.method(boost::beast::http::verb::get);
+        req.raw.target({target.data(), target.size()});
+        req.BindTarget();
+        chmicro::http::Response resp;
+        r.Handle(req, resp);
+        return resp;
+    };
+
+    REQUIRE(get("/health").body == "health");
+    REQUIRE(trace == "late ");
+    REQUIRE(get("/get").body == "get");
+    REQUIRE(trace == "id late route ");
+    REQUIRE(get("/composed").body == "composed");
+    REQUIRE(trace == "id late a b ");
+    auto denied = get("/composed?deny=1");
+    REQUIRE(denied.status == 403);
+    REQUIRE(denied.body.empty());
+    REQUIRE(trace == "id late a b ");
+}
@@ -0,0 +1,93 @@
+#include <chtest.hpp>
+
+#include <chmicro/http/file.h>
+#include <chmicro/http/router.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace {
+
+chmicro::http::RangeStatus Range(std::string_view header, std::uint64_t size, chmicro::http::ByteRange& out) {
+    return chmicro::http::ParseRange(header, size, out);
+}
+
+// Temporary directory holding one 1000-byte blob.
+struct BlobDir {
+    BlobDir() {
+        dir = std::filesystem::temp_directory_path() / ("chmicro_static_" + std::to_string(std::rand()));
+        std::filesystem::create_directories(dir / "sub");
+        std::ofstream(dir / "sub" / "blob.bin", std::ios::binary) << std::string(1000, 'x');
+    }
+    ~BlobDir() {
+        std::error_code ec;
+        std::filesystem::remove_all(dir, ec);
+    }
+
+    std::filesystem::path dir;
+};
+
+chmicro::http::Response Get(const chmicro::http::Router& r, std::string path) {
+    chmicro::http::Request req;
+    req.raw.method(boost::beast::http::verb::get);
+    req.path = path;
+    chmicro::http::Response resp;
+    r.Handle(req, resp);
+    return resp;
+}
+
+} // namespace
+
+TEST_CASE("ParseRange handles first-last, open and suffix ranges") {
+    chmicro::http::ByteRange r;
+    REQUIRE(Range("bytes=0-99", 1000, r) == chmicro::http::RangeStatus::satisfiable);
+    REQUIRE(r.offset == 0);
+    REQUIRE(r.length == 100);
+
+    REQUIRE(Range("bytes=900-", 1000, r) == chmicro::http::RangeStatus::satisfiable);
+    REQUIRE(r.offset == 900);
+    REQUIRE(r.length == 100);
+
+    REQUIRE(Range("bytes=-10", 1000, r) == chmicro::http::RangeStatus::satisfiable);
+    REQUIRE(r.offset == 990);
+    REQUIRE(r.length == 10);
+
+    REQUIRE(Range("bytes=500-5000", 1000, r) == chmicro::http::RangeStatus::satisfiable);
+    REQUIRE(r.length == 500);
+
+    REQUIRE(Range("bytes=1000-", 1000, r) == chmicro::http::RangeStatus::unsatisfiable);
+    REQUIRE(Range("bytes=0-1,5-6", 1000, r) == chmicro::http::RangeStatus::none);
+    REQUIRE(Range("items=0-1", 1000, r) == chmicro::http::RangeStatus::none);
+    REQUIRE(Range("bytes=9-3", 1000, r) == chmicro::http::RangeStatus::none);
+}
+
+TEST_CASE("Router::Static serves files as zero-copy bodies with ranges") {
+    BlobDir blobs;
+    chmicro::http::Router r;
+    r.Static("/blobs/", blobs.dir.string());
+
+    auto resp = Get(r, "/blobs/sub/blob.bin");
+    REQUIRE(resp.status == 200);
+    REQUIRE(resp.file != nullptr);
+    REQUIRE(resp.body.empty());
+    REQUIRE(resp.BodySize() == 1000);
+    REQUIRE(resp.content_type == "application/octet-stream");
+
+    resp.ApplyRange("bytes=100-199");
+    REQUIRE(resp.status == 206);
+    REQUIRE(resp.file_offset == 100);
+    REQUIRE(resp.file_length == 100);
+    REQUIRE(resp.headers["Content-Range"] == "bytes 100-199/1000");
+
+    auto whole = Get(r, "/blobs/sub/blob.bin");
+    whole.ApplyRange("bytes=2000-");
+    REQUIRE(whole.status == 416);
+    REQUIRE(whole.file == nullptr);
+    REQUIRE(whole.headers["Content-Range"] == "bytes */1000");
+
+    REQUIRE(Get(r, "/blobs/missing.bin").status == 404);
+    REQUIRE(Get(r, "/blobs/../etc/passwd").status == 404);
+    REQUIRE(Get(r, "/blobs/sub").status == 404);
+}
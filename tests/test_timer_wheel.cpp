@@ -0,0 +1,95 @@
+#include <chtest.hpp>
+
+#include <chmicro/runtime/timer_wheel.h>
+
+#include <boost/asio/io_context.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+namespace {
+
+using namespace std::chrono_literals;
+
+// Runs `ioc` until `done` holds or `limit` passes.
+template <class Pred>
+void RunUntil(boost::asio::io_context& ioc, Pred done, std::chrono::milliseconds limit = 2000ms) {
+    auto end = std::chrono::steady_clock::now() + limit;
+    while (!done() && std::chrono::steady_clock::now() < end) {
+        ioc.run_for(5ms);
+    }
+}
+
+} // namespace
+
+TEST_CASE("TimerWheel fires expired deadlines within a tick") {
+    boost::asio::io_context ioc;
+    auto wheel = std::make_shared<chmicro::TimerWheel>(ioc, 10ms, 16);
+    wheel->Start();
+
+    std::atomic<int> fired{0};
+    auto d = std::make_shared<chmicro::TimerWheel::Deadline>([&] { ++fired; });
+    auto start = std::chrono::steady_clock::now();
+    d->Arm(*wheel, 50ms);
+    RunUntil(ioc, [&] { return fired.load() > 0; });
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    REQUIRE(fired.load() == 1);
+    REQUIRE(d->Expired(*wheel));
+    REQUIRE(elapsed >= 40ms);
+    REQUIRE(elapsed < 500ms);
+    wheel->Stop();
+}
+
+TEST_CASE("TimerWheel follows re-armed, far and disarmed deadlines") {
+    boost::asio::io_context ioc;
+    // 16 slots of 10 ms: a 300 ms deadline wraps the wheel and is re-filed on the way.
+    auto wheel = std::make_shared<chmicro::TimerWheel>(ioc, 10ms, 16);
+    wheel->Start();
+
+    std::atomic<int> pushed{0};
+    auto moved = std::make_shared<chmicro::TimerWheel::Deadline>([&] { ++pushed; });
+    moved->Arm(*wheel, 30ms);
+    // Keep pushing it out; it must not fire while it keeps moving.
+    for (int i = 0; i < 10; ++i) {
+        ioc.run_for(10ms);
+        moved->Arm(*wheel, 30ms);
+    }
+    REQUIRE(pushed.load() == 0);
+
+    std::atomic<int> far{0};
+    auto far_deadline = std::make_shared<chmicro::TimerWheel::Deadline>([&] { ++far; });
+    auto start = std::chrono::steady_clock::now();
+    far_deadline->Arm(*wheel, 300ms);
+
+    std::atomic<int> cancelled{0};
+    auto off = std::make_shared<chmicro::TimerWheel::Deadline>([&] { ++cancelled; });
+    off->Arm(*wheel, 20ms);
+    off->Disarm();
+
+    RunUntil(ioc, [&] { return far.load() > 0; });
+    REQUIRE(far.load() == 1);
+    REQUIRE(std::chrono::steady_clock::now() - start >= 280ms);
+    REQUIRE(pushed.load() == 1);
+    REQUIRE(cancelled.load() == 0);
+
+    // Owners that went away are dropped silently.
+    std::atomic<int> gone{0};
+    {
+        auto d = std::make_shared<chmicro::TimerWheel::Deadline>([&] { ++gone; });
+        d->Arm(*wheel, 10ms);
+    }
+    RunUntil(ioc, [] { return false; }, 50ms);
+    REQUIRE(gone.load() == 0);
+
+    // Poke() reaches filed deadlines long before they are due.
+    std::atomic<int> poked{0};
+    auto later = std::make_shared<chmicro::TimerWheel::Deadline>([&] { ++poked; });
+    later->Arm(*wheel, 10000ms);
+    wheel->Poke();
+    REQUIRE(poked.load() == 1);
+    REQUIRE(!later->Expired(*wheel));
+    wheel->Stop();
+}
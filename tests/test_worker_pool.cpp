@@ -0,0 +1,64 @@
+#include <chtest.hpp>
+
+#include <chmicro/runtime/worker_pool.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+TEST_CASE("WorkerPool runs submitted tasks") {
+    chmicro::WorkerPool pool(chmicro::WorkerPoolOptions{2, 64});
+    pool.Start();
+
+    std::atomic<int> done{0};
+    for (int i = 0; i < 32; ++i) {
+        REQUIRE(pool.TrySubmit([&] { done.fetch_add(1); }));
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (done.load() < 32 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE(done.load() == 32);
+    pool.Stop();
+}
+
+TEST_CASE("WorkerPool rejects when the queue is full") {
+    chmicro::WorkerPool pool(chmicro::WorkerPoolOptions{1, 2});
+
+    // Not started: tasks stay queued, so the third one exceeds capacity.
+    REQUIRE(pool.TrySubmit([] {}));
+    REQUIRE(pool.TrySubmit([] {}));
+    REQUIRE(!pool.TrySubmit([] {}));
+    REQUIRE(pool.QueueDepth() == 2);
+}
+
+TEST_CASE("WorkerPool leaves nothing queued when Stop races submitters") {
+    for (int round = 0; round < 50; ++round) {
+        chmicro::WorkerPool pool(chmicro::WorkerPoolOptions{2, 64});
+        pool.Start();
+
+        std::atomic<bool> go{true};
+        std::vector<std::thread> submitters;
+        for (int i = 0; i < 3; ++i) {
+            submitters.emplace_back([&] {
+                while (go.load()) {
+                    pool.TrySubmit([] { std::this_thread::sleep_for(std::chrono::microseconds(50)); });
+                }
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        pool.Stop();
+        auto depth = pool.QueueDepth();
+        go = false;
+        for (auto& t : submitters) {
+            t.join();
+        }
+
+        // Everything accepted before Stop() was discarded with the queues; nothing after it was.
+        REQUIRE(depth == 0);
+        REQUIRE(pool.QueueDepth() == 0);
+        REQUIRE(!pool.TrySubmit([] {}));
+    }
+}